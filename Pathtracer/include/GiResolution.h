@@ -0,0 +1,141 @@
+// Resolution of the ReSTIR GI reservoirs, shared by the shaders
+// (Common_v6.hlsl, RayGen_v6_pass1/2/3) and the C++ side (src/Render, the
+// Renderer's sizes of m_reservoirBuffer_3 / _4). Written once in the subset
+// of HLSL and C++ both compile, like PixelMapping.h.
+//
+// GI_RESOLUTION picks the pixels that own a GI reservoir:
+//   FULL:         every pixel.
+//   HALF:         the top-left pixel of every 2x2 block, a quarter of them.
+//   CHECKERBOARD: the pixels with an even x + y, half of them.
+// Only owners trace a GI path and take part in GI reuse. Their reservoirs are
+// packed into a GiGridWidth x GiGridHeight grid laid out with PIXEL_MAPPING,
+// so g_Reservoirs_current_gi / _last_gi shrink to GiBufferCount elements.
+// Every other pixel reconstructs its GI from the owners around it
+// (GiUpsampleTap): their reservoirs are evaluated at its own surface and
+// weighted by GiUpsampleWeight, so taps across a silhouette or a crease drop
+// out. src/Render/GiUpsample is the CPU reference, tools/GiUpsampling
+// measures it against full resolution GI. Change it here (or pass -D to both
+// compilers).
+
+#ifndef PATHTRACER_GIRESOLUTION_H
+#define PATHTRACER_GIRESOLUTION_H
+
+#include "PixelMapping.h"
+
+#define GI_RESOLUTION_FULL 0
+#define GI_RESOLUTION_HALF 1
+#define GI_RESOLUTION_CHECKERBOARD 2
+
+#ifndef GI_RESOLUTION
+#define GI_RESOLUTION GI_RESOLUTION_FULL
+#endif
+
+// Relative view depth difference at which a tap's weight reaches 0
+#ifndef GI_UPSAMPLE_DEPTH_TOLERANCE
+#define GI_UPSAMPLE_DEPTH_TOLERANCE 0.1f
+#endif
+
+#define GI_UPSAMPLE_TAPS 4
+#define GI_NO_TAP 0xFFFFFFFFu
+
+inline PixelUint GiGridWidth(PixelUint mode, PixelUint width)
+{
+    return mode == GI_RESOLUTION_FULL ? width : (width + 1) / 2;
+}
+
+inline PixelUint GiGridHeight(PixelUint mode, PixelUint height)
+{
+    return mode == GI_RESOLUTION_HALF ? (height + 1) / 2 : height;
+}
+
+inline bool IsGiPixel(PixelUint mode, PixelUint x, PixelUint y)
+{
+    if (mode == GI_RESOLUTION_HALF)
+        return ((x | y) & 1u) == 0;
+    if (mode == GI_RESOLUTION_CHECKERBOARD)
+        return ((x + y) & 1u) == 0;
+    return true;
+}
+
+// Element of an owner in the GI buffers; distinct for distinct owners
+inline PixelUint GiPixelIndex(PixelUint mode, PixelUint width, PixelUint x, PixelUint y)
+{
+    PixelUint gx = mode == GI_RESOLUTION_FULL ? x : x / 2;
+    PixelUint gy = mode == GI_RESOLUTION_HALF ? y / 2 : y;
+    return PixelIndex(PIXEL_MAPPING, PIXEL_TILE_SIZE, GiGridWidth(mode, width), gx, gy);
+}
+
+// Elements the GI buffers need
+inline PixelUint GiBufferCount(PixelUint mode, PixelUint width, PixelUint height)
+{
+    return PixelBufferCount(PIXEL_MAPPING, PIXEL_TILE_SIZE, GiGridWidth(mode, width), GiGridHeight(mode, height));
+}
+
+// The owner that stands in for a pixel in GI reuse (reprojected and spatial
+// neighbors): the pixel itself if it owns a reservoir, otherwise the owner of
+// its 2x2 block (HALF) or its left neighbor, the right one on the first
+// column (CHECKERBOARD, width of at least 2)
+inline PixelUint GiOwnerX(PixelUint mode, PixelUint x, PixelUint y)
+{
+    if (mode == GI_RESOLUTION_HALF)
+        return x & ~1u;
+    if (mode == GI_RESOLUTION_CHECKERBOARD && ((x + y) & 1u) != 0)
+        return x > 0 ? x - 1 : x + 1;
+    return x;
+}
+
+inline PixelUint GiOwnerY(PixelUint mode, PixelUint y)
+{
+    return mode == GI_RESOLUTION_HALF ? (y & ~1u) : y;
+}
+
+// Tap k < GI_UPSAMPLE_TAPS of a pixel that owns no reservoir, as x | y << 16,
+// or GI_NO_TAP. HALF: the owners at the corners of the 2x2 owner cell around
+// the pixel, 2 or 4 of them, all at the same distance. CHECKERBOARD: the left,
+// right, upper and lower neighbors, which all are owners.
+inline PixelUint GiUpsampleTap(PixelUint mode, PixelUint width, PixelUint height, PixelUint x, PixelUint y,
+                               PixelUint k)
+{
+    int tx = int(x);
+    int ty = int(y);
+    if (mode == GI_RESOLUTION_CHECKERBOARD)
+    {
+        int offset = (k & 1u) != 0 ? 1 : -1;
+        if (k < 2)
+            tx += offset;
+        else
+            ty += offset;
+    }
+    else if (mode == GI_RESOLUTION_HALF)
+    {
+        PixelUint sx = k & 1u;
+        PixelUint sy = k >> 1;
+        // An even coordinate has the owner row / column itself, no second side
+        if ((sx != 0 && (x & 1u) == 0) || (sy != 0 && (y & 1u) == 0))
+            return GI_NO_TAP;
+        tx = int(x & ~1u) + int(2 * sx);
+        ty = int(y & ~1u) + int(2 * sy);
+    }
+    else
+    {
+        return GI_NO_TAP;
+    }
+    if (tx < 0 || ty < 0 || tx >= int(width) || ty >= int(height))
+        return GI_NO_TAP;
+    return PixelUint(tx) | (PixelUint(ty) << 16);
+}
+
+// Weight of a tap from the guides: a tent in the relative difference of the
+// distances to the camera times the normals' cosine to the 8th power
+inline float GiUpsampleWeight(float depth, float tapDepth, float cosNormal)
+{
+    float difference = tapDepth > depth ? tapDepth - depth : depth - tapDepth;
+    float relative = difference / (depth > 1e-6f ? depth : 1e-6f);
+    float wDepth = relative < GI_UPSAMPLE_DEPTH_TOLERANCE ? 1.0f - relative / GI_UPSAMPLE_DEPTH_TOLERANCE : 0.0f;
+    float c = cosNormal > 0.0f ? cosNormal : 0.0f;
+    float c2 = c * c;
+    float c4 = c2 * c2;
+    return wDepth * c4 * c4;
+}
+
+#endif //PATHTRACER_GIRESOLUTION_H
@@ -1,7 +1,9 @@
-// ReSTIR GI Pairwise MIS canonical sample
+// ReSTIR GI Pairwise MIS canonical sample. n are GI reservoir elements
+// (MapGiPixelID), n_sample the SampleData elements of the same pixels.
 float GenPairwiseMIS_canonical_GI(
     Reservoir_GI c,
     uint n[spatial_candidate_count],
+    uint n_sample[spatial_candidate_count],
     SampleData   sample_c,
     bool         rejected[spatial_candidate_count],
     float        M_sum,
@@ -24,10 +26,10 @@ float GenPairwiseMIS_canonical_GI(
     {
         if (!rejected[j])
         {
-            float n_M_min   = min(M_cap, g_Reservoirs_current_gi[n[j]].M);
-            float j_gi = Jacobian_Reconnection(sample_c, g_sample_current[n[j]], c.xn, c.nn);
+            float n_M_min   = min(M_cap, LoadReservoir_GI_M(g_Reservoirs_current_gi, n[j]));
+            float j_gi = Jacobian_Reconnection(sample_c, g_sample_current[n_sample[j]], c.xn, c.nn);
             float p_hat_from = 0.0f;
-            p_hat_from = LinearizeVector(GetP_Hat_GI(g_sample_current[n[j]].x1, g_sample_current[n[j]].n1, c.xn, c.nn, c.E3, g_sample_current[n[j]].o, matOpt, true)) * j_gi;
+            p_hat_from = LinearizeVector(GetP_Hat_GI(g_sample_current[n_sample[j]].x1, g_sample_current[n_sample[j]].n1, c.xn, c.nn, c.E3, g_sample_current[n_sample[j]].o, matOpt, true)) * j_gi;
             float m_den = c_m_num + (c_M_max * p_hat_from);
             if (m_den > 0.0f)
             {
@@ -43,6 +45,7 @@ float GenPairwiseMIS_canonical_GI(
 float GenPairwiseMIS_noncanonical_GI(
     Reservoir_GI c,
     uint n,
+    uint n_sample,
     SampleData   sample_c,
     float        M_sum,
     float        M_cap,
@@ -57,14 +60,14 @@ float GenPairwiseMIS_noncanonical_GI(
                                      sample_c.o, matOpt, false));
 
 
-    float j_gi = Jacobian_Reconnection(sample_c, g_sample_current[n], c.xn, c.nn);
+    float j_gi = Jacobian_Reconnection(sample_c, g_sample_current[n_sample], c.xn, c.nn);
     float p_hat_from = 0.0f;
-    p_hat_from = LinearizeVector(GetP_Hat_GI(g_sample_current[n].x1, g_sample_current[n].n1, c.xn, c.nn, c.E3, g_sample_current[n].o, matOpt, false)) * j_gi;
+    p_hat_from = LinearizeVector(GetP_Hat_GI(g_sample_current[n_sample].x1, g_sample_current[n_sample].n1, c.xn, c.nn, c.E3, g_sample_current[n_sample].o, matOpt, false)) * j_gi;
     float m_num      = (M_sum - c_M_min) * p_hat_from;
     float m_den      = m_num + (c_M_min * p_c);
 
     if (m_den > 0.0f) {
-        float n_M_min = min(M_cap, g_Reservoirs_current_gi[n].M);
+        float n_M_min = min(M_cap, LoadReservoir_GI_M(g_Reservoirs_current_gi, n));
         return clamp((n_M_min / M_sum) * (m_num / m_den), 0.0f, 1.0f);
     }
     else {
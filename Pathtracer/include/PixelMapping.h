@@ -0,0 +1,70 @@
+// Pixel to buffer element mapping of the per-pixel reservoir and SampleData
+// buffers (MapPixelID), shared by the shaders (Common_v6.hlsl) and the C++
+// side (src/Render/Sampler.cpp, Renderer buffer sizes). The functions below
+// are written once in the subset of HLSL and C++ both compile.
+//
+// PIXEL_MAPPING picks the scheme:
+//   ROW_MAJOR: y * width + x.
+//   TILED:     PIXEL_TILE_SIZE^2 tiles, row-major inside and across tiles.
+//   MORTON:    the same tiles with Z-order inside (PIXEL_TILE_SIZE a power
+//              of two), so 2x2, 4x4, ... blocks are contiguous at any scale.
+// The tiled schemes pad the buffers to whole tiles (PixelBufferCount).
+// tools/PixelMappingCache replays the passes' accesses through a cache model
+// for each scheme; change it here (or pass -D to both compilers).
+
+#ifndef PATHTRACER_PIXELMAPPING_H
+#define PATHTRACER_PIXELMAPPING_H
+
+#define PIXEL_MAPPING_ROW_MAJOR 0
+#define PIXEL_MAPPING_TILED 1
+#define PIXEL_MAPPING_MORTON 2
+
+#ifndef PIXEL_MAPPING
+#define PIXEL_MAPPING PIXEL_MAPPING_TILED
+#endif
+
+#ifndef PIXEL_TILE_SIZE
+#define PIXEL_TILE_SIZE 4
+#endif
+
+#ifdef __cplusplus
+#include <cstdint>
+typedef uint32_t PixelUint;
+#else
+#define PixelUint uint
+#endif
+
+// Spreads the low 16 bits of v to the even bits
+inline PixelUint PixelMortonSpread(PixelUint v)
+{
+    v &= 0xFFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+inline PixelUint PixelIndex(PixelUint scheme, PixelUint tileSize, PixelUint width, PixelUint x, PixelUint y)
+{
+    if (scheme == PIXEL_MAPPING_ROW_MAJOR)
+        return y * width + x;
+    PixelUint tileCountX = (width + tileSize - 1) / tileSize;
+    PixelUint tileIndex = (y / tileSize) * tileCountX + x / tileSize;
+    PixelUint localX = x % tileSize;
+    PixelUint localY = y % tileSize;
+    PixelUint localIndex = scheme == PIXEL_MAPPING_MORTON
+                               ? (PixelMortonSpread(localX) | (PixelMortonSpread(localY) << 1))
+                               : localY * tileSize + localX;
+    return tileIndex * (tileSize * tileSize) + localIndex;
+}
+
+// Elements a buffer indexed with PixelIndex needs
+inline PixelUint PixelBufferCount(PixelUint scheme, PixelUint tileSize, PixelUint width, PixelUint height)
+{
+    if (scheme == PIXEL_MAPPING_ROW_MAJOR)
+        return width * height;
+    return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize) * (tileSize * tileSize);
+}
+
+#endif //PATHTRACER_PIXELMAPPING_H
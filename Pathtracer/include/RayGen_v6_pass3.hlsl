@@ -7,10 +7,10 @@
 RWTexture2DArray<float4> gOutput : register(u0);
 RWTexture2D<float4> gPermanentData : register(u1);
 
-RWStructuredBuffer<Reservoir_DI> g_Reservoirs_current : register(u2);
-RWStructuredBuffer<Reservoir_DI> g_Reservoirs_last : register(u3);
-RWStructuredBuffer<Reservoir_GI> g_Reservoirs_current_gi : register(u4);
-RWStructuredBuffer<Reservoir_GI> g_Reservoirs_last_gi : register(u5);
+RESERVOIR_BUFFER(Reservoir_DI) g_Reservoirs_current : register(u2);
+RESERVOIR_BUFFER(Reservoir_DI) g_Reservoirs_last : register(u3);
+RESERVOIR_BUFFER(Reservoir_GI) g_Reservoirs_current_gi : register(u4);
+RESERVOIR_BUFFER(Reservoir_GI) g_Reservoirs_last_gi : register(u5);
 RWStructuredBuffer<SampleData> g_sample_current : register(u6);
 RWStructuredBuffer<SampleData> g_sample_last : register(u7);
 
@@ -41,6 +41,43 @@ cbuffer CameraParams : register(b0)
     float time;
 }
 
+// GI of a pixel that owns no GI reservoir (GI_RESOLUTION, GiResolution.h):
+// the current GI reservoirs of the owners around it, evaluated at its own
+// surface and averaged with the depth / normal weights of GiUpsampleWeight.
+// Owners on another material or an emitter are skipped; if no tap is left,
+// the owner standing in for the pixel is used alone. The current reservoirs
+// are not written in this pass, so the taps are race free.
+// src/Render/GiUpsample.cpp is the CPU reference.
+float3 UpsampleGI(uint2 launchIndex, uint2 dims, SampleData sdata_current, float3 init_orig, MaterialOptimized matOpt)
+{
+    float depth = length(sdata_current.x1 - init_orig);
+    float3 sum = float3(0.0f, 0.0f, 0.0f);
+    float weightSum = 0.0f;
+
+    [unroll]
+    for (uint k = 0; k < GI_UPSAMPLE_TAPS; k++)
+    {
+        uint tap = GiUpsampleTap(GI_RESOLUTION, dims.x, dims.y, launchIndex.x, launchIndex.y, k);
+        if (tap == GI_NO_TAP)
+            continue;
+        uint2 tapPos = uint2(tap & 0xFFFFu, tap >> 16);
+        SampleData sdata_tap = g_sample_current[MapPixelID(dims, tapPos)];
+        if (length(sdata_tap.L1) != 0.0f || sdata_tap.mID != sdata_current.mID)
+            continue;
+        float w = GiUpsampleWeight(depth, length(sdata_tap.x1 - init_orig), dot(sdata_current.n1, sdata_tap.n1));
+        if (w <= 0.0f)
+            continue;
+        Reservoir_GI r = LoadReservoir_GI(g_Reservoirs_current_gi, MapGiPixelID(dims, tapPos));
+        sum += w * GetP_Hat_GI(sdata_current.x1, sdata_current.n1, r.xn, r.nn, r.E3, sdata_current.o, matOpt, false) * r.W;
+        weightSum += w;
+    }
+    if (weightSum > 0.0f)
+        return sum / weightSum;
+
+    Reservoir_GI r = LoadReservoir_GI(g_Reservoirs_current_gi, MapGiPixelID(dims, GiOwner(launchIndex)));
+    return GetP_Hat_GI(sdata_current.x1, sdata_current.n1, r.xn, r.nn, r.E3, sdata_current.o, matOpt, false) * r.W;
+}
+
 // Second raygen shader is the ReSTIR pass. The reservoirs were filled in the first shader, now we recombine them.
 
 [shader("raygeneration")]
@@ -53,6 +90,8 @@ void RayGen3()
     uint2 launchIndex = DispatchRaysIndex().xy;
     float2 dims       = float2(DispatchRaysDimensions().xy);
     uint pixelIdx     = MapPixelID(dims, launchIndex);
+    bool ownsGI       = IsGiPixel(GI_RESOLUTION, launchIndex.x, launchIndex.y);
+    uint giPixelIdx   = MapGiPixelID(dims, launchIndex);
     SampleData sdata_current = g_sample_current[pixelIdx];
 
     // If the sample is flagged with L1 == 0, 0, 0, proceed with ReSTIR reuse
@@ -84,12 +123,13 @@ void RayGen3()
         // Spatial reuse: build two separate candidate lists — one for DI, one for GI.
         uint spatial_candidates_DI[spatial_candidate_count];
         bool rejected_DI[spatial_candidate_count];
-        uint spatial_candidates_GI[spatial_candidate_count];
+        uint spatial_candidates_GI[spatial_candidate_count]; // GI reservoir elements
+        uint spatial_samples_GI[spatial_candidate_count];    // their owners' SampleData
         bool rejected_GI[spatial_candidate_count];
 
         // Start with the primary reservoir's M.
-        float M_sum_DI = min(spatial_M_cap,    g_Reservoirs_current[pixelIdx].M);
-        float M_sum_GI = min(spatial_M_cap_GI, g_Reservoirs_current_gi[pixelIdx].M);
+        float M_sum_DI = min(spatial_M_cap,    LoadReservoir_DI_M(g_Reservoirs_current, pixelIdx));
+        float M_sum_GI = min(spatial_M_cap_GI, LoadReservoir_GI_M(g_Reservoirs_current_gi, giPixelIdx));
 
         // We store how many candidates we have for each reservoir
         int candidateFoundCount_DI = 0;
@@ -120,7 +160,7 @@ void RayGen3()
             bool candidateAccepted =
                 !RejectNormal(sdata_current.n1, g_sample_current[pixel_r].n1, 0.9f) &&
                 !RejectDistance(sdata_current.x1, g_sample_current[pixel_r].x1, init_orig, 0.1f) &&
-                IsValidReservoir(g_Reservoirs_current[pixel_r]) &&
+                IsValidReservoir(LoadReservoir_DI(g_Reservoirs_current, pixel_r)) &&
                 (length(g_sample_current[pixel_r].L1) == 0.0f) &&
                 (g_sample_current[pixel_r].mID != 4294967294) &&
                 (g_sample_current[pixel_r].mID == sdata_current.mID);
@@ -128,7 +168,7 @@ void RayGen3()
             if (candidateAccepted)
             {
                 spatial_candidates_DI[candidateFoundCount_DI] = pixel_r;
-                M_sum_DI += min(spatial_M_cap, g_Reservoirs_current[pixel_r].M);
+                M_sum_DI += min(spatial_M_cap, LoadReservoir_DI_M(g_Reservoirs_current, pixel_r));
                 rejected_DI[candidateFoundCount_DI] = false;
                 candidateFoundCount_DI++;
             }
@@ -141,32 +181,35 @@ void RayGen3()
             rejected_DI[v] = true;
         }
 
-        // Second loop: gather GI candidates
+        // Second loop: gather GI candidates, among the pixels that own a GI reservoir
         [loop]
-        for (int attempt = 0; attempt < spatial_max_tries && candidateFoundCount_GI < spatial_candidate_count; attempt++)
+        for (int attempt = 0; ownsGI && attempt < spatial_max_tries && candidateFoundCount_GI < spatial_candidate_count; attempt++)
         {
-            uint pixel_r = GetRandomPixelCircleWeighted(
+            uint2 neighbor = GiOwner(GetRandomPixelCircleWeighted_d(
                 spatial_radius,
                 DispatchRaysDimensions().x,
                 DispatchRaysDimensions().y,
                 launchIndex.x,
                 launchIndex.y,
                 seed
-            );
+            ));
+            uint pixel_r = MapPixelID(dims, neighbor);
+            uint gi_r = MapGiPixelID(dims, neighbor);
 
             // Evaluate GI candidate predicate
             bool candidateAcceptedGI =
+                any(neighbor != launchIndex) &&
                 matOpt.Pr_Pm_Ps_Pc.x > 0.3f &&
                 //!RejectNormal(sdata_current.n1, g_sample_current[pixel_r].n1, 0.5f) &&
                 !RejectDistance(sdata_current.x1, g_sample_current[pixel_r].x1, init_orig, 0.1f) &&
-                !RejectBelowSurface(normalize(g_Reservoirs_current_gi[pixel_r].xn - sdata_current.x1), sdata_current.n1) &&
-                !RejectWsum(g_Reservoirs_current_gi[pixel_r].w_sum, w_sum_threshold) &&
-                IsValidReservoir_GI(g_Reservoirs_current_gi[pixel_r]) &&
+                !RejectBelowSurface(normalize(LoadReservoir_GI_xn(g_Reservoirs_current_gi, gi_r) - sdata_current.x1), sdata_current.n1) &&
+                !RejectWsum(LoadReservoir_GI_w_sum(g_Reservoirs_current_gi, gi_r), w_sum_threshold) &&
+                IsValidReservoir_GI(LoadReservoir_GI(g_Reservoirs_current_gi, gi_r)) &&
                 !RejectJacobian(Jacobian_Reconnection(
                     g_sample_current[pixel_r],
                     sdata_current,
-                    g_Reservoirs_current_gi[pixel_r].xn,
-                    g_Reservoirs_current_gi[pixel_r].nn
+                    LoadReservoir_GI_xn(g_Reservoirs_current_gi, gi_r),
+                    LoadReservoir_GI_nn(g_Reservoirs_current_gi, gi_r)
                 ), j_threshold) &&
                 (length(g_sample_current[pixel_r].L1) == 0.0f) &&
                 (g_sample_current[pixel_r].mID != 4294967294) &&
@@ -174,8 +217,9 @@ void RayGen3()
 
             if (candidateAcceptedGI)
             {
-                spatial_candidates_GI[candidateFoundCount_GI] = pixel_r;
-                M_sum_GI += min(spatial_M_cap_GI, g_Reservoirs_current_gi[pixel_r].M);
+                spatial_candidates_GI[candidateFoundCount_GI] = gi_r;
+                spatial_samples_GI[candidateFoundCount_GI] = pixel_r;
+                M_sum_GI += min(spatial_M_cap_GI, LoadReservoir_GI_M(g_Reservoirs_current_gi, gi_r));
                 rejected_GI[candidateFoundCount_GI] = false;
                 candidateFoundCount_GI++;
             }
@@ -190,8 +234,8 @@ void RayGen3()
 
         // --------------------------------------------------------------------
         // Get the canonical (current pixel) DI and GI reservoirs
-        Reservoir_DI reservoir_current     = g_Reservoirs_current[pixelIdx];
-        Reservoir_GI reservoir_current_gi  = g_Reservoirs_current_gi[pixelIdx];
+        Reservoir_DI reservoir_current     = LoadReservoir_DI(g_Reservoirs_current, pixelIdx);
+        Reservoir_GI reservoir_current_gi  = LoadReservoir_GI(g_Reservoirs_current_gi, giPixelIdx);
         Reservoir_DI canonical            = reservoir_current;    // DI
         Reservoir_GI canonical_gi         = reservoir_current_gi; // GI
 
@@ -222,6 +266,7 @@ void RayGen3()
         float mi_c_gi = GenPairwiseMIS_canonical_GI(
             canonical_gi,
             spatial_candidates_GI,
+            spatial_samples_GI,
             sdata_current,
             rejected_GI,
             M_sum_GI,
@@ -260,22 +305,22 @@ void RayGen3()
                             GetP_Hat(
                                 sdata_current.x1,
                                 sdata_current.n1,
-                                g_Reservoirs_current[spatial_candidate].x2,
-                                g_Reservoirs_current[spatial_candidate].n2,
-                                g_Reservoirs_current[spatial_candidate].L2,
+                                LoadReservoir_DI_x2(g_Reservoirs_current, spatial_candidate),
+                                LoadReservoir_DI_n2(g_Reservoirs_current, spatial_candidate),
+                                LoadReservoir_DI_L2(g_Reservoirs_current, spatial_candidate),
                                 sdata_current.o,
                                 matOpt,
                                 false
                             ) *
-                            g_Reservoirs_current[spatial_candidate].W;
+                            LoadReservoir_DI_W(g_Reservoirs_current, spatial_candidate);
 
                 UpdateReservoir(
                     reservoir_current,
                     w_s,
-                    min(spatial_M_cap, g_Reservoirs_current[spatial_candidate].M),
-                    g_Reservoirs_current[spatial_candidate].x2,
-                    g_Reservoirs_current[spatial_candidate].n2,
-                    g_Reservoirs_current[spatial_candidate].L2,
+                    min(spatial_M_cap, LoadReservoir_DI_M(g_Reservoirs_current, spatial_candidate)),
+                    LoadReservoir_DI_x2(g_Reservoirs_current, spatial_candidate),
+                    LoadReservoir_DI_n2(g_Reservoirs_current, spatial_candidate),
+                    LoadReservoir_DI_L2(g_Reservoirs_current, spatial_candidate),
                     seed
                 );
             }
@@ -288,9 +333,11 @@ void RayGen3()
             if (!rejected_GI[v])
             {
                 uint spatial_candidate = spatial_candidates_GI[v];
+                uint spatial_sample = spatial_samples_GI[v];
                 float mi_s_gi = GenPairwiseMIS_noncanonical_GI(
                     canonical_gi,
                     spatial_candidate,
+                    spatial_sample,
                     sdata_current,
                     M_sum_GI,
                     spatial_M_cap,
@@ -299,32 +346,32 @@ void RayGen3()
 
                 // Jacobian for path reconnection
                 float j_gi = Jacobian_Reconnection(
-                    g_sample_current[spatial_candidate],
+                    g_sample_current[spatial_sample],
                     sdata_current,
-                    g_Reservoirs_current_gi[spatial_candidate].xn,
-                    g_Reservoirs_current_gi[spatial_candidate].nn
+                    LoadReservoir_GI_xn(g_Reservoirs_current_gi, spatial_candidate),
+                    LoadReservoir_GI_nn(g_Reservoirs_current_gi, spatial_candidate)
                 );
 
                 float3 f_gi = GetP_Hat_GI(
                     sdata_current.x1,
                     sdata_current.n1,
-                    g_Reservoirs_current_gi[spatial_candidate].xn,
-                    g_Reservoirs_current_gi[spatial_candidate].nn,
-                    g_Reservoirs_current_gi[spatial_candidate].E3,
+                    LoadReservoir_GI_xn(g_Reservoirs_current_gi, spatial_candidate),
+                    LoadReservoir_GI_nn(g_Reservoirs_current_gi, spatial_candidate),
+                    LoadReservoir_GI_E3(g_Reservoirs_current_gi, spatial_candidate),
                     sdata_current.o,
                     matOpt,
                     true
                 );
-                float w_s_gi = mi_s_gi * LinearizeVector(f_gi) * g_Reservoirs_current_gi[spatial_candidate].W * j_gi;
+                float w_s_gi = mi_s_gi * LinearizeVector(f_gi) * LoadReservoir_GI_W(g_Reservoirs_current_gi, spatial_candidate) * j_gi;
 
                 if(j_gi != 0.0f){
                     UpdateReservoir_GI(
                         reservoir_current_gi,
                         w_s_gi,
-                        min(spatial_M_cap_GI, g_Reservoirs_current_gi[spatial_candidate].M),
-                        g_Reservoirs_current_gi[spatial_candidate].xn,
-                        g_Reservoirs_current_gi[spatial_candidate].nn,
-                        g_Reservoirs_current_gi[spatial_candidate].E3,
+                        min(spatial_M_cap_GI, LoadReservoir_GI_M(g_Reservoirs_current_gi, spatial_candidate)),
+                        LoadReservoir_GI_xn(g_Reservoirs_current_gi, spatial_candidate),
+                        LoadReservoir_GI_nn(g_Reservoirs_current_gi, spatial_candidate),
+                        LoadReservoir_GI_E3(g_Reservoirs_current_gi, spatial_candidate),
                         seed
                     );
                 }
@@ -356,20 +403,27 @@ void RayGen3()
 
 
         // GI -----------------------------------------------------------------------------------
-        float3 f_gi_final = GetP_Hat_GI(
-            sdata_current.x1,
-            sdata_current.n1,
-            reservoir_current_gi.xn,
-            reservoir_current_gi.nn,
-            reservoir_current_gi.E3,
-            sdata_current.o,
-            matOpt,
-            false
-        );
+        if (ownsGI)
+        {
+            float3 f_gi_final = GetP_Hat_GI(
+                sdata_current.x1,
+                sdata_current.n1,
+                reservoir_current_gi.xn,
+                reservoir_current_gi.nn,
+                reservoir_current_gi.E3,
+                sdata_current.o,
+                matOpt,
+                false
+            );
 
-        float p_hat_gi = LinearizeVector(f_gi_final);
-        reservoir_current_gi.W = GetW_GI(reservoir_current_gi, p_hat_gi);
-        accumulation += f_gi_final * reservoir_current_gi.W;
+            float p_hat_gi = LinearizeVector(f_gi_final);
+            reservoir_current_gi.W = GetW_GI(reservoir_current_gi, p_hat_gi);
+            accumulation += f_gi_final * reservoir_current_gi.W;
+        }
+        else
+        {
+            accumulation += UpsampleGI(launchIndex, dims, sdata_current, init_orig, matOpt);
+        }
 
 
         // DEBUG-------------------------------
@@ -432,8 +486,9 @@ void RayGen3()
             averagedColor = float3(0, 1, 1); // cyan for infinity
 
         // Write out the final reservoir for potential temporal reuse next frame
-        g_Reservoirs_last[pixelIdx]     = reservoir_current;
-        g_Reservoirs_last_gi[pixelIdx]  = reservoir_current_gi;
+        StoreReservoir_DI(g_Reservoirs_last, pixelIdx, reservoir_current);
+        if (ownsGI)
+            StoreReservoir_GI(g_Reservoirs_last_gi, giPixelIdx, reservoir_current_gi);
         g_sample_last[pixelIdx]         = sdata_current;
 
         // Gamma correct
@@ -0,0 +1,198 @@
+// Reservoir layout shared by the shaders (Reservoir_v6.hlsl) and the C++ side
+// (src/Render/Reservoir.h, Renderer). Each reservoir is described once, as a
+// list of FIELD(struct, name, type, stream, offset in stream); the HLSL
+// structs and buffer accessors here and the C++ structs are generated from
+// it, so both sides always agree. The C++ static_asserts in Reservoir.h
+// check the resulting sizes and offsets.
+//
+// RESERVOIR_LAYOUT picks the storage of the per-pixel reservoir buffers:
+//   AOS: RWStructuredBuffer of 40 byte structs, the original layout.
+//   SOA: one RWByteAddressBuffer per reservoir buffer holding four streams
+//        back to back (positions, normals, radiance, weights: w_sum, W and
+//        M), so passes that only test M or w_sum read 12 of 44 bytes.
+// Change it here (or pass -DRESERVOIR_LAYOUT=1 to both compilers); the
+// renderer sizes the buffers and views from the same constants. AoS stays the
+// default: every pass reads at least three of the four streams, and the
+// random neighbor reads of the spatial pass touch one line per stream
+// (tools/ReservoirBandwidth replays the passes in both layouts).
+//
+// SampleData is listed the same way. SAMPLE_DATA_DEBUG keeps its float3 debug
+// channel, written by the init pass for visualizations and read by nothing
+// else; release builds of the renderer drop it (60 -> 48 bytes per pixel in
+// g_sample_current and g_sample_last) along with the init pass work that
+// fills it. CompileShaderLibrary passes the C++ value on to dxc.
+
+#ifndef PATHTRACER_RESERVOIRLAYOUT_H
+#define PATHTRACER_RESERVOIRLAYOUT_H
+
+#define RESERVOIR_LAYOUT_AOS 0
+#define RESERVOIR_LAYOUT_SOA 1
+
+#ifndef RESERVOIR_LAYOUT
+#define RESERVOIR_LAYOUT RESERVOIR_LAYOUT_AOS
+#endif
+
+#define RESERVOIR_DI_FIELDS(FIELD)                    \
+    FIELD(Reservoir_DI, x2,    float3,   POSITION, 0) \
+    FIELD(Reservoir_DI, w_sum, float,    WEIGHT,   0) \
+    FIELD(Reservoir_DI, n2,    float3,   NORMAL,   0) \
+    FIELD(Reservoir_DI, W,     float,    WEIGHT,   4) \
+    FIELD(Reservoir_DI, L2,    half3,    RADIANCE, 0) \
+    FIELD(Reservoir_DI, M,     uint16_t, WEIGHT,   8)
+
+#define RESERVOIR_GI_FIELDS(FIELD)                    \
+    FIELD(Reservoir_GI, xn,    float3,   POSITION, 0) \
+    FIELD(Reservoir_GI, w_sum, float,    WEIGHT,   0) \
+    FIELD(Reservoir_GI, nn,    float3,   NORMAL,   0) \
+    FIELD(Reservoir_GI, W,     float,    WEIGHT,   4) \
+    FIELD(Reservoir_GI, E3,    half3,    RADIANCE, 0) \
+    FIELD(Reservoir_GI, M,     uint16_t, WEIGHT,   8)
+
+// AoS element: natural scalar alignment, no 16 byte rows
+#define RESERVOIR_AOS_BYTES 40
+
+// SoA streams: bytes per element, and bytes per element of all earlier
+// streams (a stream starts at FIRST * reservoir count). 4 byte multiples.
+#define RESERVOIR_STREAM_POSITION_BYTES 12
+#define RESERVOIR_STREAM_NORMAL_BYTES   12
+#define RESERVOIR_STREAM_RADIANCE_BYTES 8
+#define RESERVOIR_STREAM_WEIGHT_BYTES   12
+#define RESERVOIR_STREAM_POSITION_FIRST 0
+#define RESERVOIR_STREAM_NORMAL_FIRST   12
+#define RESERVOIR_STREAM_RADIANCE_FIRST 24
+#define RESERVOIR_STREAM_WEIGHT_FIRST   32
+#define RESERVOIR_SOA_BYTES 44
+
+#if RESERVOIR_LAYOUT == RESERVOIR_LAYOUT_SOA
+#define RESERVOIR_ELEMENT_BYTES RESERVOIR_SOA_BYTES
+#else
+#define RESERVOIR_ELEMENT_BYTES RESERVOIR_AOS_BYTES
+#endif
+
+#ifndef SAMPLE_DATA_DEBUG
+#if defined(__cplusplus) && defined(NDEBUG)
+#define SAMPLE_DATA_DEBUG 0
+#else
+#define SAMPLE_DATA_DEBUG 1
+#endif
+#endif
+
+#define SAMPLE_DATA_BASE_FIELDS(FIELD) \
+    FIELD(SampleData, x1,    float3)   \
+    FIELD(SampleData, mID,   uint16_t) \
+    FIELD(SampleData, L1,    half3)    \
+    FIELD(SampleData, n1,    float3)   \
+    FIELD(SampleData, o,     float3)   \
+    FIELD(SampleData, objID, uint)
+
+#define SAMPLE_DATA_DEBUG_BYTES 60
+#define SAMPLE_DATA_RELEASE_BYTES 48
+
+#if SAMPLE_DATA_DEBUG
+#define SAMPLE_DATA_FIELDS(FIELD)      \
+    SAMPLE_DATA_BASE_FIELDS(FIELD)     \
+    FIELD(SampleData, debug, float3)
+#define SAMPLE_DATA_BYTES SAMPLE_DATA_DEBUG_BYTES
+#else
+#define SAMPLE_DATA_FIELDS(FIELD) SAMPLE_DATA_BASE_FIELDS(FIELD)
+#define SAMPLE_DATA_BYTES SAMPLE_DATA_RELEASE_BYTES
+#endif
+
+#ifndef __cplusplus
+
+#define SAMPLE_DATA_DECLARE_FIELD(S, name, type) type name;
+
+struct SampleData
+{
+    SAMPLE_DATA_FIELDS(SAMPLE_DATA_DECLARE_FIELD)
+};
+
+#define RESERVOIR_DECLARE_FIELD(S, name, type, stream, offset) type name;
+
+struct Reservoir_DI
+{
+    RESERVOIR_DI_FIELDS(RESERVOIR_DECLARE_FIELD)
+};
+
+struct Reservoir_GI
+{
+    RESERVOIR_GI_FIELDS(RESERVOIR_DECLARE_FIELD)
+};
+
+// Accessors, the same for both layouts:
+//   Load<struct>(buffer, index), Store<struct>(buffer, index, r)
+//   Load<struct>_<field>(buffer, index), Store<struct>_<field>(buffer, index, v)
+// e.g. LoadReservoir_DI_M(g_Reservoirs_current, pixel_r). Unused fields of a
+// whole-struct load are not fetched in the SoA layout.
+#if RESERVOIR_LAYOUT == RESERVOIR_LAYOUT_SOA
+
+#define RESERVOIR_BUFFER(S) RWByteAddressBuffer
+
+inline uint ReservoirAddress(RWByteAddressBuffer buffer, uint first, uint stride, uint offset, uint index)
+{
+    uint bytes;
+    buffer.GetDimensions(bytes);
+    return first * (bytes / RESERVOIR_SOA_BYTES) + index * stride + offset;
+}
+
+#define RESERVOIR_FIELD_ACCESSORS(S, name, type, stream, offset)                                        \
+    inline type Load##S##_##name(RWByteAddressBuffer buffer, uint index)                                \
+    {                                                                                                   \
+        return buffer.Load<type>(ReservoirAddress(buffer, RESERVOIR_STREAM_##stream##_FIRST,            \
+                                                  RESERVOIR_STREAM_##stream##_BYTES, offset, index));   \
+    }                                                                                                   \
+    inline void Store##S##_##name(RWByteAddressBuffer buffer, uint index, type value)                   \
+    {                                                                                                   \
+        buffer.Store<type>(ReservoirAddress(buffer, RESERVOIR_STREAM_##stream##_FIRST,                  \
+                                            RESERVOIR_STREAM_##stream##_BYTES, offset, index), value);  \
+    }
+
+#define RESERVOIR_LOAD_MEMBER(S, name, type, stream, offset) r.name = Load##S##_##name(buffer, index);
+#define RESERVOIR_STORE_MEMBER(S, name, type, stream, offset) Store##S##_##name(buffer, index, r.name);
+
+#define RESERVOIR_ACCESSORS(S, FIELDS)                                     \
+    FIELDS(RESERVOIR_FIELD_ACCESSORS)                                      \
+    inline S Load##S(RWByteAddressBuffer buffer, uint index)               \
+    {                                                                      \
+        S r;                                                               \
+        FIELDS(RESERVOIR_LOAD_MEMBER)                                      \
+        return r;                                                          \
+    }                                                                      \
+    inline void Store##S(RWByteAddressBuffer buffer, uint index, S r)      \
+    {                                                                      \
+        FIELDS(RESERVOIR_STORE_MEMBER)                                     \
+    }
+
+#else
+
+#define RESERVOIR_BUFFER(S) RWStructuredBuffer<S>
+
+#define RESERVOIR_FIELD_ACCESSORS(S, name, type, stream, offset)                      \
+    inline type Load##S##_##name(RWStructuredBuffer<S> buffer, uint index)            \
+    {                                                                                 \
+        return buffer[index].name;                                                    \
+    }                                                                                 \
+    inline void Store##S##_##name(RWStructuredBuffer<S> buffer, uint index, type value) \
+    {                                                                                 \
+        buffer[index].name = value;                                                   \
+    }
+
+#define RESERVOIR_ACCESSORS(S, FIELDS)                                      \
+    FIELDS(RESERVOIR_FIELD_ACCESSORS)                                       \
+    inline S Load##S(RWStructuredBuffer<S> buffer, uint index)              \
+    {                                                                       \
+        return buffer[index];                                               \
+    }                                                                       \
+    inline void Store##S(RWStructuredBuffer<S> buffer, uint index, S r)     \
+    {                                                                       \
+        buffer[index] = r;                                                  \
+    }
+
+#endif
+
+RESERVOIR_ACCESSORS(Reservoir_DI, RESERVOIR_DI_FIELDS)
+RESERVOIR_ACCESSORS(Reservoir_GI, RESERVOIR_GI_FIELDS)
+
+#endif // !__cplusplus
+
+#endif //PATHTRACER_RESERVOIRLAYOUT_H
@@ -0,0 +1,45 @@
+// Packed reservoir and sample encoding, constants shared by the shaders
+// (shaders/Compression_v7.hlsl) and the C++ encoder (src/Render/
+// ReservoirCompression.h), which must produce the same bits.
+//
+// PackedReservoir, for Reservoir_DI and Reservoir_GI, 24 bytes (40 unpacked):
+//   x         x2 / xn, float3. Kept exact: shadow rays stop 10 * s_bias short
+//             of it, and an octahedral direction from x1 already moves a
+//             light sample a few units away by more than that.
+//   normalM   n2 / nn octahedral (12 bits per axis, 0 = zero vector), M
+//   radiance  L2 / E3, RGB9E5 (shared exponent, like DXGI R9G9B9E5_SHAREDEXP)
+//   weights   W with the low mantissa bits dropped, w_sum as a 10 bit float.
+//             Stored w_sum is only tested against 0 (IsValidReservoir) and
+//             w_sum_threshold (RejectWsum); 0 stays 0, positive stays positive.
+//
+// PackedSampleData, 32 bytes (60 unpacked): x1 as float3, n1 and o
+// octahedral (16 bits per axis), L1 RGB9E5, objID, mID. debug is not stored.
+
+#ifndef PATHTRACER_RESERVOIRPACKING_H
+#define PATHTRACER_RESERVOIRPACKING_H
+
+// Octahedral unit vectors, bits per axis: SampleData, reservoirs
+#define PACKED_OCT_BITS 16
+#define PACKED_RESERVOIR_OCT_BITS 12
+
+// M in the top bits of normalM, clamped; spatial_M_cap is 128
+#define PACKED_M_BITS 8
+#define PACKED_M_MAX 255
+
+// RGB9E5: mantissa bits, exponent bias and the largest encodable value,
+// (2^9 - 1) / 2^9 * 2^(31 - 15)
+#define PACKED_RGB9E5_MANTISSA_BITS 9
+#define PACKED_RGB9E5_EXPONENT_BIAS 15
+#define PACKED_RGB9E5_MAX 65408.0f
+
+// weights: W keeps 8 exponent and 14 mantissa bits in the high 22 bits (it
+// is never negative); w_sum 5 exponent bits (bias 16) and 5 mantissa bits
+#define PACKED_W_DROPPED_BITS 9
+#define PACKED_W_SUM_BITS 10
+#define PACKED_W_SUM_DROPPED_BITS 18
+#define PACKED_W_SUM_EXPONENT_BIAS 16
+
+#define PACKED_RESERVOIR_BYTES 24
+#define PACKED_SAMPLE_BYTES 32
+
+#endif //PATHTRACER_RESERVOIRPACKING_H
@@ -1,30 +1,7 @@
-// Each row is 16 bytes
-struct SampleData
-{
-    float3 x1;  // (12 bytes)
-    uint16_t  mID;   // (2 bytes)
-    half3 L1;   // (6 bytes)
-    float3 n1;  // (12 bytes)
-    float3 o;    // (12 bytes)
-    uint  objID;   // (4 bytes)
-    float3  debug;   // (12 bytes)
-};
-
-
-// RIS reservoir for direct lighting
-struct Reservoir_DI
-{
-    float3 x2;    float w_sum; // 16 bytes total
-    float3 n2;    float W;     // 16 bytes total
-    half3 L2;     uint16_t M;   // 8 bytes total
-};
-
-struct Reservoir_GI
-{
-    float3 xn;     float w_sum; //16
-    float3 nn;     float W;  //16
-    half3 E3;     uint16_t M; //8
-};
+// SampleData, Reservoir_DI (RIS reservoir for direct lighting) and
+// Reservoir_GI, with their buffer accessors; layout selected in
+// ReservoirLayout.h
+#include "ReservoirLayout.h"
 
 // Update the reservoir with the light
 inline bool UpdateReservoir_GI(
@@ -10,6 +10,10 @@
 #include <d3d12.h>
 #include "DXSampleHelper.h"
 #include <dxcapi.h>
+#include "../include/ReservoirLayout.h"
+#include "../src/Render/ShaderCache.h"
+#include "../src/Render/ShaderBuild.h"
+#include "../src/Render/ShaderPermutation.h"
 
 #include <vector>
 #include <iostream>
@@ -83,82 +87,247 @@ static const D3D12_HEAP_PROPERTIES kUploadHeapProps = {
 static const D3D12_HEAP_PROPERTIES kDefaultHeapProps = {
     D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0};
 
+// SampleData layout of this build (ReservoirLayout.h), for the shaders
+#if SAMPLE_DATA_DEBUG
+#define SAMPLE_DATA_DEBUG_ARG L"SAMPLE_DATA_DEBUG=1"
+#else
+#define SAMPLE_DATA_DEBUG_ARG L"SAMPLE_DATA_DEBUG=0"
+#endif
+
 //--------------------------------------------------------------------------------------------------
-// Compile a HLSL file into a DXIL library
+// Compiled libraries of previous runs, in the working directory. Delete the
+// directory to force a full recompile.
 //
-IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
+inline ShaderCache& CompiledShaderCache()
 {
-  static IDxcCompiler* pCompiler = nullptr;
-  static IDxcLibrary* pLibrary = nullptr;
-  static IDxcIncludeHandler* dxcIncludeHandler;
+  static ShaderCache cache(L"ShaderCache");
+  return cache;
+}
 
-  HRESULT hr;
+//--------------------------------------------------------------------------------------------------
+// Version of the loaded dxcompiler.dll, part of the cache key: a new compiler
+// may generate different code from the same source
+//
+inline std::string CompilerVersion(IDxcCompiler* pCompiler)
+{
+  std::string version = "dxc";
+  IDxcVersionInfo* pVersion = nullptr;
+  if (SUCCEEDED(pCompiler->QueryInterface(__uuidof(IDxcVersionInfo), (void**)&pVersion)))
+  {
+    UINT32 major = 0, minor = 0;
+    pVersion->GetVersion(&major, &minor);
+    version += " " + std::to_string(major) + "." + std::to_string(minor);
+    pVersion->Release();
+  }
+  IDxcVersionInfo2* pVersion2 = nullptr;
+  if (SUCCEEDED(pCompiler->QueryInterface(__uuidof(IDxcVersionInfo2), (void**)&pVersion2)))
+  {
+    UINT32 commitCount = 0;
+    char* commitHash = nullptr;
+    if (SUCCEEDED(pVersion2->GetCommitInfo(&commitCount, &commitHash)) && commitHash)
+    {
+      version += " " + std::to_string(commitCount) + " " + commitHash;
+      CoTaskMemFree(commitHash);
+    }
+    pVersion2->Release();
+  }
+  return version;
+}
 
-  // Initialize the DXC compiler and compiler helper
-  if (!pCompiler)
+//--------------------------------------------------------------------------------------------------
+// The DXC objects of one compiling thread. They must not be used by two
+// threads at once, so BuildShaderLibraries gives each pool thread its own.
+//
+class ShaderLibraryCompiler
+{
+public:
+  ShaderLibraryCompiler()
   {
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), (void **)&pCompiler));
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void **)&pLibrary));
-    ThrowIfFailed(pLibrary->CreateIncludeHandler(&dxcIncludeHandler));
+    // Initialize the DXC compiler and compiler helper
+    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), (void **)&m_compiler));
+    ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void **)&m_library));
+    ThrowIfFailed(m_library->CreateIncludeHandler(&m_includeHandler));
+    m_version = CompilerVersion(m_compiler.Get());
   }
-  // Open and read the file
-  std::ifstream shaderFile(fileName);
-  if (shaderFile.good() == false)
+
+  // Compile a HLSL file into a DXIL library specialized by the defines of
+  // permutation, or load it from CompiledShaderCache when neither the file,
+  // its includes, the arguments nor the compiler changed. On failure returns
+  // nullptr with the compiler messages in error.
+  IDxcBlob* Compile(LPCWSTR fileName, const ShaderPermutation& permutation, std::string& error, bool& cached)
   {
-    throw std::logic_error("Cannot find shader file");
+    static const wchar_t* target = L"lib_6_7";
+    cached = false;
+
+    // Setup the compiler arguments:
+    // Use "-Zi" for full debug info (line table, etc.)
+    // Or use "-Zs" for minimal debug info (useful for dynamic shader editing)
+    const wchar_t* arguments[] = {
+      L"-Zi",                        // full debug info
+      L"-O3",                        // highest optimisation
+      L"-enable-16bit-types",        // keep fp16 alive
+      L"-D",  L"MAX_REGS=96",        // <‑‑ 96‑register cap
+      L"-D",  SAMPLE_DATA_DEBUG_ARG, // debug channel of SampleData, as in the C++ build
+      L"-HV", L"2021"                // enable SM 6.7+ attributes
+    };
+
+    // The permutation's -D arguments after the fixed ones
+    std::vector<std::wstring> defines;
+    for (const std::string& argument : permutation.Arguments())
+    {
+      defines.push_back(std::wstring(argument.begin(), argument.end()));
+    }
+    std::vector<LPCWSTR> allArguments(arguments, arguments + _countof(arguments));
+    for (const std::wstring& define : defines)
+    {
+      allArguments.push_back(define.c_str());
+    }
+
+    // Look the library up by the source of the file and its includes, the
+    // arguments and the compiler
+    std::vector<std::wstring> keyArguments(allArguments.begin(), allArguments.end());
+    keyArguments.push_back(target);
+    const std::filesystem::path shaderPath(fileName);
+    const std::string cacheName = shaderPath.stem().string() + permutation.CacheSuffix();
+    const ShaderKey key = ComputeShaderKey(shaderPath, keyArguments, m_version);
+    std::vector<uint8_t> stored;
+    if (CompiledShaderCache().Load(cacheName, key.value, stored))
+    {
+      IDxcBlobEncoding* pCachedBlob;
+      ThrowIfFailed(m_library->CreateBlobWithEncodingOnHeapCopy(stored.data(), (uint32_t)stored.size(), 0,
+                                                                &pCachedBlob));
+      cached = true;
+      return pCachedBlob;
+    }
+
+    // Open and read the file
+    std::ifstream shaderFile(fileName);
+    if (shaderFile.good() == false)
+    {
+      error = "Cannot find shader file";
+      return nullptr;
+    }
+    std::stringstream strStream;
+    strStream << shaderFile.rdbuf();
+    std::string sShader = strStream.str();
+
+    // Create blob from the string
+    IDxcBlobEncoding* pTextBlob;
+    ThrowIfFailed(m_library->CreateBlobWithEncodingFromPinned(
+        (LPBYTE)sShader.c_str(), (uint32_t)sShader.size(), 0, &pTextBlob));
+
+    // Compile
+    IDxcOperationResult* pResult;
+    ThrowIfFailed(m_compiler->Compile(pTextBlob, fileName, L"", target, allArguments.data(),
+                                      (UINT32)allArguments.size(), nullptr, 0, m_includeHandler.Get(), &pResult));
+
+    // Verify the result
+    HRESULT resultCode;
+    ThrowIfFailed(pResult->GetStatus(&resultCode));
+    if (FAILED(resultCode))
+    {
+      IDxcBlobEncoding* pError;
+      if (FAILED(pResult->GetErrorBuffer(&pError)))
+      {
+        error = "Failed to get shader compiler error";
+        return nullptr;
+      }
+
+      // Convert error blob to a string
+      error.assign((const char*)pError->GetBufferPointer(), pError->GetBufferSize());
+      return nullptr;
+    }
+
+    IDxcBlob* pBlob;
+    ThrowIfFailed(pResult->GetResult(&pBlob));
+    // A failed store only means compiling again next run
+    CompiledShaderCache().Store(cacheName, key.value, pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+    return pBlob;
   }
-  std::stringstream strStream;
-  strStream << shaderFile.rdbuf();
-  std::string sShader = strStream.str();
-
-  // Create blob from the string
-  IDxcBlobEncoding* pTextBlob;
-  ThrowIfFailed(pLibrary->CreateBlobWithEncodingFromPinned(
-      (LPBYTE)sShader.c_str(), (uint32_t)sShader.size(), 0, &pTextBlob));
-
-  // Setup the compiler arguments:
-  // Use "-Zi" for full debug info (line table, etc.)
-  // Or use "-Zs" for minimal debug info (useful for dynamic shader editing)
-  const wchar_t* arguments[] = {
-    L"-Zi",                        // full debug info
-    L"-O3",                        // highest optimisation
-    L"-enable-16bit-types",        // keep fp16 alive
-    L"-D",  L"MAX_REGS=96",        // <‑‑ 96‑register cap
-    L"-HV", L"2021"                // enable SM 6.7+ attributes
+
+private:
+  Microsoft::WRL::ComPtr<IDxcCompiler> m_compiler;
+  Microsoft::WRL::ComPtr<IDxcLibrary> m_library;
+  Microsoft::WRL::ComPtr<IDxcIncludeHandler> m_includeHandler;
+  std::string m_version;
 };
 
-  // Compile
-  IDxcOperationResult* pResult;
-  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_7", arguments, _countof(arguments), nullptr, 0,
-                                   dxcIncludeHandler, &pResult));
+//--------------------------------------------------------------------------------------------------
+// Compile HLSL files into DXIL libraries with the defines of permutation, one
+// job per file on the pool (BuildShaders). The blobs are in the order of the
+// files. When any file fails, none are returned and report holds the errors
+// of all of them.
+//
+std::vector<IDxcBlob*> BuildShaderLibraries(const std::vector<LPCWSTR>& fileNames,
+                                            const ShaderPermutation& permutation, ThreadPool& pool,
+                                            ShaderBuildReport& report)
+{
+  std::vector<IDxcBlob*> blobs(fileNames.size(), nullptr);
+  std::vector<std::string> names;
+  for (LPCWSTR fileName : fileNames)
+  {
+    names.push_back(std::filesystem::path(fileName).filename().string());
+  }
 
-  // Verify the result
-  HRESULT resultCode;
-  ThrowIfFailed(pResult->GetStatus(&resultCode));
-  if (FAILED(resultCode))
+  report = BuildShaders<ShaderLibraryCompiler>(
+      pool, names,
+      []() -> std::unique_ptr<ShaderLibraryCompiler> {
+        try
+        {
+          return std::make_unique<ShaderLibraryCompiler>();
+        }
+        catch (const std::exception&)
+        {
+          return nullptr;
+        }
+      },
+      [&](ShaderLibraryCompiler& compiler, uint32_t job) {
+        // Exceptions must not leave a pool thread
+        ShaderBuildOutput output;
+        try
+        {
+          blobs[job] = compiler.Compile(fileNames[job], permutation, output.error, output.cached);
+        }
+        catch (const std::exception& e)
+        {
+          output.error = e.what();
+        }
+        output.ok = blobs[job] != nullptr;
+        return output;
+      });
+
+  if (report.Failed())
   {
-    IDxcBlobEncoding* pError;
-    hr = pResult->GetErrorBuffer(&pError);
-    if (FAILED(hr))
+    for (IDxcBlob* pBlob : blobs)
     {
-      throw std::logic_error("Failed to get shader compiler error");
+      if (pBlob)
+      {
+        pBlob->Release();
+      }
     }
+    return {};
+  }
+  return blobs;
+}
 
-    // Convert error blob to a string
-    std::vector<char> infoLog(pError->GetBufferSize() + 1);
-    memcpy(infoLog.data(), pError->GetBufferPointer(), pError->GetBufferSize());
-    infoLog[pError->GetBufferSize()] = 0;
-
+//--------------------------------------------------------------------------------------------------
+// BuildShaderLibraries, showing the errors of all failed files in one message
+// before throwing
+//
+std::vector<IDxcBlob*> CompileShaderLibraries(const std::vector<LPCWSTR>& fileNames,
+                                              const ShaderPermutation& permutation, ThreadPool& pool,
+                                              ShaderBuildReport& report)
+{
+  std::vector<IDxcBlob*> blobs = BuildShaderLibraries(fileNames, permutation, pool, report);
+  if (report.Failed())
+  {
     std::string errorMsg = "Shader Compiler Error:\n";
-    errorMsg.append(infoLog.data());
+    errorMsg.append(report.Errors());
 
     MessageBoxA(nullptr, errorMsg.c_str(), "Error!", MB_OK);
     throw std::logic_error("Failed compile shader");
   }
-
-  IDxcBlob* pBlob;
-  ThrowIfFailed(pResult->GetResult(&pBlob));
-  return pBlob;
+  return blobs;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -9,6 +9,8 @@
 //
 //*********************************************************
 #include <chrono>
+#include <filesystem>
+#include <numeric>
 #include "stdafx.h"
 
 #include "Renderer.h"
@@ -31,6 +33,57 @@ static std::chrono::steady_clock::time_point g_lastRenderTime
 // Our desired interval: 1 frame every 5 seconds => 0.2 FPS
 static const float FRAME_INTERVAL_SECONDS = 10.00f;
 
+// The SoA reservoir layout is a RWByteAddressBuffer in the shaders: raw view
+// over the same bytes instead of a structured one
+static void SetReservoirUavLayout(D3D12_UNORDERED_ACCESS_VIEW_DESC& desc) {
+#if RESERVOIR_LAYOUT == RESERVOIR_LAYOUT_SOA
+    desc.Format = DXGI_FORMAT_R32_TYPELESS;
+    desc.Buffer.NumElements = desc.Buffer.NumElements * desc.Buffer.StructureByteStride / 4;
+    desc.Buffer.StructureByteStride = 0;
+    desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+#else
+    (void)desc;
+#endif
+}
+
+// The ray tracing libraries, in the order of m_libraryVariants
+static const std::vector<std::string> kShaderLibraries = {
+    "RayGen_v6_pass1.hlsl", "RayGen_v6_pass2.hlsl", "RayGen_v6_pass3.hlsl",
+    "Miss_v6.hlsl",         "Hit_v6.hlsl",          "ShadowRay.hlsl"};
+
+// Where the libraries are compiled from and watched for hot reload: the
+// include directory of the source tree when it is there, so that edits to it
+// reload, otherwise the copy next to the executable
+static std::filesystem::path ShaderDirectory() {
+#ifdef PATHTRACER_SHADER_DIR
+    std::error_code error;
+    if (std::filesystem::is_directory(PATHTRACER_SHADER_DIR, error)) {
+        return std::filesystem::path(PATHTRACER_SHADER_DIR);
+    }
+#endif
+    return std::filesystem::path(".");
+}
+
+static std::vector<std::wstring> ShaderLibraryPaths(const std::vector<uint32_t> &libraries) {
+    std::vector<std::wstring> paths;
+    for (uint32_t library : libraries) {
+        paths.push_back((ShaderDirectory() / kShaderLibraries[library]).wstring());
+    }
+    return paths;
+}
+
+static D3D12_RESOURCE_STATES ToResourceState(GraphState state) {
+    switch (state) {
+        case GraphState::Present: return D3D12_RESOURCE_STATE_PRESENT;
+        case GraphState::UnorderedAccess: return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+        case GraphState::ShaderResource: return D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        case GraphState::CopySource: return D3D12_RESOURCE_STATE_COPY_SOURCE;
+        case GraphState::CopyDest: return D3D12_RESOURCE_STATE_COPY_DEST;
+        case GraphState::RenderTarget: return D3D12_RESOURCE_STATE_RENDER_TARGET;
+    }
+    return D3D12_RESOURCE_STATE_COMMON;
+}
+
 Renderer::Renderer(UINT width, UINT height,
                    std::wstring name)
     : DXSample(width, height, name), m_frameIndex(0),
@@ -62,6 +115,15 @@ void Renderer::OnInit() {
   // close it now.
   ThrowIfFailed(m_commandList->Close());
 
+  // Heap slots of the shader bindings; the root signatures and the heap are
+  // both built from them
+  m_bindings = AllocateBindingTable(m_descriptors);
+  for (const DescriptorBinding &b : kDescriptorBindings) {
+    if (m_bindings.Slot(b.binding) == kDescriptorNone) {
+      throw std::runtime_error(std::string("No descriptor heap slot for ") + b.name);
+    }
+  }
+
   // Create the raytracing pipeline, associating the shader code to symbol names
   // and to their root signatures, and defining the amount of memory carried by
   // rays (ray payload)
@@ -95,6 +157,13 @@ void Renderer::OnInit() {
   // are invoked for each instance in the  AS
   CreateShaderBindingTable();
 
+  // Watch the sources of the libraries for hot reload
+  m_shaderWatch = ShaderWatch(ShaderDirectory(), kShaderLibraries);
+  m_lastShaderPoll = std::chrono::steady_clock::now();
+
+  // Order the passes of the frame and the barriers between them
+  CreateRenderGraph();
+
     slGetNewFrameToken(m_frameToken, nullptr);   // token is valid forever, SL recycles it internally
 
 
@@ -246,6 +315,31 @@ void Renderer::LoadPipeline() {
 
   ThrowIfFailed(m_device->CreateCommandAllocator(
       D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+  // One allocator per frame in flight, reset once m_frameRing retires its slot
+  for (FrameContext &frame : m_frames) {
+    ThrowIfFailed(m_device->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frame.commandAllocator)));
+  }
+
+  // Create synchronization objects. Loading already waits on them when the
+  // upload ring fills up.
+  ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE,
+                                      IID_PPV_ARGS(&m_fence)));
+
+  // Create an event handle to use for frame synchronization.
+  m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (m_fenceEvent == nullptr) {
+    ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+  }
+
+  // The upload ring's buffer stays mapped; upload heaps allow this and the
+  // CPU only ever writes to it
+  m_uploadBuffer = nv_helpers_dx12::CreateBuffer(
+      m_device.Get(), UploadRingSize, D3D12_RESOURCE_FLAG_NONE,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+  CD3DX12_RANGE uploadReadRange(0, 0);
+  ThrowIfFailed(m_uploadBuffer->Map(0, &uploadReadRange,
+                                    reinterpret_cast<void **>(&m_uploadData)));
 
   // #DXR Extra: Depth Buffering
   // The original sample does not support depth buffering, so we need to
@@ -373,62 +467,36 @@ void Renderer::LoadAssets() {
       //Material:
       {
           const UINT materialBufferSize = static_cast<UINT>(m_materials.size()) * sizeof(Material);
-
-          CD3DX12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-          CD3DX12_RESOURCE_DESC bufferRes = CD3DX12_RESOURCE_DESC::Buffer(materialBufferSize);
-          ThrowIfFailed(m_device->CreateCommittedResource(
-                  &heapProp, D3D12_HEAP_FLAG_NONE, &bufferRes, //
-                  D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_materialBuffer)));
-
-          // Copy material data to the buffer.
-          UINT8* pMaterialDataBegin;
-          CD3DX12_RANGE readRange(0, 0);
-          ThrowIfFailed(m_materialBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pMaterialDataBegin)));
-          memcpy(pMaterialDataBegin, m_materials.data(), materialBufferSize);
-          m_materialBuffer->Unmap(0, nullptr);
+          m_materialBuffer = CreateStaticBuffer(m_materials.data(), materialBufferSize,
+                                                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
       }
 
       //Material Indices
       {
           const UINT materialIndexBufferSize = static_cast<UINT>(m_materialIDs.size()) * sizeof(UINT);
-
-          CD3DX12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-          CD3DX12_RESOURCE_DESC bufferRes = CD3DX12_RESOURCE_DESC::Buffer(materialIndexBufferSize);
-          ThrowIfFailed(m_device->CreateCommittedResource(
-                  &heapProp, D3D12_HEAP_FLAG_NONE, &bufferRes, //
-                  D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_materialIndexBuffer)));
-
-          // Copy material index data to the buffer.
-          UINT8* pMaterialIndexDataBegin;
-          CD3DX12_RANGE readRange(0, 0);
-          ThrowIfFailed(m_materialIndexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pMaterialIndexDataBegin)));
-          memcpy(pMaterialIndexDataBegin, m_materialIDs.data(), materialIndexBufferSize);
-          m_materialIndexBuffer->Unmap(0, nullptr);
+          m_materialIndexBuffer = CreateStaticBuffer(m_materialIDs.data(), materialIndexBufferSize,
+                                                     D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
       }
   }
 
-  // Create synchronization objects and wait until assets have been uploaded to
-  // the GPU.
-  {
-    ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE,
-                                        IID_PPV_ARGS(&m_fence)));
-    m_fenceValue = 1;
-
-    // Create an event handle to use for frame synchronization.
-    m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    if (m_fenceEvent == nullptr) {
-      ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-    }
-
-    // Wait for the command list to execute; we are reusing the same command
-    // list in our main loop but for now, we just want to wait for setup to
-    // complete before continuing.
-    WaitForPreviousFrame();
-  }
+  // The copies recorded above run with the acceleration structure builds,
+  // which read the vertex and index buffers after them in the same list
+  // (CreateAccelerationStructures flushes it).
 }
 
 // Update frame-based values.
 void Renderer::OnUpdate() {
+  // Between frames: swap in shaders recompiled since the last one
+  UpdateShaderReload();
+
+  // The frame's allocator and instance descriptors are about to be
+  // rewritten: wait until the GPU is done with the last frame that used the
+  // slot
+  m_frameRing.BeginFrame(m_queueFence);
+  m_descriptors.BeginFrame(m_frameRing.Slot());
+  // Upload ring space of the frames the GPU has finished is free again
+  m_uploadRing.Retire(m_queueFence.CompletedValue());
+
   // #DXR Extra: Perspective Camera
   UpdateCameraBuffer();
 
@@ -476,7 +544,10 @@ void Renderer::OnRender()
     ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
     m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
     ThrowIfFailed(m_swapChain->Present(0, 0));
-    WaitForPreviousFrame();
+    // No wait here: the next frame records into the other slot while the GPU
+    // works on this one
+    m_uploadRing.EndFrame(m_frameRing.EndFrame(m_queueFence));
+    m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
     // ----------------------------------------
 
     // FPS calculation
@@ -494,7 +565,8 @@ void Renderer::OnRender()
         // Build the string
         std::wstringstream ss;
         ss << std::fixed << std::setprecision(2)
-               << L"Frame Time: " << dT << L" ms (" << fps << L" fps)";
+               << L"Frame Time: " << dT << L" ms (" << fps << L" fps)"
+               << L" | Upload: " << m_uploadRing.Stats().lastFrameBytes / 1024.0f << L" KB/frame";
 
         // Update the window title
         SetWindowTextW(Win32Application::GetHwnd(), ss.str().c_str());
@@ -544,7 +616,10 @@ void Renderer::OnRender()
 void Renderer::OnDestroy() {
   // Ensure that the GPU is no longer referencing resources that are about to be
   // cleaned up by the destructor.
-  WaitForPreviousFrame();
+  WaitForGpu();
+  if (m_shaderReloadJob.valid()) {
+    m_shaderReloadJob.wait();
+  }
 
   CloseHandle(m_fenceEvent);
     if(SL_FAILED(res, slShutdown()))
@@ -556,27 +631,22 @@ void Renderer::OnDestroy() {
 void Renderer::PopulateCommandList() {
   // Command list allocators can only be reset when the associated
   // command lists have finished execution on the GPU; apps should use
-  // fences to determine GPU execution progress.
-  ThrowIfFailed(m_commandAllocator->Reset());
+  // fences to determine GPU execution progress. OnUpdate waited for the
+  // slot's previous frame.
+  FrameContext &frame = m_frames[m_frameRing.Slot()];
+  ThrowIfFailed(frame.commandAllocator->Reset());
 
   // However, when ExecuteCommandList() is called on a particular command
   // list, that command list can then be reset at any time and must be before
   // re-recording.
   ThrowIfFailed(
-      m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+      m_commandList->Reset(frame.commandAllocator.Get(), m_pipelineState.Get()));
 
   // Set necessary state.
   m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
   m_commandList->RSSetViewports(1, &m_viewport);
   m_commandList->RSSetScissorRects(1, &m_scissorRect);
 
-    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_renderTargets[m_frameIndex].Get(),
-            D3D12_RESOURCE_STATE_PRESENT,
-            D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-    m_commandList->ResourceBarrier(1, &barrier);
-
   CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(
       m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex,
       m_rtvDescriptorSize);
@@ -592,6 +662,33 @@ void Renderer::PopulateCommandList() {
     // transform matrix of the triangle. Note that the build contains a barrier,
     // hence we can do the rendering in the same command list
     CreateTopLevelAS(m_instances, true);
+
+    // This frame's camera and instance constants, written by OnUpdate into
+    // the upload ring. The transitions to COPY_DEST wait for the previous
+    // frame's reads.
+    {
+      CD3DX12_RESOURCE_BARRIER toCopy[] = {
+          CD3DX12_RESOURCE_BARRIER::Transition(
+              m_cameraBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+              D3D12_RESOURCE_STATE_COPY_DEST),
+          CD3DX12_RESOURCE_BARRIER::Transition(
+              m_instanceProperties.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+              D3D12_RESOURCE_STATE_COPY_DEST)};
+      m_commandList->ResourceBarrier(_countof(toCopy), toCopy);
+      m_commandList->CopyBufferRegion(m_cameraBuffer.Get(), 0, m_uploadBuffer.Get(),
+                                      m_cameraUploadOffset, m_cameraBufferSize);
+      m_commandList->CopyBufferRegion(
+          m_instanceProperties.Get(), 0, m_uploadBuffer.Get(), m_instancePropertiesUploadOffset,
+          m_instancePropertiesData.size() * sizeof(InstanceProperties));
+      CD3DX12_RESOURCE_BARRIER toRead[] = {
+          CD3DX12_RESOURCE_BARRIER::Transition(
+              m_cameraBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+              D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER),
+          CD3DX12_RESOURCE_BARRIER::Transition(
+              m_instanceProperties.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+              D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)};
+      m_commandList->ResourceBarrier(_countof(toRead), toRead);
+    }
     // #DXR
     // Bind the descriptor heap giving access to the top-level acceleration
     // structure, as well as the raytracing output
@@ -599,14 +696,6 @@ void Renderer::PopulateCommandList() {
     m_commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()),
                                       heaps.data());
 
-    // On the last frame, the raytracing output was used as a copy source, to
-    // copy its contents into the render target. Now we need to transition it to
-    // a UAV so that the shaders can write in it.
-    CD3DX12_RESOURCE_BARRIER transition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    m_commandList->ResourceBarrier(1, &transition);
-
     // Setup the raytracing task
     D3D12_DISPATCH_RAYS_DESC desc = {};
     // The layout of the SBT is as follows: ray generation shader, miss
@@ -650,88 +739,253 @@ void Renderer::PopulateCommandList() {
 
     // Bind the raytracing pipeline
     m_commandList->SetPipelineState1(m_rtStateObject.Get());
-    // Dispatch the rays and write to the raytracing output
-    m_commandList->DispatchRays(&desc);
-
-    // Create the barrier object
-    CD3DX12_RESOURCE_BARRIER globalUAVBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
-    m_commandList->ResourceBarrier(1, &globalUAVBarrier);
-
-
-    // Second ray gen pass
-    desc.RayGenerationShaderRecord.StartAddress = sbtStart + rgSize; // the second RayGen
-    desc.RayGenerationShaderRecord.SizeInBytes  = rgSize;
-    m_commandList->DispatchRays(&desc);
-
-    // Insert a UAV barrier between RayGen2 and RayGen3
-    CD3DX12_RESOURCE_BARRIER uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
-    m_commandList->ResourceBarrier(1, &uavBarrier);
-
-    // Dispatch third raygen shader (RayGen3)
-    desc.RayGenerationShaderRecord.StartAddress = sbtStart + 2 * rgSize;
-    desc.RayGenerationShaderRecord.SizeInBytes  = rgSize;
-    m_commandList->DispatchRays(&desc);
-
-    // The raytracing output needs to be copied to the actual render target used
-    // for display. For this, we need to transition the raytracing output from a
-    // UAV to a copy source, and the render target buffer to a copy destination.
-    // We can then do the actual copy, before transitioning the render target
-    // buffer into a render target, that will be then used to display the image
-    // Transition the raytracing output texture array from UAV to COPY_SOURCE
-    transition = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_outputResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-    m_commandList->ResourceBarrier(1, &transition);
-
-    // Transition the current render target from RENDER_TARGET to COPY_DEST
-    transition = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_DEST);
-    m_commandList->ResourceBarrier(1, &transition);
-
-    UINT selectedLayer = m_displayLevels[m_currentDisplayLevel];
-    // Calculate the subresource index for the specific layer of the texture array
-    UINT subresourceIndex = D3D12CalcSubresource(0, selectedLayer, 0, 1, 30);
-    CD3DX12_TEXTURE_COPY_LOCATION src(m_outputResource.Get(), subresourceIndex);
-    CD3DX12_TEXTURE_COPY_LOCATION dest(m_renderTargets[m_frameIndex].Get(), 0);
-
-    // Define the region to copy - in this case, the whole layer
-    D3D12_BOX srcBox = {0, 0, 0, static_cast<UINT>(m_width), static_cast<UINT>(m_height), 1};
-    m_commandList->CopyTextureRegion(&dest, 0, 0, 0, &src, &srcBox);
-
-    // Transition the render target back to RENDER_TARGET to be used for presentation
-    transition = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    m_commandList->ResourceBarrier(1, &transition);
-
-  //}
-
-    barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_renderTargets[m_frameIndex].Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET,
-        D3D12_RESOURCE_STATE_PRESENT
-    );
-    m_commandList->ResourceBarrier(1, &barrier);
 
+    // The passes in the order of the compiled render graph, each after the
+    // transitions and UAV barriers it needs (CreateRenderGraph). The output
+    // array starts and ends the frame as a copy source, the back buffer in
+    // PRESENT.
+    for (const GraphStep &step : m_compiledGraph.steps) {
+      RecordGraphBarriers(step.barriers);
+      if (step.pass == m_presentCopyPass) {
+        // Copy the selected layer of the raytracing output to the back buffer
+        UINT selectedLayer = m_displayLevels[m_currentDisplayLevel];
+        // Calculate the subresource index of the slice holding that layer
+        UINT subresourceIndex = D3D12CalcSubresource(0, m_outputLayers.Slice(selectedLayer), 0, 1,
+                                                     m_outputLayers.ResidentSlices());
+        CD3DX12_TEXTURE_COPY_LOCATION src(m_outputResource.Get(), subresourceIndex);
+        CD3DX12_TEXTURE_COPY_LOCATION dest(m_renderTargets[m_frameIndex].Get(), 0);
+
+        // Define the region to copy - in this case, the whole layer
+        D3D12_BOX srcBox = {0, 0, 0, static_cast<UINT>(m_width), static_cast<UINT>(m_height), 1};
+        m_commandList->CopyTextureRegion(&dest, 0, 0, 0, &src, &srcBox);
+        continue;
+      }
+      // The ray generation shaders are consecutive SBT records
+      for (UINT r = 0; r < _countof(m_rayGenPasses); r++) {
+        if (m_rayGenPasses[r] == step.pass) {
+          desc.RayGenerationShaderRecord.StartAddress = sbtStart + r * rgSize;
+          desc.RayGenerationShaderRecord.SizeInBytes = rgSize;
+          m_commandList->DispatchRays(&desc);
+        }
+      }
+    }
+    RecordGraphBarriers(m_compiledGraph.finalBarriers);
+
+  ThrowIfFailed(m_commandList->Close());
+}
+
+void Renderer::WaitForGpu() {
+  m_frameRing.WaitIdle(m_queueFence);
+}
+
+void Renderer::CreateRenderGraph() {
+  m_renderGraph = RenderGraph();
+  m_graphResources.clear();
+  auto importResource = [&](const char *name, ComPtr<ID3D12Resource> *resource,
+                            GraphState initialState, GraphState finalState) {
+    m_graphResources.push_back(resource);
+    return m_renderGraph.Import(name, initialState, finalState);
+  };
+  // The current reservoirs and samples are rewritten by the first pass every
+  // frame, only their lifetimes within the frame matter
+  auto transient = [&](const char *name, ComPtr<ID3D12Resource> *resource) {
+    m_graphResources.push_back(resource);
+    return m_renderGraph.CreateTransient(name, (*resource)->GetDesc().Width,
+                                         GraphState::UnorderedAccess);
+  };
+  const GraphState uav = GraphState::UnorderedAccess;
+
+  const uint32_t output =
+      importResource("output", &m_outputResource, GraphState::CopySource, GraphState::CopySource);
+  const uint32_t backBuffer =
+      importResource("back_buffer", nullptr, GraphState::Present, GraphState::Present);
+  const uint32_t permanent = importResource("permanent", &m_permanentDataTexture, uav, uav);
+  const uint32_t lastDi = importResource("reservoirs_last_di", &m_reservoirBuffer_2, uav, uav);
+  const uint32_t lastGi = importResource("reservoirs_last_gi", &m_reservoirBuffer_4, uav, uav);
+  const uint32_t samplesLast = importResource("samples_last", &m_sampleBuffer_last, uav, uav);
+  const uint32_t di = transient("reservoirs_di", &m_reservoirBuffer);
+  const uint32_t gi = transient("reservoirs_gi", &m_reservoirBuffer_3);
+  const uint32_t samples = transient("samples", &m_sampleBuffer_current);
+
+  // RayGen: initial candidates
+  m_rayGenPasses[0] = m_renderGraph.AddPass(
+      "init", {{di, uav, true}, {gi, uav, true}, {samples, uav, true}});
+  // RayGen2: temporal reuse against last frame's reservoirs
+  m_rayGenPasses[1] = m_renderGraph.AddPass(
+      "temporal", {{di, uav, true}, {gi, uav, true}, {samples, uav, true},
+                   {lastDi, uav, false}, {lastGi, uav, false}, {samplesLast, uav, false}});
+  // RayGen3: spatial reuse, shading, accumulation and the next frame's history
+  m_rayGenPasses[2] = m_renderGraph.AddPass(
+      "spatial", {{di, uav, false}, {gi, uav, false}, {samples, uav, false},
+                  {permanent, uav, true}, {lastDi, uav, true}, {lastGi, uav, true},
+                  {samplesLast, uav, true}, {output, uav, true}});
+  m_presentCopyPass = m_renderGraph.AddPass(
+      "present_copy", {{output, GraphState::CopySource, false}, {backBuffer, GraphState::CopyDest, true}});
+
+  m_compiledGraph = m_renderGraph.Compile();
+  if (!m_compiledGraph.error.empty())
+    throw std::runtime_error("Render graph: " + m_compiledGraph.error);
+  std::wcout << L"Render graph: " << m_compiledGraph.steps.size() << L" passes in "
+             << m_compiledGraph.levels << L" levels, "
+             << m_compiledGraph.BarrierCount(GraphBarrierType::Uav) << L" UAV barriers, "
+             << m_compiledGraph.BarrierCount(GraphBarrierType::Transition) << L" transitions, transients "
+             << m_compiledGraph.transientBytes / (1024 * 1024) << L" MB -> "
+             << m_compiledGraph.aliasedBytes / (1024 * 1024) << L" MB aliased" << std::endl;
+}
+
+void Renderer::RecordGraphBarriers(const std::vector<GraphBarrier> &barriers) {
+  std::vector<CD3DX12_RESOURCE_BARRIER> d3dBarriers;
+  for (const GraphBarrier &b : barriers) {
+    ComPtr<ID3D12Resource> *resource = m_graphResources[b.resource];
+    ID3D12Resource *d3dResource = resource ? resource->Get() : m_renderTargets[m_frameIndex].Get();
+    switch (b.type) {
+    case GraphBarrierType::Transition:
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+          d3dResource, ToResourceState(b.before), ToResourceState(b.after)));
+      break;
+    case GraphBarrierType::Uav:
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(d3dResource));
+      break;
+    case GraphBarrierType::Aliasing:
+      // The graph's transients are committed resources; the alias slots are
+      // only reported until they are placed in a shared heap
+      break;
+    }
+  }
+  if (!d3dBarriers.empty())
+    m_commandList->ResourceBarrier(static_cast<UINT>(d3dBarriers.size()), d3dBarriers.data());
+}
+
+UINT64 Renderer::AllocateFrameUpload(UINT64 size, UINT64 alignment) {
+  UINT64 offset = m_uploadRing.Allocate(size, alignment);
+  if (offset == kUploadRingFull) {
+    // The frames still in flight hold the rest of the ring
+    WaitForGpu();
+    m_uploadRing.Retire(m_queueFence.CompletedValue());
+    offset = m_uploadRing.Allocate(size, alignment);
+    if (offset == kUploadRingFull)
+      throw std::runtime_error("Per-frame uploads do not fit in the upload ring");
+  }
+  return offset;
+}
+
+void Renderer::FlushUploads() {
   ThrowIfFailed(m_commandList->Close());
+  ID3D12CommandList *ppCommandLists[] = {m_commandList.Get()};
+  m_commandQueue->ExecuteCommandLists(1, ppCommandLists);
+  // The staging space used so far retires with the value WaitForGpu signals
+  m_uploadRing.EndFrame(m_frameRing.NextValue());
+  WaitForGpu();
+  m_uploadRing.Retire(m_queueFence.CompletedValue());
+  ThrowIfFailed(
+      m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
 }
 
-void Renderer::WaitForPreviousFrame() {
-  // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-  // This is code implemented as such for simplicity. The
-  // D3D12HelloFrameBuffering sample illustrates how to use fences for efficient
-  // resource usage and to maximize GPU utilization.
-
-  // Signal and increment the fence value.
-  const UINT64 fence = m_fenceValue;
-  ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
-  m_fenceValue++;
-
-  // Wait until the previous frame is finished.
-  if (m_fence->GetCompletedValue() < fence) {
-    ThrowIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
-    WaitForSingleObject(m_fenceEvent, INFINITE);
+ComPtr<ID3D12Resource> Renderer::CreateStaticBuffer(const void *data, UINT64 size,
+                                                    D3D12_RESOURCE_STATES state) {
+  ComPtr<ID3D12Resource> buffer =
+      CreatePlacedBuffer(size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+
+  // Staged in chunks of at most a quarter of the ring so that large meshes
+  // go through with only a few flushes
+  const UINT64 maxChunk = UploadRingSize / 4;
+  const uint8_t *src = static_cast<const uint8_t *>(data);
+  for (UINT64 done = 0; done < size;) {
+    const UINT64 chunk = std::min(size - done, maxChunk);
+    UINT64 offset = m_uploadRing.Allocate(chunk, 16);
+    if (offset == kUploadRingFull) {
+      FlushUploads();
+      offset = m_uploadRing.Allocate(chunk, 16);
+    }
+    memcpy(m_uploadData + offset, src + done, chunk);
+    m_commandList->CopyBufferRegion(buffer.Get(), done, m_uploadBuffer.Get(), offset, chunk);
+    done += chunk;
   }
 
-  m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+  CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+      buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, state);
+  m_commandList->ResourceBarrier(1, &barrier);
+  return buffer;
+}
+
+ComPtr<ID3D12Resource> Renderer::CreatePlacedBuffer(UINT64 size, D3D12_RESOURCE_FLAGS flags,
+                                                    D3D12_RESOURCE_STATES state) {
+  D3D12_RESOURCE_DESC desc = {};
+  desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  desc.Width = size;
+  desc.Height = 1;
+  desc.DepthOrArraySize = 1;
+  desc.MipLevels = 1;
+  desc.Format = DXGI_FORMAT_UNKNOWN;
+  desc.SampleDesc.Count = 1;
+  desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  desc.Flags = flags;
+  const D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+  PlacedBuffer placed = {};
+  for (placed.heap = 0; placed.heap < m_placedHeaps.size(); placed.heap++) {
+    placed.allocation = m_placedHeaps[placed.heap].tlsf.Allocate(info.SizeInBytes, info.Alignment);
+    if (placed.allocation.offset != kTlsfNone) {
+      break;
+    }
+  }
+  if (placed.heap == m_placedHeaps.size()) {
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = std::max(PlacedHeapSize, info.SizeInBytes);
+    heapDesc.Properties = nv_helpers_dx12::kDefaultHeapProps;
+    heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    PlacedHeap heap = {nullptr, TlsfAllocator(heapDesc.SizeInBytes, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)};
+    ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap.heap)));
+    m_placedHeaps.push_back(std::move(heap));
+    placed.allocation = m_placedHeaps.back().tlsf.Allocate(info.SizeInBytes, info.Alignment);
+  }
+
+  ComPtr<ID3D12Resource> buffer;
+  ThrowIfFailed(m_device->CreatePlacedResource(m_placedHeaps[placed.heap].heap.Get(),
+                                               placed.allocation.offset, &desc, state, nullptr,
+                                               IID_PPV_ARGS(&buffer)));
+  m_placedBuffers[buffer.Get()] = placed;
+  return buffer;
+}
+
+void Renderer::ReleasePlacedBuffer(ComPtr<ID3D12Resource> &buffer) {
+  auto placed = m_placedBuffers.find(buffer.Get());
+  if (placed != m_placedBuffers.end()) {
+    m_placedHeaps[placed->second.heap].tlsf.Free(placed->second.allocation);
+    m_placedBuffers.erase(placed);
+  }
+  buffer.Reset();
+}
+
+void Renderer::PrintPlacedHeapStats() {
+  UINT64 heapBytes = 0, usedBytes = 0, freeBytes = 0, largestFree = 0;
+  for (const PlacedHeap &heap : m_placedHeaps) {
+    const TlsfStats stats = heap.tlsf.Stats();
+    heapBytes += heap.tlsf.Capacity();
+    usedBytes += stats.usedBytes;
+    freeBytes += stats.freeBytes;
+    largestFree = std::max(largestFree, stats.largestFree);
+  }
+  std::wcout << L"Placed buffers: " << m_placedBuffers.size() << L" in " << m_placedHeaps.size()
+             << L" heaps, " << usedBytes / (1024 * 1024) << L" of " << heapBytes / (1024 * 1024)
+             << L" MB used, largest free block " << largestFree / (1024 * 1024) << L" of "
+             << freeBytes / (1024 * 1024) << L" MB free" << std::endl;
+}
+
+void Renderer::QueueFence::Signal(uint64_t value) {
+  ThrowIfFailed(m_renderer.m_commandQueue->Signal(m_renderer.m_fence.Get(), value));
+}
+
+uint64_t Renderer::QueueFence::CompletedValue() {
+  return m_renderer.m_fence->GetCompletedValue();
+}
+
+void Renderer::QueueFence::WaitFor(uint64_t value) {
+  if (m_renderer.m_fence->GetCompletedValue() < value) {
+    ThrowIfFailed(m_renderer.m_fence->SetEventOnCompletion(value, m_renderer.m_fenceEvent));
+    WaitForSingleObject(m_renderer.m_fenceEvent, INFINITE);
+  }
 }
 
 void Renderer::CheckRaytracingSupport() {
@@ -750,12 +1004,136 @@ void Renderer::OnKeyUp(UINT8 key) {
     if (key == 'C') {
         m_currentDisplayLevel = (m_currentDisplayLevel + 1) % m_displayLevels.size();
         std::wcout << L"C key pressed, switching to level: " << m_currentDisplayLevel << std::endl;
+        // First time this level is shown: it needs a slice of the output array
+        if (m_outputLayers.Select(m_displayLevels[m_currentDisplayLevel])) {
+            WaitForGpu();
+            CreateOutputArray();
+            CreateOutputArrayView();
+        }
     }
 
     if (key == VK_SPACE) {
         m_raster = !m_raster;
         std::wcout << L"Space key pressed, toggling rasterization: " << m_raster << std::endl;
     }
+
+    if (key == 'P') {
+        SelectPermutation((m_permutation + 1) % static_cast<uint32_t>(m_permutations.size()));
+    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Rebuilds the raytracing pipeline and the shader binding table with the
+// libraries of another ReSTIR preset. Called between frames; the GPU is
+// idle before the state object and the SBT are replaced. When the preset
+// does not compile, the current one stays.
+//
+void Renderer::SelectPermutation(uint32_t index) {
+    // A reload in flight was compiled for the current preset
+    FinishShaderReload(true);
+    const uint32_t previous = m_permutation;
+    m_permutation = index;
+    const std::string &name = m_permutations[index].name;
+    std::wcout << L"P key pressed, switching to preset: " << std::wstring(name.begin(), name.end()) << std::endl;
+    WaitForGpu();
+    try {
+        CreateRaytracingPipeline();
+    } catch (const std::logic_error &) {
+        m_permutation = previous;
+        std::wcout << L"Preset failed to compile, keeping the previous one" << std::endl;
+        return;
+    }
+    CreateShaderBindingTable();
+}
+
+//-----------------------------------------------------------------------------
+//
+// Shader hot reload, once per frame before it is recorded. Applies a finished
+// background build, polls the sources of the libraries a few times a second,
+// and starts a build of the changed libraries once the changes settled.
+//
+void Renderer::UpdateShaderReload() {
+    FinishShaderReload(false);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastShaderPoll < std::chrono::milliseconds(100)) {
+        return;
+    }
+    m_lastShaderPoll = now;
+    const double milliseconds = std::chrono::duration<double, std::milli>(now.time_since_epoch()).count();
+    m_shaderReload.Changed(m_shaderWatch.Poll(), milliseconds);
+    const std::vector<uint32_t> libraries = m_shaderReload.Start(milliseconds);
+    if (libraries.empty()) {
+        return;
+    }
+
+    std::wcout << L"Shader sources changed, recompiling:";
+    for (uint32_t library : libraries) {
+        const std::string &name = kShaderLibraries[library];
+        std::wcout << L" " << std::wstring(name.begin(), name.end());
+    }
+    std::wcout << std::endl;
+    const ShaderPermutation permutation = m_permutations[m_permutation];
+    const std::vector<std::wstring> paths = ShaderLibraryPaths(libraries);
+    m_shaderReloadJob = std::async(std::launch::async, [permutation, libraries, paths]() {
+        ShaderReloadJob job;
+        job.permutation = permutation.Id();
+        job.libraries = libraries;
+        std::vector<LPCWSTR> files;
+        for (const std::wstring &path : paths) {
+            files.push_back(path.c_str());
+        }
+        ThreadPool compilePool(std::max<uint32_t>(
+            1, std::min<uint32_t>(std::thread::hardware_concurrency(), static_cast<uint32_t>(files.size()))));
+        for (IDxcBlob *blob : nv_helpers_dx12::BuildShaderLibraries(files, permutation, compilePool, job.report)) {
+            job.blobs.emplace_back();
+            job.blobs.back().Attach(blob);
+        }
+        return job;
+    });
+}
+
+//-----------------------------------------------------------------------------
+//
+// Applies the background build when it is done, or after waiting for it. The
+// recompiled libraries replace those of the current preset, the libraries of
+// other presets are dropped as they were compiled from the old sources, and
+// the state object and the SBT are rebuilt while the GPU is idle. A build
+// with errors prints them and leaves the running shaders in place. Returns
+// whether the pipeline was rebuilt.
+//
+bool Renderer::FinishShaderReload(bool wait) {
+    if (!m_shaderReloadJob.valid() ||
+        (!wait && m_shaderReloadJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) {
+        return false;
+    }
+    ShaderReloadJob job = m_shaderReloadJob.get();
+    const bool ok = job.report.Failed() == 0 && job.blobs.size() == job.libraries.size();
+    m_shaderReload.Finished(ok);
+    if (!ok) {
+        const std::string errors = job.report.Errors();
+        std::wcout << L"Shader reload failed, keeping the running shaders:\n"
+                   << std::wstring(errors.begin(), errors.end()) << std::endl;
+        return false;
+    }
+
+    std::vector<ComPtr<IDxcBlob>> libraries = m_libraryVariants[job.permutation];
+    if (libraries.size() != kShaderLibraries.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < job.libraries.size(); i++) {
+        libraries[job.libraries[i]] = job.blobs[i];
+    }
+    m_libraryVariants.clear();
+    m_libraryVariants[job.permutation] = libraries;
+
+    WaitForGpu();
+    CreateRaytracingPipeline();
+    CreateShaderBindingTable();
+    std::wcout << L"Shaders reloaded: " << job.report.results.size() - job.report.Cached() << L" compiled, "
+               << job.report.Cached() << L" cached in " << job.report.wallMilliseconds << L" ms" << std::endl;
+    return true;
 }
 
 
@@ -802,16 +1180,22 @@ Renderer::CreateBottomLevelAS(
   // Once the sizes are obtained, the application is responsible for allocating
   // the necessary buffers. Since the entire generation will be done on the GPU,
   // we can directly allocate those on the default heap
+  // The builds of a load run one after the other and share the scratch
   AccelerationStructureBuffers buffers;
-  buffers.pScratch = nv_helpers_dx12::CreateBuffer(
-      m_device.Get(), scratchSizeInBytes,
-      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON,
-      nv_helpers_dx12::kDefaultHeapProps);
-  buffers.pResult = nv_helpers_dx12::CreateBuffer(
-      m_device.Get(), resultSizeInBytes,
-      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-      D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-      nv_helpers_dx12::kDefaultHeapProps);
+  if (!m_blasScratch || m_blasScratch->GetDesc().Width < scratchSizeInBytes) {
+    if (m_blasScratch) {
+      m_retiredBlasScratch.push_back(m_blasScratch);
+    }
+    m_blasScratch = CreatePlacedBuffer(scratchSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                                       D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+  } else {
+    // The previous build is done with it before this one starts
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(m_blasScratch.Get());
+    m_commandList->ResourceBarrier(1, &barrier);
+  }
+  buffers.pScratch = m_blasScratch;
+  buffers.pResult = CreatePlacedBuffer(resultSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                                       D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
 
   // Build the acceleration structure. Note that this call integrates a barrier
   // on the generated AS, so that it can be used to compute a top-level AS right
@@ -857,22 +1241,24 @@ void Renderer::CreateTopLevelAS(
         m_device.Get(), true, &scratchSize, &resultSize, &instanceDescsSize);
 
     // Create the scratch and result buffers. Since the build is all done on
-    // GPU, those can be allocated on the default heap
-    m_topLevelASBuffers.pScratch = nv_helpers_dx12::CreateBuffer(
-        m_device.Get(), scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nv_helpers_dx12::kDefaultHeapProps);
-    m_topLevelASBuffers.pResult = nv_helpers_dx12::CreateBuffer(
-        m_device.Get(), resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-        D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-        nv_helpers_dx12::kDefaultHeapProps);
+    // GPU, those can be placed in the default heaps. The scratch stays: the
+    // refit of every frame uses it.
+    m_topLevelASBuffers.pScratch = CreatePlacedBuffer(
+        scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    m_topLevelASBuffers.pResult = CreatePlacedBuffer(
+        resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+        D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
 
     // The buffer describing the instances: ID, shader binding information,
     // matrices ... Those will be copied into the buffer by the helper through
-    // mapping, so the buffer has to be allocated on the upload heap.
-    m_topLevelASBuffers.pInstanceDesc = nv_helpers_dx12::CreateBuffer(
-        m_device.Get(), instanceDescsSize, D3D12_RESOURCE_FLAG_NONE,
-        D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+    // mapping, so the buffer has to be allocated on the upload heap. The
+    // refit rewrites it every frame, so each frame in flight has its own.
+    for (FrameContext &frame : m_frames) {
+      frame.instanceDescs = nv_helpers_dx12::CreateBuffer(
+          m_device.Get(), instanceDescsSize, D3D12_RESOURCE_FLAG_NONE,
+          D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+    }
   }
   // After all the buffers are allocated, or if only an update is required, we
   // can build the acceleration structure. Note that in the case of the update
@@ -881,7 +1267,7 @@ void Renderer::CreateTopLevelAS(
   m_topLevelASGenerator.Generate(m_commandList.Get(),
                                  m_topLevelASBuffers.pScratch.Get(),
                                  m_topLevelASBuffers.pResult.Get(),
-                                 m_topLevelASBuffers.pInstanceDesc.Get(),
+                                 m_frames[m_frameRing.Slot()].instanceDescs.Get(),
                                  updateOnly, m_topLevelASBuffers.pResult.Get());
 }
 
@@ -900,7 +1286,6 @@ void Renderer::CreateAccelerationStructures() {
   // #DXR Extra: Indexed Geometry
   // Build the bottom AS from the Menger Sponge vertex buffer
 
-    std::vector<AccelerationStructureBuffers> blasBuffers;
     m_instances.clear();
     m_instanceModelIndices.clear();
 
@@ -911,7 +1296,6 @@ void Renderer::CreateAccelerationStructures() {
                 {{m_IB[i].Get(), m_IndexCount[i]}}
         );
 
-        blasBuffers.push_back(buffers);
 
         // Assuming each instance will use an identity matrix for simplicity,
         // but you can replace XMMatrixIdentity() with any transformation matrix.
@@ -924,25 +1308,36 @@ void Renderer::CreateAccelerationStructures() {
 
     // Create buffer for emissive triangles
     CreateEmissiveTrianglesBuffer();
+    m_modelVertices.clear();
+    m_modelIndices.clear();
 
-  // Flush the command list and wait for it to finish
-  m_commandList->Close();
-  ID3D12CommandList *ppCommandLists[] = {m_commandList.Get()};
-  m_commandQueue->ExecuteCommandLists(1, ppCommandLists);
-  m_fenceValue++;
-  m_commandQueue->Signal(m_fence.Get(), m_fenceValue);
-
-  m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent);
-  WaitForSingleObject(m_fenceEvent, INFINITE);
+  // Flush the command list (static buffer copies and AS builds) and wait for
+  // it to finish; it is reset to be reused for rendering
+  FlushUploads();
 
-  // Once the command list is finished executing, reset it to be reused for
-  // rendering
-  ThrowIfFailed(
-      m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+  // The BLAS scratch is free for the buffers created after the load
+  ReleasePlacedBuffer(m_blasScratch);
+  for (ComPtr<ID3D12Resource> &scratch : m_retiredBlasScratch) {
+    ReleasePlacedBuffer(scratch);
+  }
+  m_retiredBlasScratch.clear();
+  PrintPlacedHeapStats();
+}
 
-  // Store the AS buffers. The rest of the buffers will be released once we exit
-  // the function
-  //m_bottomLevelAS = bottomLevelBuffers.pResult;
+//-----------------------------------------------------------------------------
+// One heap table with the bindings of kDescriptorBindings visible to a root
+// signature, at the slots of m_bindings
+//
+void Renderer::AddBindingRanges(nv_helpers_dx12::RootSignatureGenerator &rsc, uint8_t visibility) {
+    std::vector<std::tuple<UINT, UINT, UINT, D3D12_DESCRIPTOR_RANGE_TYPE, UINT>> ranges;
+    for (const DescriptorRange &r : m_bindings.Ranges(visibility)) {
+        const D3D12_DESCRIPTOR_RANGE_TYPE type =
+                r.type == DescriptorType::Cbv ? D3D12_DESCRIPTOR_RANGE_TYPE_CBV
+                : r.type == DescriptorType::Srv ? D3D12_DESCRIPTOR_RANGE_TYPE_SRV
+                : D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+        ranges.emplace_back(r.shaderRegister, r.count, r.space, type, r.heapOffset);
+    }
+    rsc.AddHeapRangesParameter(ranges);
 }
 
 //-----------------------------------------------------------------------------
@@ -952,26 +1347,7 @@ void Renderer::CreateAccelerationStructures() {
 
 ComPtr<ID3D12RootSignature> Renderer::CreateRayGenSignature() {
     nv_helpers_dx12::RootSignatureGenerator rsc;
-
-    rsc.AddHeapRangesParameter(
-            {
-                    {0 /*u0*/, 1 /*1 descriptor */, 0 /*use the implicit register space 0*/, D3D12_DESCRIPTOR_RANGE_TYPE_UAV /* UAV representing the output buffer*/,0 /*heap slot where the UAV is defined*/},
-                    {1 /*u1*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 7},
-                    {0 /*t0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Top-level acceleration structure*/,1},
-                    {0 /*b0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_CBV /*Camera parameters*/,2},
-                    {3 /*t3*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3}, // **Added SRV for t3**
-                    {4 /*t4*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4 /*5th slot - Material IDs*/},
-                    {5 /*t5*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 5 /*6th slot - Materials*/},
-                    {6 /*t6*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV,6},
-                    {2 /*u2*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV,8},
-                    {3 /*u3*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV,9},
-                    {4 /*u4*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV,10},
-                    {5 /*u5*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV,11},
-                    {6 /*u6*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV,12},
-                    {7 /*u7*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV,13}
-            }
-    );
-
+    AddBindingRanges(rsc, kVisibleRayGen);
     return rsc.Generate(m_device.Get(), true);
 }
 
@@ -994,16 +1370,8 @@ ComPtr<ID3D12RootSignature> Renderer::CreateHitSignature() {
   // HLSL as register(b0)
   rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0);
   // #DXR Extra - Another ray type
-  // Add a single range pointing to the TLAS in the heap
-    rsc.AddHeapRangesParameter(
-            {{0 /*t2*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 /*2nd slot of the heap*/},
-             //{0 /*b0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_CBV /*Scene data*/, 2},
-                    // # DXR Extra - Simple Lighting
-             {3 /*t3*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Per-instance data*/, 3},
-             {4 /*t4*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4 /*5th slot - Material IDs*/},
-             {5 /*t5*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 5 /*6th slot - Materials*/},
-                    {6 /*t6*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 6 /*7th slot - Light triangles*/}
-            });
+  // The TLAS, instance and material data in the heap
+  AddBindingRanges(rsc, kVisibleHit);
   return rsc.Generate(m_device.Get(), true);
 }
 
@@ -1030,15 +1398,48 @@ void Renderer::CreateRaytracingPipeline() {
   // during the raytracing process. This section compiles the HLSL code into a
   // set of DXIL libraries. We chose to separate the code in several libraries
   // by semantic (ray generation, hit, miss) for clarity. Any code layout can be
-  // used.
-  m_rayGenLibrary = nv_helpers_dx12::CompileShaderLibrary(L"RayGen_v6_pass1.hlsl");
-  m_rayGenLibrary2 = nv_helpers_dx12::CompileShaderLibrary(L"RayGen_v6_pass2.hlsl");
-  m_rayGenLibrary3 = nv_helpers_dx12::CompileShaderLibrary(L"RayGen_v6_pass3.hlsl");
-  m_missLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Miss_v6.hlsl");
-  m_hitLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Hit_v6.hlsl");
+  // used. The libraries are compiled in parallel, one per pool thread, with
+  // the defines of the selected preset. The ones compiled by an earlier run
+  // from the same sources come from the shader cache (DXRHelper.h), the ones
+  // of a preset used before in this run from memory.
+  const ShaderPermutation &permutation = m_permutations[m_permutation];
+  std::vector<ComPtr<IDxcBlob>> &libraries = m_libraryVariants[permutation.Id()];
+  if (libraries.empty()) {
+    std::vector<uint32_t> all(kShaderLibraries.size());
+    std::iota(all.begin(), all.end(), 0u);
+    const std::vector<std::wstring> paths = ShaderLibraryPaths(all);
+    std::vector<LPCWSTR> libraryFiles;
+    for (const std::wstring &path : paths) {
+      libraryFiles.push_back(path.c_str());
+    }
+    ThreadPool compilePool(std::min<uint32_t>(std::thread::hardware_concurrency(),
+                                              static_cast<uint32_t>(libraryFiles.size())));
+    ShaderBuildReport build;
+    std::vector<IDxcBlob *> blobs;
+    try {
+      blobs = nv_helpers_dx12::CompileShaderLibraries(libraryFiles, permutation, compilePool, build);
+    } catch (...) {
+      m_libraryVariants.erase(permutation.Id());
+      throw;
+    }
+    std::wcout << L"Shader libraries (" << std::wstring(permutation.name.begin(), permutation.name.end())
+               << L"): " << build.Cached() << L" cached, " << build.results.size() - build.Cached()
+               << L" compiled on " << build.threads << L" threads in " << build.wallMilliseconds << L" ms ("
+               << build.jobMilliseconds << L" ms of jobs, " << build.SavedMilliseconds() << L" ms saved)"
+               << std::endl;
+    for (IDxcBlob *blob : blobs) {
+      libraries.emplace_back();
+      libraries.back().Attach(blob);
+    }
+  }
+  m_rayGenLibrary = libraries[0];
+  m_rayGenLibrary2 = libraries[1];
+  m_rayGenLibrary3 = libraries[2];
+  m_missLibrary = libraries[3];
+  m_hitLibrary = libraries[4];
 
   // #DXR Extra - Another ray type
-  m_shadowLibrary = nv_helpers_dx12::CompileShaderLibrary(L"ShadowRay.hlsl");
+  m_shadowLibrary = libraries[5];
   pipeline.AddLibrary(m_shadowLibrary.Get(),
                       {L"ShadowClosestHit", L"ShadowMiss"});
   m_shadowSignature = CreateHitSignature();
@@ -1143,26 +1544,7 @@ void Renderer::CreateRaytracingPipeline() {
 // output image
 //
 void Renderer::CreateRaytracingOutputBuffer() {
-  D3D12_RESOURCE_DESC resDesc = {};
-  //10 backtracking size, times the buffer number
-  resDesc.DepthOrArraySize = 30 * 2;
-  resDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-  // The backbuffer is actually DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, but sRGB
-  // formats cannot be used with UAVs. For accuracy we should convert to sRGB
-  // ourselves in the shader
-  resDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-
-  resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-  resDesc.Width = GetWidth();
-  resDesc.Height = GetHeight();
-  resDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-  resDesc.MipLevels = 1;
-  resDesc.SampleDesc.Count = 1;
-  ThrowIfFailed(m_device->CreateCommittedResource(
-      &nv_helpers_dx12::kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc,
-      D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr,
-      IID_PPV_ARGS(&m_outputResource)));
-
+  CreateOutputArray();
 
     // Create a texture description
     D3D12_RESOURCE_DESC textureDesc = {};
@@ -1187,6 +1569,56 @@ void Renderer::CreateRaytracingOutputBuffer() {
 
 }
 
+//-----------------------------------------------------------------------------
+//
+// The output texture array holds the presented image in slice 0 and only the
+// debug levels selected so far (m_outputLayers), instead of all 60 layers
+//
+void Renderer::CreateOutputArray() {
+  D3D12_RESOURCE_DESC resDesc = {};
+  resDesc.DepthOrArraySize = static_cast<UINT16>(m_outputLayers.ResidentSlices());
+  resDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+  // The backbuffer is actually DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, but sRGB
+  // formats cannot be used with UAVs. For accuracy we should convert to sRGB
+  // ourselves in the shader
+  resDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+  resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+  resDesc.Width = GetWidth();
+  resDesc.Height = GetHeight();
+  resDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+  resDesc.MipLevels = 1;
+  resDesc.SampleDesc.Count = 1;
+  m_outputResource.Reset();
+  ThrowIfFailed(m_device->CreateCommittedResource(
+      &nv_helpers_dx12::kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc,
+      D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr,
+      IID_PPV_ARGS(&m_outputResource)));
+
+  std::wcout << L"Output array: " << m_outputLayers.ResidentSlices() << L" slices, "
+             << m_outputLayers.ResidentBytes(GetWidth(), GetHeight()) / (1024 * 1024) << L" MB ("
+             << m_outputLayers.AllLayersBytes(GetWidth(), GetHeight()) / (1024 * 1024) << L" MB for all "
+             << m_outputLayers.LogicalLayers() << L" layers)" << std::endl;
+}
+
+void Renderer::CreateOutputArrayView() {
+  D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+  uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+  uavDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+  uavDesc.Texture2DArray.MipSlice = 0;
+  uavDesc.Texture2DArray.FirstArraySlice = 0;
+  uavDesc.Texture2DArray.ArraySize = m_outputLayers.ResidentSlices();
+  m_device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc,
+                                      BindingDescriptor(Binding::Output));
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE Renderer::BindingDescriptor(Binding binding) {
+  D3D12_CPU_DESCRIPTOR_HANDLE handle = m_srvUavHeap->GetCPUDescriptorHandleForHeapStart();
+  handle.ptr += static_cast<SIZE_T>(m_bindings.Slot(binding)) *
+                m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+  return handle;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Create the main heap used by the shaders, which will give access to the
@@ -1194,34 +1626,16 @@ void Renderer::CreateRaytracingOutputBuffer() {
 //
 void Renderer::CreateShaderResourceHeap() {
   // #DXR Extra: Perspective Camera
-  // Create a SRV/UAV/CBV descriptor heap. We need 3 entries - 1 SRV for the
-  // TLAS, 1 UAV for the raytracing output and 1 CBV for the camera matrices
-// Create a SRV/UAV/CBV descriptor heap. We need 4 entries - 1 SRV for the TLAS, 1 UAV for the
-// raytracing output, 1 CBV for the camera matrices, 1 SRV for the
-// per-instance data (# DXR Extra - Simple Lighting)
+  // Create a SRV/UAV/CBV descriptor heap holding the persistent and per-frame
+  // ranges of m_descriptors. Each view goes to the slot of its binding
+  // (m_bindings, see src/Render/DescriptorLayout.h)
     m_srvUavHeap = nv_helpers_dx12::CreateDescriptorHeap(
-            m_device.Get(), 20, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
+            m_device.Get(), m_descriptors.Capacity(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
 
-  // Get a handle to the heap memory on the CPU side, to be able to write the
-  // descriptors directly
-  D3D12_CPU_DESCRIPTOR_HANDLE srvHandle =
-      m_srvUavHeap->GetCPUDescriptorHandleForHeapStart();
+  // Written by CreateOutputArrayView, also when the array grows
+  CreateOutputArrayView();
 
-  // Create the UAV. Based on the root signature we created it is the first
-  // entry. The Create*View methods write the view information directly into
-  // srvHandle
-  D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
-    uavDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // Ensure this matches your resource format
-    uavDesc.Texture2DArray.MipSlice = 0; // Assuming you're using the first MIP level
-    uavDesc.Texture2DArray.FirstArraySlice = 0; // Starting at the first layer of the array
-    uavDesc.Texture2DArray.ArraySize = 30; // The number of layers in the array
-  m_device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc,
-                                      srvHandle);
-
-  // Add the Top Level AS SRV right after the raytracing output buffer
-  srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(
-      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+  D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = BindingDescriptor(Binding::SceneBVH);
 
   D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
   srvDesc.Format = DXGI_FORMAT_UNKNOWN;
@@ -1233,9 +1647,8 @@ void Renderer::CreateShaderResourceHeap() {
   m_device->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
 
   // #DXR Extra: Perspective Camera
-  // Add the constant buffer for the camera after the TLAS
-  srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(
-      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+  // The constant buffer for the camera
+  srvHandle = BindingDescriptor(Binding::Camera);
 
 // Describe and create a constant buffer view for the camera
     D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
@@ -1253,8 +1666,7 @@ void Renderer::CreateShaderResourceHeap() {
 
 
     //# DXR Extra - Simple Lighting
-    srvHandle.ptr +=
-            m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::InstanceProperties);
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc1;
     srvDesc1.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -1267,10 +1679,8 @@ void Renderer::CreateShaderResourceHeap() {
 // Write the per-instance properties buffer view in the heap
     m_device->CreateShaderResourceView(m_instanceProperties.Get(), &srvDesc1, srvHandle);
 
-    // Move to the next descriptor slot
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
     // Create SRV for the Material IDs buffer
+    srvHandle = BindingDescriptor(Binding::MaterialIDs);
     D3D12_SHADER_RESOURCE_VIEW_DESC materialIdSrvDesc = {};
     materialIdSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     materialIdSrvDesc.Format = DXGI_FORMAT_R32_UINT; // Assuming material IDs are 32-bit unsigned integers
@@ -1281,10 +1691,8 @@ void Renderer::CreateShaderResourceHeap() {
     materialIdSrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
     m_device->CreateShaderResourceView(m_materialIndexBuffer.Get(), &materialIdSrvDesc, srvHandle);
 
-    // Move to the next descriptor slot
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
     // Create SRV for the Materials buffer
+    srvHandle = BindingDescriptor(Binding::Materials);
     D3D12_SHADER_RESOURCE_VIEW_DESC materialsSrvDesc = {};
     materialsSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     materialsSrvDesc.Format = DXGI_FORMAT_UNKNOWN; // Use DXGI_FORMAT_UNKNOWN for structured buffers
@@ -1295,10 +1703,8 @@ void Renderer::CreateShaderResourceHeap() {
     materialsSrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
     m_device->CreateShaderResourceView(m_materialBuffer.Get(), &materialsSrvDesc, srvHandle);
 
-// After existing descriptors
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
 // Create SRV for the Emissive Triangles buffer
+    srvHandle = BindingDescriptor(Binding::EmissiveTriangles);
     D3D12_SHADER_RESOURCE_VIEW_DESC emissiveTrianglesSrvDesc = {};
     emissiveTrianglesSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     emissiveTrianglesSrvDesc.Format = DXGI_FORMAT_UNKNOWN; // Structured buffer
@@ -1309,36 +1715,38 @@ void Renderer::CreateShaderResourceHeap() {
     emissiveTrianglesSrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
     m_device->CreateShaderResourceView(m_emissiveTrianglesBuffer.Get(), &emissiveTrianglesSrvDesc, srvHandle);
 
-    // Move to the next descriptor slot after the last SRV
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
     // Create UAV for the permanent data texture
+    srvHandle = BindingDescriptor(Binding::PermanentData);
     D3D12_UNORDERED_ACCESS_VIEW_DESC permanentDataUavDesc = {};
     permanentDataUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
     permanentDataUavDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; // Ensure this matches your resource format
     permanentDataUavDesc.Texture2D.MipSlice = 0;
     permanentDataUavDesc.Texture2D.PlaneSlice = 0;
 
-    // Create the UAV in the heap at the current descriptor slot (heap slot 7)
     m_device->CreateUnorderedAccessView(m_permanentDataTexture.Get(), nullptr, &permanentDataUavDesc, srvHandle);
 
 
 
     //_________________________________
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::ReservoirsDi);
 
     // Assuming you know the number of elements and structure size
     UINT width = GetWidth();
     UINT height = GetHeight();
-    UINT reservoirCount = width * height;
+    // MapPixelID pads the tiled schemes to whole tiles (PixelMapping.h)
+    UINT reservoirCount = PixelBufferCount(PIXEL_MAPPING, PIXEL_TILE_SIZE, width, height);
+    // GI reservoirs only for the pixels that own one (GiResolution.h)
+    UINT reservoirCount_gi = GiBufferCount(GI_RESOLUTION, width, height);
     UINT reservoirElementSize_di = sizeof(Reservoir_DI);
     UINT reservoirElementSize_gi = sizeof(Reservoir_GI);
     UINT reservoirElementSize_sample = sizeof(SampleData);
     UINT reservoirBufferSize_di = reservoirCount * reservoirElementSize_di;
-    UINT reservoirBufferSize_gi = reservoirCount * reservoirElementSize_gi;
+    UINT reservoirBufferSize_gi = reservoirCount_gi * reservoirElementSize_gi;
     UINT reservoirBufferSize_sample = reservoirCount * reservoirElementSize_sample;
 
-// Create default-heap buffer with UAV for random read/write
+// Create default-heap buffer with UAV for random read/write. Committed, not
+// placed: the first frame reads the history buffers, zeroed memory only comes
+// with a new committed resource
     D3D12_RESOURCE_DESC reservoirDesc = {};
     reservoirDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
     reservoirDesc.Alignment = 0;
@@ -1368,6 +1776,7 @@ void Renderer::CreateShaderResourceHeap() {
     reservoirUavDesc.Buffer.StructureByteStride = reservoirElementSize_di;
     reservoirUavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
 
+    SetReservoirUavLayout(reservoirUavDesc);
     m_device->CreateUnorderedAccessView(
             m_reservoirBuffer.Get(),
             nullptr,
@@ -1377,7 +1786,7 @@ void Renderer::CreateShaderResourceHeap() {
     //_________________________________
 
     //_________________________________
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::ReservoirsLastDi);
 
 // Create default-heap buffer with UAV for random read/write
     D3D12_RESOURCE_DESC reservoirDesc_2 = {};
@@ -1409,6 +1818,7 @@ void Renderer::CreateShaderResourceHeap() {
     reservoirUavDesc_2.Buffer.StructureByteStride = reservoirElementSize_di;
     reservoirUavDesc_2.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
 
+    SetReservoirUavLayout(reservoirUavDesc_2);
     m_device->CreateUnorderedAccessView(
             m_reservoirBuffer_2.Get(),
             nullptr,
@@ -1418,7 +1828,7 @@ void Renderer::CreateShaderResourceHeap() {
     //_________________________________
 
     //_________________________________
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::ReservoirsGi);
     // Create default-heap buffer with UAV for random read/write
     D3D12_RESOURCE_DESC reservoirDesc_3 = {};
     reservoirDesc_3.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
@@ -1442,23 +1852,24 @@ void Renderer::CreateShaderResourceHeap() {
     ));
 
     D3D12_UNORDERED_ACCESS_VIEW_DESC reservoirUavDesc_3 = {};
-    reservoirUavDesc_2.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-    reservoirUavDesc_2.Format = DXGI_FORMAT_UNKNOWN; // For structured buffers
-    reservoirUavDesc_2.Buffer.FirstElement = 0;
-    reservoirUavDesc_2.Buffer.NumElements = reservoirCount;
-    reservoirUavDesc_2.Buffer.StructureByteStride = reservoirElementSize_gi;
-    reservoirUavDesc_2.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-
+    reservoirUavDesc_3.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    reservoirUavDesc_3.Format = DXGI_FORMAT_UNKNOWN; // For structured buffers
+    reservoirUavDesc_3.Buffer.FirstElement = 0;
+    reservoirUavDesc_3.Buffer.NumElements = reservoirCount_gi;
+    reservoirUavDesc_3.Buffer.StructureByteStride = reservoirElementSize_gi;
+    reservoirUavDesc_3.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+
+    SetReservoirUavLayout(reservoirUavDesc_3);
     m_device->CreateUnorderedAccessView(
             m_reservoirBuffer_3.Get(),
             nullptr,
-            &reservoirUavDesc_2,
+            &reservoirUavDesc_3,
             srvHandle
     );
     //_________________________________
 
     //_________________________________
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::ReservoirsLastGi);
     // Create default-heap buffer with UAV for random read/write
     D3D12_RESOURCE_DESC reservoirDesc_4 = {};
     reservoirDesc_4.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
@@ -1485,10 +1896,11 @@ void Renderer::CreateShaderResourceHeap() {
     reservoirUavDesc_4.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
     reservoirUavDesc_4.Format = DXGI_FORMAT_UNKNOWN; // For structured buffers
     reservoirUavDesc_4.Buffer.FirstElement = 0;
-    reservoirUavDesc_4.Buffer.NumElements = reservoirCount;
+    reservoirUavDesc_4.Buffer.NumElements = reservoirCount_gi;
     reservoirUavDesc_4.Buffer.StructureByteStride = reservoirElementSize_gi;
     reservoirUavDesc_4.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
 
+    SetReservoirUavLayout(reservoirUavDesc_4);
     m_device->CreateUnorderedAccessView(
             m_reservoirBuffer_4.Get(),
             nullptr,
@@ -1497,7 +1909,7 @@ void Renderer::CreateShaderResourceHeap() {
     );
     //_________________________________
     //_________________________________
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::SamplesCurrent);
     // Create default-heap buffer with UAV for random read/write
     D3D12_RESOURCE_DESC reservoirDesc_5 = {};
     reservoirDesc_5.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
@@ -1537,7 +1949,7 @@ void Renderer::CreateShaderResourceHeap() {
     //_________________________________
 
     //_________________________________
-    srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvHandle = BindingDescriptor(Binding::SamplesLast);
     // Create default-heap buffer with UAV for random read/write
     D3D12_RESOURCE_DESC reservoirDesc_6 = {};
     reservoirDesc_6.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
@@ -1680,10 +2092,11 @@ void Renderer::CreateCameraBuffer() {
     // Debug output: Display the calculated buffer size
     std::wcout << L"Camera buffer size (in bytes): " << m_cameraBufferSize << std::endl;
 
-    // Create the constant buffer for all matrices and additional parameters
-    m_cameraBuffer = nv_helpers_dx12::CreateBuffer(
-            m_device.Get(), m_cameraBufferSize, D3D12_RESOURCE_FLAG_NONE,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+    // Create the constant buffer for all matrices and additional parameters.
+    // The shaders read it from the default heap; each frame writes its copy
+    // into the upload ring, which PopulateCommandList copies over.
+    m_cameraBuffer = CreatePlacedBuffer(m_cameraBufferSize, D3D12_RESOURCE_FLAG_NONE,
+                                        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
     // Debug output: Check if the buffer was created successfully
     if (m_cameraBuffer)
@@ -1739,13 +2152,10 @@ void Renderer::UpdateCameraBuffer() {
     matrices[4] = m_prevViewMatrix;
     matrices[5] = m_prevProjMatrix;
 
-    // Copy matrix contents to the buffer
-    uint8_t *pData;
-    HRESULT hr = m_cameraBuffer->Map(0, nullptr, (void **)&pData);
-    if (FAILED(hr)) {
-        std::wcerr << L"Failed to map camera buffer!" << std::endl;
-        return;
-    }
+    // Copy matrix contents to this frame's space in the upload ring
+    m_cameraUploadOffset = AllocateFrameUpload(m_cameraBufferSize,
+                                               D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+    uint8_t *pData = m_uploadData + m_cameraUploadOffset;
 
     // Copy the 6 matrices
     memcpy(pData, matrices.data(), 6 * sizeof(XMMATRIX));
@@ -1759,9 +2169,6 @@ void Renderer::UpdateCameraBuffer() {
 
     memcpy(pData + (6 * sizeof(XMMATRIX)), &currentTime, sizeof(float));
 
-
-    m_cameraBuffer->Unmap(0, nullptr);
-
     // Save the current matrices for use in the next frame
     m_prevViewMatrix = matrices[0];
     m_prevProjMatrix = matrices[1];
@@ -1987,6 +2394,32 @@ void Renderer::CreateVB(std::string name) {
 
   //nv_helpers_dx12::GenerateMengerSponge(3, 0.75, vertices, indices);
   ObjLoader::loadObjFile(name,&vertices, &indices, &materials, &materialIDs, &materialIDOffset, &materialVertexOffset);
+  if (m_preSplitGeometry) {
+      PreSplitStats splitStats = PreSplitTriangles(
+          vertices, indices, m_preSplitSettings,
+          [](const Vertex &v) { return glm::vec3(v.position.x, v.position.y, v.position.z); },
+          [](const Vertex &a, const Vertex &b, float u) {
+              // The hit shader only uses vertex normals with all components set; keep others at zero
+              const XMFLOAT4 &na = a.normal_material;
+              const XMFLOAT4 &nb = b.normal_material;
+              bool usable = na.x != 0 && na.y != 0 && na.z != 0 && nb.x != 0 && nb.y != 0 && nb.z != 0;
+              XMFLOAT3 pos(a.position.x + (b.position.x - a.position.x) * u,
+                           a.position.y + (b.position.y - a.position.y) * u,
+                           a.position.z + (b.position.z - a.position.z) * u);
+              XMFLOAT4 normal = usable ? XMFLOAT4(na.x + (nb.x - na.x) * u, na.y + (nb.y - na.y) * u,
+                                                  na.z + (nb.z - na.z) * u, na.w)
+                                       : XMFLOAT4(0.0f, 0.0f, 0.0f, na.w);
+              return Vertex(pos, normal);
+          },
+          [&](uint32_t from, uint32_t) {
+              // Material IDs are stored per triangle corner and indexed by PrimitiveIndex()
+              UINT ids[3] = {materialIDs[3 * from], materialIDs[3 * from + 1], materialIDs[3 * from + 2]};
+              materialIDs.insert(materialIDs.end(), ids, ids + 3);
+          });
+      std::wcout << L"Pre-split: " << splitStats.inputTriangles << L" -> " << splitStats.outputTriangles
+                 << L" triangles, largest box " << splitStats.maxAreaFractionBefore << L" -> "
+                 << splitStats.maxAreaFractionAfter << L" of the mesh bounds" << std::endl;
+  }
     // Before inserting new material IDs, store the current offset
     m_materialIDOffsets.push_back(static_cast<UINT>(m_materialIDs.size()));
 
@@ -1999,27 +2432,11 @@ void Renderer::CreateVB(std::string name) {
     const UINT mengerVBSize =
         static_cast<UINT>(vertices.size()) * sizeof(Vertex);
 
-    // Note: using upload heaps to transfer static data like vert buffers is not
-    // recommended. Every time the GPU needs it, the upload heap will be
-    // marshalled over. Please read up on Default Heap usage. An upload heap is
-    // used here for code simplicity and because there are very few verts to
-    // actually transfer.
-    CD3DX12_HEAP_PROPERTIES heapProperty =
-        CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC bufferResource =
-        CD3DX12_RESOURCE_DESC::Buffer(mengerVBSize);
-    ThrowIfFailed(m_device->CreateCommittedResource(
-        &heapProperty, D3D12_HEAP_FLAG_NONE, &bufferResource, //
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&l_VB)));
-
-    // Copy the triangle data to the vertex buffer.
-    UINT8 *pVertexDataBegin;
-    CD3DX12_RANGE readRange(
-        0, 0); // We do not intend to read from this resource on the CPU.
-    ThrowIfFailed(l_VB->Map(
-        0, &readRange, reinterpret_cast<void **>(&pVertexDataBegin)));
-    memcpy(pVertexDataBegin, vertices.data(), mengerVBSize);
-      l_VB->Unmap(0, nullptr);
+    // The vertex buffer lives on the default heap; the data is staged through
+    // the upload ring. The BLAS builds and the hit shaders read it as a
+    // non-pixel shader resource.
+    l_VB = CreateStaticBuffer(vertices.data(), mengerVBSize,
+                              D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
     // Initialize the vertex buffer view.
       l_VBView.BufferLocation = l_VB->GetGPUVirtualAddress();
@@ -2029,27 +2446,9 @@ void Renderer::CreateVB(std::string name) {
   {
     const UINT IBSize = static_cast<UINT>(indices.size()) * sizeof(UINT);
 
-    // Note: using upload heaps to transfer static data like vert buffers is not
-    // recommended. Every time the GPU needs it, the upload heap will be
-    // marshalled over. Please read up on Default Heap usage. An upload heap is
-    // used here for code simplicity and because there are very few verts to
-    // actually transfer.
-    CD3DX12_HEAP_PROPERTIES heapProperty =
-        CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC bufferResource =
-        CD3DX12_RESOURCE_DESC::Buffer(IBSize);
-    ThrowIfFailed(m_device->CreateCommittedResource(
-        &heapProperty, D3D12_HEAP_FLAG_NONE, &bufferResource, //
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&l_IB)));
-
-    // Copy the triangle data to the index buffer.
-    UINT8 *pIndexDataBegin;
-    CD3DX12_RANGE readRange(
-        0, 0); // We do not intend to read from this resource on the CPU.
-    ThrowIfFailed(l_IB->Map(0, &readRange,
-                                  reinterpret_cast<void **>(&pIndexDataBegin)));
-    memcpy(pIndexDataBegin, indices.data(), IBSize);
-      l_IB->Unmap(0, nullptr);
+    // Staged into the default heap like the vertex buffer
+    l_IB = CreateStaticBuffer(indices.data(), IBSize,
+                              D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
     // Initialize the index buffer view.
       l_IBView.BufferLocation = l_IB->GetGPUVirtualAddress();
@@ -2067,6 +2466,8 @@ void Renderer::CreateVB(std::string name) {
     m_IBView.push_back(l_IBView);
     m_VertexCount.push_back(l_VertexCount);
     m_IndexCount.push_back(l_IndexCount);
+    m_modelVertices.push_back(std::move(vertices));
+    m_modelIndices.push_back(std::move(indices));
     m_material.push_back(l_material);
     m_materialID.push_back(l_materialID);
 }
@@ -2079,21 +2480,20 @@ void Renderer::CreateInstancePropertiesBuffer() {
       static_cast<uint32_t>(m_instances.size()) * sizeof(InstanceProperties),
       D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 
-  // Create the constant buffer for all matrices
-  m_instanceProperties = nv_helpers_dx12::CreateBuffer(
-      m_device.Get(), bufferSize, D3D12_RESOURCE_FLAG_NONE,
-      D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+  // Create the constant buffer for all matrices, read from the default heap
+  // and filled from the upload ring every frame like m_cameraBuffer
+  m_instanceProperties = CreatePlacedBuffer(bufferSize, D3D12_RESOURCE_FLAG_NONE,
+                                            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+  m_instancePropertiesData.assign(m_instances.size(), InstanceProperties{});
 }
 
 //--------------------------------------------------------------------------------------------------
 // Copy the per-instance data into the buffer
 // #DXR Extra - Refitting
 void Renderer::UpdateInstancePropertiesBuffer() {
-  InstanceProperties *current = nullptr;
-  CD3DX12_RANGE readRange(
-      0, 0); // We do not intend to read from this resource on the CPU.
-  ThrowIfFailed(m_instanceProperties->Map(0, &readRange,
-                                          reinterpret_cast<void **>(&current)));
+  // The previous transforms come from the CPU copy; the upload ring only
+  // holds what the GPU copies this frame
+  InstanceProperties *current = m_instancePropertiesData.data();
     for (const auto &inst : m_instances)
     {
         XMVECTOR det_filler;
@@ -2117,7 +2517,11 @@ void Renderer::UpdateInstancePropertiesBuffer() {
         current->objectToWorldNormal = XMMatrixTranspose(XMMatrixInverse(&det, upper3x3));
         current++;
     }
-  m_instanceProperties->Unmap(0, nullptr);
+
+  const UINT64 size = m_instancePropertiesData.size() * sizeof(InstanceProperties);
+  m_instancePropertiesUploadOffset =
+      AllocateFrameUpload(size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+  memcpy(m_uploadData + m_instancePropertiesUploadOffset, m_instancePropertiesData.data(), size);
 }
 
 void Renderer::CollectEmissiveTriangles() {
@@ -2129,16 +2533,9 @@ void Renderer::CollectEmissiveTriangles() {
         UINT e_materialIDOffset = m_materialIDOffsets[modelIndex];
         UINT triangleCount = m_IndexCount[modelIndex] / 3;
 
-        // Map the vertex and index buffers for the model
-        Vertex* vertices = nullptr;
-        UINT* indices = nullptr;
-        CD3DX12_RANGE readRange(0, 0);
-
-        // Map the vertex buffer
-        ThrowIfFailed(m_VB[modelIndex]->Map(0, &readRange, reinterpret_cast<void**>(&vertices)));
-
-        // Map the index buffer
-        ThrowIfFailed(m_IB[modelIndex]->Map(0, &readRange, reinterpret_cast<void**>(&indices)));
+        // The CPU copies of the model's vertex and index buffers
+        const Vertex* vertices = m_modelVertices[modelIndex].data();
+        const UINT* indices = m_modelIndices[modelIndex].data();
 
         for (UINT t = 0; t < triangleCount; ++t) {
             UINT idx0 = indices[t * 3 + 0];
@@ -2177,10 +2574,6 @@ void Renderer::CollectEmissiveTriangles() {
                 m_emissiveTriangles.push_back(lt);
             }
         }
-
-        // Unmap the vertex and index buffers
-        m_VB[modelIndex]->Unmap(0, nullptr);
-        m_IB[modelIndex]->Unmap(0, nullptr);
     }
 
     // Sort the emissive triangles based on weight in descending order
@@ -2242,41 +2635,10 @@ void Renderer::CreateEmissiveTrianglesBuffer() {
         m_emissiveTriangle.triCount = static_cast<UINT>(m_emissiveTriangles.size());
     }
 
-    // Create an upload buffer
-    ComPtr<ID3D12Resource> emissiveTrianglesUploadBuffer = nv_helpers_dx12::CreateBuffer(
-            m_device.Get(), static_cast<UINT>(bufferSize), D3D12_RESOURCE_FLAG_NONE,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
-
-    // Copy data to the upload buffer
-    {
-        LightTriangle* pData = nullptr;
-        CD3DX12_RANGE readRange(0, 0);
-        ThrowIfFailed(emissiveTrianglesUploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
-        memcpy(pData, m_emissiveTriangles.data(), bufferSize);
-        emissiveTrianglesUploadBuffer->Unmap(0, nullptr);
-    }
-
-    // Create the default heap buffer
-    m_emissiveTrianglesBuffer = nv_helpers_dx12::CreateBuffer(
-            m_device.Get(), static_cast<UINT>(bufferSize), D3D12_RESOURCE_FLAG_NONE,
-            D3D12_RESOURCE_STATE_COPY_DEST, nv_helpers_dx12::kDefaultHeapProps);
-
-    // Copy data from upload buffer to default heap buffer
-    m_commandList->CopyBufferRegion(m_emissiveTrianglesBuffer.Get(), 0, emissiveTrianglesUploadBuffer.Get(), 0, bufferSize);
-
-    // Transition the buffer to GENERIC_READ for shader access
-    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_emissiveTrianglesBuffer.Get(),
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_GENERIC_READ);
-    m_commandList->ResourceBarrier(1, &barrier);
-
-    // Execute and flush the command list
-    ThrowIfFailed(m_commandList->Close());
-    ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-    m_commandQueue->ExecuteCommandLists(1, ppCommandLists);
-    WaitForPreviousFrame();
-    ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), nullptr));
+    // Default heap buffer staged through the upload ring, in GENERIC_READ for
+    // shader access; the copy runs with the flush in CreateAccelerationStructures
+    m_emissiveTrianglesBuffer = CreateStaticBuffer(m_emissiveTriangles.data(), bufferSize,
+                                                   D3D12_RESOURCE_STATE_GENERIC_READ);
 }
 
 
@@ -15,12 +15,29 @@
 
 #include <dxcapi.h>
 #include <vector>
+#include <unordered_map>
+#include <future>
+#include <chrono>
 #include <d3d12video.h>
 #include <DirectXPackedVector.h>
 
+#include "nv_helpers_dx12/RootSignatureGenerator.h"
 #include "nv_helpers_dx12/ShaderBindingTableGenerator.h"
 #include "nv_helpers_dx12/TopLevelASGenerator.h"
 #include "../src/Components/Vertex.h"
+#include "../src/Accel/PreSplit.h"
+#include "../include/ReservoirLayout.h"
+#include "../include/PixelMapping.h"
+#include "../include/GiResolution.h"
+#include "../src/Render/OutputLayers.h"
+#include "../src/Render/FrameRing.h"
+#include "../src/Render/UploadRing.h"
+#include "../src/Render/RenderGraph.h"
+#include "../src/Render/DescriptorLayout.h"
+#include "../src/Render/Tlsf.h"
+#include "../src/Render/ShaderPermutation.h"
+#include "../src/Render/ShaderBuild.h"
+#include "../src/Render/ShaderReload.h"
 
 #include <sl.h>            // core SL types: sl::Result, sl::FeatureHandle, etc.
 #include <sl_consts.h>     // the sl::kFeature… enum values
@@ -63,7 +80,7 @@ private:
   ComPtr<IDXGISwapChain3> m_swapChain;
   ComPtr<ID3D12Device5> m_device;
   ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
-  ComPtr<ID3D12CommandAllocator> m_commandAllocator;
+  ComPtr<ID3D12CommandAllocator> m_commandAllocator; // loading and other flushed work
   ComPtr<ID3D12CommandQueue> m_commandQueue;
   ComPtr<ID3D12RootSignature> m_rootSignature;
   ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
@@ -80,12 +97,76 @@ private:
   UINT m_frameIndex;
   HANDLE m_fenceEvent;
   ComPtr<ID3D12Fence> m_fence;
-  UINT64 m_fenceValue;
+
+  // FrameFence over m_commandQueue / m_fence for m_frameRing
+  class QueueFence : public FrameFence {
+  public:
+    explicit QueueFence(Renderer &renderer) : m_renderer(renderer) {}
+    void Signal(uint64_t value) override;
+    uint64_t CompletedValue() override;
+    void WaitFor(uint64_t value) override;
+
+  private:
+    Renderer &m_renderer;
+  };
+
+  // What the CPU writes for a frame while earlier frames may still be on the
+  // GPU; slot m_frameRing.Slot() is recorded, see src/Render/FrameRing.h
+  struct FrameContext {
+    ComPtr<ID3D12CommandAllocator> commandAllocator;
+    ComPtr<ID3D12Resource> instanceDescs; // TLAS build / refit input, mapped by the helper
+  };
+  FrameContext m_frames[FrameCount];
+  FrameRing m_frameRing{FrameCount};
+  QueueFence m_queueFence{*this};
+
+  // Upload heap mapped for the lifetime of the renderer. The per-frame
+  // constants and the staging copies of static buffers are suballocated from
+  // it by m_uploadRing and freed by fence value, see src/Render/UploadRing.h
+  static const UINT64 UploadRingSize = 32ull << 20;
+  ComPtr<ID3D12Resource> m_uploadBuffer;
+  uint8_t *m_uploadData = nullptr;
+  UploadRing m_uploadRing{UploadRingSize};
+  UINT64 m_cameraUploadOffset = 0;             // copied into m_cameraBuffer
+  UINT64 m_instancePropertiesUploadOffset = 0; // copied into m_instanceProperties
+  // Ring space for the frame being recorded; waits for the GPU when full
+  UINT64 AllocateFrameUpload(UINT64 size, UINT64 alignment);
+  // Default-heap buffer filled from data through the ring by copies recorded
+  // into m_commandList, left in state
+  ComPtr<ID3D12Resource> CreateStaticBuffer(const void *data, UINT64 size,
+                                            D3D12_RESOURCE_STATES state);
+  // Executes the loading commands recorded so far, waits for them and
+  // reopens m_commandList
+  void FlushUploads();
+
+  // Default-heap buffers placed in ID3D12Heaps of PlacedHeapSize bytes, each
+  // suballocated by a TlsfAllocator (src/Render/Tlsf.h); a buffer larger than
+  // that gets a heap of its own size. Declared before the buffers so the
+  // heaps are released last.
+  static const UINT64 PlacedHeapSize = 256ull << 20;
+  struct PlacedHeap {
+    ComPtr<ID3D12Heap> heap;
+    TlsfAllocator tlsf;
+  };
+  struct PlacedBuffer {
+    size_t heap;
+    TlsfAllocation allocation;
+  };
+  std::vector<PlacedHeap> m_placedHeaps;
+  std::unordered_map<ID3D12Resource *, PlacedBuffer> m_placedBuffers;
+  ComPtr<ID3D12Resource> CreatePlacedBuffer(UINT64 size, D3D12_RESOURCE_FLAGS flags,
+                                            D3D12_RESOURCE_STATES state);
+  // Gives the memory of a CreatePlacedBuffer buffer back to its heap; the GPU
+  // must be done with it
+  void ReleasePlacedBuffer(ComPtr<ID3D12Resource> &buffer);
+  // Heap bytes, used bytes and fragmentation over all placed heaps
+  void PrintPlacedHeapStats();
 
   void LoadPipeline();
   void LoadAssets();
   void PopulateCommandList();
-  void WaitForPreviousFrame();
+  // Blocks until the GPU has finished everything submitted so far
+  void WaitForGpu();
 
   void CheckRaytracingSupport();
 
@@ -123,19 +204,20 @@ private:
         XMFLOAT3 pad0;
     };
 
+    // Opaque here, the fields live in ReservoirLayout.h
     struct Reservoir_DI
     {
-        uint8_t  pad[40]; // 48 bytes
+        uint8_t  pad[RESERVOIR_ELEMENT_BYTES];
     };
 
     struct Reservoir_GI
     {
-        uint8_t  pad[40]; // 56 bytes :(
+        uint8_t  pad[RESERVOIR_ELEMENT_BYTES];
     };
 
     struct SampleData
     {
-        uint8_t  pad[60]; // 48 bytes
+        uint8_t  pad[SAMPLE_DATA_BYTES]; // 60 bytes, 48 without the debug channel
     };
 
 
@@ -152,6 +234,10 @@ private:
       std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers,
       std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vIndexBuffers =
           {});
+  // Scratch shared by the BLAS builds of a load, grown when a build needs
+  // more; the outgrown ones wait in m_retiredBlasScratch until the flush
+  ComPtr<ID3D12Resource> m_blasScratch;
+  std::vector<ComPtr<ID3D12Resource>> m_retiredBlasScratch;
 
   /// Create the main acceleration structure that holds
   /// all instances of the scene
@@ -173,6 +259,31 @@ private:
 
   void CreateRaytracingPipeline();
 
+  // ReSTIR presets compiled into the ray tracing libraries (P cycles them).
+  // The libraries of every preset used so far stay in memory, keyed by
+  // ShaderPermutation::Id, in the order CreateRaytracingPipeline compiles them.
+  void SelectPermutation(uint32_t index);
+  std::vector<ShaderPermutation> m_permutations = RestirPresets();
+  uint32_t m_permutation = 0;
+  std::unordered_map<uint64_t, std::vector<ComPtr<IDxcBlob>>> m_libraryVariants;
+
+  // Shader hot reload (ShaderReload.h): the libraries whose sources changed
+  // are compiled on a background thread for the current preset, then the
+  // state object and the SBT are rebuilt between frames. Resources, and with
+  // them the reservoir history and the scene, are kept.
+  struct ShaderReloadJob {
+    uint64_t permutation = 0;
+    std::vector<uint32_t> libraries;             // indices into the pipeline's libraries
+    std::vector<ComPtr<IDxcBlob>> blobs;         // in the order of libraries; empty on failure
+    ShaderBuildReport report;
+  };
+  void UpdateShaderReload();
+  bool FinishShaderReload(bool wait);
+  ShaderWatch m_shaderWatch;
+  ShaderReloadSchedule m_shaderReload;
+  std::future<ShaderReloadJob> m_shaderReloadJob;
+  std::chrono::steady_clock::time_point m_lastShaderPoll;
+
   ComPtr<IDxcBlob> m_rayGenLibrary;
   ComPtr<IDxcBlob> m_rayGenLibrary2;
   ComPtr<IDxcBlob> m_rayGenLibrary3;
@@ -192,9 +303,23 @@ private:
   // #DXR
   void CreateRaytracingOutputBuffer();
   void CreateShaderResourceHeap();
+  // m_outputResource with the slices of m_outputLayers, and its UAV in the
+  // Binding::Output slot
+  void CreateOutputArray();
+  void CreateOutputArrayView();
   ComPtr<ID3D12Resource> m_outputResource;
     ComPtr<ID3D12Resource> m_permanentDataTexture;
   ComPtr<ID3D12DescriptorHeap> m_srvUavHeap;
+  // Slots of m_srvUavHeap, see src/Render/DescriptorLayout.h: persistent
+  // ranges for the views of the bindings, a linear range per frame slot for
+  // views that only live for one frame
+  static const UINT PersistentDescriptors = 64;
+  static const UINT FrameDescriptors = 16;
+  DescriptorAllocator m_descriptors{PersistentDescriptors, FrameCount, FrameDescriptors};
+  BindingTable m_bindings = {};
+  D3D12_CPU_DESCRIPTOR_HANDLE BindingDescriptor(Binding binding);
+  // Heap ranges of the bindings a root signature sees
+  void AddBindingRanges(nv_helpers_dx12::RootSignatureGenerator &rsc, uint8_t visibility);
 
   // #DXR
   void CreateShaderBindingTable();
@@ -250,6 +375,10 @@ private:
   UINT materialIDOffset = 0;
   UINT materialVertexOffset = 0;
 
+  // Subdivide oversized triangles before they reach the BLAS builder (see src/Accel/PreSplit.h)
+  bool m_preSplitGeometry = false;
+  PreSplitSettings m_preSplitSettings;
+
   //Support for several objects (instanced optionally)
   //____________________________________________________________________________________________________________________
   std::vector<ComPtr<ID3D12Resource>> m_VB;
@@ -260,6 +389,10 @@ private:
   std::vector<ComPtr<ID3D12Resource>> m_materialID;
   std::vector<UINT> m_IndexCount;
   std::vector<UINT> m_VertexCount;
+  // CPU copies of the geometry for CollectEmissiveTriangles, m_VB / m_IB are
+  // not readable; released once the emissive triangles are built
+  std::vector<std::vector<Vertex>> m_modelVertices;
+  std::vector<std::vector<UINT>> m_modelIndices;
   //____________________________________________________________________________________________________________________
 
 
@@ -289,6 +422,7 @@ private:
 
   ComPtr<ID3D12Resource> m_instanceProperties;
   ComPtr<ID3D12Resource> m_instancePropertiesPrevious;
+  std::vector<InstanceProperties> m_instancePropertiesData; // CPU copy, keeps the previous transforms
   void CreateInstancePropertiesBuffer();
   void UpdateInstancePropertiesBuffer();
 
@@ -297,6 +431,18 @@ private:
 
   UINT m_currentDisplayLevel = 0; // Start with the main image at level 0
   std::vector<UINT> m_displayLevels = {0, 10, 11, 12, 13, 14, 15, 16, 17, 20,21,22,23,24,25,26,27,28}; // Levels to cycle through
+  OutputLayerPlan m_outputLayers; // resident slices of m_outputResource, debug levels on first selection
+
+  // The ray tracing passes and the copy to the back buffer with the
+  // resources they access; compiled once into the barriers PopulateCommandList
+  // records, see src/Render/RenderGraph.h
+  void CreateRenderGraph();
+  void RecordGraphBarriers(const std::vector<GraphBarrier> &barriers);
+  RenderGraph m_renderGraph;
+  CompiledGraph m_compiledGraph;
+  std::vector<ComPtr<ID3D12Resource> *> m_graphResources; // per graph resource, nullptr for the back buffer
+  uint32_t m_rayGenPasses[3] = {}; // graph pass of RayGen, RayGen2, RayGen3 (SBT order)
+  uint32_t m_presentCopyPass = 0;
   void ExtractFrustumPlanes(const XMMATRIX &viewProjMatrix, XMFLOAT4 *planes);
 
 
@@ -5,23 +5,53 @@
 #define LUT_SIZE_THETA 16
 #define EXPOSURE 1.0f
 
+// ReSTIR tuning: a permutation of the libraries may set any of these with
+// -D (src/Render/ShaderPermutation.h)
+#ifndef nee_samples
 #define nee_samples 4
+#endif
+#ifndef nee_samples_DI
 #define nee_samples_DI 4
+#endif
+#ifndef bsdf_samples_DI
 #define bsdf_samples_DI 1
+#endif
+#ifndef bounces
 #define bounces 3
+#endif
 #define rr_threshold 1
 
+#ifndef spatial_candidate_count
 #define spatial_candidate_count 3
+#endif
+#ifndef spatial_max_tries
 #define spatial_max_tries 9
+#endif
+#ifndef spatial_radius
 #define spatial_radius 20
+#endif
+#ifndef spatial_exponent
 #define spatial_exponent 1.0f
+#endif
+#ifndef spatial_M_cap
 #define spatial_M_cap 128
+#endif
+#ifndef spatial_M_cap_GI
 #define spatial_M_cap_GI 128
+#endif
+#ifndef temporal_M_cap
 #define temporal_M_cap 16
+#endif
+#ifndef temporal_M_cap_GI
 #define temporal_M_cap_GI 16
+#endif
 #define temporal_r_threshold 0.09f
+#ifndef w_sum_threshold
 #define w_sum_threshold 5.0f
+#endif
+#ifndef j_threshold
 #define j_threshold 5.0f
+#endif
 
 #define beta 1.0f
 
@@ -159,42 +189,25 @@ float3 SafeMultiply(float scalar, float3 vec)
     return result;
 }
 
-// Column Major
-/*inline uint MapPixelID(uint2 dims, uint2 lIndex){
-    return lIndex.x * dims.y + lIndex.y;
-}*/
+// Buffer element of a pixel, scheme selected in PixelMapping.h
+#include "../include/PixelMapping.h"
 
-// Row Major
-/*inline uint MapPixelID(uint2 dims, uint2 lIndex){
-    return lIndex.y * dims.x + lIndex.x;
-}*/
-
-// Swizzling
 inline uint MapPixelID(uint2 dims, uint2 lIndex)
 {
-    // Internal tile dimensions (square tiles).
-    const uint tileSize = 4;
-
-    // How many tiles do we have horizontally?
-    // Use integer division w/ ceiling to handle dimensions not multiples of tileSize.
-    uint tileCountX = (dims.x + tileSize - 1) / tileSize;
-
-    // Determine which tile this pixel belongs to:
-    uint tileIndexX = lIndex.x / tileSize;
-    uint tileIndexY = lIndex.y / tileSize;
-
-    // Local pixel coordinates inside that tile.
-    uint localX = lIndex.x % tileSize;
-    uint localY = lIndex.y % tileSize;
+    return PixelIndex(PIXEL_MAPPING, PIXEL_TILE_SIZE, dims.x, lIndex.x, lIndex.y);
+}
 
-    // Flatten the tile index (row-major across tiles):
-    uint flattenedTileIndex = tileIndexY * tileCountX + tileIndexX;
+// GI reservoir element of a pixel that owns one, mode selected in GiResolution.h
+#include "../include/GiResolution.h"
 
-    // Flatten the local pixel index within the tile (row-major again):
-    uint flattenedLocalIndex = localY * tileSize + localX;
+inline uint MapGiPixelID(uint2 dims, uint2 lIndex)
+{
+    return GiPixelIndex(GI_RESOLUTION, dims.x, lIndex.x, lIndex.y);
+}
 
-    // Combine: first skip all full tiles, then add the local index.
-    return flattenedTileIndex * (tileSize * tileSize) + flattenedLocalIndex;
+inline uint2 GiOwner(uint2 p)
+{
+    return uint2(GiOwnerX(GI_RESOLUTION, p.x, p.y), GiOwnerY(GI_RESOLUTION, p.y));
 }
 
 
@@ -1,88 +1,197 @@
-// Each row is 16 bytes
-struct SampleData
-{
-    float3 x1;  // (12 bytes)
-    uint16_t  mID;   // (2 bytes)
-    half3 L1;   // (6 bytes)
-    float3 n1;  // (12 bytes)
-    float3 o;    // (12 bytes)
-    uint  objID;   // (4 bytes)
-    float3  debug;   // (12 bytes)
-};
-
+// Packed storage for Reservoir_DI / Reservoir_GI / SampleData, see
+// ReservoirPacking.h for the layout. Include after Reservoir_v6.hlsl.
+// src/Render/ReservoirCompression.cpp is the C++ version, bit for bit.
+#include "../include/ReservoirPacking.h"
 
-// RIS reservoir for direct lighting
-struct Reservoir_DI
+struct PackedReservoir
 {
-    float3 x2;    float w_sum; // 16 bytes total
-    float3 n2;    float W;     // 16 bytes total
-    half3 L2;     uint16_t M;   // 8 bytes total
+    float3 x;       // x2 / xn
+    uint normalM;   // octahedral normal | M
+    uint radiance;  // RGB9E5
+    uint weights;   // W high bits | w_sum
 };
 
-struct Reservoir_GI
+struct PackedSampleData
 {
-    float3 xn;     float w_sum; //16
-    float3 nn;     float W;  //16
-    half3 E3;     uint16_t M; //8
+    float3 x1;
+    uint n1;        // octahedral
+    uint o;         // octahedral
+    uint L1;        // RGB9E5
+    uint objID;
+    uint mID;
 };
 
-// Update the reservoir with the light
-inline bool UpdateReservoir_GI(
-    inout Reservoir_GI reservoir,
-    float wi,
-    float M,
+// 2^e for integer e in the normal float range, exact
+inline float Pow2(int e)
+{
+    return asfloat(uint(e + 127) << 23);
+}
 
-    float3 xn,
-    float3 nn,
-    float3 E3,
-    inout uint2 seed
-    )
+// bits per axis in the low 2 * bits bits; code 0 is the zero vector
+inline uint PackOctahedral(float3 n, uint bits)
 {
+    float l1 = abs(n.x) + abs(n.y) + abs(n.z);
+    if (l1 == 0.0f)
+        return 0;
+    float2 p = n.xy / l1;
+    if (n.z < 0.0f)
+        p = (1.0f - abs(p.yx)) * float2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+    uint maxq = (1u << bits) - 1;
+    uint2 q = uint2(floor(saturate(p * 0.5f + 0.5f) * float(maxq) + 0.5f));
+    // (0, 0) and (max, max) are both -z, keep 0 for the zero vector
+    if (q.x == 0 && q.y == 0)
+        q = uint2(maxq, maxq);
+    return q.x | (q.y << bits);
+}
 
-    reservoir.w_sum += wi;
-    reservoir.M += M;
+inline float3 UnpackOctahedral(uint code, uint bits)
+{
+    if (code == 0)
+        return float3(0.0f, 0.0f, 0.0f);
+    uint maxq = (1u << bits) - 1;
+    float2 p = float2(code & maxq, (code >> bits) & maxq) * (2.0f / float(maxq)) - 1.0f;
+    float3 n = float3(p, 1.0f - abs(p.x) - abs(p.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
 
-    if (RandomFloat(seed) < wi / reservoir.w_sum)
+inline uint PackRGB9E5(float3 c)
+{
+    c = clamp(c, 0.0f, PACKED_RGB9E5_MAX);
+    float maxc = max(c.x, max(c.y, c.z));
+    // floor(log2(maxc)) from the exponent bits, no log2 rounding
+    int log2Max = int((asuint(maxc) >> 23) & 0xFF) - 127;
+    int e = max(-PACKED_RGB9E5_EXPONENT_BIAS - 1, log2Max) + 1 + PACKED_RGB9E5_EXPONENT_BIAS;
+    float scale = Pow2(PACKED_RGB9E5_EXPONENT_BIAS + PACKED_RGB9E5_MANTISSA_BITS - e);
+    if (floor(maxc * scale + 0.5f) == float(1 << PACKED_RGB9E5_MANTISSA_BITS))
     {
-        reservoir.xn = xn;
-        reservoir.nn = nn;
-        reservoir.E3 = E3;
-        return true;
+        e++;
+        scale *= 0.5f;
     }
-    return false;
+    uint3 m = uint3(floor(c * scale + 0.5f));
+    return m.x | (m.y << 9) | (m.z << 18) | (uint(e) << 27);
 }
 
+inline float3 UnpackRGB9E5(uint v)
+{
+    int e = int(v >> 27);
+    float scale = Pow2(e - PACKED_RGB9E5_EXPONENT_BIAS - PACKED_RGB9E5_MANTISSA_BITS);
+    return float3(v & 0x1FF, (v >> 9) & 0x1FF, (v >> 18) & 0x1FF) * scale;
+}
 
-// Update the reservoir with the light
-inline bool UpdateReservoir(
-    inout Reservoir_DI reservoir,
-    float wi,
-    float M,
+inline uint PackNormalM(float3 n, uint M)
+{
+    return PackOctahedral(n, PACKED_RESERVOIR_OCT_BITS) | (min(M, (uint)PACKED_M_MAX) << (2 * PACKED_RESERVOIR_OCT_BITS));
+}
 
-    float3 x2,
-    float3 n2,
-    float3 L2, // No need to update L1, as this is always 0 when the sample is processed here. Alwo,we dont want to reuse sample on a lights surface
-    inout uint2 seed
-    )
+inline float3 UnpackNormal(uint normalM)
 {
+    return UnpackOctahedral(normalM & ((1u << (2 * PACKED_RESERVOIR_OCT_BITS)) - 1), PACKED_RESERVOIR_OCT_BITS);
+}
 
-    reservoir.w_sum += wi;
-    reservoir.M += (uint16_t)M;
+inline uint UnpackM(uint normalM)
+{
+    return normalM >> (2 * PACKED_RESERVOIR_OCT_BITS);
+}
 
-    if (RandomFloat(seed) < wi / reservoir.w_sum)
+// w_sum: the float bits rounded to 5 mantissa bits and rebiased to a 5 bit
+// exponent, clamped so that a positive w_sum never becomes 0
+inline uint PackWeights(float W, float w_sum)
+{
+    uint wBits = asuint(W > 0.0f ? W : 0.0f);
+    uint wKept = (wBits + (1u << (PACKED_W_DROPPED_BITS - 1))) >> PACKED_W_DROPPED_BITS;
+    uint sum = 0;
+    if (w_sum > 0.0f)
     {
-        reservoir.x2 = x2;
-        reservoir.n2 = n2;
-        reservoir.L2 = L2;
-        return true;
+        int s = int((asuint(w_sum) + (1u << (PACKED_W_SUM_DROPPED_BITS - 1))) >> PACKED_W_SUM_DROPPED_BITS);
+        s -= (127 - PACKED_W_SUM_EXPONENT_BIAS) << 5;
+        sum = uint(clamp(s, 1 << 5, (1 << PACKED_W_SUM_BITS) - 1));
     }
-    return false;
+    return (wKept << PACKED_W_SUM_BITS) | sum;
 }
 
-inline void SetReservoirWeight(Reservoir_DI reservoir, float weight){
-    reservoir.w_sum = weight;
+inline float UnpackW(uint weights)
+{
+    return asfloat((weights >> PACKED_W_SUM_BITS) << PACKED_W_DROPPED_BITS);
 }
 
-inline void SetReservoirWeight_GI(Reservoir_DI reservoir, float weight){
-    reservoir.w_sum = weight;
-}
\ No newline at end of file
+inline float UnpackWsum(uint weights)
+{
+    uint sum = weights & ((1u << PACKED_W_SUM_BITS) - 1);
+    if (sum == 0)
+        return 0.0f;
+    return asfloat((sum + ((127 - PACKED_W_SUM_EXPONENT_BIAS) << 5)) << PACKED_W_SUM_DROPPED_BITS);
+}
+
+inline PackedReservoir PackReservoir_DI(Reservoir_DI r)
+{
+    PackedReservoir p;
+    p.x = r.x2;
+    p.normalM = PackNormalM(r.n2, r.M);
+    p.radiance = PackRGB9E5(r.L2);
+    p.weights = PackWeights(r.W, r.w_sum);
+    return p;
+}
+
+inline Reservoir_DI UnpackReservoir_DI(PackedReservoir p)
+{
+    Reservoir_DI r;
+    r.x2 = p.x;
+    r.n2 = UnpackNormal(p.normalM);
+    r.L2 = (half3)UnpackRGB9E5(p.radiance);
+    r.w_sum = UnpackWsum(p.weights);
+    r.W = UnpackW(p.weights);
+    r.M = (uint16_t)UnpackM(p.normalM);
+    return r;
+}
+
+inline PackedReservoir PackReservoir_GI(Reservoir_GI r)
+{
+    PackedReservoir p;
+    p.x = r.xn;
+    p.normalM = PackNormalM(r.nn, r.M);
+    p.radiance = PackRGB9E5(r.E3);
+    p.weights = PackWeights(r.W, r.w_sum);
+    return p;
+}
+
+inline Reservoir_GI UnpackReservoir_GI(PackedReservoir p)
+{
+    Reservoir_GI r;
+    r.xn = p.x;
+    r.nn = UnpackNormal(p.normalM);
+    r.E3 = (half3)UnpackRGB9E5(p.radiance);
+    r.w_sum = UnpackWsum(p.weights);
+    r.W = UnpackW(p.weights);
+    r.M = (uint16_t)UnpackM(p.normalM);
+    return r;
+}
+
+inline PackedSampleData PackSampleData(SampleData s)
+{
+    PackedSampleData p;
+    p.x1 = s.x1;
+    p.n1 = PackOctahedral(s.n1, PACKED_OCT_BITS);
+    p.o = PackOctahedral(s.o, PACKED_OCT_BITS);
+    p.L1 = PackRGB9E5(s.L1);
+    p.objID = s.objID;
+    p.mID = s.mID;
+    return p;
+}
+
+inline SampleData UnpackSampleData(PackedSampleData p)
+{
+    SampleData s;
+    s.x1 = p.x1;
+    s.mID = (uint16_t)p.mID;
+    s.L1 = (half3)UnpackRGB9E5(p.L1);
+    s.n1 = UnpackOctahedral(p.n1, PACKED_OCT_BITS);
+    s.o = UnpackOctahedral(p.o, PACKED_OCT_BITS);
+    s.objID = p.objID;
+#if SAMPLE_DATA_DEBUG
+    s.debug = float3(0.0f, 0.0f, 0.0f);
+#endif
+    return s;
+}
@@ -19,7 +19,7 @@ float GenPairwiseMIS_canonical(
     {
         if (!rejected[j])
         {
-            float n_M_min   = min(M_cap, g_Reservoirs_current[n[j]].M);
+            float n_M_min   = min(M_cap, LoadReservoir_DI_M(g_Reservoirs_current, n[j]));
             float p_hat_from = GetP_Hat(g_sample_current[n[j]].x1, g_sample_current[n[j]].n1, c.x2, c.n2, c.L2, g_sample_current[n[j]].o, matOpt, true);
 
             float m_den = c_m_num + (c_M_max * p_hat_from);
@@ -51,7 +51,7 @@ float GenPairwiseMIS_noncanonical(
     float m_den      = m_num + (c_M_min * p_c);
 
     if (m_den > 0.0f) {
-        float n_M_min = min(M_cap, g_Reservoirs_current[n].M);
+        float n_M_min = min(M_cap, LoadReservoir_DI_M(g_Reservoirs_current, n));
         return (n_M_min / M_sum) * (m_num / m_den);
     }
     else {
@@ -10,10 +10,10 @@
 RWTexture2DArray<float4> gOutput : register(u0);
 RWTexture2D<float4> gPermanentData : register(u1);
 
-RWStructuredBuffer<Reservoir_DI> g_Reservoirs_current : register(u2);
-RWStructuredBuffer<Reservoir_DI> g_Reservoirs_last : register(u3);
-RWStructuredBuffer<Reservoir_GI> g_Reservoirs_current_gi : register(u4);
-RWStructuredBuffer<Reservoir_GI> g_Reservoirs_last_gi : register(u5);
+RESERVOIR_BUFFER(Reservoir_DI) g_Reservoirs_current : register(u2);
+RESERVOIR_BUFFER(Reservoir_DI) g_Reservoirs_last : register(u3);
+RESERVOIR_BUFFER(Reservoir_GI) g_Reservoirs_current_gi : register(u4);
+RESERVOIR_BUFFER(Reservoir_GI) g_Reservoirs_last_gi : register(u5);
 RWStructuredBuffer<SampleData> g_sample_current : register(u6);
 RWStructuredBuffer<SampleData> g_sample_last : register(u7);
 
@@ -51,6 +51,7 @@ void RayGen() {
     uint2 launchIndex = DispatchRaysIndex().xy;
     float2 dims = float2(DispatchRaysDimensions().xy);
     uint pixelIdx = MapPixelID(dims, launchIndex);
+    bool ownsGI = IsGiPixel(GI_RESOLUTION, launchIndex.x, launchIndex.y);
 
     // #DXR Extra: Perspective Camera
     float aspectRatio = dims.x / dims.y;
@@ -133,7 +134,9 @@ void RayGen() {
         float3(0, 0, 0),  // n1
         float3(0, 0, 0),   // o
         payload.objID,        // mID
+#if SAMPLE_DATA_DEBUG
         float3(0,0,0),        // debug
+#endif
     };
 
     //_______________________________PATH_SAMPLING__________________________________
@@ -169,22 +172,31 @@ void RayGen() {
         //for(int p = 0; p< 40000; p++)
             //p_hat = GetP_Hat(sdata.x1, sdata.n1, reservoir.x2, reservoir.n2, reservoir.L2, sdata.o, matOpt, true);
 
-        // Perform path sampling (simpliefied for now)
-        sdata.debug = SamplePathSimple(reservoir_GI, payload.hitPosition, payload.hitNormal, -direction, matOpt, seed);
-        sdata.debug += ReconnectDI(sdata.x1, sdata.n1, reservoir.x2, reservoir.n2, reservoir.L2, sdata.o, matOpt) * reservoir.W;
-
-        float3 f_c = LinearizeVector(GetP_Hat_GI(sdata.x1, sdata.n1,
-                                     reservoir_GI.xn, reservoir_GI.nn,
-                                     reservoir_GI.E3,
-                                     sdata.o, matOpt, false));
-        reservoir_GI.W = GetW_GI(reservoir_GI, f_c);
-        reservoir_GI.M = 1.0f;
+#if SAMPLE_DATA_DEBUG
+        sdata.debug = ReconnectDI(sdata.x1, sdata.n1, reservoir.x2, reservoir.n2, reservoir.L2, sdata.o, matOpt) * reservoir.W;
+#endif
+        // Perform path sampling (simpliefied for now), only on pixels that own a GI reservoir
+        if(ownsGI){
+#if SAMPLE_DATA_DEBUG
+            sdata.debug += SamplePathSimple(reservoir_GI, payload.hitPosition, payload.hitNormal, -direction, matOpt, seed);
+#else
+            SamplePathSimple(reservoir_GI, payload.hitPosition, payload.hitNormal, -direction, matOpt, seed);
+#endif
+
+            float3 f_c = LinearizeVector(GetP_Hat_GI(sdata.x1, sdata.n1,
+                                         reservoir_GI.xn, reservoir_GI.nn,
+                                         reservoir_GI.E3,
+                                         sdata.o, matOpt, false));
+            reservoir_GI.W = GetW_GI(reservoir_GI, f_c);
+            reservoir_GI.M = 1.0f;
+        }
         //sdata.debug = reservoir_GI.w_sum > 0.0f? 1.0f: 0.0f;
         /*if(!IsValidReservoir_GI(reservoir_GI))
             sdata.debug = float3(1,0,0);*/
 
     }
-	g_Reservoirs_current[pixelIdx] = reservoir;
-    g_Reservoirs_current_gi[pixelIdx] = reservoir_GI;
+	StoreReservoir_DI(g_Reservoirs_current, pixelIdx, reservoir);
+    if(ownsGI)
+        StoreReservoir_GI(g_Reservoirs_current_gi, MapGiPixelID(dims, launchIndex), reservoir_GI);
     g_sample_current[pixelIdx] = sdata;
 }
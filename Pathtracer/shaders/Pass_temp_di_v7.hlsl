@@ -7,10 +7,10 @@
 RWTexture2DArray<float4> gOutput : register(u0);
 RWTexture2D<float4> gPermanentData : register(u1);
 
-RWStructuredBuffer<Reservoir_DI> g_Reservoirs_current : register(u2);
-RWStructuredBuffer<Reservoir_DI> g_Reservoirs_last : register(u3);
-RWStructuredBuffer<Reservoir_GI> g_Reservoirs_current_gi : register(u4);
-RWStructuredBuffer<Reservoir_GI> g_Reservoirs_last_gi : register(u5);
+RESERVOIR_BUFFER(Reservoir_DI) g_Reservoirs_current : register(u2);
+RESERVOIR_BUFFER(Reservoir_DI) g_Reservoirs_last : register(u3);
+RESERVOIR_BUFFER(Reservoir_GI) g_Reservoirs_current_gi : register(u4);
+RESERVOIR_BUFFER(Reservoir_GI) g_Reservoirs_last_gi : register(u5);
 RWStructuredBuffer<SampleData> g_sample_current : register(u6);
 RWStructuredBuffer<SampleData> g_sample_last : register(u7);
 
@@ -50,10 +50,12 @@ void RayGen2() {
     uint2 launchIndex = DispatchRaysIndex().xy;
     float2 dims = float2(DispatchRaysDimensions().xy);
     uint pixelIdx = MapPixelID(dims, launchIndex);
+    bool ownsGI = IsGiPixel(GI_RESOLUTION, launchIndex.x, launchIndex.y);
+    uint giPixelIdx = MapGiPixelID(dims, launchIndex);
 
     // The current reservoirs and sample data
-    Reservoir_DI reservoir_current = g_Reservoirs_current[pixelIdx];
-    Reservoir_GI reservoir_gi_current = g_Reservoirs_current_gi[pixelIdx];
+    Reservoir_DI reservoir_current = LoadReservoir_DI(g_Reservoirs_current, pixelIdx);
+    Reservoir_GI reservoir_gi_current = LoadReservoir_GI(g_Reservoirs_current_gi, giPixelIdx);
     SampleData sdata_current = g_sample_current[pixelIdx];
 
     if(sdata_current.L1.x == 0.0f && sdata_current.L1.y == 0.0f && sdata_current.L1.z == 0.0f){
@@ -81,9 +83,12 @@ void RayGen2() {
         // Obtain the best reprojected pixel from the previous frame.
         int2 pixelPos = GetBestReprojectedPixel_d(sdata_current.x1, prevView, prevProjection, dims, sdata_current.objID);
         uint tempPixelIdx = MapPixelID(dims, pixelPos);
-        Reservoir_DI reservoir_last = g_Reservoirs_last[tempPixelIdx];
-        Reservoir_GI reservoir_gi_last = g_Reservoirs_last_gi[tempPixelIdx];
+        Reservoir_DI reservoir_last = LoadReservoir_DI(g_Reservoirs_last, tempPixelIdx);
         SampleData sdata_last = g_sample_last[tempPixelIdx];
+        // GI history lives at the owner standing in for the reprojected pixel
+        uint2 pixelPosGI = GiOwner(uint2(pixelPos));
+        Reservoir_GI reservoir_gi_last = LoadReservoir_GI(g_Reservoirs_last_gi, MapGiPixelID(dims, pixelPosGI));
+        SampleData sdata_last_gi = g_sample_last[MapPixelID(dims, pixelPosGI)];
 
         // Define separate candidate acceptance criteria for DI and GI temporal reuse.
         bool candidateAcceptedDI = (pixelPos.x != -1 && pixelPos.y != -1 &&
@@ -96,13 +101,13 @@ void RayGen2() {
             (sdata_last.mID == sdata_current.mID)
         );
 
-        bool candidateAcceptedGI = (pixelPos.x != -1 && pixelPos.y != -1 &&
-            length(sdata_last.L1) == 0.0f &&
+        bool candidateAcceptedGI = (ownsGI && pixelPos.x != -1 && pixelPos.y != -1 &&
+            length(sdata_last_gi.L1) == 0.0f &&
             !RejectWsum(reservoir_gi_last.w_sum, w_sum_threshold) &&
-            //!RejectNormal(sdata_current.n1, sdata_last.n1, 0.1f) &&
-            !RejectDistance(sdata_current.x1, sdata_last.x1, init_orig, 0.1f) &&
+            //!RejectNormal(sdata_current.n1, sdata_last_gi.n1, 0.1f) &&
+            !RejectDistance(sdata_current.x1, sdata_last_gi.x1, init_orig, 0.1f) &&
             IsValidReservoir_GI(reservoir_gi_last) &&
-            (sdata_last.mID == sdata_current.mID)
+            (sdata_last_gi.mID == sdata_current.mID)
         );
 
         //sdata_current.debug = float3(1,0,0);
@@ -162,8 +167,8 @@ void RayGen2() {
 
             float M_sum_gi = min(temporal_M_cap_GI, reservoir_gi_current.M) + min(temporal_M_cap_GI, reservoir_gi_last.M);
 
-            float mi_c_gi = GenPairwiseMIS_canonical_temporal_GI(reservoir_gi_current, reservoir_gi_last, sdata_current, sdata_last, M_sum_gi, temporal_M_cap_GI, matOpt);
-            float mi_t_gi = GenPairwiseMIS_noncanonical_temporal_GI(reservoir_gi_current, reservoir_gi_last, sdata_current, sdata_last, M_sum_gi, temporal_M_cap_GI, matOpt);
+            float mi_c_gi = GenPairwiseMIS_canonical_temporal_GI(reservoir_gi_current, reservoir_gi_last, sdata_current, sdata_last_gi, M_sum_gi, temporal_M_cap_GI, matOpt);
+            float mi_t_gi = GenPairwiseMIS_noncanonical_temporal_GI(reservoir_gi_current, reservoir_gi_last, sdata_current, sdata_last_gi, M_sum_gi, temporal_M_cap_GI, matOpt);
 
             //DEBUG
             //sdata_current.debug = mi_c_gi + mi_t_gi;
@@ -198,7 +203,8 @@ void RayGen2() {
                                      sdata_current.o, matOpt, false)));
         }
     }
-    g_Reservoirs_current[pixelIdx] = reservoir_current;
-    g_Reservoirs_current_gi[pixelIdx] = reservoir_gi_current;
+    StoreReservoir_DI(g_Reservoirs_current, pixelIdx, reservoir_current);
+    if(ownsGI)
+        StoreReservoir_GI(g_Reservoirs_current_gi, giPixelIdx, reservoir_gi_current);
     g_sample_current[pixelIdx] = sdata_current;
 }
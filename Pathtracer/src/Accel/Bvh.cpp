@@ -0,0 +1,529 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(kInfinity);
+    glm::vec3 max = glm::vec3(-kInfinity);
+
+    void Grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void Grow(const Bounds& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+    bool Empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    float HalfArea() const {
+        if (Empty()) {
+            return 0.0f;
+        }
+        const glm::vec3 e = max - min;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+    static Bounds Intersection(const Bounds& a, const Bounds& b) {
+        return {glm::max(a.min, b.min), glm::min(a.max, b.max)};
+    }
+};
+
+// A triangle, or the part of it inside a spatial split, as seen by the builder
+struct Reference {
+    Bounds bounds;
+    uint32_t triangle;
+
+    glm::vec3 Centroid() const { return (bounds.min + bounds.max) * 0.5f; }
+};
+
+struct Split {
+    float cost = kInfinity;
+    int axis = -1;
+    bool spatial = false;
+    uint32_t bin = 0;      // last bin that goes left
+    float binMin = 0.0f;   // bin mapping of the winning axis
+    float binScale = 0.0f;
+    Bounds left, right;
+    uint32_t leftCount = 0, rightCount = 0;
+};
+
+// Top-down builder shared by the binned SAH and SBVH modes. Every task owns its
+// reference list, because spatial splits can grow it.
+class Builder {
+public:
+    Builder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+            const BvhBuildSettings& settings, std::vector<BvhNode>& nodes)
+        : m_positions(positions), m_indices(indices), m_settings(settings), m_nodes(nodes) {}
+
+    std::vector<Reference> Run(std::vector<Reference> refs) {
+        struct Task {
+            uint32_t node;
+            std::vector<Reference> refs;
+            uint32_t depth; // of the node, the root at 0
+        };
+
+        const size_t triangleCount = refs.size();
+        m_referenceBudget = m_settings.builder == BvhBuilder::Sbvh
+                            ? static_cast<size_t>(static_cast<double>(triangleCount) * m_settings.splitBudget)
+                            : 0;
+
+        std::vector<Reference> leafRefs;
+        leafRefs.reserve(triangleCount + m_referenceBudget);
+        m_nodes.clear();
+        m_nodes.reserve(2 * (triangleCount + m_referenceBudget) + 1);
+        m_nodes.push_back({});
+
+        Bounds rootBounds;
+        for (const Reference& r : refs) {
+            rootBounds.Grow(r.bounds);
+        }
+        m_rootHalfArea = rootBounds.HalfArea();
+
+        std::vector<Task> stack;
+        stack.push_back({0, std::move(refs), 0});
+        while (!stack.empty()) {
+            Task task = std::move(stack.back());
+            stack.pop_back();
+            const uint32_t count = static_cast<uint32_t>(task.refs.size());
+
+            Bounds bounds, centroidBounds;
+            for (const Reference& r : task.refs) {
+                bounds.Grow(r.bounds);
+                centroidBounds.Grow(r.Centroid());
+            }
+
+            // Traversal stacks hold kBvhMaxDepth entries: the deepest level
+            // only has leaves
+            const bool maxDepth = task.depth + 1 >= kBvhMaxDepth;
+
+            Split split;
+            if (count > 1 && !maxDepth) {
+                split = FindObjectSplit(task.refs, bounds, centroidBounds);
+                // Stich et al.: only look for a spatial split if the object split children overlap noticeably
+                if (m_referenceBudget > 0 && split.axis >= 0) {
+                    const float overlap = Bounds::Intersection(split.left, split.right).HalfArea();
+                    if (overlap > m_settings.splitAlpha * m_rootHalfArea) {
+                        const Split spatial = FindSpatialSplit(task.refs, bounds);
+                        if (spatial.cost < split.cost) {
+                            split = spatial;
+                        }
+                    }
+                }
+            }
+
+            const float leafCost = m_settings.intersectionCost * static_cast<float>(count);
+            const bool mustSplit = count > m_settings.maxLeafSize;
+            if (count <= 1 || maxDepth || (!mustSplit && split.cost >= leafCost)) {
+                assert(count <= std::numeric_limits<uint16_t>::max() && "leaf too large for BvhNode::count");
+                BvhNode& leaf = m_nodes[task.node];
+                leaf.boundsMin = bounds.min;
+                leaf.boundsMax = bounds.max;
+                leaf.leftFirst = static_cast<uint32_t>(leafRefs.size());
+                leaf.count = static_cast<uint16_t>(count);
+                leaf.axis = 0;
+                leafRefs.insert(leafRefs.end(), task.refs.begin(), task.refs.end());
+                continue;
+            }
+
+            std::vector<Reference> left, right;
+            if (split.spatial) {
+                PartitionSpatial(task.refs, split, left, right);
+            } else if (split.axis >= 0) {
+                for (const Reference& r : task.refs) {
+                    (ObjectBin(r, split.axis, split.binMin, split.binScale) <= split.bin ? left : right).push_back(r);
+                }
+            }
+            if (left.empty() || right.empty()) {
+                // All centroids coincide: split the list in half
+                left.assign(task.refs.begin(), task.refs.begin() + count / 2);
+                right.assign(task.refs.begin() + count / 2, task.refs.end());
+            }
+
+            const uint32_t leftChild = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back({});
+            m_nodes.push_back({});
+
+            BvhNode& node = m_nodes[task.node];
+            node.boundsMin = bounds.min;
+            node.boundsMax = bounds.max;
+            node.leftFirst = leftChild;
+            node.count = 0;
+            node.axis = static_cast<uint16_t>(std::max(split.axis, 0));
+
+            task.refs.clear();
+            task.refs.shrink_to_fit();
+            stack.push_back({leftChild + 1, std::move(right), task.depth + 1});
+            stack.push_back({leftChild, std::move(left), task.depth + 1});
+        }
+        return leafRefs;
+    }
+
+private:
+    uint32_t ObjectBin(const Reference& r, int axis, float binMin, float binScale) const {
+        const float c = (r.bounds.min[axis] + r.bounds.max[axis]) * 0.5f;
+        return std::min(m_settings.binCount - 1, static_cast<uint32_t>((c - binMin) * binScale));
+    }
+
+    float SplitCost(const Bounds& bounds, const Bounds& left, uint32_t leftCount,
+                    const Bounds& right, uint32_t rightCount) const {
+        return m_settings.traversalCost + m_settings.intersectionCost / std::max(bounds.HalfArea(), 1e-20f) *
+               (left.HalfArea() * static_cast<float>(leftCount) + right.HalfArea() * static_cast<float>(rightCount));
+    }
+
+    Split FindObjectSplit(const std::vector<Reference>& refs, const Bounds& bounds, const Bounds& centroidBounds) {
+        const uint32_t binCount = m_settings.binCount;
+        Split best;
+        for (int axis = 0; axis < 3; axis++) {
+            const float binMin = centroidBounds.min[axis];
+            const float extent = centroidBounds.max[axis] - binMin;
+            if (extent <= 0.0f) {
+                continue;
+            }
+            const float binScale = static_cast<float>(binCount) / extent;
+
+            m_binBounds.assign(binCount, Bounds{});
+            m_binCounts.assign(binCount, 0);
+            for (const Reference& r : refs) {
+                const uint32_t b = ObjectBin(r, axis, binMin, binScale);
+                m_binCounts[b]++;
+                m_binBounds[b].Grow(r.bounds);
+            }
+            Sweep(bounds, m_binCounts, m_binCounts, axis, false, best);
+            if (best.axis == axis && !best.spatial) {
+                best.binMin = binMin;
+                best.binScale = binScale;
+            }
+        }
+        return best;
+    }
+
+    Split FindSpatialSplit(const std::vector<Reference>& refs, const Bounds& bounds) {
+        const uint32_t binCount = m_settings.binCount;
+        Split best;
+        for (int axis = 0; axis < 3; axis++) {
+            const float binMin = bounds.min[axis];
+            const float extent = bounds.max[axis] - binMin;
+            if (extent <= 0.0f) {
+                continue;
+            }
+            const float binWidth = extent / static_cast<float>(binCount);
+            const float binScale = 1.0f / binWidth;
+
+            m_binBounds.assign(binCount, Bounds{});
+            m_binEntries.assign(binCount, 0);
+            m_binExits.assign(binCount, 0);
+            for (const Reference& r : refs) {
+                const uint32_t first = std::min(binCount - 1, static_cast<uint32_t>(
+                        std::max(0.0f, (r.bounds.min[axis] - binMin) * binScale)));
+                const uint32_t last = std::clamp(static_cast<uint32_t>(
+                        std::max(0.0f, (r.bounds.max[axis] - binMin) * binScale)), first, binCount - 1);
+
+                // Chop the reference into the bins it straddles
+                Reference rest = r;
+                for (uint32_t b = first; b < last; b++) {
+                    Reference piece;
+                    SplitReference(rest, axis, binMin + binWidth * static_cast<float>(b + 1), piece, rest);
+                    m_binBounds[b].Grow(piece.bounds);
+                }
+                m_binBounds[last].Grow(rest.bounds);
+                m_binEntries[first]++;
+                m_binExits[last]++;
+            }
+            Sweep(bounds, m_binEntries, m_binExits, axis, true, best);
+            if (best.axis == axis && best.spatial) {
+                best.binMin = binMin;
+                best.binScale = binScale;
+            }
+        }
+        return best;
+    }
+
+    // Left-to-right SAH sweep over the current bins; updates best if a cheaper split is found
+    void Sweep(const Bounds& bounds, const std::vector<uint32_t>& leftCounts, const std::vector<uint32_t>& rightCounts,
+               int axis, bool spatial, Split& best) {
+        const uint32_t binCount = m_settings.binCount;
+        m_rightBounds.resize(binCount);
+        m_rightCounts.resize(binCount);
+
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (uint32_t b = binCount - 1; b > 0; b--) {
+            right.Grow(m_binBounds[b]);
+            rightCount += rightCounts[b];
+            m_rightBounds[b] = right;
+            m_rightCounts[b] = rightCount;
+        }
+
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (uint32_t b = 0; b < binCount - 1; b++) {
+            left.Grow(m_binBounds[b]);
+            leftCount += leftCounts[b];
+            if (leftCount == 0 || m_rightCounts[b + 1] == 0) {
+                continue;
+            }
+            const float cost = SplitCost(bounds, left, leftCount, m_rightBounds[b + 1], m_rightCounts[b + 1]);
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.axis = axis;
+                best.spatial = spatial;
+                best.bin = b;
+                best.left = left;
+                best.right = m_rightBounds[b + 1];
+                best.leftCount = leftCount;
+                best.rightCount = m_rightCounts[b + 1];
+            }
+        }
+    }
+
+    void PartitionSpatial(const std::vector<Reference>& refs, const Split& split,
+                          std::vector<Reference>& left, std::vector<Reference>& right) {
+        const int axis = split.axis;
+        const float plane = split.binMin + static_cast<float>(split.bin + 1) / split.binScale;
+        Bounds leftBounds = split.left, rightBounds = split.right;
+        float leftCount = static_cast<float>(split.leftCount), rightCount = static_cast<float>(split.rightCount);
+
+        for (const Reference& r : refs) {
+            if (r.bounds.max[axis] <= plane) {
+                left.push_back(r);
+                continue;
+            }
+            if (r.bounds.min[axis] >= plane) {
+                right.push_back(r);
+                continue;
+            }
+
+            Reference l, rr;
+            SplitReference(r, axis, plane, l, rr);
+            if (l.bounds.Empty() || rr.bounds.Empty()) {
+                // The triangle only grazes the plane inside these bounds
+                (l.bounds.Empty() ? right : left).push_back(r);
+                continue;
+            }
+
+            // Straddling: split it, or move it to one side if that is cheaper (reference unsplitting)
+            Bounds leftWith = leftBounds, rightWith = rightBounds;
+            leftWith.Grow(r.bounds);
+            rightWith.Grow(r.bounds);
+            const float splitCost = leftBounds.HalfArea() * leftCount + rightBounds.HalfArea() * rightCount;
+            const float leftCost = leftWith.HalfArea() * leftCount + rightBounds.HalfArea() * (rightCount - 1.0f);
+            const float rightCost = leftBounds.HalfArea() * (leftCount - 1.0f) + rightWith.HalfArea() * rightCount;
+
+            if (m_referenceBudget > 0 && splitCost < leftCost && splitCost < rightCost) {
+                left.push_back(l);
+                right.push_back(rr);
+                m_referenceBudget--;
+            } else if (leftCost <= rightCost) {
+                left.push_back(r);
+                leftBounds = leftWith;
+                rightCount -= 1.0f;
+            } else {
+                right.push_back(r);
+                rightBounds = rightWith;
+                leftCount -= 1.0f;
+            }
+        }
+    }
+
+    // Clips the triangle of ref against an axis-aligned plane and returns the bounds on both sides
+    void SplitReference(const Reference& ref, int axis, float plane, Reference& left, Reference& right) const {
+        const glm::vec3 v[3] = {m_positions[m_indices[3 * ref.triangle + 0]],
+                                m_positions[m_indices[3 * ref.triangle + 1]],
+                                m_positions[m_indices[3 * ref.triangle + 2]]};
+        Bounds l, r;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3& a = v[i];
+            const glm::vec3& b = v[(i + 1) % 3];
+            if (a[axis] <= plane) {
+                l.Grow(a);
+            }
+            if (a[axis] >= plane) {
+                r.Grow(a);
+            }
+            if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane)) {
+                glm::vec3 p = a + (b - a) * ((plane - a[axis]) / (b[axis] - a[axis]));
+                p[axis] = plane;
+                l.Grow(p);
+                r.Grow(p);
+            }
+        }
+        l.max[axis] = std::min(l.max[axis], plane);
+        r.min[axis] = std::max(r.min[axis], plane);
+
+        left.triangle = right.triangle = ref.triangle;
+        left.bounds = Bounds::Intersection(l, ref.bounds);
+        right.bounds = Bounds::Intersection(r, ref.bounds);
+    }
+
+    const std::vector<glm::vec3>& m_positions;
+    const std::vector<uint32_t>& m_indices;
+    const BvhBuildSettings& m_settings;
+    std::vector<BvhNode>& m_nodes;
+
+    size_t m_referenceBudget = 0;
+    float m_rootHalfArea = 0.0f;
+    std::vector<Bounds> m_binBounds, m_rightBounds;
+    std::vector<uint32_t> m_binCounts, m_binEntries, m_binExits, m_rightCounts;
+};
+
+} // namespace
+
+void Bvh::Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+                const BvhBuildSettings& settings) {
+    m_settings = settings;
+    m_settings.binCount = std::max(settings.binCount, 2u);
+    m_settings.maxLeafSize = std::clamp(settings.maxLeafSize, 1u, 0xFFFFu);
+    m_settings.splitBudget = std::max(settings.splitBudget, 0.0f);
+
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<Reference> refs(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        refs[t].triangle = t;
+        refs[t].bounds.Grow(positions[indices[3 * t + 0]]);
+        refs[t].bounds.Grow(positions[indices[3 * t + 1]]);
+        refs[t].bounds.Grow(positions[indices[3 * t + 2]]);
+    }
+
+    Builder builder(positions, indices, m_settings, m_nodes);
+    const std::vector<Reference> leafRefs = builder.Run(std::move(refs));
+
+    m_leafTriangleIds.resize(leafRefs.size());
+    m_leafTriangles.resize(leafRefs.size());
+    for (size_t i = 0; i < leafRefs.size(); i++) {
+        const uint32_t t = leafRefs[i].triangle;
+        const glm::vec3& p0 = positions[indices[3 * t + 0]];
+        m_leafTriangleIds[i] = t;
+        m_leafTriangles[i] = {p0, positions[indices[3 * t + 1]] - p0, positions[indices[3 * t + 2]] - p0};
+    }
+}
+
+bool Bvh::Intersect(const BvhRay& ray, BvhHit& hit, BvhTraversalStats* stats) const {
+    hit = BvhHit{};
+    if (m_nodes.empty() || m_leafTriangles.empty()) {
+        return false;
+    }
+    return IntersectSubtree(0, ray, hit, stats);
+}
+
+bool Bvh::Occluded(const BvhRay& ray, BvhTraversalStats* stats) const {
+    if (m_nodes.empty() || m_leafTriangles.empty()) {
+        return false;
+    }
+    return OccludedSubtree(0, ray, stats);
+}
+
+bool Bvh::IntersectSubtree(uint32_t root, const BvhRay& ray, BvhHit& hit, BvhTraversalStats* stats) const {
+    const glm::vec3 invDirection = 1.0f / ray.direction;
+    float tMax = ray.tMax;
+    uint32_t stack[kBvhMaxDepth];
+    uint32_t stackSize = 0;
+    uint64_t nodeTests = 0;
+    uint64_t triangleTests = 0;
+    bool found = false;
+    uint32_t nodeIndex = IntersectBounds(m_nodes[root].boundsMin, m_nodes[root].boundsMax, ray.origin,
+                                         invDirection, ray.tMin, tMax) != std::numeric_limits<float>::infinity()
+                         ? root : kBvhInvalidTriangle;
+
+    while (nodeIndex != kBvhInvalidTriangle) {
+        const BvhNode& node = m_nodes[nodeIndex];
+        nodeTests++;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                triangleTests++;
+                float t, u, v;
+                if (IntersectTriangle(m_leafTriangles[i], ray.origin, ray.direction, ray.tMin, tMax, t, u, v)) {
+                    tMax = t;
+                    found = true;
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.triangle = m_leafTriangleIds[i];
+                }
+            }
+            nodeIndex = stackSize > 0 ? stack[--stackSize] : kBvhInvalidTriangle;
+            continue;
+        }
+
+        // Windows headers define near/far, hence the longer names
+        uint32_t nearChild = node.leftFirst;
+        uint32_t farChild = node.leftFirst + 1;
+        float tNear = IntersectBounds(m_nodes[nearChild].boundsMin, m_nodes[nearChild].boundsMax, ray.origin,
+                                      invDirection, ray.tMin, tMax);
+        float tFar = IntersectBounds(m_nodes[farChild].boundsMin, m_nodes[farChild].boundsMax, ray.origin,
+                                     invDirection, ray.tMin, tMax);
+        if (tFar < tNear) {
+            std::swap(nearChild, farChild);
+            std::swap(tNear, tFar);
+        }
+
+        if (tNear == std::numeric_limits<float>::infinity()) {
+            nodeIndex = stackSize > 0 ? stack[--stackSize] : kBvhInvalidTriangle;
+        } else {
+            if (tFar != std::numeric_limits<float>::infinity()) {
+                // One pending far child per level above the leaves
+                assert(stackSize < kBvhMaxDepth && "BVH deeper than kBvhMaxDepth");
+                stack[stackSize++] = farChild;
+            }
+            nodeIndex = nearChild;
+        }
+    }
+
+    if (stats) {
+        stats->rays++;
+        stats->nodeTests += nodeTests;
+        stats->triangleTests += triangleTests;
+    }
+    return found;
+}
+
+bool Bvh::OccludedSubtree(uint32_t root, const BvhRay& ray, BvhTraversalStats* stats) const {
+    const glm::vec3 invDirection = 1.0f / ray.direction;
+    uint32_t stack[kBvhMaxDepth];
+    uint32_t stackSize = 0;
+    uint64_t nodeTests = 0;
+    uint64_t triangleTests = 0;
+    bool occluded = false;
+
+    if (IntersectBounds(m_nodes[root].boundsMin, m_nodes[root].boundsMax, ray.origin, invDirection,
+                        ray.tMin, ray.tMax) != std::numeric_limits<float>::infinity()) {
+        stack[stackSize++] = root;
+    }
+
+    while (stackSize > 0 && !occluded) {
+        const BvhNode& node = m_nodes[stack[--stackSize]];
+        nodeTests++;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                triangleTests++;
+                float t, u, v;
+                if (IntersectTriangle(m_leafTriangles[i], ray.origin, ray.direction, ray.tMin, ray.tMax, t, u, v)) {
+                    occluded = true;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        for (uint32_t child = node.leftFirst; child < node.leftFirst + 2u; child++) {
+            if (IntersectBounds(m_nodes[child].boundsMin, m_nodes[child].boundsMax, ray.origin, invDirection,
+                                ray.tMin, ray.tMax) != std::numeric_limits<float>::infinity()) {
+                // A pending sibling per level above the node, then its two children
+                assert(stackSize < kBvhMaxDepth && "BVH deeper than kBvhMaxDepth");
+                stack[stackSize++] = child;
+            }
+        }
+    }
+
+    if (stats) {
+        stats->rays++;
+        stats->nodeTests += nodeTests;
+        stats->triangleTests += triangleTests;
+    }
+    return occluded;
+}
@@ -0,0 +1,153 @@
+#ifndef PATHTRACER_BVH_H
+#define PATHTRACER_BVH_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// CPU bounding volume hierarchy over a flat triangle list. This is the
+// reference acceleration structure of the CPU tools; the DX12 renderer keeps
+// building its BLAS/TLAS through nv_helpers_dx12.
+
+constexpr uint32_t kBvhInvalidTriangle = 0xFFFFFFFFu;
+// Levels of a tree, the root included; the builder makes leaves of the
+// deepest one so the fixed traversal stacks cannot overflow
+constexpr uint32_t kBvhMaxDepth = 64;
+
+struct BvhRay {
+    glm::vec3 origin;
+    float tMin = 0.0001f;
+    glm::vec3 direction;
+    float tMax = 10000.0f;
+};
+
+// u/v follow the DXR BuiltInTriangleIntersectionAttributes convention:
+// u weights the second vertex, v the third
+struct BvhHit {
+    float t = std::numeric_limits<float>::infinity();
+    float u = 0.0f;
+    float v = 0.0f;
+    uint32_t triangle = kBvhInvalidTriangle;
+
+    bool IsHit() const { return triangle != kBvhInvalidTriangle; }
+};
+
+// 32 bytes. Interior nodes have count == 0 and their children at
+// leftFirst / leftFirst + 1; leaves reference count triangles starting at
+// leftFirst in the leaf triangle arrays.
+struct BvhNode {
+    glm::vec3 boundsMin;
+    uint32_t leftFirst;
+    glm::vec3 boundsMax;
+    uint16_t count;
+    uint16_t axis; // split axis of interior nodes
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode is expected to fill half a cache line");
+
+// Pre-transformed triangle for Moller-Trumbore (v0, v1 - v0, v2 - v0)
+struct BvhTriangle {
+    glm::vec3 v0;
+    glm::vec3 e1;
+    glm::vec3 e2;
+};
+
+struct BvhTraversalStats {
+    uint64_t rays = 0;
+    uint64_t nodeTests = 0;     // nodes fetched during traversal
+    uint64_t triangleTests = 0; // ray/triangle intersection tests
+
+    BvhTraversalStats& operator+=(const BvhTraversalStats& other) {
+        rays += other.rays;
+        nodeTests += other.nodeTests;
+        triangleTests += other.triangleTests;
+        return *this;
+    }
+};
+
+enum class BvhBuilder {
+    BinnedSah,
+    Sbvh, // binned SAH plus spatial splits (Stich et al. 2009)
+};
+
+struct BvhBuildSettings {
+    BvhBuilder builder = BvhBuilder::BinnedSah;
+    uint32_t binCount = 16;
+    uint32_t maxLeafSize = 4;
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+    // SBVH only: extra triangle references the spatial splits may create,
+    // as a fraction of the triangle count
+    float splitBudget = 0.3f;
+    // SBVH only: spatial splits are tried when the best object split's
+    // children overlap by more than alpha * root surface area
+    float splitAlpha = 1e-5f;
+};
+
+class Bvh {
+public:
+    void Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+               const BvhBuildSettings& settings = {});
+
+    // Closest hit; returns true if something was hit within [tMin, tMax]
+    bool Intersect(const BvhRay& ray, BvhHit& hit, BvhTraversalStats* stats = nullptr) const;
+    // Any hit, for shadow rays
+    bool Occluded(const BvhRay& ray, BvhTraversalStats* stats = nullptr) const;
+
+    // Same traversals starting below an arbitrary node. IntersectSubtree only
+    // overwrites hit when it finds something closer than ray.tMax, so packet
+    // tracers can hand individual rays over mid-traversal.
+    bool IntersectSubtree(uint32_t root, const BvhRay& ray, BvhHit& hit, BvhTraversalStats* stats = nullptr) const;
+    bool OccludedSubtree(uint32_t root, const BvhRay& ray, BvhTraversalStats* stats = nullptr) const;
+
+    const std::vector<BvhNode>& Nodes() const { return m_nodes; }
+    // Leaf slot -> original triangle index. SBVH leaves can reference a triangle more than once.
+    const std::vector<uint32_t>& LeafTriangleIds() const { return m_leafTriangleIds; }
+    // Leaf slot -> triangle data, same order as LeafTriangleIds
+    const std::vector<BvhTriangle>& LeafTriangles() const { return m_leafTriangles; }
+    const BvhBuildSettings& Settings() const { return m_settings; }
+
+private:
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_leafTriangleIds;
+    std::vector<BvhTriangle> m_leafTriangles;
+    BvhBuildSettings m_settings;
+};
+
+// Moller-Trumbore, shared by the single ray and the packet tracers
+inline bool IntersectTriangle(const BvhTriangle& tri, const glm::vec3& origin, const glm::vec3& direction,
+                              float tMin, float tMax, float& t, float& u, float& v) {
+    const glm::vec3 p = glm::cross(direction, tri.e2);
+    const float det = glm::dot(tri.e1, p);
+    if (det == 0.0f) {
+        return false;
+    }
+    const float invDet = 1.0f / det;
+    const glm::vec3 s = origin - tri.v0;
+    u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    const glm::vec3 q = glm::cross(s, tri.e1);
+    v = glm::dot(direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    t = glm::dot(tri.e2, q) * invDet;
+    return t > tMin && t < tMax;
+}
+
+// Slab test; returns the entry distance or +inf on a miss
+inline float IntersectBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& origin,
+                             const glm::vec3& invDirection, float tMin, float tMax) {
+    const glm::vec3 t0 = (boundsMin - origin) * invDirection;
+    const glm::vec3 t1 = (boundsMax - origin) * invDirection;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+    const float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, tMin));
+    const float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, tMax));
+    return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+#endif //PATHTRACER_BVH_H
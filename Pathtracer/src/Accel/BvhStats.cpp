@@ -0,0 +1,154 @@
+#include "BvhStats.h"
+
+#include <algorithm>
+
+namespace {
+
+double HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    const glm::vec3 e = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return static_cast<double>(e.x) * e.y + static_cast<double>(e.y) * e.z + static_cast<double>(e.z) * e.x;
+}
+
+double PolygonArea(const glm::vec3* polygon, int count) {
+    glm::dvec3 sum(0.0);
+    for (int i = 1; i + 1 < count; i++) {
+        sum += glm::cross(glm::dvec3(polygon[i] - polygon[0]), glm::dvec3(polygon[i + 1] - polygon[0]));
+    }
+    return 0.5 * glm::length(sum);
+}
+
+// Area of the part of the triangle inside the box (Sutherland-Hodgman against the six slabs)
+double ClippedArea(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                   const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    // A triangle clipped by six planes has at most nine vertices
+    glm::vec3 polygon[9] = {a, b, c};
+    glm::vec3 clipped[9];
+    int count = 3;
+
+    for (int plane = 0; plane < 6 && count > 0; plane++) {
+        const int axis = plane >> 1;
+        const bool isMax = plane & 1;
+        const float bound = isMax ? boundsMax[axis] : boundsMin[axis];
+        auto inside = [&](const glm::vec3& p) { return isMax ? p[axis] <= bound : p[axis] >= bound; };
+
+        int out = 0;
+        for (int i = 0; i < count; i++) {
+            const glm::vec3& p = polygon[i];
+            const glm::vec3& q = polygon[(i + 1) % count];
+            const bool pIn = inside(p);
+            const bool qIn = inside(q);
+            if (pIn) {
+                clipped[out++] = p;
+            }
+            if (pIn != qIn) {
+                const float u = (bound - p[axis]) / (q[axis] - p[axis]);
+                glm::vec3 m = p + (q - p) * u;
+                m[axis] = bound;
+                clipped[out++] = m;
+            }
+        }
+        count = out;
+        std::copy(clipped, clipped + count, polygon);
+    }
+    return count >= 3 ? PolygonArea(polygon, count) : 0.0;
+}
+
+} // namespace
+
+BvhQuality ComputeBvhQuality(const Bvh& bvh, const std::vector<glm::vec3>& positions,
+                             const std::vector<uint32_t>& indices) {
+    BvhQuality quality;
+    const std::vector<BvhNode>& nodes = bvh.Nodes();
+    const std::vector<uint32_t>& leafIds = bvh.LeafTriangleIds();
+    const BvhBuildSettings& settings = bvh.Settings();
+    if (nodes.empty()) {
+        return quality;
+    }
+    quality.nodeCount = static_cast<uint32_t>(nodes.size());
+    quality.references = static_cast<uint32_t>(leafIds.size());
+
+    // Leaf slot range covered by every subtree. Children always have higher
+    // indices than their parent, so one backwards pass resolves them.
+    std::vector<uint32_t> slotBegin(nodes.size()), slotEnd(nodes.size());
+    for (size_t i = nodes.size(); i-- > 0;) {
+        const BvhNode& node = nodes[i];
+        if (node.count > 0) {
+            slotBegin[i] = node.leftFirst;
+            slotEnd[i] = node.leftFirst + node.count;
+        } else {
+            slotBegin[i] = std::min(slotBegin[node.leftFirst], slotBegin[node.leftFirst + 1]);
+            slotEnd[i] = std::max(slotEnd[node.leftFirst], slotEnd[node.leftFirst + 1]);
+        }
+    }
+
+    // SAH cost, depth and leaf statistics
+    const double rootArea = std::max(HalfArea(nodes[0].boundsMin, nodes[0].boundsMax), 1e-30);
+    std::vector<uint32_t> depth(nodes.size(), 0);
+    uint64_t leafDepthSum = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const BvhNode& node = nodes[i];
+        const double area = HalfArea(node.boundsMin, node.boundsMax) / rootArea;
+        quality.maxDepth = std::max(quality.maxDepth, depth[i]);
+        if (node.count > 0) {
+            quality.sahCost += settings.intersectionCost * node.count * area;
+            quality.leafCount++;
+            leafDepthSum += depth[i];
+            if (quality.leafSizeHistogram.size() <= node.count) {
+                quality.leafSizeHistogram.resize(node.count + 1, 0);
+            }
+            quality.leafSizeHistogram[node.count]++;
+        } else {
+            quality.sahCost += settings.traversalCost * area;
+            depth[node.leftFirst] = depth[node.leftFirst + 1] = depth[i] + 1;
+        }
+    }
+    if (quality.leafCount > 0) {
+        quality.averageLeafDepth = static_cast<double>(leafDepthSum) / quality.leafCount;
+        quality.averageLeafSize = static_cast<double>(quality.references) / quality.leafCount;
+    }
+
+    // Leaf slots of every triangle (more than one when SBVH split it)
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<std::vector<uint32_t>> triangleSlots(triangleCount);
+    for (uint32_t slot = 0; slot < leafIds.size(); slot++) {
+        triangleSlots[leafIds[slot]].push_back(slot);
+    }
+
+    // EPO: walk every triangle down the nodes its bounds overlap and add the
+    // clipped area wherever the node's subtree does not reference it
+    double totalArea = 0.0;
+    double overlap = 0.0;
+    std::vector<uint32_t> stack;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const glm::vec3& a = positions[indices[3 * t + 0]];
+        const glm::vec3& b = positions[indices[3 * t + 1]];
+        const glm::vec3& c = positions[indices[3 * t + 2]];
+        totalArea += 0.5 * glm::length(glm::cross(glm::dvec3(b - a), glm::dvec3(c - a)));
+        const glm::vec3 triMin = glm::min(a, glm::min(b, c));
+        const glm::vec3 triMax = glm::max(a, glm::max(b, c));
+
+        stack.assign(1, 0);
+        while (!stack.empty()) {
+            const uint32_t n = stack.back();
+            stack.pop_back();
+            const BvhNode& node = nodes[n];
+            if (glm::any(glm::greaterThan(triMin, node.boundsMax)) ||
+                glm::any(glm::lessThan(triMax, node.boundsMin))) {
+                continue;
+            }
+
+            const bool referenced = std::any_of(triangleSlots[t].begin(), triangleSlots[t].end(),
+                                                [&](uint32_t slot) { return slot >= slotBegin[n] && slot < slotEnd[n]; });
+            if (!referenced) {
+                const double cost = node.count > 0 ? settings.intersectionCost * node.count : settings.traversalCost;
+                overlap += cost * ClippedArea(a, b, c, node.boundsMin, node.boundsMax);
+            }
+            if (node.count == 0) {
+                stack.push_back(node.leftFirst);
+                stack.push_back(node.leftFirst + 1);
+            }
+        }
+    }
+    quality.epo = totalArea > 0.0 ? overlap / totalArea : 0.0;
+    return quality;
+}
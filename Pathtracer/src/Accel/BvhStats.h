@@ -0,0 +1,36 @@
+#ifndef PATHTRACER_BVHSTATS_H
+#define PATHTRACER_BVHSTATS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+
+// Ray-independent quality metrics of a built Bvh, for tracking layout
+// regressions across builder changes.
+//
+// SAH cost is the usual expected cost of a random ray hitting the root,
+// using the builder's traversal / intersection costs. EPO (end-point
+// overlap, Aila et al. 2013) is the surface area of geometry that lies
+// inside a node without being referenced by its subtree, weighted by the
+// same costs and normalized by the total triangle area; it predicts ray
+// tracing cost better than SAH once spatial splits are involved.
+
+struct BvhQuality {
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t references = 0; // leaf triangle slots, > triangle count with spatial splits
+    uint32_t maxDepth = 0;
+    double averageLeafDepth = 0.0;
+    double averageLeafSize = 0.0;
+    double sahCost = 0.0;
+    double epo = 0.0;
+    // leafSizeHistogram[n] = number of leaves referencing n triangles
+    std::vector<uint32_t> leafSizeHistogram;
+};
+
+// positions / indices must be the geometry the Bvh was built from
+BvhQuality ComputeBvhQuality(const Bvh& bvh, const std::vector<glm::vec3>& positions,
+                             const std::vector<uint32_t>& indices);
+
+#endif //PATHTRACER_BVHSTATS_H
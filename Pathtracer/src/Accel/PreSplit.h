@@ -0,0 +1,191 @@
+#ifndef PATHTRACER_PRESPLIT_H
+#define PATHTRACER_PRESPLIT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Pre-split pass for geometry handed to DXR. The driver builds its own BVH,
+// so unlike the CPU SBVH we cannot split references; instead oversized
+// triangles are subdivided in the mesh itself before
+// BottomLevelASGenerator::AddVertexBuffer. The worst triangle is cut by the
+// mid plane of its bounds' longest axis, which is what a spatial split would
+// do to its reference. Every edge that is cut is split in all triangles
+// sharing it, so no T-junctions are introduced.
+//
+// Header-only on purpose: the renderer uses it with its DirectXMath Vertex,
+// the CPU tools with their own vertex layout.
+
+struct PreSplitSettings {
+    // Extra triangles the pass may add, as a fraction of the input count
+    float splitBudget = 0.25f;
+    // Triangles whose bounding box surface area is below this fraction of the
+    // mesh bounds' surface area are left alone
+    float minAreaFraction = 0.002f;
+};
+
+struct PreSplitStats {
+    uint32_t inputTriangles = 0;
+    uint32_t outputTriangles = 0;
+    uint32_t addedVertices = 0;
+    float maxAreaFractionBefore = 0.0f; // largest triangle box / mesh box, surface area
+    float maxAreaFractionAfter = 0.0f;
+};
+
+// position(vertex) -> glm::vec3, interpolate(a, b, u) -> vertex at a + (b - a) * u,
+// onSplit(oldTriangle, newTriangle) lets the caller copy per-triangle data
+// (material IDs, instance IDs, ...) to the triangle appended at the end.
+template <typename VertexT, typename IndexT, typename PositionFn, typename InterpolateFn, typename SplitFn>
+PreSplitStats PreSplitTriangles(std::vector<VertexT>& vertices, std::vector<IndexT>& indices,
+                                const PreSplitSettings& settings, PositionFn position, InterpolateFn interpolate,
+                                SplitFn onSplit) {
+    auto halfArea = [](const glm::vec3& bMin, const glm::vec3& bMax) {
+        const glm::vec3 e = bMax - bMin;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    };
+    // Box surface the triangle does not cover: zero for axis-aligned right
+    // triangles (walls, floors), large for long diagonal slivers
+    auto triangleHalfArea = [&](size_t t) {
+        const glm::vec3 a = position(vertices[indices[3 * t + 0]]);
+        const glm::vec3 b = position(vertices[indices[3 * t + 1]]);
+        const glm::vec3 c = position(vertices[indices[3 * t + 2]]);
+        const float box = halfArea(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+        return std::max(0.0f, box - glm::length(glm::cross(b - a, c - a)));
+    };
+    auto edgeKey = [](uint32_t a, uint32_t b) {
+        return a < b ? (static_cast<uint64_t>(a) << 32 | b) : (static_cast<uint64_t>(b) << 32 | a);
+    };
+
+    PreSplitStats stats;
+    const size_t inputTriangles = indices.size() / 3;
+    stats.inputTriangles = static_cast<uint32_t>(inputTriangles);
+    stats.outputTriangles = stats.inputTriangles;
+    if (inputTriangles == 0) {
+        return stats;
+    }
+
+    glm::vec3 meshMin(std::numeric_limits<float>::infinity()), meshMax(-std::numeric_limits<float>::infinity());
+    for (const VertexT& v : vertices) {
+        meshMin = glm::min(meshMin, position(v));
+        meshMax = glm::max(meshMax, position(v));
+    }
+    const float meshArea = std::max(halfArea(meshMin, meshMax), 1e-20f);
+    const float threshold = settings.minAreaFraction * meshArea;
+
+    // Edge -> triangles, for splitting neighbours along with the triangle itself
+    std::unordered_map<uint64_t, std::vector<uint32_t>> edgeTriangles;
+    auto link = [&](uint32_t a, uint32_t b, uint32_t t) { edgeTriangles[edgeKey(a, b)].push_back(t); };
+    auto unlink = [&](uint32_t a, uint32_t b, uint32_t t) {
+        auto& list = edgeTriangles[edgeKey(a, b)];
+        list.erase(std::remove(list.begin(), list.end(), t), list.end());
+    };
+
+    using Entry = std::pair<float, uint32_t>;
+    std::priority_queue<Entry> queue;
+    for (uint32_t t = 0; t < inputTriangles; t++) {
+        for (int e = 0; e < 3; e++) {
+            link(static_cast<uint32_t>(indices[3 * t + e]), static_cast<uint32_t>(indices[3 * t + (e + 1) % 3]), t);
+        }
+        const float area = triangleHalfArea(t);
+        stats.maxAreaFractionBefore = std::max(stats.maxAreaFractionBefore, area / meshArea);
+        if (area > threshold) {
+            queue.push({area, t});
+        }
+    }
+
+    auto splitEdge = [&](uint32_t a, uint32_t b, float u) {
+        const uint32_t m = static_cast<uint32_t>(vertices.size());
+        vertices.push_back(interpolate(vertices[a], vertices[b], u));
+        stats.addedVertices++;
+
+        const std::vector<uint32_t> sharing = edgeTriangles[edgeKey(a, b)];
+        for (const uint32_t s : sharing) {
+            // Rotate so that the split edge is (i0, i1) in s's own winding
+            int e = 0;
+            while (e < 3 && edgeKey(static_cast<uint32_t>(indices[3 * s + e]),
+                                    static_cast<uint32_t>(indices[3 * s + (e + 1) % 3])) != edgeKey(a, b)) {
+                e++;
+            }
+            const uint32_t i0 = static_cast<uint32_t>(indices[3 * s + e]);
+            const uint32_t i1 = static_cast<uint32_t>(indices[3 * s + (e + 1) % 3]);
+            const uint32_t i2 = static_cast<uint32_t>(indices[3 * s + (e + 2) % 3]);
+            const uint32_t n = static_cast<uint32_t>(indices.size() / 3);
+
+            // s becomes (i0, m, i2), the new triangle n is (m, i1, i2)
+            indices[3 * s + 0] = static_cast<IndexT>(i0);
+            indices[3 * s + 1] = static_cast<IndexT>(m);
+            indices[3 * s + 2] = static_cast<IndexT>(i2);
+            indices.push_back(static_cast<IndexT>(m));
+            indices.push_back(static_cast<IndexT>(i1));
+            indices.push_back(static_cast<IndexT>(i2));
+            onSplit(s, n);
+
+            unlink(i0, i1, s);
+            unlink(i1, i2, s);
+            link(i0, m, s);
+            link(m, i2, s);
+            link(m, i1, n);
+            link(i1, i2, n);
+            link(i2, m, n);
+
+            for (const uint32_t c : {s, n}) {
+                const float childArea = triangleHalfArea(c);
+                if (childArea > threshold) {
+                    queue.push({childArea, c});
+                }
+            }
+        }
+    };
+
+    const size_t maxTriangles = inputTriangles + static_cast<size_t>(inputTriangles * std::max(settings.splitBudget, 0.0f));
+    while (!queue.empty() && indices.size() / 3 < maxTriangles) {
+        const auto [area, t] = queue.top();
+        queue.pop();
+        if (area != triangleHalfArea(t)) {
+            continue; // stale entry, the triangle was split as someone's neighbour
+        }
+
+        // Cut t by the mid plane of the longest axis of its bounds, like a spatial split
+        uint32_t v[3];
+        glm::vec3 p[3];
+        for (int i = 0; i < 3; i++) {
+            v[i] = static_cast<uint32_t>(indices[3 * t + i]);
+            p[i] = position(vertices[v[i]]);
+        }
+        const glm::vec3 boxMin = glm::min(p[0], glm::min(p[1], p[2]));
+        const glm::vec3 extent = glm::max(p[0], glm::max(p[1], p[2])) - boxMin;
+        const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        const float plane = boxMin[axis] + extent[axis] * 0.5f;
+
+        // The edges crossing the plane, captured before any of them is split
+        uint32_t crossingA[2], crossingB[2];
+        float crossingU[2];
+        int crossings = 0;
+        for (int e = 0; e < 3; e++) {
+            const float da = p[e][axis] - plane;
+            const float db = p[(e + 1) % 3][axis] - plane;
+            if ((da < 0.0f && db > 0.0f) || (da > 0.0f && db < 0.0f)) {
+                crossingA[crossings] = v[e];
+                crossingB[crossings] = v[(e + 1) % 3];
+                crossingU[crossings] = da / (da - db);
+                crossings++;
+            }
+        }
+        for (int c = 0; c < crossings; c++) {
+            splitEdge(crossingA[c], crossingB[c], crossingU[c]);
+        }
+    }
+
+    stats.outputTriangles = static_cast<uint32_t>(indices.size() / 3);
+    for (size_t t = 0; t < indices.size() / 3; t++) {
+        stats.maxAreaFractionAfter = std::max(stats.maxAreaFractionAfter, triangleHalfArea(t) / meshArea);
+    }
+    return stats;
+}
+
+#endif //PATHTRACER_PRESPLIT_H
@@ -0,0 +1,104 @@
+#include "RayBatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+glm::vec3 CosineSampleHemisphere(const glm::vec3& n, float u1, float u2) {
+    const float r = std::sqrt(u1);
+    const float phi = 2.0f * 3.14159265359f * u2;
+    const glm::vec3 t = glm::normalize(std::fabs(n.z) < 0.999f ? glm::cross(glm::vec3(0, 0, 1), n)
+                                                                : glm::cross(glm::vec3(1, 0, 0), n));
+    const glm::vec3 b = glm::cross(n, t);
+    return glm::normalize(t * (r * std::cos(phi)) + b * (r * std::sin(phi)) +
+                          n * std::sqrt(std::max(0.0f, 1.0f - u1)));
+}
+
+} // namespace
+
+std::vector<BvhRay> GeneratePrimaryRays(const CpuScene& scene, uint32_t width, uint32_t height) {
+    const CpuCameraRays camera = scene.camera.Rays(width, height);
+    std::vector<BvhRay> rays(static_cast<size_t>(width) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            BvhRay& ray = rays[static_cast<size_t>(y) * width + x];
+            camera.Generate(static_cast<float>(x), static_cast<float>(y), ray.origin, ray.direction);
+        }
+    }
+    return rays;
+}
+
+std::vector<BvhRay> GenerateDiffuseRays(const CpuScene& scene, const std::vector<BvhRay>& rays,
+                                        const std::vector<BvhHit>& hits, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    std::vector<BvhRay> next;
+    next.reserve(rays.size());
+    for (size_t i = 0; i < rays.size(); i++) {
+        const BvhHit& hit = hits[i];
+        if (!hit.IsHit()) {
+            continue;
+        }
+        glm::vec3 n = scene.GeometricNormal(hit.triangle);
+        if (glm::dot(n, rays[i].direction) > 0.0f) {
+            n = -n;
+        }
+        BvhRay bounce;
+        bounce.origin = rays[i].origin + rays[i].direction * hit.t + n * 1e-4f;
+        bounce.direction = CosineSampleHemisphere(n, uniform(rng), uniform(rng));
+        next.push_back(bounce);
+    }
+    std::shuffle(next.begin(), next.end(), rng);
+    return next;
+}
+
+std::vector<BvhRay> GenerateShadowRays(const CpuScene& scene, const std::vector<BvhRay>& rays,
+                                       const std::vector<BvhHit>& hits, uint32_t seed) {
+    constexpr float bias = 0.00002f; // s_bias of Common_v6.hlsl
+
+    std::vector<BvhRay> next;
+    if (scene.emissiveTriangles.empty()) {
+        return next;
+    }
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    next.reserve(rays.size());
+    for (size_t i = 0; i < rays.size(); i++) {
+        const BvhHit& hit = hits[i];
+        if (!hit.IsHit()) {
+            continue;
+        }
+        const CpuLightTriangle& light = scene.emissiveTriangles[scene.SampleEmissiveTriangle(uniform(rng))];
+        float xi1 = uniform(rng);
+        float xi2 = uniform(rng);
+        if (xi1 + xi2 > 1.0f) {
+            xi1 = 1.0f - xi1;
+            xi2 = 1.0f - xi2;
+        }
+        const glm::vec3 samplePoint = light.x * (1.0f - xi1 - xi2) + light.y * xi1 + light.z * xi2;
+
+        glm::vec3 n = scene.GeometricNormal(hit.triangle);
+        if (glm::dot(n, rays[i].direction) > 0.0f) {
+            n = -n;
+        }
+        const glm::vec3 position = rays[i].origin + rays[i].direction * hit.t;
+        const glm::vec3 toLight = samplePoint - position;
+        const float dist = glm::length(toLight);
+        if (dist <= 0.0f) {
+            continue;
+        }
+
+        BvhRay shadow;
+        shadow.origin = position + n * bias;
+        shadow.direction = toLight / dist;
+        shadow.tMin = 0.0f;
+        shadow.tMax = std::max(dist - 10.0f * bias, 2.0f * bias);
+        next.push_back(shadow);
+    }
+    std::shuffle(next.begin(), next.end(), rng);
+    return next;
+}
@@ -0,0 +1,28 @@
+#ifndef PATHTRACER_RAYBATCH_H
+#define PATHTRACER_RAYBATCH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+#include "../Scene/CpuScene.h"
+
+// Ray distributions used by the CPU benchmarks and the acceleration structure
+// statistics. Everything is deterministic for a given seed so runs can be
+// compared across builds.
+
+// One unjittered camera ray per pixel, row-major, same as RayGen
+std::vector<BvhRay> GeneratePrimaryRays(const CpuScene& scene, uint32_t width, uint32_t height);
+
+// Cosine-weighted diffuse bounce from every hit in hits; misses are dropped.
+// The result is shuffled, as it would arrive from a wavefront queue.
+std::vector<BvhRay> GenerateDiffuseRays(const CpuScene& scene, const std::vector<BvhRay>& rays,
+                                        const std::vector<BvhHit>& hits, uint32_t seed);
+
+// One shadow ray per hit towards a point on an emissive triangle, picked
+// and placed like SampleLightTriangle and offset like VisibilityCheck in
+// Sampler_v6.hlsl. Misses are dropped; the result is shuffled.
+std::vector<BvhRay> GenerateShadowRays(const CpuScene& scene, const std::vector<BvhRay>& rays,
+                                       const std::vector<BvhHit>& hits, uint32_t seed);
+
+#endif //PATHTRACER_RAYBATCH_H
@@ -0,0 +1,319 @@
+#include "RayStream.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace {
+
+// Spreads the low 10 bits of v so that there are two zero bits between each
+uint32_t Part1By2(uint32_t v) {
+    v &= 0x000003FFu;
+    v = (v ^ (v << 16)) & 0xFF0000FFu;
+    v = (v ^ (v << 8)) & 0x0300F00Fu;
+    v = (v ^ (v << 4)) & 0x030C30C3u;
+    v = (v ^ (v << 2)) & 0x09249249u;
+    return v;
+}
+
+uint32_t DirectionOctant(const glm::vec3& d) {
+    return (d.x < 0.0f ? 1u : 0u) | (d.y < 0.0f ? 2u : 0u) | (d.z < 0.0f ? 4u : 0u);
+}
+
+struct StackEntry {
+    uint32_t node;
+    uint32_t mask;
+};
+
+} // namespace
+
+RayStream::RayStream(const Bvh& bvh, const RayStreamSettings& settings)
+    : m_bvh(bvh), m_settings(settings) {
+    m_settings.packetSize = std::clamp(settings.packetSize, 1u, kRayStreamMaxPacketSize);
+    m_settings.originCellBits = std::min(settings.originCellBits, 9u);
+
+    m_sceneMin = glm::vec3(0.0f);
+    m_cellScale = glm::vec3(0.0f);
+    if (!bvh.Nodes().empty()) {
+        const BvhNode& root = bvh.Nodes()[0];
+        const glm::vec3 extent = glm::max(root.boundsMax - root.boundsMin, glm::vec3(1e-6f));
+        m_sceneMin = root.boundsMin;
+        m_cellScale = static_cast<float>(1u << m_settings.originCellBits) / extent;
+    }
+}
+
+void RayStream::Sort(const std::vector<BvhRay>& rays) {
+    const size_t count = rays.size();
+    m_order.resize(count);
+    m_keys.resize(count);
+
+    const uint32_t cellBits = m_settings.originCellBits;
+    const uint32_t maxCell = (1u << cellBits) - 1u;
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3 cell = glm::clamp((rays[i].origin - m_sceneMin) * m_cellScale, glm::vec3(0.0f),
+                                          glm::vec3(static_cast<float>(maxCell)));
+        const uint32_t morton = Part1By2(static_cast<uint32_t>(cell.x)) |
+                                Part1By2(static_cast<uint32_t>(cell.y)) << 1 |
+                                Part1By2(static_cast<uint32_t>(cell.z)) << 2;
+        // Octant in the top bits: packets never mix direction signs
+        m_keys[i] = DirectionOctant(rays[i].direction) << (3 * cellBits) | morton;
+        m_order[i] = static_cast<uint32_t>(i);
+    }
+
+    if (!m_settings.sort) {
+        return;
+    }
+
+    // LSD radix sort, 8 bits per pass, carrying the ray index along
+    m_scratchKeys.resize(count);
+    m_scratchOrder.resize(count);
+    const uint32_t keyBits = 3 + 3 * cellBits;
+    for (uint32_t shift = 0; shift < keyBits; shift += 8) {
+        uint32_t histogram[257] = {};
+        for (size_t i = 0; i < count; i++) {
+            histogram[((m_keys[i] >> shift) & 0xFFu) + 1]++;
+        }
+        for (uint32_t b = 0; b < 256; b++) {
+            histogram[b + 1] += histogram[b];
+        }
+        for (size_t i = 0; i < count; i++) {
+            const uint32_t dst = histogram[(m_keys[i] >> shift) & 0xFFu]++;
+            m_scratchKeys[dst] = m_keys[i];
+            m_scratchOrder[dst] = m_order[i];
+        }
+        m_keys.swap(m_scratchKeys);
+        m_order.swap(m_scratchOrder);
+    }
+}
+
+void RayStream::Intersect(const std::vector<BvhRay>& rays, std::vector<BvhHit>& hits,
+                          BvhTraversalStats* stats, RayStreamStats* streamStats) {
+    hits.assign(rays.size(), BvhHit{});
+    Trace<false>(rays, hits.data(), nullptr, stats, streamStats);
+}
+
+void RayStream::Occluded(const std::vector<BvhRay>& rays, std::vector<uint8_t>& occluded,
+                         BvhTraversalStats* stats, RayStreamStats* streamStats) {
+    occluded.assign(rays.size(), 0);
+    Trace<true>(rays, nullptr, occluded.data(), stats, streamStats);
+}
+
+template <bool AnyHit>
+void RayStream::Trace(const std::vector<BvhRay>& rays, BvhHit* hits, uint8_t* occluded,
+                      BvhTraversalStats* stats, RayStreamStats* streamStats) {
+    if (rays.empty() || m_bvh.Nodes().empty() || m_bvh.LeafTriangles().empty()) {
+        return;
+    }
+    Sort(rays);
+
+    BvhTraversalStats localStats;
+    RayStreamStats localStreamStats;
+    const uint32_t octantShift = 3 * m_settings.originCellBits;
+    const size_t count = rays.size();
+
+    size_t first = 0;
+    while (first < count) {
+        size_t last = first + 1;
+        if (m_settings.sort) {
+            const uint32_t octant = m_keys[first] >> octantShift;
+            while (last < count && last - first < m_settings.packetSize && (m_keys[last] >> octantShift) == octant) {
+                last++;
+            }
+        } else {
+            last = std::min(count, first + m_settings.packetSize);
+        }
+        TracePacket<AnyHit>(rays, m_order.data() + first, static_cast<uint32_t>(last - first), hits, occluded,
+                            localStats, localStreamStats);
+        first = last;
+    }
+
+    if (stats) {
+        *stats += localStats;
+    }
+    if (streamStats) {
+        streamStats->packets += localStreamStats.packets;
+        streamStats->packetNodeVisits += localStreamStats.packetNodeVisits;
+        streamStats->activeLanes += localStreamStats.activeLanes;
+    }
+}
+
+template <bool AnyHit>
+void RayStream::TracePacket(const std::vector<BvhRay>& rays, const uint32_t* ids, uint32_t count,
+                            BvhHit* hits, uint8_t* occluded, BvhTraversalStats& stats,
+                            RayStreamStats& streamStats) const {
+    const std::vector<BvhNode>& nodes = m_bvh.Nodes();
+    const std::vector<BvhTriangle>& triangles = m_bvh.LeafTriangles();
+    const std::vector<uint32_t>& triangleIds = m_bvh.LeafTriangleIds();
+
+    // Gather into SoA so the box test runs over contiguous lanes
+    alignas(64) float ox[kRayStreamMaxPacketSize], oy[kRayStreamMaxPacketSize], oz[kRayStreamMaxPacketSize];
+    alignas(64) float ix[kRayStreamMaxPacketSize], iy[kRayStreamMaxPacketSize], iz[kRayStreamMaxPacketSize];
+    alignas(64) float dx[kRayStreamMaxPacketSize], dy[kRayStreamMaxPacketSize], dz[kRayStreamMaxPacketSize];
+    alignas(64) float tMin[kRayStreamMaxPacketSize], tMax[kRayStreamMaxPacketSize];
+    BvhHit packetHits[kRayStreamMaxPacketSize];
+    for (uint32_t i = 0; i < count; i++) {
+        const BvhRay& ray = rays[ids[i]];
+        ox[i] = ray.origin.x;
+        oy[i] = ray.origin.y;
+        oz[i] = ray.origin.z;
+        dx[i] = ray.direction.x;
+        dy[i] = ray.direction.y;
+        dz[i] = ray.direction.z;
+        ix[i] = 1.0f / ray.direction.x;
+        iy[i] = 1.0f / ray.direction.y;
+        iz[i] = 1.0f / ray.direction.z;
+        tMin[i] = ray.tMin;
+        tMax[i] = ray.tMax;
+    }
+
+    // Unused lanes get an empty interval so the box test can run over whole groups of four
+    const uint32_t laneCount = std::min((count + 3u) & ~3u, kRayStreamMaxPacketSize);
+    for (uint32_t i = count; i < laneCount; i++) {
+        ox[i] = oy[i] = oz[i] = 0.0f;
+        dx[i] = dy[i] = dz[i] = 1.0f;
+        ix[i] = iy[i] = iz[i] = 1.0f;
+        tMin[i] = 1.0f;
+        tMax[i] = -1.0f;
+    }
+
+    alignas(64) int32_t laneHits[kRayStreamMaxPacketSize];
+    auto testNode = [&](const BvhNode& node, uint32_t mask) {
+        for (uint32_t i = 0; i < laneCount; i++) {
+            const float tx0 = (node.boundsMin.x - ox[i]) * ix[i], tx1 = (node.boundsMax.x - ox[i]) * ix[i];
+            const float ty0 = (node.boundsMin.y - oy[i]) * iy[i], ty1 = (node.boundsMax.y - oy[i]) * iy[i];
+            const float tz0 = (node.boundsMin.z - oz[i]) * iz[i], tz1 = (node.boundsMax.z - oz[i]) * iz[i];
+            const float entry = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+                                         std::max(std::min(tz0, tz1), tMin[i]));
+            const float exit = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+                                        std::min(std::max(tz0, tz1), tMax[i]));
+            laneHits[i] = entry <= exit ? 1 : 0;
+        }
+        uint32_t hitMask = 0;
+        for (uint32_t i = 0; i < laneCount; i++) {
+            hitMask |= static_cast<uint32_t>(laneHits[i]) << i;
+        }
+        return hitMask & mask;
+    };
+
+    // Moller-Trumbore across all lanes, operation for operation the same as IntersectTriangle
+    alignas(64) float laneT[kRayStreamMaxPacketSize], laneU[kRayStreamMaxPacketSize], laneV[kRayStreamMaxPacketSize];
+    auto testTriangle = [&](const BvhTriangle& tri) {
+        for (uint32_t i = 0; i < laneCount; i++) {
+            const float px = dy[i] * tri.e2.z - tri.e2.y * dz[i];
+            const float py = dz[i] * tri.e2.x - tri.e2.z * dx[i];
+            const float pz = dx[i] * tri.e2.y - tri.e2.x * dy[i];
+            const float det = tri.e1.x * px + tri.e1.y * py + tri.e1.z * pz;
+            const float invDet = 1.0f / det;
+            const float sx = ox[i] - tri.v0.x, sy = oy[i] - tri.v0.y, sz = oz[i] - tri.v0.z;
+            const float u = (sx * px + sy * py + sz * pz) * invDet;
+            const float qx = sy * tri.e1.z - tri.e1.y * sz;
+            const float qy = sz * tri.e1.x - tri.e1.z * sx;
+            const float qz = sx * tri.e1.y - tri.e1.x * sy;
+            const float v = (dx[i] * qx + dy[i] * qy + dz[i] * qz) * invDet;
+            const float hitT = (tri.e2.x * qx + tri.e2.y * qy + tri.e2.z * qz) * invDet;
+            laneT[i] = hitT;
+            laneU[i] = u;
+            laneV[i] = v;
+            laneHits[i] = (det != 0.0f) & (u >= 0.0f) & (u <= 1.0f) & (v >= 0.0f) & (u + v <= 1.0f) &
+                          (hitT > tMin[i]) & (hitT < tMax[i]);
+        }
+    };
+
+    // All lanes share the octant after sorting; lane 0 decides the child order
+    const glm::vec3& leadDirection = rays[ids[0]].direction;
+    const bool negative[3] = {leadDirection.x < 0.0f, leadDirection.y < 0.0f, leadDirection.z < 0.0f};
+
+    const uint32_t allLanes = count == 32 ? 0xFFFFFFFFu : (1u << count) - 1u;
+    uint32_t done = 0;
+    // Both children are pushed on a visit: one entry per level and one more
+    StackEntry stack[kBvhMaxDepth + 1];
+    uint32_t stackSize = 0;
+
+    const uint32_t rootMask = testNode(nodes[0], allLanes);
+    if (rootMask) {
+        stack[stackSize++] = {0, rootMask};
+    }
+
+    while (stackSize > 0) {
+        const StackEntry entry = stack[--stackSize];
+        uint32_t mask = entry.mask & ~done;
+        if (!mask) {
+            continue;
+        }
+        const BvhNode& node = nodes[entry.node];
+        const uint32_t active = static_cast<uint32_t>(std::popcount(mask));
+
+        // Too few lanes left for the packet to pay off: finish them one by one
+        if (active <= m_settings.singleRayThreshold) {
+            BvhTraversalStats singleStats;
+            for (uint32_t lanes = mask; lanes; lanes &= lanes - 1) {
+                const uint32_t i = static_cast<uint32_t>(std::countr_zero(lanes));
+                BvhRay ray = rays[ids[i]];
+                ray.tMin = tMin[i];
+                ray.tMax = tMax[i];
+                if constexpr (AnyHit) {
+                    if (m_bvh.OccludedSubtree(entry.node, ray, &singleStats)) {
+                        done |= 1u << i;
+                    }
+                } else if (m_bvh.IntersectSubtree(entry.node, ray, packetHits[i], &singleStats)) {
+                    tMax[i] = packetHits[i].t;
+                }
+            }
+            stats.nodeTests += singleStats.nodeTests;
+            stats.triangleTests += singleStats.triangleTests;
+            continue;
+        }
+
+        streamStats.packetNodeVisits++;
+        streamStats.activeLanes += active;
+        stats.nodeTests += active;
+
+        if (node.count > 0) {
+            for (uint32_t t = node.leftFirst; t < node.leftFirst + node.count && mask; t++) {
+                testTriangle(triangles[t]);
+                stats.triangleTests += static_cast<uint32_t>(std::popcount(mask));
+                for (uint32_t lanes = mask; lanes; lanes &= lanes - 1) {
+                    const uint32_t i = static_cast<uint32_t>(std::countr_zero(lanes));
+                    if (laneHits[i]) {
+                        if constexpr (AnyHit) {
+                            done |= 1u << i;
+                        } else {
+                            tMax[i] = laneT[i];
+                            packetHits[i] = {laneT[i], laneU[i], laneV[i], triangleIds[t]};
+                        }
+                    }
+                }
+                mask &= ~done;
+            }
+            continue;
+        }
+
+        const uint32_t left = node.leftFirst;
+        const uint32_t right = node.leftFirst + 1;
+        const uint32_t leftMask = testNode(nodes[left], mask);
+        const uint32_t rightMask = testNode(nodes[right], mask);
+        const bool rightFirst = negative[node.axis];
+
+        // Push the far child first so the near one is popped next
+        const StackEntry nearEntry = rightFirst ? StackEntry{right, rightMask} : StackEntry{left, leftMask};
+        const StackEntry farEntry = rightFirst ? StackEntry{left, leftMask} : StackEntry{right, rightMask};
+        assert(stackSize + 2 <= kBvhMaxDepth + 1 && "BVH deeper than kBvhMaxDepth");
+        if (farEntry.mask) {
+            stack[stackSize++] = farEntry;
+        }
+        if (nearEntry.mask) {
+            stack[stackSize++] = nearEntry;
+        }
+    }
+
+    // Scatter back into the caller's order
+    for (uint32_t i = 0; i < count; i++) {
+        if constexpr (AnyHit) {
+            occluded[ids[i]] = (done >> i) & 1u;
+        } else {
+            hits[ids[i]] = packetHits[i];
+        }
+    }
+    stats.rays += count;
+    streamStats.packets++;
+}
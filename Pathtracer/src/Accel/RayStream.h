@@ -0,0 +1,71 @@
+#ifndef PATHTRACER_RAYSTREAM_H
+#define PATHTRACER_RAYSTREAM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+
+// Stream tracer for large batches of incoherent rays (diffuse bounces,
+// shadow rays). Rays are binned by direction octant and by the Morton index of
+// their origin cell in the scene bounds, cut into packets that share an octant
+// and traced together through the BVH. Results are scattered back into the
+// caller's order, so the stream is a drop-in replacement for a loop over
+// Bvh::Intersect / Bvh::Occluded.
+
+constexpr uint32_t kRayStreamMaxPacketSize = 32; // one bit per lane in the active masks
+
+struct RayStreamSettings {
+    uint32_t packetSize = 16;     // clamped to [1, kRayStreamMaxPacketSize]
+    uint32_t originCellBits = 4;  // 2^bits origin cells per axis, at most 9
+    uint32_t singleRayThreshold = 4; // hand lanes to single-ray traversal at or below this many active
+    bool sort = true;             // false: packets are cut from the input order
+};
+
+struct RayStreamStats {
+    uint64_t packets = 0;
+    uint64_t packetNodeVisits = 0; // node fetches by whole packets
+    uint64_t activeLanes = 0;      // sum of active rays over those fetches
+
+    // Fraction of packet lanes doing useful work per node fetch
+    double LaneUtilization(uint32_t packetSize) const {
+        return packetNodeVisits ? static_cast<double>(activeLanes) /
+                                  (static_cast<double>(packetNodeVisits) * packetSize) : 0.0;
+    }
+};
+
+class RayStream {
+public:
+    explicit RayStream(const Bvh& bvh, const RayStreamSettings& settings = {});
+
+    void Intersect(const std::vector<BvhRay>& rays, std::vector<BvhHit>& hits,
+                   BvhTraversalStats* stats = nullptr, RayStreamStats* streamStats = nullptr);
+    // occluded[i] is 1 if rays[i] hits anything within [tMin, tMax]
+    void Occluded(const std::vector<BvhRay>& rays, std::vector<uint8_t>& occluded,
+                  BvhTraversalStats* stats = nullptr, RayStreamStats* streamStats = nullptr);
+
+    const RayStreamSettings& Settings() const { return m_settings; }
+    // Ray order of the last call, exposed for tools that want to inspect the binning
+    const std::vector<uint32_t>& Order() const { return m_order; }
+
+private:
+    void Sort(const std::vector<BvhRay>& rays);
+    template <bool AnyHit>
+    void Trace(const std::vector<BvhRay>& rays, BvhHit* hits, uint8_t* occluded,
+               BvhTraversalStats* stats, RayStreamStats* streamStats);
+    template <bool AnyHit>
+    void TracePacket(const std::vector<BvhRay>& rays, const uint32_t* ids, uint32_t count,
+                     BvhHit* hits, uint8_t* occluded, BvhTraversalStats& stats, RayStreamStats& streamStats) const;
+
+    const Bvh& m_bvh;
+    RayStreamSettings m_settings;
+    glm::vec3 m_sceneMin;
+    glm::vec3 m_cellScale;
+
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_scratchKeys;
+    std::vector<uint32_t> m_scratchOrder;
+};
+
+#endif //PATHTRACER_RAYSTREAM_H
@@ -0,0 +1,390 @@
+#include "Brdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <glm/gtc/packing.hpp>
+#include "Rng.h"
+
+namespace {
+
+// HLSL saturate / max / min: a NaN operand yields the other operand (D3D10+ rules)
+float Saturate(float x) {
+    return std::isnan(x) ? 0.0f : std::min(std::max(x, 0.0f), 1.0f);
+}
+
+glm::vec3 Saturate(const glm::vec3& v) {
+    return glm::vec3(Saturate(v.x), Saturate(v.y), Saturate(v.z));
+}
+
+float ShaderMax(float a, float b) {
+    return std::isnan(a) ? b : (std::isnan(b) ? a : std::max(a, b));
+}
+
+float ShaderMin(float a, float b) {
+    return std::isnan(a) ? b : (std::isnan(b) ? a : std::min(a, b));
+}
+
+bool IsFinite(const glm::vec3& v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+float RoundHalf(float v) {
+    return glm::unpackHalf1x16(glm::packHalf1x16(v));
+}
+
+void CoordinateSystem(const glm::vec3& N, glm::vec3& T, glm::vec3& B) {
+    if (std::fabs(N.z) < 0.999f) {
+        T = glm::normalize(glm::cross(glm::vec3(0.0f, 0.0f, 1.0f), N));
+    } else {
+        T = glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), N));
+    }
+    B = glm::cross(N, T);
+}
+
+// Lambertian_v6.hlsl
+glm::vec3 RandomUnitVectorInHemisphere(const glm::vec3& normal, glm::uvec2& seed) {
+    const float u1 = RandomFloat(seed);
+    const float u2 = RandomFloat(seed);
+
+    const float r = std::sqrt(u1);
+    const float theta = 2.0f * 3.14159265358979323846f * u2;
+    const float x = r * std::cos(theta);
+    const float y = r * std::sin(theta);
+    const float z = std::sqrt(ShaderMax(0.0f, 1.0f - x * x - y * y));
+
+    const glm::vec3 h = normal;
+    const glm::vec3 up = std::fabs(normal.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    const glm::vec3 right = glm::normalize(glm::cross(up, h));
+    const glm::vec3 forward = glm::cross(h, right);
+
+    glm::vec3 hemisphereSample = glm::normalize(x * right + y * forward + z * h);
+    if (glm::dot(hemisphereSample, normal) < 0.0f) {
+        hemisphereSample = -hemisphereSample;
+    }
+    return hemisphereSample;
+}
+
+// GGX_v6.hlsl, Heitz VNDF sampling
+void SampleBRDF_GGX(const ShadingMaterial& mat, const glm::vec3& outgoing, const glm::vec3& normal,
+                    const glm::vec3& flatNormal, glm::vec3& sample, glm::vec3& origin,
+                    const glm::vec3& worldOrigin, glm::uvec2& seed, bool mirrorBelowSurface) {
+    const float alpha = mat.Pr_Pm_Ps_Pc.x * mat.Pr_Pm_Ps_Pc.x;
+
+    const glm::vec3 N = glm::normalize(normal);
+    const glm::vec3 V = glm::normalize(outgoing);
+    glm::vec3 T1, T2;
+    CoordinateSystem(N, T1, T2);
+
+    const float vx = glm::dot(T1, V);
+    const float vy = glm::dot(T2, V);
+    const float vz = glm::dot(N, V);
+    const glm::vec3 Ve = glm::normalize(glm::vec3(alpha * vx, alpha * vy, vz));
+
+    const float lensq = Ve.x * Ve.x + Ve.y * Ve.y;
+    const glm::vec3 T1h = lensq > 0.0f ? glm::vec3(-Ve.y, Ve.x, 0.0f) * (1.0f / std::sqrt(lensq))
+                                       : glm::vec3(1.0f, 0.0f, 0.0f);
+    const glm::vec3 T2h = glm::cross(Ve, T1h);
+
+    const float U1 = RandomFloat(seed);
+    const float U2 = RandomFloat(seed);
+    const float r = std::sqrt(U1);
+    const float phi = 2.0f * kShaderPi * U2;
+    const float t1 = r * std::cos(phi);
+    float t2 = r * std::sin(phi);
+
+    const float s = 0.5f * (1.0f + Ve.z);
+    t2 = (1.0f - s) * std::sqrt(Saturate(1.0f - t1 * t1)) + s * t2;
+
+    const glm::vec3 Nh = t1 * T1h + t2 * T2h + std::sqrt(Saturate(1.0f - t1 * t1 - t2 * t2)) * Ve;
+    const glm::vec3 Ne = glm::normalize(glm::vec3(alpha * Nh.x, alpha * Nh.y, ShaderMax(0.0f, Nh.z)));
+    const glm::vec3 H = Ne.x * T1 + Ne.y * T2 + Ne.z * N;
+
+    sample = glm::reflect(-V, H);
+    if (mirrorBelowSurface && glm::dot(sample, normal) < 0.0f) {
+        sample = -sample;
+    }
+    origin = worldOrigin + kShadowBias * flatNormal;
+}
+
+glm::vec3 EvaluateBRDF_GGX(const ShadingMaterial& mat, const glm::vec3& normal, const glm::vec3& incoming,
+                           const glm::vec3& outgoing) {
+    const glm::vec3 N = glm::normalize(normal);
+    const glm::vec3 V = glm::normalize(outgoing);
+    const glm::vec3 L = glm::normalize(-incoming);
+    const glm::vec3 H = glm::normalize(V + L);
+    const float NdotV = glm::dot(N, V);
+    const float NdotL = glm::dot(N, L);
+    const float NdotH = glm::dot(N, H);
+    const float VdotH = glm::dot(V, H);
+
+    const glm::vec3 F = SchlickFresnel(mat.Ks, VdotH);
+    const float D = D_GGX(NdotH, mat.Pr_Pm_Ps_Pc.x);
+    const float G = G2_SmithGGX(NdotV, NdotL, mat.Pr_Pm_Ps_Pc.x * mat.Pr_Pm_Ps_Pc.x);
+
+    const float denominator = 4.0f * NdotV * NdotL;
+    if (denominator < kShaderEpsilon) {
+        return glm::vec3(0.0f);
+    }
+    const glm::vec3 specular = (F * D * G) / denominator;
+
+    // Multiscatter GGX
+    const float Ess = ESS_LUT(mat, NdotV);
+    const float kms = (1.0f - Ess) / Ess;
+    const glm::vec3 specular_ess = specular * (1.0f + mat.Ks * kms);
+    return IsFinite(specular_ess) ? specular_ess : glm::vec3(0.0f);
+}
+
+float BRDF_PDF_GGX(const ShadingMaterial& mat, const glm::vec3& normal, const glm::vec3& incoming,
+                   const glm::vec3& outgoing) {
+    const glm::vec3 N = glm::normalize(normal);
+    const glm::vec3 V = glm::normalize(outgoing);
+    const glm::vec3 L = glm::normalize(-incoming);
+    const glm::vec3 H = glm::normalize(V + L);
+    const float NdotH = glm::dot(N, H);
+    const float NdotV = glm::dot(N, V);
+
+    const float alpha = mat.Pr_Pm_Ps_Pc.x * mat.Pr_Pm_Ps_Pc.x;
+    const float G1 = G1_SmithGGX(NdotV, alpha);
+    const float D = D_GGX(NdotH, mat.Pr_Pm_Ps_Pc.x);
+    return G1 * D / (NdotV * 4.0f);
+}
+
+// The CPU-side GGX helpers of ObjLoader.h used by ComputeEss. They differ
+// from the shader versions (no D, clamped denominators) and are kept as is
+// so the LUT matches what the renderer uploads.
+namespace lut {
+
+void SampleGGX(float roughness, const glm::vec3& outgoing, const glm::vec3& normal, glm::vec3& sample,
+               float e0, float e1) {
+    const float alpha = roughness * roughness;
+    const glm::vec3 N = glm::normalize(normal);
+    const glm::vec3 V = glm::normalize(outgoing);
+    glm::vec3 T1, T2;
+    CoordinateSystem(N, T1, T2);
+
+    const glm::vec3 Vh = glm::normalize(glm::vec3(glm::dot(T1, V), glm::dot(T2, V), glm::dot(N, V)));
+    const glm::vec3 Vs = glm::normalize(glm::vec3(alpha * Vh.x, alpha * Vh.y, Vh.z));
+
+    const float lensq = Vs.x * Vs.x + Vs.y * Vs.y;
+    glm::vec3 T1h, T2h;
+    if (lensq > 0.0f) {
+        const float invSqrtLensq = 1.0f / std::sqrt(lensq);
+        T1h = glm::normalize(glm::vec3(-Vs.y * invSqrtLensq, Vs.x * invSqrtLensq, 0.0f));
+        T2h = glm::cross(Vs, T1h);
+    } else {
+        T1h = glm::vec3(1.0f, 0.0f, 0.0f);
+        T2h = glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    const float r = std::sqrt(e0);
+    const float phi = 2.0f * 3.14159265359f * e1;
+    const float x = r * std::cos(phi);
+    const float y = r * std::sin(phi);
+    const float z = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+    const glm::vec3 Ns = glm::normalize(x * T1h + y * T2h + z * Vs);
+    const glm::vec3 Nh = glm::normalize(glm::vec3(alpha * Ns.x, alpha * Ns.y, std::max(0.0f, Ns.z)));
+    const glm::vec3 H = glm::normalize(Nh.x * T1 + Nh.y * T2 + Nh.z * N);
+    sample = glm::normalize(glm::reflect(-V, H));
+}
+
+float G1(float NdotV, float alpha) {
+    const float alpha2 = alpha * alpha;
+    const float denomC = std::sqrt(alpha2 + (1.0f - alpha2) * NdotV * NdotV) + NdotV;
+    return 2.0f * NdotV / std::max(denomC, 1e-7f);
+}
+
+float ComputeEss(const glm::vec3& N, const glm::vec3& V, float roughness, int numSamples, std::mt19937& gen) {
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    float Ess = 0.0f;
+    for (int i = 0; i < numSamples; ++i) {
+        const float u1 = dist(gen);
+        const float u2 = dist(gen);
+        glm::vec3 L;
+        SampleGGX(roughness, V, N, L, u1, u2);
+        if (glm::dot(N, L) <= 0.0f) {
+            continue;
+        }
+
+        const float NdotL = std::fabs(glm::dot(N, L));
+        const float NdotV = std::max(glm::dot(N, V), 0.0f);
+        const float NdotLc = std::max(glm::dot(N, L), 0.0f);
+        // EvaluateBRDF_GGX with F = 1 and without D, BRDF_PDF_GGX without D
+        const float brdf = G2_SmithGGX(NdotV, NdotLc, roughness * roughness) / std::max(4.0f * NdotV * NdotLc, 1e-7f);
+        const float pdf = std::max(G1(NdotV, roughness * roughness) / std::max(NdotV * 4.0f, 1e-7f), 1e-7f);
+        if (brdf > 0.0f) {
+            Ess += (NdotL * brdf) / pdf;
+        }
+    }
+    return numSamples > 0 ? Ess / static_cast<float>(numSamples) : 0.0f;
+}
+
+} // namespace lut
+
+} // namespace
+
+ShadingMaterial MakeShadingMaterial(const CpuMaterial& material, uint32_t materialID, bool halfPrecision) {
+    ShadingMaterial mat;
+    mat.Kd = material.Kd;
+    mat.Pr_Pm_Ps_Pc = material.Pr_Pm_Ps_Pc;
+    mat.Ks = material.Ks;
+    mat.Ke = material.Ke;
+    mat.mID = materialID;
+    mat.LUT = material.LUT;
+    if (halfPrecision) {
+        for (int i = 0; i < 4; i++) {
+            mat.Kd[i] = RoundHalf(mat.Kd[i]);
+            mat.Pr_Pm_Ps_Pc[i] = RoundHalf(mat.Pr_Pm_Ps_Pc[i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            mat.Ks[i] = RoundHalf(mat.Ks[i]);
+            mat.Ke[i] = RoundHalf(mat.Ke[i]);
+        }
+    }
+    return mat;
+}
+
+ShadingMaterial MissMaterial() {
+    ShadingMaterial mat;
+    mat.mID = 4294967294u;
+    return mat;
+}
+
+glm::vec3 SchlickFresnel(const glm::vec3& F0, float cosTheta) {
+    return Saturate(F0 + (1.0f - F0) * std::pow(std::fabs(1.0f - cosTheta), 5.0f));
+}
+
+float D_GGX(float NdotH, float roughness) {
+    const float alpha = roughness * roughness;
+    const float alpha2 = alpha * alpha;
+    const float NdotH2 = NdotH * NdotH;
+    const float denom = NdotH2 * (alpha2 - 1.0f) + 1.0f;
+    return alpha2 / (kShaderPi * denom * denom);
+}
+
+float G1_SmithGGX(float NdotV, float alpha) {
+    const float alpha2 = alpha * alpha;
+    const float denomC = std::sqrt(alpha2 + (1.0f - alpha2) * NdotV * NdotV) + NdotV;
+    return 2.0f * NdotV / denomC;
+}
+
+float G2_SmithGGX(float NdotV, float NdotL, float alpha) {
+    const float alpha2 = alpha * alpha;
+    const float denomA = NdotV * std::sqrt(alpha2 + (1.0f - alpha2) * NdotL * NdotL);
+    const float denomB = NdotL * std::sqrt(alpha2 + (1.0f - alpha2) * NdotV * NdotV);
+    return 2.0f * NdotL * NdotV / (denomA + denomB);
+}
+
+float ESS_LUT(const ShadingMaterial& mat, float NdotV) {
+    if (!mat.LUT) {
+        return 0.0f;
+    }
+    NdotV = Saturate(NdotV);
+    const float thetaIdxF = NdotV * (kLutSizeTheta - 1);
+    const int thetaIdx0 = static_cast<int>(std::floor(thetaIdxF));
+    const int thetaIdx1 = std::min(thetaIdx0 + 1, kLutSizeTheta - 1);
+    const float wTheta = thetaIdxF - static_cast<float>(thetaIdx0);
+    const float v0 = mat.LUT[thetaIdx0];
+    const float v1 = mat.LUT[thetaIdx1];
+    return v0 + wTheta * (v1 - v0);
+}
+
+uint32_t SelectSamplingStrategy(const ShadingMaterial& mat, const glm::vec3& outgoing, const glm::vec3& normal,
+                                glm::uvec2& seed, float& probability) {
+    const float r = RandomFloat(seed);
+    const float roughness = mat.Pr_Pm_Ps_Pc.x;
+    const float metallic = mat.Pr_Pm_Ps_Pc.y;
+
+    const float cosTheta = glm::dot(normal, outgoing);
+    const glm::vec3 fresnel = SchlickFresnel(mat.Ks, cosTheta);
+
+    const float p_s = ShaderMin(1.0f, (fresnel.x + fresnel.y + fresnel.z) / 3.0f + metallic);
+    probability = p_s;
+
+    if (r <= p_s) {
+        return roughness < 0.04f ? 0u : 1u;
+    }
+    // Diffuse, and refraction which is currently replaced by diffuse
+    return 0u;
+}
+
+glm::vec2 CalculateStrategyProbabilities(const ShadingMaterial& mat, const glm::vec3& outgoing,
+                                         const glm::vec3& normal) {
+    const float metallic = mat.Pr_Pm_Ps_Pc.y;
+    const float cosTheta = glm::dot(normal, outgoing);
+    const glm::vec3 fresnel = SchlickFresnel(mat.Ks, cosTheta);
+    const float p_s = ShaderMin(1.0f, (fresnel.x + fresnel.y + fresnel.z) / 3.0f + metallic);
+    return glm::vec2(1.0f - p_s, p_s);
+}
+
+void SampleBRDF(uint32_t strategy, const ShadingMaterial& mat, const glm::vec3& incoming, const glm::vec3& normal,
+                const glm::vec3& flatNormal, glm::vec3& sample, glm::vec3& origin, const glm::vec3& worldOrigin,
+                glm::uvec2& seed, bool mirrorBelowSurface) {
+    if (strategy == 0) {
+        sample = RandomUnitVectorInHemisphere(normal, seed);
+        origin = worldOrigin + kShadowBias * flatNormal;
+    } else if (strategy == 1) {
+        SampleBRDF_GGX(mat, incoming, normal, flatNormal, sample, origin, worldOrigin, seed, mirrorBelowSurface);
+    }
+}
+
+glm::vec3 EvaluateBRDF(uint32_t strategy, const ShadingMaterial& mat, const glm::vec3& normal,
+                       const glm::vec3& incidence, const glm::vec3& outgoing) {
+    if (strategy == 0) {
+        return glm::vec3(mat.Kd) / kShaderPi;
+    }
+    if (strategy == 1) {
+        return EvaluateBRDF_GGX(mat, normal, incidence, outgoing);
+    }
+    return glm::vec3(0.0f);
+}
+
+float BRDF_PDF(uint32_t strategy, const ShadingMaterial& mat, const glm::vec3& normal,
+               const glm::vec3& incidence, const glm::vec3& outgoing) {
+    if (strategy == 0) {
+        return ShaderMax(glm::dot(normal, -incidence), kShaderEpsilon) / kShaderPi;
+    }
+    if (strategy == 1) {
+        return BRDF_PDF_GGX(mat, normal, incidence, outgoing);
+    }
+    return 0.0f;
+}
+
+glm::vec3 EvaluateMixedBRDF(const ShadingMaterial& mat, const glm::vec3& normal, const glm::vec3& incidence,
+                            const glm::vec3& outgoing) {
+    const glm::vec2 probs = CalculateStrategyProbabilities(mat, glm::normalize(outgoing), normal);
+    return SafeMultiply(probs.x, EvaluateBRDF(0, mat, normal, incidence, glm::normalize(outgoing))) +
+           SafeMultiply(probs.y, EvaluateBRDF(1, mat, normal, incidence, glm::normalize(outgoing)));
+}
+
+float MixedBRDF_PDF(const ShadingMaterial& mat, const glm::vec3& normal, const glm::vec3& incidence,
+                    const glm::vec3& outgoing) {
+    const glm::vec2 probs = CalculateStrategyProbabilities(mat, glm::normalize(outgoing), normal);
+    return SafeMultiply(probs.x, BRDF_PDF(0, mat, normal, incidence, outgoing)) +
+           SafeMultiply(probs.y, BRDF_PDF(1, mat, normal, incidence, outgoing));
+}
+
+float SafeMultiply(float scalar, float value) {
+    const float result = scalar * value;
+    return std::isfinite(result) ? result : 0.0f;
+}
+
+glm::vec3 SafeMultiply(float scalar, const glm::vec3& v) {
+    const glm::vec3 result = scalar * v;
+    return IsFinite(result) ? result : glm::vec3(0.0f);
+}
+
+void GenerateEssLUT(CpuMaterial& material, uint32_t seed) {
+    constexpr float epsilon = 0.04f; // replaces cos(theta) = 0
+    constexpr int samples = 16000;   // NUM_SAMPLES_MC
+
+    std::mt19937 gen(seed);
+    for (int thetaIdx = 0; thetaIdx < kLutSizeTheta; ++thetaIdx) {
+        const float cosTheta = epsilon + static_cast<float>(thetaIdx) / (kLutSizeTheta - 1) * (1.0f - epsilon);
+        const float sinTheta = std::sqrt(std::max(epsilon, 1.0f - cosTheta * cosTheta));
+        const glm::vec3 N(0.0f, 0.0f, 1.0f);
+        const glm::vec3 V(sinTheta, 0.0f, cosTheta);
+        material.LUT[thetaIdx] = lut::ComputeEss(N, V, material.Pr_Pm_Ps_Pc.x, samples, gen);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef PATHTRACER_BRDF_H
+#define PATHTRACER_BRDF_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include "../Scene/CpuScene.h"
+
+// C++ port of the material model of GGX_v6 / Lambertian_v6 / BRDF_v6.hlsl
+// (identical to the _v7 copies): a diffuse Lambert lobe and a multiscatter
+// GGX lobe, mixed by the Fresnel-based strategy probabilities. Function
+// names, argument order and the number and order of RandomFloat draws match
+// the shaders, so the CPU passes consume seeds exactly like the GPU does.
+
+constexpr float kShaderPi = 3.1415f;         // PI of Common_v6.hlsl
+constexpr float kShaderEpsilon = 0.000001f;  // EPSILON of Common_v6.hlsl
+constexpr float kShadowBias = 0.00002f;      // s_bias of Common_v6.hlsl
+constexpr int kLutSizeTheta = 16;
+
+// MaterialOptimized: the material as the shaders see it after loading it into registers
+struct ShadingMaterial {
+    glm::vec4 Kd = glm::vec4(0.0f);
+    glm::vec4 Pr_Pm_Ps_Pc = glm::vec4(0.0f);
+    glm::vec3 Ks = glm::vec3(0.0f);
+    glm::vec3 Ke = glm::vec3(0.0f);
+    uint32_t mID = 0;
+    const float* LUT = nullptr; // materials[mID].LUT, read by ESS_LUT
+};
+
+// halfPrecision rounds Kd/Pr_Pm_Ps_Pc/Ks/Ke through half like the shaders' half4/half3 fields
+ShadingMaterial MakeShadingMaterial(const CpuMaterial& material, uint32_t materialID, bool halfPrecision);
+
+// g_DefaultMissMaterial
+ShadingMaterial MissMaterial();
+
+glm::vec3 SchlickFresnel(const glm::vec3& F0, float cosTheta);
+float D_GGX(float NdotH, float roughness);
+float G1_SmithGGX(float NdotV, float alpha);
+float G2_SmithGGX(float NdotV, float NdotL, float alpha);
+float ESS_LUT(const ShadingMaterial& mat, float NdotV);
+
+// 0 = Lambert, 1 = GGX. Draws one random number.
+uint32_t SelectSamplingStrategy(const ShadingMaterial& mat, const glm::vec3& outgoing, const glm::vec3& normal,
+                                glm::uvec2& seed, float& probability);
+// (p_diffuse, p_specular)
+glm::vec2 CalculateStrategyProbabilities(const ShadingMaterial& mat, const glm::vec3& outgoing,
+                                         const glm::vec3& normal);
+
+// Draws two random numbers. The GGX sampler mirrors directions that end up
+// below the surface; mirrorBelowSurface = false keeps them as sampled so a
+// caller can reject them instead (the mirrored pdf is not BRDF_PDF).
+void SampleBRDF(uint32_t strategy, const ShadingMaterial& mat, const glm::vec3& incoming, const glm::vec3& normal,
+                const glm::vec3& flatNormal, glm::vec3& sample, glm::vec3& origin, const glm::vec3& worldOrigin,
+                glm::uvec2& seed, bool mirrorBelowSurface = true);
+// incidence points towards the surface (-L), outgoing away from it (V)
+glm::vec3 EvaluateBRDF(uint32_t strategy, const ShadingMaterial& mat, const glm::vec3& normal,
+                       const glm::vec3& incidence, const glm::vec3& outgoing);
+float BRDF_PDF(uint32_t strategy, const ShadingMaterial& mat, const glm::vec3& normal,
+               const glm::vec3& incidence, const glm::vec3& outgoing);
+
+// Strategy-weighted sum of both lobes, as every caller in Sampler_v6.hlsl combines them
+glm::vec3 EvaluateMixedBRDF(const ShadingMaterial& mat, const glm::vec3& normal, const glm::vec3& incidence,
+                            const glm::vec3& outgoing);
+float MixedBRDF_PDF(const ShadingMaterial& mat, const glm::vec3& normal, const glm::vec3& incidence,
+                    const glm::vec3& outgoing);
+
+// SafeMultiply of Common_v6.hlsl: zero instead of NaN / inf
+float SafeMultiply(float scalar, float value);
+glm::vec3 SafeMultiply(float scalar, const glm::vec3& v);
+
+// GenerateEssLUT of ObjLoader.h: single-scattering GGX albedo per cos(theta),
+// Monte Carlo with a fixed seed instead of std::random_device
+void GenerateEssLUT(CpuMaterial& material, uint32_t seed = 0);
+
+#endif //PATHTRACER_BRDF_H
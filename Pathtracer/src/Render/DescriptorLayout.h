@@ -0,0 +1,258 @@
+#ifndef PATHTRACER_DESCRIPTORLAYOUT_H
+#define PATHTRACER_DESCRIPTORLAYOUT_H
+
+#include <cstdint>
+#include <vector>
+
+// Slots of the renderer's shader visible CBV/SRV/UAV heap
+// (Renderer::m_srvUavHeap). The heap is split in two:
+//   persistent: ranges that live until freed (the views of the scene and
+//               reservoir buffers), first fit from a free list;
+//   per frame:  framesInFlight slices at the end of the heap, each a linear
+//               range emptied when its frame slot is recorded again (the slot
+//               of FrameRing, whose fence wait guarantees the GPU is done).
+// The shader bindings are described once in kDescriptorBindings; their heap
+// slots and the descriptor ranges of the root signatures are generated from
+// it, so adding a buffer is one row here and a resized buffer keeps its slot.
+// No device calls, so both are checked by tools/DescriptorLayout.
+
+constexpr uint32_t kDescriptorNone = ~0u;
+
+enum class DescriptorType : uint8_t { Cbv, Srv, Uav };
+
+inline const char* DescriptorTypeName(DescriptorType type) {
+    switch (type) {
+        case DescriptorType::Cbv: return "b";
+        case DescriptorType::Srv: return "t";
+        case DescriptorType::Uav: return "u";
+    }
+    return "?";
+}
+
+// Root signatures that see a binding
+enum DescriptorVisibility : uint8_t {
+    kVisibleRayGen = 1, // the three RayGen passes
+    kVisibleHit = 2,    // the hit and shadow hit groups
+};
+
+// Shader bindings in heap order. Registers as declared in the shaders
+// (RayGen_v6_pass*.hlsl, Hit_v6.hlsl and their _v7 copies).
+enum class Binding : uint32_t {
+    Output,
+    SceneBVH,
+    Camera,
+    InstanceProperties,
+    MaterialIDs,
+    Materials,
+    EmissiveTriangles,
+    PermanentData,
+    ReservoirsDi,
+    ReservoirsLastDi,
+    ReservoirsGi,
+    ReservoirsLastGi,
+    SamplesCurrent,
+    SamplesLast,
+    Count
+};
+
+struct DescriptorBinding {
+    Binding binding;
+    const char* name; // as in the shaders
+    DescriptorType type;
+    uint32_t shaderRegister;
+    uint32_t space;
+    uint32_t count;
+    uint8_t visibility;
+};
+
+inline constexpr DescriptorBinding kDescriptorBindings[] = {
+    {Binding::Output,             "gOutput",                  DescriptorType::Uav, 0, 0, 1, kVisibleRayGen},
+    {Binding::SceneBVH,           "SceneBVH",                 DescriptorType::Srv, 0, 0, 1, kVisibleRayGen | kVisibleHit},
+    {Binding::Camera,             "CameraParams",             DescriptorType::Cbv, 0, 0, 1, kVisibleRayGen},
+    {Binding::InstanceProperties, "instanceProps",            DescriptorType::Srv, 3, 0, 1, kVisibleRayGen | kVisibleHit},
+    {Binding::MaterialIDs,        "materialIDs",              DescriptorType::Srv, 4, 0, 1, kVisibleRayGen | kVisibleHit},
+    {Binding::Materials,          "materials",                DescriptorType::Srv, 5, 0, 1, kVisibleRayGen | kVisibleHit},
+    {Binding::EmissiveTriangles,  "g_EmissiveTriangles",      DescriptorType::Srv, 6, 0, 1, kVisibleRayGen | kVisibleHit},
+    {Binding::PermanentData,      "gPermanentData",           DescriptorType::Uav, 1, 0, 1, kVisibleRayGen},
+    {Binding::ReservoirsDi,       "g_Reservoirs_current",     DescriptorType::Uav, 2, 0, 1, kVisibleRayGen},
+    {Binding::ReservoirsLastDi,   "g_Reservoirs_last",        DescriptorType::Uav, 3, 0, 1, kVisibleRayGen},
+    {Binding::ReservoirsGi,       "g_Reservoirs_current_gi",  DescriptorType::Uav, 4, 0, 1, kVisibleRayGen},
+    {Binding::ReservoirsLastGi,   "g_Reservoirs_last_gi",     DescriptorType::Uav, 5, 0, 1, kVisibleRayGen},
+    {Binding::SamplesCurrent,     "g_sample_current",         DescriptorType::Uav, 6, 0, 1, kVisibleRayGen},
+    {Binding::SamplesLast,        "g_sample_last",            DescriptorType::Uav, 7, 0, 1, kVisibleRayGen},
+};
+
+static_assert(sizeof(kDescriptorBindings) / sizeof(kDescriptorBindings[0]) ==
+                  static_cast<uint32_t>(Binding::Count),
+              "one row per Binding");
+
+struct DescriptorAllocatorStats {
+    uint32_t persistentUsed = 0;
+    uint32_t persistentPeak = 0;
+    uint32_t persistentFailures = 0; // AllocatePersistent calls that found no range
+    uint32_t framePeak = 0;          // most descriptors one frame slice held
+    uint32_t frameFailures = 0;      // AllocateFrame calls past the end of the slice
+};
+
+class DescriptorAllocator {
+public:
+    DescriptorAllocator(uint32_t persistentCount, uint32_t framesInFlight, uint32_t perFrameCount)
+        : m_persistentCount(persistentCount),
+          m_perFrameCount(perFrameCount),
+          m_frameHeads(framesInFlight ? framesInFlight : 1, 0) {
+        if (persistentCount) {
+            m_free.push_back({0, persistentCount});
+        }
+    }
+
+    // Descriptors of the whole heap, persistent and per-frame
+    uint32_t Capacity() const { return m_persistentCount + FramesInFlight() * m_perFrameCount; }
+    uint32_t FramesInFlight() const { return static_cast<uint32_t>(m_frameHeads.size()); }
+
+    // First slot of count contiguous descriptors, or kDescriptorNone
+    uint32_t AllocatePersistent(uint32_t count) {
+        for (size_t i = 0; i < m_free.size() && count; i++) {
+            Range& range = m_free[i];
+            if (range.count < count) {
+                continue;
+            }
+            const uint32_t first = range.first;
+            range.first += count;
+            range.count -= count;
+            if (range.count == 0) {
+                m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            m_stats.persistentUsed += count;
+            if (m_stats.persistentUsed > m_stats.persistentPeak) {
+                m_stats.persistentPeak = m_stats.persistentUsed;
+            }
+            return first;
+        }
+        m_stats.persistentFailures++;
+        return kDescriptorNone;
+    }
+
+    // Returns a range of AllocatePersistent; the caller makes sure the GPU no
+    // longer reads it. Merges with free neighbors so ranges do not splinter.
+    void FreePersistent(uint32_t first, uint32_t count) {
+        if (first == kDescriptorNone || count == 0) {
+            return;
+        }
+        size_t i = 0;
+        while (i < m_free.size() && m_free[i].first < first) {
+            i++;
+        }
+        m_free.insert(m_free.begin() + static_cast<std::ptrdiff_t>(i), {first, count});
+        if (i + 1 < m_free.size() && m_free[i].first + m_free[i].count == m_free[i + 1].first) {
+            m_free[i].count += m_free[i + 1].count;
+            m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i + 1));
+        }
+        if (i > 0 && m_free[i - 1].first + m_free[i - 1].count == m_free[i].first) {
+            m_free[i - 1].count += m_free[i].count;
+            m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        m_stats.persistentUsed -= count;
+    }
+
+    // Largest range AllocatePersistent can still return
+    uint32_t LargestFreeRange() const {
+        uint32_t largest = 0;
+        for (const Range& range : m_free) {
+            largest = range.count > largest ? range.count : largest;
+        }
+        return largest;
+    }
+
+    // Empties the slice of frame slot; the frame previously recorded in it has
+    // completed (FrameRing::BeginFrame waited for it)
+    void BeginFrame(uint32_t slot) {
+        m_frameSlot = slot % FramesInFlight();
+        m_frameHeads[m_frameSlot] = 0;
+    }
+
+    // First slot of count contiguous descriptors valid for the frame being
+    // recorded, or kDescriptorNone when its slice is full
+    uint32_t AllocateFrame(uint32_t count) {
+        uint32_t& head = m_frameHeads[m_frameSlot];
+        if (head + count > m_perFrameCount) {
+            m_stats.frameFailures++;
+            return kDescriptorNone;
+        }
+        const uint32_t first = m_persistentCount + m_frameSlot * m_perFrameCount + head;
+        head += count;
+        if (head > m_stats.framePeak) {
+            m_stats.framePeak = head;
+        }
+        return first;
+    }
+
+    const DescriptorAllocatorStats& Stats() const { return m_stats; }
+
+private:
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    uint32_t m_persistentCount;
+    uint32_t m_perFrameCount;
+    std::vector<uint32_t> m_frameHeads;
+    uint32_t m_frameSlot = 0;
+    std::vector<Range> m_free; // sorted by first, never adjacent
+    DescriptorAllocatorStats m_stats;
+};
+
+// One descriptor range of a root signature table, as taken by
+// RootSignatureGenerator::AddHeapRangesParameter; heapOffset is relative to
+// the heap start, which is the table pointer in the shader binding table
+struct DescriptorRange {
+    DescriptorType type;
+    uint32_t shaderRegister;
+    uint32_t space;
+    uint32_t count;
+    uint32_t heapOffset;
+};
+
+// Heap slot of every binding
+struct BindingTable {
+    uint32_t slots[static_cast<uint32_t>(Binding::Count)];
+
+    uint32_t Slot(Binding binding) const { return slots[static_cast<uint32_t>(binding)]; }
+
+    // Ranges of the bindings visible to a root signature. Bindings of one type
+    // and space with consecutive registers in consecutive slots share a range.
+    std::vector<DescriptorRange> Ranges(uint8_t visibility) const {
+        std::vector<DescriptorRange> ranges;
+        for (const DescriptorBinding& b : kDescriptorBindings) {
+            if (!(b.visibility & visibility)) {
+                continue;
+            }
+            const uint32_t slot = Slot(b.binding);
+            bool merged = false;
+            for (DescriptorRange& r : ranges) {
+                if (r.type == b.type && r.space == b.space && r.shaderRegister + r.count == b.shaderRegister &&
+                    r.heapOffset + r.count == slot) {
+                    r.count += b.count;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) {
+                ranges.push_back({b.type, b.shaderRegister, b.space, b.count, slot});
+            }
+        }
+        return ranges;
+    }
+};
+
+// Persistent slots for all bindings, in table order. A binding that gets no
+// slot (heap too small) is kDescriptorNone.
+inline BindingTable AllocateBindingTable(DescriptorAllocator& allocator) {
+    BindingTable table;
+    for (const DescriptorBinding& b : kDescriptorBindings) {
+        table.slots[static_cast<uint32_t>(b.binding)] = allocator.AllocatePersistent(b.count);
+    }
+    return table;
+}
+
+#endif //PATHTRACER_DESCRIPTORLAYOUT_H
@@ -0,0 +1,85 @@
+#ifndef PATHTRACER_FRAMERING_H
+#define PATHTRACER_FRAMERING_H
+
+#include <cstdint>
+#include <vector>
+
+// Fence bookkeeping of the renderer's frame contexts (command allocator,
+// TLAS instance descriptors; the upload ring retires by the same fence
+// values, see UploadRing.h). Frame f records into slot f % framesInFlight;
+// the slot is reused only after the fence value signaled at the end of its
+// previous frame has completed, so the CPU can record up to framesInFlight
+// frames ahead of the GPU. The queue and fence
+// are behind FrameFence: the renderer wraps ID3D12CommandQueue /
+// ID3D12Fence, tools/FrameRing a simulated GPU, so the ring can be checked
+// without a device.
+
+class FrameFence {
+public:
+    virtual ~FrameFence() = default;
+    // Queues a signal of value behind the work submitted so far
+    virtual void Signal(uint64_t value) = 0;
+    virtual uint64_t CompletedValue() = 0;
+    // Blocks until CompletedValue() >= value
+    virtual void WaitFor(uint64_t value) = 0;
+};
+
+struct FrameRingStats {
+    uint64_t frames = 0;     // EndFrame calls
+    uint64_t frameWaits = 0; // BeginFrame calls that blocked on a slot
+    uint64_t idleWaits = 0;  // WaitIdle calls
+};
+
+class FrameRing {
+public:
+    explicit FrameRing(uint32_t framesInFlight) : m_slotValues(framesInFlight ? framesInFlight : 1, 0) {}
+
+    uint32_t FramesInFlight() const { return static_cast<uint32_t>(m_slotValues.size()); }
+
+    // Slot of the frame being recorded, valid between BeginFrame and EndFrame
+    uint32_t Slot() const { return static_cast<uint32_t>(m_stats.frames % m_slotValues.size()); }
+
+    // Waits until the GPU is done with the next frame's slot and returns it;
+    // its allocator and upload memory may be reset afterwards
+    uint32_t BeginFrame(FrameFence& fence) {
+        const uint64_t value = m_slotValues[Slot()];
+        if (fence.CompletedValue() < value) {
+            fence.WaitFor(value);
+            m_stats.frameWaits++;
+        }
+        return Slot();
+    }
+
+    // After the frame's command lists were executed: signals the value that
+    // retires the slot and moves on to the next one
+    uint64_t EndFrame(FrameFence& fence) {
+        const uint64_t value = m_nextValue++;
+        fence.Signal(value);
+        m_slotValues[Slot()] = value;
+        m_stats.frames++;
+        return value;
+    }
+
+    // Waits for everything submitted so far (loading, resizes, shutdown)
+    void WaitIdle(FrameFence& fence) {
+        const uint64_t value = m_nextValue++;
+        fence.Signal(value);
+        fence.WaitFor(value);
+        m_stats.idleWaits++;
+    }
+
+    // Whether the slot's last frame is done at the given completed fence value
+    bool Retired(uint32_t slot, uint64_t completed) const { return m_slotValues[slot] <= completed; }
+
+    // Value to signal next; everything below it has been signaled
+    uint64_t NextValue() const { return m_nextValue; }
+
+    const FrameRingStats& Stats() const { return m_stats; }
+
+private:
+    std::vector<uint64_t> m_slotValues; // per slot, signaled after its last frame, 0 before the first
+    uint64_t m_nextValue = 1;
+    FrameRingStats m_stats;
+};
+
+#endif //PATHTRACER_FRAMERING_H
@@ -0,0 +1,65 @@
+#include "GiUpsample.h"
+
+namespace {
+
+// Structured buffer reads past the end return zeros
+const SampleData kZeroSample{};
+const Reservoir_GI kZeroReservoirGI{};
+
+} // namespace
+
+const char* GiUpsampleFilterName(GiUpsampleFilter filter) {
+    return filter == GiUpsampleFilter::Guided ? "guided" : "bilinear";
+}
+
+glm::vec3 UpsampleGIPixel(const SceneTracer& tracer, const glm::vec3& cameraOrigin, GiUpsampleFilter filter,
+                          uint32_t x, uint32_t y, const RestirFrame& current, const SampleData& sdata_current,
+                          const ShadingMaterial& matOpt, bool* fallback) {
+    const glm::uvec2 dims(current.width, current.height);
+    const auto sampleAt = [&](uint32_t i) -> const SampleData& {
+        return i < current.samples.size() ? current.samples[i] : kZeroSample;
+    };
+    const auto reservoirGIAt = [&](uint32_t i) -> const Reservoir_GI& {
+        return i < current.reservoirsGI.size() ? current.reservoirsGI[i] : kZeroReservoirGI;
+    };
+    const auto shade = [&](const Reservoir_GI& r) {
+        return GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1, r.xn, r.nn, ToFloat3(r.E3), sdata_current.o,
+                           matOpt, false) * r.W;
+    };
+
+    const float depth = glm::length(sdata_current.x1 - cameraOrigin);
+    glm::vec3 sum(0.0f);
+    float weightSum = 0.0f;
+    for (uint32_t k = 0; k < GI_UPSAMPLE_TAPS; k++) {
+        const uint32_t tap = GiUpsampleTap(current.giResolution, current.width, current.height, x, y, k);
+        if (tap == GI_NO_TAP) {
+            continue;
+        }
+        const glm::uvec2 tapPos(tap & 0xFFFFu, tap >> 16);
+        const SampleData& s = sampleAt(MapPixelID(dims, tapPos));
+        if (glm::length(ToFloat3(s.L1)) != 0.0f) {
+            continue;
+        }
+        float weight = 1.0f;
+        if (filter == GiUpsampleFilter::Guided) {
+            if (s.mID != sdata_current.mID) {
+                continue;
+            }
+            weight = GiUpsampleWeight(depth, glm::length(s.x1 - cameraOrigin), glm::dot(sdata_current.n1, s.n1));
+            if (!(weight > 0.0f)) {
+                continue;
+            }
+        }
+        sum += weight * shade(reservoirGIAt(MapGiPixelID(current.giResolution, dims, tapPos)));
+        weightSum += weight;
+    }
+
+    if (fallback) {
+        *fallback = !(weightSum > 0.0f);
+    }
+    if (weightSum > 0.0f) {
+        return sum / weightSum;
+    }
+    const glm::uvec2 owner = GiOwner(current.giResolution, glm::uvec2(x, y));
+    return shade(reservoirGIAt(MapGiPixelID(current.giResolution, dims, owner)));
+}
@@ -0,0 +1,28 @@
+#ifndef PATHTRACER_GIUPSAMPLE_H
+#define PATHTRACER_GIUPSAMPLE_H
+
+#include <cstdint>
+
+#include "InitPass.h"
+
+// CPU reference of the GI reconstruction in RayGen_v6_pass3.hlsl
+// (UpsampleGI) for pixels that own no GI reservoir (GiResolution.h). The
+// current GI reservoirs of the owners around the pixel (GiUpsampleTap) are
+// evaluated at the pixel's own surface and averaged, so the BRDF and normal
+// detail stay at full resolution and only the incoming radiance is shared.
+
+enum class GiUpsampleFilter : uint32_t {
+    Guided,   // UpsampleGI: GiUpsampleWeight on depth and normal, same material only
+    Bilinear, // every tap on a non-emissive surface with the same weight, no guides
+};
+
+const char* GiUpsampleFilterName(GiUpsampleFilter filter);
+
+// GI of pixel (x, y), not an owner, from the current frame's buffers.
+// fallback, if given, tells whether no tap passed and the owner standing in
+// for the pixel was used alone.
+glm::vec3 UpsampleGIPixel(const SceneTracer& tracer, const glm::vec3& cameraOrigin, GiUpsampleFilter filter,
+                          uint32_t x, uint32_t y, const RestirFrame& current, const SampleData& sdata_current,
+                          const ShadingMaterial& matOpt, bool* fallback = nullptr);
+
+#endif //PATHTRACER_GIUPSAMPLE_H
@@ -0,0 +1,111 @@
+#include "InitPass.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Rng.h"
+
+void RestirFrame::Resize(uint32_t w, uint32_t h, uint32_t gi) {
+    width = w;
+    height = h;
+    giResolution = gi;
+    // MapPixelID pads the tiled schemes to whole tiles
+    const size_t count = PixelBufferCount(PIXEL_MAPPING, PIXEL_TILE_SIZE, w, h);
+    reservoirsDI.assign(count, Reservoir_DI{});
+    reservoirsGI.assign(GiBufferCount(gi, w, h), Reservoir_GI{});
+    samples.assign(count, SampleData{});
+}
+
+size_t RestirFrame::Bytes() const {
+    return reservoirsDI.size() * sizeof(Reservoir_DI) + reservoirsGI.size() * sizeof(Reservoir_GI) +
+           samples.size() * sizeof(SampleData);
+}
+
+void InitPassPixel(const SceneTracer& tracer, const CpuCameraRays& camera, const InitPassSettings& settings,
+                   uint32_t x, uint32_t y, RestirFrame& frame) {
+    const uint32_t pixelIdx = MapPixelID(glm::uvec2(frame.width, frame.height), glm::uvec2(x, y));
+    glm::uvec2 seed = SeedPixel(x, y, 1, settings.time);
+    const bool ownsGI = frame.OwnsGI(x, y);
+
+    // Unjittered, like the shader
+    glm::vec3 origin, direction;
+    camera.Generate(static_cast<float>(x), static_cast<float>(y), origin, direction);
+
+    // A miss leaves the payload as the miss shader wrote it; the rest of the GPU payload is undefined, zeros here
+    const CpuHitInfo payload = tracer.TraceRay(origin, direction, 0.0001f, 10000.0f);
+
+    const uint32_t mID = payload.materialID;
+    const bool performSampling = !(glm::length(tracer.Material(mID).Ke) > 0.0f);
+    const ShadingMaterial matOpt = LoadMaterial(tracer, mID);
+
+    Reservoir_DI reservoir;
+    Reservoir_GI reservoir_GI;
+    SampleData sdata;
+    sdata.mID = static_cast<uint16_t>(mID);
+    sdata.L1 = ToHalf3(matOpt.Ke);
+    sdata.objID = payload.objID;
+
+    if (performSampling) {
+        SampleRIS(tracer, settings.restir.neeSamplesDI, settings.restir.bsdfSamplesDI, -direction, reservoir,
+                  payload, matOpt, seed);
+
+        sdata.x1 = payload.hitPosition;
+        sdata.n1 = glm::normalize(payload.hitNormal);
+        sdata.o = -direction;
+
+        const glm::vec3 L2 = ToFloat3(reservoir.L2);
+        const float p_hat = GetP_Hat(tracer, sdata.x1, sdata.n1, reservoir.x2, reservoir.n2, L2, sdata.o, matOpt,
+                                     true);
+        reservoir.W = GetW(reservoir, p_hat);
+
+#if SAMPLE_DATA_DEBUG
+        sdata.debug = ReconnectDI(sdata.x1, sdata.n1, reservoir.x2, reservoir.n2, L2, sdata.o, matOpt) * reservoir.W;
+#endif
+        if (ownsGI) {
+#if SAMPLE_DATA_DEBUG
+            sdata.debug += SamplePathSimple(tracer, settings.restir, reservoir_GI, payload.hitPosition,
+                                            payload.hitNormal, -direction, matOpt, seed);
+#else
+            SamplePathSimple(tracer, settings.restir, reservoir_GI, payload.hitPosition, payload.hitNormal,
+                             -direction, matOpt, seed);
+#endif
+
+            const float f_c = LinearizeVector(GetP_Hat_GI(tracer, sdata.x1, sdata.n1, reservoir_GI.xn,
+                                                          reservoir_GI.nn, ToFloat3(reservoir_GI.E3), sdata.o,
+                                                          matOpt, false));
+            reservoir_GI.W = GetW_GI(reservoir_GI, f_c);
+            reservoir_GI.M = 1;
+        }
+    }
+
+    if (pixelIdx < frame.samples.size()) {
+        frame.reservoirsDI[pixelIdx] = reservoir;
+        frame.samples[pixelIdx] = sdata;
+    }
+    const uint32_t giIdx = frame.GiIndex(x, y);
+    if (ownsGI && giIdx < frame.reservoirsGI.size()) {
+        frame.reservoirsGI[giIdx] = reservoir_GI;
+    }
+}
+
+double RunInitPass(const SceneTracer& tracer, ThreadPool& pool, const CpuCameraRays& camera,
+                   const InitPassSettings& settings, RestirFrame& frame) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t tileSize = std::max(1u, settings.tileSize);
+    const uint32_t tilesX = (frame.width + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (frame.height + tileSize - 1) / tileSize;
+    pool.ParallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t) {
+        const uint32_t x0 = (tile % tilesX) * tileSize;
+        const uint32_t y0 = (tile / tilesX) * tileSize;
+        const uint32_t x1 = std::min(x0 + tileSize, frame.width);
+        const uint32_t y1 = std::min(y0 + tileSize, frame.height);
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                InitPassPixel(tracer, camera, settings, x, y, frame);
+            }
+        }
+    });
+
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
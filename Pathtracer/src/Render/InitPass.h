@@ -0,0 +1,50 @@
+#ifndef PATHTRACER_INITPASS_H
+#define PATHTRACER_INITPASS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../Util/ThreadPool.h"
+#include "Reservoir.h"
+#include "Sampler.h"
+#include "SceneTracer.h"
+
+// CPU version of the initial sampling pass (RayGen_v6_pass1.hlsl /
+// Pass_init_di_v7.hlsl): primary ray, RIS for direct light, one GI path on
+// the pixels owning a GI reservoir, written into buffers laid out like g_Reservoirs_current,
+// g_Reservoirs_current_gi and g_sample_current.
+
+// The per-frame UAVs of the ReSTIR passes, element i at MapPixelID; GI
+// reservoirs at MapGiPixelID, only for the pixels owning one (GiResolution.h)
+struct RestirFrame {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t giResolution = GI_RESOLUTION;
+    std::vector<Reservoir_DI> reservoirsDI;
+    std::vector<Reservoir_GI> reservoirsGI;
+    std::vector<SampleData> samples;
+
+    // Sized like Renderer::CreateShaderResourceHeap
+    void Resize(uint32_t w, uint32_t h, uint32_t gi = GI_RESOLUTION);
+    bool OwnsGI(uint32_t x, uint32_t y) const { return IsGiPixel(giResolution, x, y); }
+    uint32_t GiIndex(uint32_t x, uint32_t y) const {
+        return MapGiPixelID(giResolution, glm::uvec2(width, height), glm::uvec2(x, y));
+    }
+    size_t Bytes() const;
+};
+
+struct InitPassSettings {
+    RestirSettings restir;
+    uint32_t time = 0; // CameraParams.time, seeds the frame
+    uint32_t tileSize = 8; // TILE_WIDTH / TILE_HEIGHT
+};
+
+// One pixel of RayGen(); out-of-range buffer indices are dropped like UAV writes past the end
+void InitPassPixel(const SceneTracer& tracer, const CpuCameraRays& camera, const InitPassSettings& settings,
+                   uint32_t x, uint32_t y, RestirFrame& frame);
+
+// Whole frame, tile-parallel; frame must have the camera's size. Returns seconds.
+double RunInitPass(const SceneTracer& tracer, ThreadPool& pool, const CpuCameraRays& camera,
+                   const InitPassSettings& settings, RestirFrame& frame);
+
+#endif //PATHTRACER_INITPASS_H
@@ -0,0 +1,135 @@
+#include "Mis.h"
+
+#include <algorithm>
+
+#include "Sampler.h"
+
+namespace {
+
+float CanonicalTemporal(float cM, float nM, float M_sum, float M_cap) {
+    float m_c = std::min(M_cap, cM) / M_sum;
+    const float m_num = std::min(M_cap, cM);
+    const float m_den = m_num + (M_sum - std::min(M_cap, cM));
+    if (m_den > 0.0f) {
+        m_c += (std::min(M_cap, nM) / M_sum) * (m_num / m_den);
+    }
+    return m_c;
+}
+
+float NoncanonicalTemporal(float cM, float nM, float M_sum, float M_cap) {
+    const float m_num = M_sum - std::min(M_cap, cM);
+    const float m_den = m_num + std::min(M_cap, cM);
+    if (m_den > 0.0f) {
+        return (std::min(M_cap, nM) / M_sum) * m_num / m_den;
+    }
+    return 0.0f;
+}
+
+} // namespace
+
+float GenPairwiseMIS_canonical(const SceneTracer& tracer, const std::vector<Reservoir_DI>& reservoirs,
+                               const std::vector<SampleData>& samples, const Reservoir_DI& c, const uint32_t* n,
+                               uint32_t count, const SampleData& sample_c, float M_sum, float M_cap,
+                               const ShadingMaterial& matOpt) {
+    const float c_M_min = std::min(M_cap, static_cast<float>(c.M));
+    const float c_M_max = M_sum - c_M_min;
+    const glm::vec3 L2 = ToFloat3(c.L2);
+    const float p_c = GetP_Hat(tracer, sample_c.x1, sample_c.n1, c.x2, c.n2, L2, sample_c.o, matOpt, false);
+    const float c_m_num = c_M_min * p_c;
+    float m_c = c_M_min / M_sum;
+
+    for (uint32_t j = 0; j < count; j++) {
+        const SampleData& s = samples[n[j]];
+        const float n_M_min = std::min(M_cap, static_cast<float>(reservoirs[n[j]].M));
+        const float p_hat_from = GetP_Hat(tracer, s.x1, s.n1, c.x2, c.n2, L2, s.o, matOpt, true);
+        const float m_den = c_m_num + c_M_max * p_hat_from;
+        if (m_den > 0.0f) {
+            m_c += (n_M_min / M_sum) * (c_m_num / m_den);
+        }
+    }
+    return m_c;
+}
+
+float GenPairwiseMIS_noncanonical(const SceneTracer& tracer, const std::vector<Reservoir_DI>& reservoirs,
+                                  const std::vector<SampleData>& samples, const Reservoir_DI& c, uint32_t n,
+                                  const SampleData& sample_c, float M_sum, float M_cap,
+                                  const ShadingMaterial& matOpt) {
+    const float c_M_min = std::min(M_cap, static_cast<float>(c.M));
+    const glm::vec3 L2 = ToFloat3(c.L2);
+    const float p_c = GetP_Hat(tracer, sample_c.x1, sample_c.n1, c.x2, c.n2, L2, sample_c.o, matOpt, false);
+
+    const SampleData& s = samples[n];
+    const float p_hat_from = GetP_Hat(tracer, s.x1, s.n1, c.x2, c.n2, L2, s.o, matOpt, false);
+    const float m_num = (M_sum - c_M_min) * p_hat_from;
+    const float m_den = m_num + c_M_min * p_c;
+    if (m_den > 0.0f) {
+        const float n_M_min = std::min(M_cap, static_cast<float>(reservoirs[n].M));
+        return (n_M_min / M_sum) * (m_num / m_den);
+    }
+    return 0.0f;
+}
+
+float GenPairwiseMIS_canonical_GI(const SceneTracer& tracer, const std::vector<Reservoir_GI>& reservoirs,
+                                  const std::vector<SampleData>& samples, const Reservoir_GI& c, const uint32_t* n,
+                                  const uint32_t* nSamples, uint32_t count, const SampleData& sample_c, float M_sum,
+                                  float M_cap, const ShadingMaterial& matOpt) {
+    const float c_M_min = std::min(M_cap, static_cast<float>(c.M));
+    const float c_M_max = M_sum - c_M_min;
+    const glm::vec3 E3 = ToFloat3(c.E3);
+    const float p_c = LinearizeVector(
+        GetP_Hat_GI(tracer, sample_c.x1, sample_c.n1, c.xn, c.nn, E3, sample_c.o, matOpt, false));
+    const float c_m_num = c_M_min * p_c;
+    float m_c = c_M_min / M_sum;
+
+    for (uint32_t j = 0; j < count; j++) {
+        const SampleData& s = samples[nSamples[j]];
+        const float n_M_min = std::min(M_cap, static_cast<float>(reservoirs[n[j]].M));
+        const float j_gi = Jacobian_Reconnection(sample_c, s, c.xn, c.nn);
+        const float p_hat_from =
+            LinearizeVector(GetP_Hat_GI(tracer, s.x1, s.n1, c.xn, c.nn, E3, s.o, matOpt, true)) * j_gi;
+        const float m_den = c_m_num + c_M_max * p_hat_from;
+        if (m_den > 0.0f) {
+            m_c += (n_M_min / M_sum) * (c_m_num / m_den);
+        }
+    }
+    return glm::clamp(m_c, 0.0f, 1.0f);
+}
+
+float GenPairwiseMIS_noncanonical_GI(const SceneTracer& tracer, const std::vector<Reservoir_GI>& reservoirs,
+                                     const std::vector<SampleData>& samples, const Reservoir_GI& c, uint32_t n,
+                                     uint32_t nSample, const SampleData& sample_c, float M_sum, float M_cap,
+                                     const ShadingMaterial& matOpt) {
+    const float c_M_min = std::min(M_cap, static_cast<float>(c.M));
+    const glm::vec3 E3 = ToFloat3(c.E3);
+    const float p_c = LinearizeVector(
+        GetP_Hat_GI(tracer, sample_c.x1, sample_c.n1, c.xn, c.nn, E3, sample_c.o, matOpt, false));
+
+    const SampleData& s = samples[nSample];
+    const float j_gi = Jacobian_Reconnection(sample_c, s, c.xn, c.nn);
+    const float p_hat_from =
+        LinearizeVector(GetP_Hat_GI(tracer, s.x1, s.n1, c.xn, c.nn, E3, s.o, matOpt, false)) * j_gi;
+    const float m_num = (M_sum - c_M_min) * p_hat_from;
+    const float m_den = m_num + c_M_min * p_c;
+    if (m_den > 0.0f) {
+        const float n_M_min = std::min(M_cap, static_cast<float>(reservoirs[n].M));
+        return glm::clamp((n_M_min / M_sum) * (m_num / m_den), 0.0f, 1.0f);
+    }
+    return 0.0f;
+}
+
+float GenPairwiseMIS_canonical_temporal(const Reservoir_DI& c, const Reservoir_DI& n, float M_sum, float M_cap) {
+    return CanonicalTemporal(c.M, n.M, M_sum, M_cap);
+}
+
+float GenPairwiseMIS_noncanonical_temporal(const Reservoir_DI& c, const Reservoir_DI& n, float M_sum, float M_cap) {
+    return NoncanonicalTemporal(c.M, n.M, M_sum, M_cap);
+}
+
+float GenPairwiseMIS_canonical_temporal_GI(const Reservoir_GI& c, const Reservoir_GI& n, float M_sum, float M_cap) {
+    return CanonicalTemporal(c.M, n.M, M_sum, M_cap);
+}
+
+float GenPairwiseMIS_noncanonical_temporal_GI(const Reservoir_GI& c, const Reservoir_GI& n, float M_sum,
+                                              float M_cap) {
+    return NoncanonicalTemporal(c.M, n.M, M_sum, M_cap);
+}
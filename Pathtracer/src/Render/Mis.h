@@ -0,0 +1,48 @@
+#ifndef PATHTRACER_MIS_H
+#define PATHTRACER_MIS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Brdf.h"
+#include "Reservoir.h"
+#include "SceneTracer.h"
+
+// C++ port of the pairwise MIS weights of MIS_v6.hlsl and MIS_GI_v6.hlsl
+// (MIS_v7 is the same code). c is the canonical reservoir, n the reused one;
+// M_sum is the sum of the M_cap-clamped confidences.
+
+// Spatial variants over the accepted neighbors n[0..count) of the current
+// frame's buffers (g_Reservoirs_current*, g_sample_current). Like the shader,
+// the non-canonical weights evaluate the canonical sample at the neighbor,
+// not the neighbor's own sample. The GI variants take the neighbors' GI
+// reservoir elements n and their SampleData elements nSamples separately,
+// which differ when GI_RESOLUTION is not FULL.
+float GenPairwiseMIS_canonical(const SceneTracer& tracer, const std::vector<Reservoir_DI>& reservoirs,
+                               const std::vector<SampleData>& samples, const Reservoir_DI& c, const uint32_t* n,
+                               uint32_t count, const SampleData& sample_c, float M_sum, float M_cap,
+                               const ShadingMaterial& matOpt);
+float GenPairwiseMIS_noncanonical(const SceneTracer& tracer, const std::vector<Reservoir_DI>& reservoirs,
+                                  const std::vector<SampleData>& samples, const Reservoir_DI& c, uint32_t n,
+                                  const SampleData& sample_c, float M_sum, float M_cap,
+                                  const ShadingMaterial& matOpt);
+float GenPairwiseMIS_canonical_GI(const SceneTracer& tracer, const std::vector<Reservoir_GI>& reservoirs,
+                                  const std::vector<SampleData>& samples, const Reservoir_GI& c, const uint32_t* n,
+                                  const uint32_t* nSamples, uint32_t count, const SampleData& sample_c, float M_sum,
+                                  float M_cap, const ShadingMaterial& matOpt);
+float GenPairwiseMIS_noncanonical_GI(const SceneTracer& tracer, const std::vector<Reservoir_GI>& reservoirs,
+                                     const std::vector<SampleData>& samples, const Reservoir_GI& c, uint32_t n,
+                                     uint32_t nSample, const SampleData& sample_c, float M_sum, float M_cap,
+                                     const ShadingMaterial& matOpt);
+
+// Temporal variants: confidence only, the target functions cancel out
+float GenPairwiseMIS_canonical_temporal(const Reservoir_DI& c, const Reservoir_DI& n, float M_sum, float M_cap);
+float GenPairwiseMIS_noncanonical_temporal(const Reservoir_DI& c, const Reservoir_DI& n, float M_sum, float M_cap);
+
+// The shader versions also take both SampleData and the material but, like
+// the DI ones, only read M
+float GenPairwiseMIS_canonical_temporal_GI(const Reservoir_GI& c, const Reservoir_GI& n, float M_sum, float M_cap);
+float GenPairwiseMIS_noncanonical_temporal_GI(const Reservoir_GI& c, const Reservoir_GI& n, float M_sum,
+                                              float M_cap);
+
+#endif //PATHTRACER_MIS_H
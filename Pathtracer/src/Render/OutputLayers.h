@@ -0,0 +1,88 @@
+#ifndef PATHTRACER_OUTPUTLAYERS_H
+#define PATHTRACER_OUTPUTLAYERS_H
+
+#include <cstdint>
+#include <vector>
+
+// Which layers of the raytracing output array (m_outputResource) are
+// resident. Layer 0 is the presented image and always has slice 0; the
+// debug views cycled with 'C' only get a slice once they are selected.
+//   OnDemand: every selected view keeps its own slice, the array grows by
+//             one slice per new view.
+//   Scratch:  all debug views share slice 1, the array is at most 2 deep.
+// Select() tells the renderer when the array has to be recreated. No
+// device calls here, so the sizing can be checked anywhere
+// (tools/OutputLayers).
+
+enum class DebugLayerMode : uint32_t {
+    OnDemand,
+    Scratch,
+};
+
+// R8G8B8A8_UNORM, the format of the output array
+constexpr uint32_t kOutputBytesPerPixel = 4;
+// The array the renderer used to allocate up front
+constexpr uint32_t kOutputLogicalLayers = 60;
+constexpr uint32_t kNoOutputSlice = 0xFFFFFFFFu;
+
+// Resident bytes of one slice of the array: whole 64 KB standard tiles,
+// 128x128 texels at kOutputBytesPerPixel, as a committed default heap
+// texture is laid out
+inline uint64_t OutputSliceBytes(uint32_t width, uint32_t height) {
+    constexpr uint64_t kTileBytes = 64 * 1024;
+    constexpr uint32_t kTileSide = 128;
+    static_assert(kTileSide * kTileSide * kOutputBytesPerPixel == kTileBytes, "tile shape is for 4 byte texels");
+    const uint64_t tilesX = (width + kTileSide - 1) / kTileSide;
+    const uint64_t tilesY = (height + kTileSide - 1) / kTileSide;
+    return tilesX * tilesY * kTileBytes;
+}
+
+class OutputLayerPlan {
+public:
+    explicit OutputLayerPlan(DebugLayerMode mode = DebugLayerMode::Scratch,
+                             uint32_t logicalLayers = kOutputLogicalLayers)
+        : m_mode(mode), m_slices(logicalLayers, kNoOutputSlice) {
+        m_slices[0] = 0;
+    }
+
+    DebugLayerMode Mode() const { return m_mode; }
+    uint32_t LogicalLayers() const { return static_cast<uint32_t>(m_slices.size()); }
+
+    // Gives the layer a slice; true if the array has to grow for it
+    bool Select(uint32_t layer) {
+        if (layer >= m_slices.size() || m_slices[layer] != kNoOutputSlice) {
+            return false;
+        }
+        if (m_mode == DebugLayerMode::Scratch) {
+            m_slices[layer] = 1;
+            const bool grows = m_resident < 2;
+            m_resident = 2;
+            return grows;
+        }
+        m_slices[layer] = m_resident++;
+        return true;
+    }
+
+    // Slice of a layer, kNoOutputSlice if it was never selected
+    uint32_t Slice(uint32_t layer) const {
+        return layer < m_slices.size() ? m_slices[layer] : kNoOutputSlice;
+    }
+
+    // Array size to allocate
+    uint32_t ResidentSlices() const { return m_resident; }
+
+    uint64_t ResidentBytes(uint32_t width, uint32_t height) const {
+        return m_resident * OutputSliceBytes(width, height);
+    }
+
+    uint64_t AllLayersBytes(uint32_t width, uint32_t height) const {
+        return m_slices.size() * OutputSliceBytes(width, height);
+    }
+
+private:
+    DebugLayerMode m_mode;
+    std::vector<uint32_t> m_slices; // per logical layer
+    uint32_t m_resident = 1;
+};
+
+#endif //PATHTRACER_OUTPUTLAYERS_H
@@ -0,0 +1,365 @@
+#include "ReferenceRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Rng.h"
+
+namespace {
+
+// Pass index of the reference streams in SeedPixel, clear of the GPU passes 1 and 2
+constexpr uint32_t kReferencePass = 16;
+
+// Density SampleBRDF actually draws from: SelectSamplingStrategy falls back
+// to the Lambert sampler for smooth specular picks, so below that roughness
+// both picks are Lambert samples
+float SamplingPdf(const ShadingMaterial& material, const glm::vec3& normal, const glm::vec3& incidence,
+                  const glm::vec3& outgoing) {
+    if (material.Pr_Pm_Ps_Pc.x < 0.04f) {
+        return BRDF_PDF(0, material, normal, incidence, outgoing);
+    }
+    return MixedBRDF_PDF(material, normal, incidence, outgoing);
+}
+
+float LightPdfArea(const CpuScene& scene, const glm::vec3& Ke) {
+    // weight / area of the picked triangle: (area * avg(Ke) / totalWeight) / area
+    return (Ke.x + Ke.y + Ke.z) / 3.0f / scene.emissiveTriangles[0].totalWeight;
+}
+
+} // namespace
+
+ReferenceRenderer::ReferenceRenderer(const SceneTracer& tracer, ThreadPool& pool) : m_tracer(tracer), m_pool(pool) {
+    Reset(m_settings);
+}
+
+void ReferenceRenderer::Reset(const ReferenceSettings& settings) {
+    m_settings = settings;
+    m_settings.tileSize = std::max(1u, m_settings.tileSize);
+    m_camera = m_tracer.Scene().camera.Rays(m_settings.width, m_settings.height);
+    m_tilesX = (m_settings.width + m_settings.tileSize - 1) / m_settings.tileSize;
+    m_tilesY = (m_settings.height + m_settings.tileSize - 1) / m_settings.tileSize;
+    m_tileSamples.assign(TileCount(), 0);
+    m_accumulation.assign(static_cast<size_t>(m_settings.width) * m_settings.height, glm::vec3(0.0f));
+    m_oddAccumulation.assign(m_accumulation.size(), glm::vec3(0.0f));
+    m_stats = {};
+}
+
+void ReferenceRenderer::Render(uint32_t samplesPerPixel) {
+    std::vector<uint32_t> tiles(TileCount());
+    for (uint32_t t = 0; t < TileCount(); t++) {
+        tiles[t] = t;
+    }
+    RenderTiles(tiles, samplesPerPixel);
+}
+
+void ReferenceRenderer::RenderTiles(const std::vector<uint32_t>& tiles, uint32_t samplesPerPixel) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // Per-thread counters, a cache line apart
+    struct alignas(64) ThreadStats {
+        ReferenceStats stats;
+    };
+    std::vector<ThreadStats> threadStats(m_pool.ThreadCount());
+
+    m_pool.ParallelFor(static_cast<uint32_t>(tiles.size()), [&](uint32_t index, uint32_t thread) {
+        const uint32_t tile = tiles[index];
+        RenderTile(tile, m_tileSamples[tile], samplesPerPixel, m_accumulation, threadStats[thread].stats,
+                   &m_oddAccumulation);
+    });
+    for (uint32_t tile : tiles) {
+        m_tileSamples[tile] += samplesPerPixel;
+    }
+
+    for (const ThreadStats& t : threadStats) {
+        m_stats.paths += t.stats.paths;
+        m_stats.rays += t.stats.rays;
+        m_stats.shadowRays += t.stats.shadowRays;
+    }
+    m_stats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+double ReferenceRenderer::EstimateError(std::vector<float>* tileErrors) const {
+    // Per tile: summed variance of the pixel means
+    std::vector<double> tileVariance(TileCount(), 0.0);
+    double variance = 0.0, luminance = 0.0;
+    for (uint32_t tile = 0; tile < TileCount(); tile++) {
+        const uint32_t n = m_tileSamples[tile];
+        const uint32_t nOdd = n / 2, nEven = n - nOdd;
+        if (nOdd == 0) {
+            continue;
+        }
+        // E[(even mean - odd mean)^2] = sigma^2 (1/nEven + 1/nOdd), Var(mean) = sigma^2 / n
+        const double varianceScale = 1.0 / (static_cast<double>(n) * (1.0 / nEven + 1.0 / nOdd));
+        uint32_t x0, y0, x1, y1;
+        TileBounds(tile, x0, y0, x1, y1);
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                const size_t i = static_cast<size_t>(y) * m_settings.width + x;
+                const glm::vec3& total = m_accumulation[i];
+                const glm::vec3& odd = m_oddAccumulation[i];
+                const double lTotal = (total.x + total.y + total.z) / 3.0;
+                const double lOdd = (odd.x + odd.y + odd.z) / 3.0;
+                const double d = (lTotal - lOdd) / nEven - lOdd / nOdd;
+                tileVariance[tile] += d * d * varianceScale;
+                luminance += lTotal / n;
+            }
+        }
+        variance += tileVariance[tile];
+    }
+
+    const double pixels = static_cast<double>(m_accumulation.size());
+    const double imageMean = luminance / pixels;
+    if (tileErrors) {
+        tileErrors->assign(TileCount(), 0.0f);
+        for (uint32_t tile = 0; tile < TileCount() && imageMean > 0.0; tile++) {
+            uint32_t x0, y0, x1, y1;
+            TileBounds(tile, x0, y0, x1, y1);
+            const double tilePixels = static_cast<double>((x1 - x0) * (y1 - y0));
+            (*tileErrors)[tile] = static_cast<float>(std::sqrt(tileVariance[tile] / tilePixels) / imageMean);
+        }
+    }
+    return imageMean > 0.0 ? std::sqrt(variance / pixels) / imageMean : 0.0;
+}
+
+AdaptiveStats ReferenceRenderer::RenderAdaptive(const AdaptiveSettings& settings,
+                                                const std::function<bool(const AdaptiveStats&)>& onPass) {
+    AdaptiveStats result;
+    result.tileThreshold = settings.tileThreshold > 0.0f ? settings.tileThreshold : settings.errorTarget;
+    // Both halves need a sample before the variance means anything
+    const uint32_t passSamples = std::max(settings.passSamples, 2u);
+
+    std::vector<uint32_t> tiles;
+    std::vector<float> tileErrors;
+    while (true) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        tiles.clear();
+        if (result.passes == 0) {
+            for (uint32_t t = 0; t < TileCount(); t++) {
+                if (m_tileSamples[t] < std::max(settings.initialSamples, 2u)) {
+                    tiles.push_back(t);
+                }
+            }
+            RenderTiles(tiles, std::max(settings.initialSamples, 2u));
+        } else {
+            for (uint32_t t = 0; t < TileCount(); t++) {
+                if (tileErrors[t] > result.tileThreshold && m_tileSamples[t] + passSamples <= settings.maxSamples) {
+                    tiles.push_back(t);
+                }
+            }
+            if (tiles.empty()) {
+                break; // every noisy tile is at maxSamples
+            }
+            RenderTiles(tiles, passSamples);
+        }
+        result.passes++;
+        result.activeTiles = static_cast<uint32_t>(tiles.size());
+        result.estimatedError = EstimateError(&tileErrors);
+        result.reachedTarget = result.estimatedError <= settings.errorTarget;
+
+        // Lower the bar while the image misses the target but no tile is above it
+        if (!result.reachedTarget) {
+            const float worst = *std::max_element(tileErrors.begin(), tileErrors.end());
+            while (worst > 0.0f && worst <= result.tileThreshold) {
+                result.tileThreshold *= 0.5f;
+            }
+        }
+        result.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (onPass && !onPass(result)) {
+            break;
+        }
+        if (result.reachedTarget || (settings.timeBudget > 0.0 && result.seconds >= settings.timeBudget)) {
+            break;
+        }
+    }
+    return result;
+}
+
+uint32_t ReferenceRenderer::SampleCount() const {
+    return m_tileSamples.empty() ? 0 : *std::min_element(m_tileSamples.begin(), m_tileSamples.end());
+}
+
+uint64_t ReferenceRenderer::TotalSampleCount() const {
+    uint64_t total = 0;
+    for (uint32_t tile = 0; tile < TileCount(); tile++) {
+        uint32_t x0, y0, x1, y1;
+        TileBounds(tile, x0, y0, x1, y1);
+        total += static_cast<uint64_t>(m_tileSamples[tile]) * (x1 - x0) * (y1 - y0);
+    }
+    return total;
+}
+
+std::vector<glm::vec3> ReferenceRenderer::Image() const {
+    std::vector<glm::vec3> image(m_accumulation.size(), glm::vec3(0.0f));
+    for (uint32_t tile = 0; tile < TileCount(); tile++) {
+        if (m_tileSamples[tile] == 0) {
+            continue;
+        }
+        const float scale = 1.0f / static_cast<float>(m_tileSamples[tile]);
+        uint32_t x0, y0, x1, y1;
+        TileBounds(tile, x0, y0, x1, y1);
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                const size_t i = static_cast<size_t>(y) * m_settings.width + x;
+                image[i] = m_accumulation[i] * scale;
+            }
+        }
+    }
+    return image;
+}
+
+void ReferenceRenderer::TileBounds(uint32_t tile, uint32_t& x0, uint32_t& y0, uint32_t& x1, uint32_t& y1) const {
+    x0 = (tile % m_tilesX) * m_settings.tileSize;
+    y0 = (tile / m_tilesX) * m_settings.tileSize;
+    x1 = std::min(x0 + m_settings.tileSize, m_settings.width);
+    y1 = std::min(y0 + m_settings.tileSize, m_settings.height);
+}
+
+void ReferenceRenderer::RenderTile(uint32_t tile, uint32_t firstSample, uint32_t sampleCount,
+                                   std::vector<glm::vec3>& target, ReferenceStats& stats,
+                                   std::vector<glm::vec3>* odd) const {
+    uint32_t x0, y0, x1, y1;
+    TileBounds(tile, x0, y0, x1, y1);
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = x0; x < x1; x++) {
+            glm::vec3 sum(0.0f), oddSum(0.0f);
+            for (uint32_t s = firstSample; s < firstSample + sampleCount; s++) {
+                const glm::vec3 L = TracePath(x, y, s, stats);
+                // A single NaN would poison the pixel for the rest of the run
+                if (std::isfinite(L.x) && std::isfinite(L.y) && std::isfinite(L.z)) {
+                    sum += L;
+                    if (s & 1) {
+                        oddSum += L;
+                    }
+                }
+            }
+            const size_t i = static_cast<size_t>(y) * m_settings.width + x;
+            target[i] += sum;
+            if (odd) {
+                (*odd)[i] += oddSum;
+            }
+        }
+    }
+}
+
+glm::vec3 ReferenceRenderer::TracePath(uint32_t x, uint32_t y, uint32_t sampleIndex, ReferenceStats& stats) const {
+    const CpuScene& scene = m_tracer.Scene();
+    glm::uvec2 seed = SeedPixel(x, y, kReferencePass + sampleIndex, m_settings.seed);
+    stats.paths++;
+
+    float px = static_cast<float>(x);
+    float py = static_cast<float>(y);
+    if (m_settings.jitter) {
+        px += RandomFloat(seed);
+        py += RandomFloat(seed);
+    }
+    glm::vec3 origin, direction;
+    m_camera.Generate(px, py, origin, direction);
+
+    stats.rays++;
+    CpuHitInfo hit = m_tracer.TraceRay(origin, direction, 0.0001f, 10000.0f);
+    if (!hit.IsHit()) {
+        return glm::vec3(0.0f);
+    }
+    // Emitters are not shaded, RayGen outputs their Ke (L1) directly
+    const CpuMaterial* material = &m_tracer.Material(hit.materialID);
+    if (glm::length(material->Ke) > 0.0f) {
+        return material->Ke;
+    }
+
+    glm::vec3 L(0.0f);
+    glm::vec3 throughput(1.0f);
+    for (uint32_t bounce = 0; bounce < m_settings.maxBounces; bounce++) {
+        const glm::vec3 outgoing = -direction;
+        // Two-sided surfaces: shade the side the path arrives from
+        glm::vec3 geometricNormal = scene.GeometricNormal(hit.triangle);
+        glm::vec3 normal = glm::normalize(hit.hitNormal);
+        if (glm::dot(geometricNormal, outgoing) < 0.0f) {
+            geometricNormal = -geometricNormal;
+            normal = -normal;
+        }
+        const ShadingMaterial shading = MakeShadingMaterial(*material, hit.materialID,
+                                                            m_settings.halfPrecisionMaterials);
+
+        L += throughput * SampleLight(hit.hitPosition, normal, geometricNormal, outgoing, shading, seed, stats);
+
+        // BSDF sample, same strategy selection and samplers as the GPU
+        float pSpecular;
+        const uint32_t strategy = SelectSamplingStrategy(shading, outgoing, normal, seed, pSpecular);
+        glm::vec3 sample, sampleOrigin;
+        SampleBRDF(strategy, shading, outgoing, normal, geometricNormal, sample, sampleOrigin, hit.hitPosition,
+                   seed, false);
+        const float cosTheta = glm::dot(normal, sample);
+        if (cosTheta <= 0.0f || glm::dot(geometricNormal, sample) <= 0.0f) {
+            break;
+        }
+        const float pdf = SamplingPdf(shading, normal, -sample, outgoing);
+        if (!(pdf > 0.0f)) {
+            break;
+        }
+        throughput *= EvaluateMixedBRDF(shading, normal, -sample, outgoing) * cosTheta / pdf;
+
+        stats.rays++;
+        direction = sample;
+        hit = m_tracer.TraceRay(sampleOrigin, sample, kShadowBias, 10000.0f);
+        if (!hit.IsHit()) {
+            break;
+        }
+        material = &m_tracer.Material(hit.materialID);
+        if (glm::length(material->Ke) > 0.0f) {
+            // Emitter found by the BSDF sample: MIS against the light sample of this vertex
+            const float cosLight = std::fabs(glm::dot(scene.GeometricNormal(hit.triangle), sample));
+            const float dist = glm::length(hit.hitPosition - sampleOrigin);
+            const float pdfLight = cosLight > 0.0f ? LightPdfArea(scene, material->Ke) * dist * dist / cosLight : 0.0f;
+            L += throughput * material->Ke * (pdf / (pdf + pdfLight));
+            break;
+        }
+    }
+    return L;
+}
+
+glm::vec3 ReferenceRenderer::SampleLight(const glm::vec3& position, const glm::vec3& normal,
+                                         const glm::vec3& geometricNormal, const glm::vec3& outgoing,
+                                         const ShadingMaterial& material, glm::uvec2& seed,
+                                         ReferenceStats& stats) const {
+    const CpuScene& scene = m_tracer.Scene();
+    if (scene.emissiveTriangles.empty()) {
+        return glm::vec3(0.0f);
+    }
+
+    // Triangle and point selection of SampleLightNEE
+    const CpuLightTriangle& light = scene.emissiveTriangles[scene.SampleEmissiveTriangle(RandomFloat(seed))];
+    float xi1 = RandomFloat(seed);
+    float xi2 = RandomFloat(seed);
+    if (xi1 + xi2 > 1.0f) {
+        xi1 = 1.0f - xi1;
+        xi2 = 1.0f - xi2;
+    }
+    const glm::vec3 samplePoint = (1.0f - xi1 - xi2) * light.x + xi1 * light.y + xi2 * light.z;
+
+    const glm::vec3 toLight = samplePoint - position;
+    const float dist2 = glm::dot(toLight, toLight);
+    const float dist = std::sqrt(dist2);
+    if (!(dist > 0.0f)) {
+        return glm::vec3(0.0f);
+    }
+    const glm::vec3 wi = toLight / dist;
+    const float cosSurface = glm::dot(normal, wi);
+    // Emitters are two-sided, as the GPU flips the light normal towards the shading point
+    const float cosLight = std::fabs(glm::dot(glm::normalize(glm::cross(light.y - light.x, light.z - light.x)), wi));
+    if (cosSurface <= 0.0f || glm::dot(geometricNormal, wi) <= 0.0f || cosLight <= 0.0f) {
+        return glm::vec3(0.0f);
+    }
+
+    stats.shadowRays++;
+    if (m_tracer.Occluded(position + geometricNormal * kShadowBias, wi, 0.0f,
+                          std::max(dist - 10.0f * kShadowBias, 2.0f * kShadowBias))) {
+        return glm::vec3(0.0f);
+    }
+
+    const float pdfLight = LightPdfArea(scene, light.emission) * dist2 / cosLight;
+    const float pdfBsdf = SamplingPdf(material, normal, -wi, outgoing);
+    const glm::vec3 f = EvaluateMixedBRDF(material, normal, -wi, outgoing);
+    return f * light.emission * cosSurface * (1.0f / (pdfLight + pdfBsdf));
+}
@@ -0,0 +1,130 @@
+#ifndef PATHTRACER_REFERENCERENDERER_H
+#define PATHTRACER_REFERENCERENDERER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "../Util/ThreadPool.h"
+#include "Brdf.h"
+#include "SceneTracer.h"
+
+// Progressive CPU path tracer that produces the ground truth the ReSTIR
+// passes converge to: same scene, camera and material model (Brdf.h), but
+// plain unbiased estimation. Every vertex does one light sample (NEE) and
+// one BSDF sample, combined with the balance heuristic. Paths end on
+// emitters and at maxBounces, like the GPU paths.
+//
+// Every (pixel, sample) pair gets its own TEA stream seeded like the raygen
+// shaders, so the image does not depend on the thread count or on which
+// thread rendered which tile.
+//
+// Samples are counted per tile. Next to the accumulation the renderer keeps
+// the sum of the odd-indexed samples, so each pixel has two interleaved half
+// estimates whose difference gives the variance of its mean. RenderAdaptive
+// uses that to spend further passes only on tiles that are still noisy.
+
+struct ReferenceSettings {
+    uint32_t width = 960;
+    uint32_t height = 540;
+    // Scattering vertices after the camera; 1 = direct light only. Default:
+    // the reconnection vertex of SamplePathSimple plus its 3 bounces.
+    uint32_t maxBounces = 4;
+    uint32_t tileSize = 16;
+    // RayGen traces unjittered pixel corners; keep that to compare against its output
+    bool jitter = false;
+    // Round materials through half like MaterialOptimized
+    bool halfPrecisionMaterials = false;
+    uint32_t seed = 0;
+};
+
+struct ReferenceStats {
+    uint64_t paths = 0;
+    uint64_t rays = 0;       // closest hit queries
+    uint64_t shadowRays = 0; // any hit queries
+    double seconds = 0.0;
+};
+
+struct AdaptiveSettings {
+    uint32_t initialSamples = 8;   // uniform first pass
+    uint32_t passSamples = 4;      // added per pass to every tile above the threshold
+    float errorTarget = 0.02f;     // stop at this estimated relative RMSE of the image
+    float tileThreshold = 0.0f;    // relative tile error that still gets samples; 0 = errorTarget.
+                                   // Halved whenever no tile is above it but the image is.
+    double timeBudget = 0.0;       // seconds, 0 = none
+    uint32_t maxSamples = 16384;   // per pixel
+};
+
+struct AdaptiveStats {
+    uint32_t passes = 0;
+    uint32_t activeTiles = 0;      // tiles sampled in the last pass
+    float tileThreshold = 0.0f;    // threshold of the last pass
+    double estimatedError = 0.0;   // EstimateError() after the last pass
+    double seconds = 0.0;          // rendering and estimation, without the callback
+    bool reachedTarget = false;
+};
+
+class ReferenceRenderer {
+public:
+    ReferenceRenderer(const SceneTracer& tracer, ThreadPool& pool);
+
+    // Clears the accumulation buffer
+    void Reset(const ReferenceSettings& settings);
+
+    // Adds samplesPerPixel samples to every pixel
+    void Render(uint32_t samplesPerPixel);
+
+    // Adds samplesPerPixel samples to every pixel of the given tiles
+    void RenderTiles(const std::vector<uint32_t>& tiles, uint32_t samplesPerPixel);
+
+    // Estimated relative RMSE of Image() (RMS standard error of the pixel
+    // luminance over the mean luminance) from the two half buffers. With
+    // tileErrors, also the RMS standard error of every tile over the image
+    // mean: once every tile is below the target, the image is too.
+    double EstimateError(std::vector<float>* tileErrors = nullptr) const;
+
+    // Adds passes until EstimateError() <= errorTarget, the time budget is
+    // spent or every noisy tile has maxSamples. onPass (optional) sees the
+    // stats after every pass and can stop the run by returning false.
+    AdaptiveStats RenderAdaptive(const AdaptiveSettings& settings,
+                                 const std::function<bool(const AdaptiveStats&)>& onPass = nullptr);
+
+    // Mean radiance per pixel, linear, row-major
+    std::vector<glm::vec3> Image() const;
+    // Samples per pixel of the least sampled tile, of one tile, and in total
+    uint32_t SampleCount() const;
+    uint32_t TileSampleCount(uint32_t tile) const { return m_tileSamples[tile]; }
+    uint64_t TotalSampleCount() const;
+    const ReferenceStats& Stats() const { return m_stats; }
+    const ReferenceSettings& Settings() const { return m_settings; }
+    uint32_t TileCount() const { return m_tilesX * m_tilesY; }
+
+    // One path through the pixel, sampleIndex selects its random stream
+    glm::vec3 TracePath(uint32_t x, uint32_t y, uint32_t sampleIndex, ReferenceStats& stats) const;
+
+    // Adds sampleCount samples starting at firstSample to every pixel of one tile;
+    // the result goes to target (width * height), not the accumulation buffer.
+    // odd, if given, also receives the odd-indexed samples.
+    void RenderTile(uint32_t tile, uint32_t firstSample, uint32_t sampleCount, std::vector<glm::vec3>& target,
+                    ReferenceStats& stats, std::vector<glm::vec3>* odd = nullptr) const;
+    void TileBounds(uint32_t tile, uint32_t& x0, uint32_t& y0, uint32_t& x1, uint32_t& y1) const;
+
+private:
+    glm::vec3 SampleLight(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& geometricNormal,
+                          const glm::vec3& outgoing, const ShadingMaterial& material, glm::uvec2& seed,
+                          ReferenceStats& stats) const;
+
+    const SceneTracer& m_tracer;
+    ThreadPool& m_pool;
+    ReferenceSettings m_settings;
+    CpuCameraRays m_camera{};
+    uint32_t m_tilesX = 0;
+    uint32_t m_tilesY = 0;
+    std::vector<uint32_t> m_tileSamples;
+    std::vector<glm::vec3> m_accumulation;
+    std::vector<glm::vec3> m_oddAccumulation; // odd sample indices only
+    ReferenceStats m_stats;
+};
+
+#endif //PATHTRACER_REFERENCERENDERER_H
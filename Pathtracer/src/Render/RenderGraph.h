@@ -0,0 +1,341 @@
+#ifndef PATHTRACER_RENDERGRAPH_H
+#define PATHTRACER_RENDERGRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Barrier scheduling of the renderer's frame (Renderer::PopulateCommandList).
+// Passes declare the resources they access and in which state. Compile drops
+// passes that contribute nothing to an imported resource, puts the rest into
+// levels of mutually independent passes (declaration order decides between
+// conflicting accesses) and emits before each level only the transitions and
+// per-resource UAV barriers those accesses need, instead of a global
+// UAV(nullptr) between every dispatch. Transient resources whose lifetimes do
+// not overlap share an alias slot. The states are the graph's own, so the
+// compiler has no device dependency and is checked by tools/RenderGraph; the
+// renderer maps them to D3D12_RESOURCE_STATES.
+
+enum class GraphState : uint8_t {
+    Present,
+    UnorderedAccess,
+    ShaderResource,
+    CopySource,
+    CopyDest,
+    RenderTarget,
+};
+
+inline const char* GraphStateName(GraphState state) {
+    switch (state) {
+        case GraphState::Present: return "present";
+        case GraphState::UnorderedAccess: return "uav";
+        case GraphState::ShaderResource: return "srv";
+        case GraphState::CopySource: return "copy_source";
+        case GraphState::CopyDest: return "copy_dest";
+        case GraphState::RenderTarget: return "render_target";
+    }
+    return "?";
+}
+
+constexpr uint32_t kGraphNone = ~0u;
+
+struct GraphAccess {
+    uint32_t resource;
+    GraphState state;
+    bool write; // read-write counts as write
+};
+
+enum class GraphBarrierType : uint8_t { Transition, Uav, Aliasing };
+
+struct GraphBarrier {
+    GraphBarrierType type;
+    uint32_t resource;
+    GraphState before = GraphState::Present; // Transition only
+    GraphState after = GraphState::Present;
+    uint32_t previous = kGraphNone;          // Aliasing: last user of the memory
+};
+
+struct GraphStep {
+    uint32_t pass;
+    uint32_t level;
+    std::vector<GraphBarrier> barriers; // recorded before the pass
+};
+
+struct CompiledGraph {
+    std::vector<GraphStep> steps;
+    std::vector<GraphBarrier> finalBarriers; // after the last pass
+    std::vector<uint32_t> aliasSlot;         // per resource, kGraphNone if imported or unused
+    std::vector<uint64_t> slotBytes;
+    uint32_t levels = 0;
+    uint32_t culledPasses = 0;
+    uint64_t transientBytes = 0; // every used transient in its own memory
+    uint64_t aliasedBytes = 0;   // with the alias slots
+    std::string error;           // empty when the graph compiled
+
+    uint32_t BarrierCount(GraphBarrierType type) const {
+        uint32_t count = 0;
+        auto add = [&](const std::vector<GraphBarrier>& barriers) {
+            for (const GraphBarrier& b : barriers) {
+                count += b.type == type;
+            }
+        };
+        for (const GraphStep& step : steps) {
+            add(step.barriers);
+        }
+        add(finalBarriers);
+        return count;
+    }
+};
+
+class RenderGraph {
+public:
+    // Resource that outlives the frame, in initialState when the frame starts
+    // and returned to finalState at its end
+    uint32_t Import(std::string name, GraphState initialState, GraphState finalState) {
+        m_resources.push_back({std::move(name), true, 0, initialState, finalState});
+        return static_cast<uint32_t>(m_resources.size() - 1);
+    }
+
+    // Resource written and consumed within the frame; kept in state outside
+    // the passes that use it
+    uint32_t CreateTransient(std::string name, uint64_t bytes, GraphState state) {
+        m_resources.push_back({std::move(name), false, bytes, state, state});
+        return static_cast<uint32_t>(m_resources.size() - 1);
+    }
+
+    // A pass with side effects is never culled
+    uint32_t AddPass(std::string name, std::vector<GraphAccess> accesses, bool sideEffects = false) {
+        m_passes.push_back({std::move(name), std::move(accesses), sideEffects});
+        return static_cast<uint32_t>(m_passes.size() - 1);
+    }
+
+    uint32_t ResourceCount() const { return static_cast<uint32_t>(m_resources.size()); }
+    uint32_t PassCount() const { return static_cast<uint32_t>(m_passes.size()); }
+    const std::string& ResourceName(uint32_t resource) const { return m_resources[resource].name; }
+    const std::string& PassName(uint32_t pass) const { return m_passes[pass].name; }
+
+    CompiledGraph Compile() const {
+        CompiledGraph out;
+        const uint32_t resourceCount = ResourceCount();
+        const uint32_t passCount = PassCount();
+        out.aliasSlot.assign(resourceCount, kGraphNone);
+
+        for (uint32_t p = 0; p < passCount; p++) {
+            const std::vector<GraphAccess>& accesses = m_passes[p].accesses;
+            for (size_t i = 0; i < accesses.size(); i++) {
+                if (accesses[i].resource >= resourceCount) {
+                    return Fail(out, "pass " + m_passes[p].name + " uses an unknown resource");
+                }
+                for (size_t j = 0; j < i; j++) {
+                    if (accesses[j].resource == accesses[i].resource) {
+                        return Fail(out, "pass " + m_passes[p].name + " lists " +
+                                             m_resources[accesses[i].resource].name + " twice");
+                    }
+                }
+            }
+        }
+
+        // Culling, back to front: a pass stays if it has side effects, writes
+        // an imported resource or writes a transient a later pass reads
+        std::vector<bool> kept(passCount, false), needed(resourceCount, false);
+        for (uint32_t p = passCount; p-- > 0;) {
+            const Pass& pass = m_passes[p];
+            bool keep = pass.sideEffects;
+            for (const GraphAccess& a : pass.accesses) {
+                keep |= a.write && (m_resources[a.resource].imported || needed[a.resource]);
+            }
+            if (!keep) {
+                out.culledPasses++;
+                continue;
+            }
+            kept[p] = true;
+            for (const GraphAccess& a : pass.accesses) {
+                needed[a.resource] = true;
+            }
+        }
+
+        // Levels: one after the latest earlier pass it conflicts with, i.e.
+        // shares a resource with where either writes or the states differ
+        std::vector<uint32_t> level(passCount, 0);
+        std::vector<uint32_t> order;
+        for (uint32_t p = 0; p < passCount; p++) {
+            if (!kept[p]) {
+                continue;
+            }
+            for (uint32_t q : order) {
+                if (Conflicts(m_passes[q], m_passes[p])) {
+                    level[p] = std::max(level[p], level[q] + 1);
+                }
+            }
+            order.push_back(p);
+            out.levels = std::max(out.levels, level[p] + 1);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return level[a] < level[b]; });
+
+        // A transient has no contents at the start of the frame
+        std::vector<bool> produced(resourceCount, false);
+        for (uint32_t p : order) {
+            for (const GraphAccess& a : m_passes[p].accesses) {
+                if (!m_resources[a.resource].imported && !produced[a.resource] && !a.write) {
+                    return Fail(out, "pass " + m_passes[p].name + " reads " + m_resources[a.resource].name +
+                                         " before any pass writes it");
+                }
+                produced[a.resource] = true;
+            }
+        }
+
+        // Lifetimes of the transients in levels, and the alias slots: first
+        // fit into a slot whose last user ended before this one starts
+        std::vector<uint32_t> first(resourceCount, kGraphNone), last(resourceCount, 0);
+        for (uint32_t p : order) {
+            for (const GraphAccess& a : m_passes[p].accesses) {
+                first[a.resource] = std::min(first[a.resource], level[p]);
+                last[a.resource] = std::max(last[a.resource], level[p]);
+            }
+        }
+        std::vector<uint32_t> transients;
+        for (uint32_t r = 0; r < resourceCount; r++) {
+            if (!m_resources[r].imported && first[r] != kGraphNone) {
+                transients.push_back(r);
+            }
+        }
+        std::stable_sort(transients.begin(), transients.end(),
+                         [&](uint32_t a, uint32_t b) { return first[a] < first[b]; });
+        std::vector<uint32_t> slotUser;       // last resource placed in each slot
+        std::vector<uint32_t> previousUser(resourceCount, kGraphNone);
+        for (uint32_t r : transients) {
+            out.transientBytes += m_resources[r].bytes;
+            uint32_t slot = kGraphNone;
+            for (uint32_t s = 0; s < slotUser.size() && slot == kGraphNone; s++) {
+                if (last[slotUser[s]] < first[r]) {
+                    slot = s;
+                }
+            }
+            if (slot == kGraphNone) {
+                slot = static_cast<uint32_t>(slotUser.size());
+                slotUser.push_back(r);
+                out.slotBytes.push_back(0);
+            } else {
+                previousUser[r] = slotUser[slot];
+                slotUser[slot] = r;
+            }
+            out.aliasSlot[r] = slot;
+            out.slotBytes[slot] = std::max(out.slotBytes[slot], m_resources[r].bytes);
+        }
+        for (uint64_t bytes : out.slotBytes) {
+            out.aliasedBytes += bytes;
+        }
+
+        // Barriers, level by level against the state at the start of the level
+        std::vector<GraphState> state(resourceCount);
+        std::vector<bool> touched(resourceCount, false), written(resourceCount, false);
+        for (uint32_t r = 0; r < resourceCount; r++) {
+            state[r] = m_resources[r].initialState;
+        }
+        for (size_t begin = 0; begin < order.size();) {
+            const uint32_t lvl = level[order[begin]];
+            size_t end = begin;
+            while (end < order.size() && level[order[end]] == lvl) {
+                end++;
+            }
+
+            std::vector<GraphBarrier> barriers;
+            // Transients whose last use was the previous level go back to their state
+            for (uint32_t r : transients) {
+                if (lvl > 0 && last[r] == lvl - 1 && state[r] != m_resources[r].finalState) {
+                    barriers.push_back({GraphBarrierType::Transition, r, state[r], m_resources[r].finalState});
+                    state[r] = m_resources[r].finalState;
+                }
+            }
+            std::vector<bool> inLevel(resourceCount, false), writtenInLevel(resourceCount, false);
+            for (size_t i = begin; i < end; i++) {
+                for (const GraphAccess& a : m_passes[order[i]].accesses) {
+                    const uint32_t r = a.resource;
+                    writtenInLevel[r] = writtenInLevel[r] || a.write;
+                    if (inLevel[r]) {
+                        continue; // same state and read only, see Conflicts
+                    }
+                    inLevel[r] = true;
+                    if (!m_resources[r].imported && first[r] == lvl && previousUser[r] != kGraphNone) {
+                        barriers.push_back({GraphBarrierType::Aliasing, r, state[r], state[r], previousUser[r]});
+                    }
+                    if (state[r] != a.state) {
+                        barriers.push_back({GraphBarrierType::Transition, r, state[r], a.state});
+                    } else if (a.state == GraphState::UnorderedAccess && touched[r] &&
+                               (written[r] || LevelWrites(order, begin, end, r))) {
+                        barriers.push_back({GraphBarrierType::Uav, r});
+                    }
+                }
+            }
+            for (size_t i = begin; i < end; i++) {
+                for (const GraphAccess& a : m_passes[order[i]].accesses) {
+                    state[a.resource] = a.state;
+                    touched[a.resource] = true;
+                    written[a.resource] = writtenInLevel[a.resource];
+                }
+            }
+
+            for (size_t i = begin; i < end; i++) {
+                GraphStep step{order[i], lvl, {}};
+                if (i == begin) {
+                    step.barriers = std::move(barriers);
+                }
+                out.steps.push_back(std::move(step));
+            }
+            begin = end;
+        }
+        for (uint32_t r = 0; r < resourceCount; r++) {
+            if (state[r] != m_resources[r].finalState) {
+                out.finalBarriers.push_back({GraphBarrierType::Transition, r, state[r], m_resources[r].finalState});
+            }
+        }
+        return out;
+    }
+
+private:
+    struct Resource {
+        std::string name;
+        bool imported;
+        uint64_t bytes;
+        GraphState initialState, finalState;
+    };
+    struct Pass {
+        std::string name;
+        std::vector<GraphAccess> accesses;
+        bool sideEffects;
+    };
+
+    static bool Conflicts(const Pass& a, const Pass& b) {
+        for (const GraphAccess& x : a.accesses) {
+            for (const GraphAccess& y : b.accesses) {
+                if (x.resource == y.resource && (x.write || y.write || x.state != y.state)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool LevelWrites(const std::vector<uint32_t>& order, size_t begin, size_t end, uint32_t resource) const {
+        for (size_t i = begin; i < end; i++) {
+            for (const GraphAccess& a : m_passes[order[i]].accesses) {
+                if (a.resource == resource && a.write) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static CompiledGraph Fail(CompiledGraph& out, std::string error) {
+        out = CompiledGraph{};
+        out.error = std::move(error);
+        return out;
+    }
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+};
+
+#endif //PATHTRACER_RENDERGRAPH_H
@@ -0,0 +1,116 @@
+#ifndef PATHTRACER_RESERVOIR_H
+#define PATHTRACER_RESERVOIR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include "../../include/ReservoirLayout.h"
+#include "Rng.h"
+
+// Byte-for-byte copies of the structured buffer elements of Reservoir_v6.hlsl.
+// Structured buffers are packed with natural scalar alignment (no 16 byte
+// rows), so a CPU buffer of these can be uploaded to or read back from the
+// UAVs unchanged. Renderer.h allocates the GPU buffers with the same sizes.
+// SampleData and the reservoirs are generated from the field lists in
+// ReservoirLayout.h, like their HLSL counterparts.
+
+// half3: three IEEE binary16 values
+struct Half3 {
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint16_t z = 0;
+};
+
+inline Half3 ToHalf3(const glm::vec3& v) {
+    return {glm::packHalf1x16(v.x), glm::packHalf1x16(v.y), glm::packHalf1x16(v.z)};
+}
+
+inline glm::vec3 ToFloat3(const Half3& h) {
+    return {glm::unpackHalf1x16(h.x), glm::unpackHalf1x16(h.y), glm::unpackHalf1x16(h.z)};
+}
+
+// HLSL field types of ReservoirLayout.h
+using ReservoirCpp_float = float;
+using ReservoirCpp_float3 = glm::vec3;
+using ReservoirCpp_half3 = Half3;
+using ReservoirCpp_uint16_t = uint16_t;
+using ReservoirCpp_uint = uint32_t;
+
+#define SAMPLE_DATA_CPP_FIELD(S, name, type) ReservoirCpp_##type name{};
+#define RESERVOIR_CPP_FIELD(S, name, type, stream, offset) ReservoirCpp_##type name{};
+
+struct SampleData {
+    SAMPLE_DATA_FIELDS(SAMPLE_DATA_CPP_FIELD)
+};
+
+// RIS reservoir for direct lighting
+struct Reservoir_DI {
+    RESERVOIR_DI_FIELDS(RESERVOIR_CPP_FIELD)
+};
+
+struct Reservoir_GI {
+    RESERVOIR_GI_FIELDS(RESERVOIR_CPP_FIELD)
+};
+
+static_assert(sizeof(Half3) == 6, "half3 is 6 bytes");
+static_assert(sizeof(SampleData) == SAMPLE_DATA_BYTES && offsetof(SampleData, L1) == 14 &&
+              offsetof(SampleData, n1) == 20 && offsetof(SampleData, objID) == 44,
+              "SampleData must match ReservoirLayout.h");
+#if SAMPLE_DATA_DEBUG
+static_assert(offsetof(SampleData, debug) == SAMPLE_DATA_RELEASE_BYTES, "debug follows the release fields");
+#endif
+static_assert(sizeof(Reservoir_DI) == 40 && offsetof(Reservoir_DI, L2) == 32 && offsetof(Reservoir_DI, M) == 38,
+              "Reservoir_DI must match Reservoir_v6.hlsl");
+static_assert(sizeof(Reservoir_GI) == 40 && offsetof(Reservoir_GI, E3) == 32 && offsetof(Reservoir_GI, M) == 38,
+              "Reservoir_GI must match Reservoir_v6.hlsl");
+static_assert(sizeof(Reservoir_DI) == RESERVOIR_AOS_BYTES && sizeof(Reservoir_GI) == RESERVOIR_AOS_BYTES,
+              "RESERVOIR_AOS_BYTES must match the generated structs");
+
+// Every field fits its SoA stream, and the streams follow each other
+#define RESERVOIR_CHECK_STREAM(S, name, type, stream, offset)                                   \
+    static_assert((offset) % alignof(ReservoirCpp_##type) == 0 &&                               \
+                  (offset) + sizeof(ReservoirCpp_##type) <= RESERVOIR_STREAM_##stream##_BYTES,  \
+                  #S "::" #name " does not fit the " #stream " stream");
+RESERVOIR_DI_FIELDS(RESERVOIR_CHECK_STREAM)
+RESERVOIR_GI_FIELDS(RESERVOIR_CHECK_STREAM)
+static_assert(RESERVOIR_STREAM_NORMAL_FIRST == RESERVOIR_STREAM_POSITION_FIRST + RESERVOIR_STREAM_POSITION_BYTES &&
+              RESERVOIR_STREAM_RADIANCE_FIRST == RESERVOIR_STREAM_NORMAL_FIRST + RESERVOIR_STREAM_NORMAL_BYTES &&
+              RESERVOIR_STREAM_WEIGHT_FIRST == RESERVOIR_STREAM_RADIANCE_FIRST + RESERVOIR_STREAM_RADIANCE_BYTES &&
+              RESERVOIR_SOA_BYTES == RESERVOIR_STREAM_WEIGHT_FIRST + RESERVOIR_STREAM_WEIGHT_BYTES,
+              "SoA streams must be contiguous");
+static_assert(RESERVOIR_STREAM_POSITION_BYTES % 4 == 0 && RESERVOIR_STREAM_NORMAL_BYTES % 4 == 0 &&
+              RESERVOIR_STREAM_RADIANCE_BYTES % 4 == 0 && RESERVOIR_STREAM_WEIGHT_BYTES % 4 == 0,
+              "ByteAddressBuffer streams need 4 byte strides");
+
+// UpdateReservoir: one random number per call, whether or not the sample is taken
+inline bool UpdateReservoir(Reservoir_DI& reservoir, float wi, float M, const glm::vec3& x2, const glm::vec3& n2,
+                            const glm::vec3& L2, glm::uvec2& seed) {
+    reservoir.w_sum += wi;
+    reservoir.M += static_cast<uint16_t>(M);
+
+    if (RandomFloat(seed) < wi / reservoir.w_sum) {
+        reservoir.x2 = x2;
+        reservoir.n2 = n2;
+        reservoir.L2 = ToHalf3(L2);
+        return true;
+    }
+    return false;
+}
+
+inline bool UpdateReservoir_GI(Reservoir_GI& reservoir, float wi, float M, const glm::vec3& xn,
+                               const glm::vec3& nn, const glm::vec3& E3, glm::uvec2& seed) {
+    reservoir.w_sum += wi;
+    reservoir.M = static_cast<uint16_t>(static_cast<float>(reservoir.M) + M);
+
+    if (RandomFloat(seed) < wi / reservoir.w_sum) {
+        reservoir.xn = xn;
+        reservoir.nn = nn;
+        reservoir.E3 = ToHalf3(E3);
+        return true;
+    }
+    return false;
+}
+
+#endif //PATHTRACER_RESERVOIR_H
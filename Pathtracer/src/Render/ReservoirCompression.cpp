@@ -0,0 +1,189 @@
+#include "ReservoirCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+uint32_t AsUint(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+float AsFloat(uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// 2^e for integer e in the normal float range, exact
+float Pow2(int e) {
+    return AsFloat(static_cast<uint32_t>(e + 127) << 23);
+}
+
+float Saturate(float x) {
+    return std::min(std::max(x, 0.0f), 1.0f);
+}
+
+} // namespace
+
+uint32_t PackOctahedral(const glm::vec3& n, uint32_t bits) {
+    const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.0f) {
+        return 0;
+    }
+    glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+    if (n.z < 0.0f) {
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    const uint32_t maxq = (1u << bits) - 1;
+    uint32_t qx = static_cast<uint32_t>(std::floor(Saturate(p.x * 0.5f + 0.5f) * static_cast<float>(maxq) + 0.5f));
+    uint32_t qy = static_cast<uint32_t>(std::floor(Saturate(p.y * 0.5f + 0.5f) * static_cast<float>(maxq) + 0.5f));
+    // (0, 0) and (max, max) are both -z, keep 0 for the zero vector
+    if (qx == 0 && qy == 0) {
+        qx = maxq;
+        qy = maxq;
+    }
+    return qx | (qy << bits);
+}
+
+glm::vec3 UnpackOctahedral(uint32_t code, uint32_t bits) {
+    if (code == 0) {
+        return glm::vec3(0.0f);
+    }
+    const uint32_t maxq = (1u << bits) - 1;
+    const glm::vec2 p = glm::vec2(static_cast<float>(code & maxq), static_cast<float>((code >> bits) & maxq)) *
+                            (2.0f / static_cast<float>(maxq)) - 1.0f;
+    glm::vec3 n(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+    const float t = Saturate(-n.z);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+uint32_t PackRGB9E5(const glm::vec3& color) {
+    const glm::vec3 c = glm::clamp(color, 0.0f, PACKED_RGB9E5_MAX);
+    const float maxc = std::max(c.x, std::max(c.y, c.z));
+    // floor(log2(maxc)) from the exponent bits, no log2 rounding
+    const int log2Max = static_cast<int>((AsUint(maxc) >> 23) & 0xFF) - 127;
+    int e = std::max(-PACKED_RGB9E5_EXPONENT_BIAS - 1, log2Max) + 1 + PACKED_RGB9E5_EXPONENT_BIAS;
+    float scale = Pow2(PACKED_RGB9E5_EXPONENT_BIAS + PACKED_RGB9E5_MANTISSA_BITS - e);
+    if (std::floor(maxc * scale + 0.5f) == static_cast<float>(1 << PACKED_RGB9E5_MANTISSA_BITS)) {
+        e++;
+        scale *= 0.5f;
+    }
+    const uint32_t mx = static_cast<uint32_t>(std::floor(c.x * scale + 0.5f));
+    const uint32_t my = static_cast<uint32_t>(std::floor(c.y * scale + 0.5f));
+    const uint32_t mz = static_cast<uint32_t>(std::floor(c.z * scale + 0.5f));
+    return mx | (my << 9) | (mz << 18) | (static_cast<uint32_t>(e) << 27);
+}
+
+glm::vec3 UnpackRGB9E5(uint32_t v) {
+    const int e = static_cast<int>(v >> 27);
+    const float scale = Pow2(e - PACKED_RGB9E5_EXPONENT_BIAS - PACKED_RGB9E5_MANTISSA_BITS);
+    return glm::vec3(static_cast<float>(v & 0x1FF), static_cast<float>((v >> 9) & 0x1FF),
+                     static_cast<float>((v >> 18) & 0x1FF)) * scale;
+}
+
+uint32_t PackNormalM(const glm::vec3& n, uint32_t M) {
+    return PackOctahedral(n, PACKED_RESERVOIR_OCT_BITS) |
+           (std::min(M, static_cast<uint32_t>(PACKED_M_MAX)) << (2 * PACKED_RESERVOIR_OCT_BITS));
+}
+
+glm::vec3 UnpackNormal(uint32_t normalM) {
+    return UnpackOctahedral(normalM & ((1u << (2 * PACKED_RESERVOIR_OCT_BITS)) - 1), PACKED_RESERVOIR_OCT_BITS);
+}
+
+uint32_t UnpackM(uint32_t normalM) {
+    return normalM >> (2 * PACKED_RESERVOIR_OCT_BITS);
+}
+
+// w_sum: the float bits rounded to 5 mantissa bits and rebiased to a 5 bit
+// exponent, clamped so that a positive w_sum never becomes 0
+uint32_t PackWeights(float W, float w_sum) {
+    const uint32_t wBits = AsUint(W > 0.0f ? W : 0.0f);
+    const uint32_t wKept = (wBits + (1u << (PACKED_W_DROPPED_BITS - 1))) >> PACKED_W_DROPPED_BITS;
+    uint32_t sum = 0;
+    if (w_sum > 0.0f) {
+        int s = static_cast<int>((AsUint(w_sum) + (1u << (PACKED_W_SUM_DROPPED_BITS - 1))) >> PACKED_W_SUM_DROPPED_BITS);
+        s -= (127 - PACKED_W_SUM_EXPONENT_BIAS) << 5;
+        sum = static_cast<uint32_t>(std::clamp(s, 1 << 5, (1 << PACKED_W_SUM_BITS) - 1));
+    }
+    return (wKept << PACKED_W_SUM_BITS) | sum;
+}
+
+float UnpackW(uint32_t weights) {
+    return AsFloat((weights >> PACKED_W_SUM_BITS) << PACKED_W_DROPPED_BITS);
+}
+
+float UnpackWsum(uint32_t weights) {
+    const uint32_t sum = weights & ((1u << PACKED_W_SUM_BITS) - 1);
+    if (sum == 0) {
+        return 0.0f;
+    }
+    return AsFloat((sum + ((127 - PACKED_W_SUM_EXPONENT_BIAS) << 5)) << PACKED_W_SUM_DROPPED_BITS);
+}
+
+PackedReservoir PackReservoir_DI(const Reservoir_DI& r) {
+    PackedReservoir p;
+    p.x = r.x2;
+    p.normalM = PackNormalM(r.n2, r.M);
+    p.radiance = PackRGB9E5(ToFloat3(r.L2));
+    p.weights = PackWeights(r.W, r.w_sum);
+    return p;
+}
+
+Reservoir_DI UnpackReservoir_DI(const PackedReservoir& p) {
+    Reservoir_DI r;
+    r.x2 = p.x;
+    r.n2 = UnpackNormal(p.normalM);
+    r.L2 = ToHalf3(UnpackRGB9E5(p.radiance));
+    r.w_sum = UnpackWsum(p.weights);
+    r.W = UnpackW(p.weights);
+    r.M = static_cast<uint16_t>(UnpackM(p.normalM));
+    return r;
+}
+
+PackedReservoir PackReservoir_GI(const Reservoir_GI& r) {
+    PackedReservoir p;
+    p.x = r.xn;
+    p.normalM = PackNormalM(r.nn, r.M);
+    p.radiance = PackRGB9E5(ToFloat3(r.E3));
+    p.weights = PackWeights(r.W, r.w_sum);
+    return p;
+}
+
+Reservoir_GI UnpackReservoir_GI(const PackedReservoir& p) {
+    Reservoir_GI r;
+    r.xn = p.x;
+    r.nn = UnpackNormal(p.normalM);
+    r.E3 = ToHalf3(UnpackRGB9E5(p.radiance));
+    r.w_sum = UnpackWsum(p.weights);
+    r.W = UnpackW(p.weights);
+    r.M = static_cast<uint16_t>(UnpackM(p.normalM));
+    return r;
+}
+
+PackedSampleData PackSampleData(const SampleData& s) {
+    PackedSampleData p;
+    p.x1 = s.x1;
+    p.n1 = PackOctahedral(s.n1, PACKED_OCT_BITS);
+    p.o = PackOctahedral(s.o, PACKED_OCT_BITS);
+    p.L1 = PackRGB9E5(ToFloat3(s.L1));
+    p.objID = s.objID;
+    p.mID = s.mID;
+    return p;
+}
+
+SampleData UnpackSampleData(const PackedSampleData& p) {
+    SampleData s;
+    s.x1 = p.x1;
+    s.mID = static_cast<uint16_t>(p.mID);
+    s.L1 = ToHalf3(UnpackRGB9E5(p.L1));
+    s.n1 = UnpackOctahedral(p.n1, PACKED_OCT_BITS);
+    s.o = UnpackOctahedral(p.o, PACKED_OCT_BITS);
+    s.objID = p.objID;
+    return s;
+}
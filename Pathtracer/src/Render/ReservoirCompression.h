@@ -0,0 +1,48 @@
+#ifndef PATHTRACER_RESERVOIRCOMPRESSION_H
+#define PATHTRACER_RESERVOIRCOMPRESSION_H
+
+#include <cstdint>
+
+#include "../../include/ReservoirPacking.h"
+#include "Reservoir.h"
+
+// C++ version of the packed encoding of Compression_v7.hlsl, same bits.
+
+struct PackedReservoir {
+    glm::vec3 x = glm::vec3(0.0f); // x2 / xn
+    uint32_t normalM = 0;          // octahedral normal | M
+    uint32_t radiance = 0;         // RGB9E5
+    uint32_t weights = 0;          // W high bits | w_sum
+};
+
+struct PackedSampleData {
+    glm::vec3 x1 = glm::vec3(0.0f);
+    uint32_t n1 = 0; // octahedral
+    uint32_t o = 0;  // octahedral
+    uint32_t L1 = 0; // RGB9E5
+    uint32_t objID = 0;
+    uint32_t mID = 0;
+};
+
+static_assert(sizeof(PackedReservoir) == PACKED_RESERVOIR_BYTES, "PackedReservoir must match Compression_v7.hlsl");
+static_assert(sizeof(PackedSampleData) == PACKED_SAMPLE_BYTES, "PackedSampleData must match Compression_v7.hlsl");
+
+uint32_t PackOctahedral(const glm::vec3& n, uint32_t bits);
+glm::vec3 UnpackOctahedral(uint32_t code, uint32_t bits);
+uint32_t PackRGB9E5(const glm::vec3& c);
+glm::vec3 UnpackRGB9E5(uint32_t v);
+uint32_t PackNormalM(const glm::vec3& n, uint32_t M);
+glm::vec3 UnpackNormal(uint32_t normalM);
+uint32_t UnpackM(uint32_t normalM);
+uint32_t PackWeights(float W, float w_sum);
+float UnpackW(uint32_t weights);
+float UnpackWsum(uint32_t weights);
+
+PackedReservoir PackReservoir_DI(const Reservoir_DI& r);
+Reservoir_DI UnpackReservoir_DI(const PackedReservoir& p);
+PackedReservoir PackReservoir_GI(const Reservoir_GI& r);
+Reservoir_GI UnpackReservoir_GI(const PackedReservoir& p);
+PackedSampleData PackSampleData(const SampleData& s);
+SampleData UnpackSampleData(const PackedSampleData& p);
+
+#endif //PATHTRACER_RESERVOIRCOMPRESSION_H
@@ -0,0 +1,122 @@
+#ifndef PATHTRACER_RESERVOIRSTORAGE_H
+#define PATHTRACER_RESERVOIRSTORAGE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Reservoir.h"
+
+// CPU copy of a GPU reservoir buffer in either layout of ReservoirLayout.h,
+// byte for byte, with the accessors the shaders use (LoadReservoir_DI_M and
+// friends). The storage picks its layout at runtime so both can be measured
+// in one binary; the accessors take a ReservoirView with the layout as a
+// template argument, fixed at compile time like in the shaders. The CPU
+// passes keep plain std::vector<Reservoir_*>.
+
+enum class ReservoirLayout : uint32_t {
+    AoS = RESERVOIR_LAYOUT_AOS,
+    SoA = RESERVOIR_LAYOUT_SOA,
+};
+
+constexpr uint32_t ReservoirElementBytes(ReservoirLayout layout) {
+    return layout == ReservoirLayout::SoA ? RESERVOIR_SOA_BYTES : RESERVOIR_AOS_BYTES;
+}
+
+// Passed by value like the HLSL buffer handle
+template <ReservoirLayout L>
+struct ReservoirView {
+    uint8_t* data = nullptr;
+    uint32_t count = 0;
+
+    // Address of a field: aosOffset inside the struct, or streamOffset inside its stream
+    size_t Address(size_t aosOffset, uint32_t streamFirst, uint32_t streamBytes, uint32_t streamOffset,
+                   uint32_t index) const {
+        if constexpr (L == ReservoirLayout::AoS) {
+            return static_cast<size_t>(index) * RESERVOIR_AOS_BYTES + aosOffset;
+        } else {
+            return static_cast<size_t>(streamFirst) * count + static_cast<size_t>(index) * streamBytes +
+                   streamOffset;
+        }
+    }
+
+    template <typename T>
+    T Load(size_t address) const {
+        T value;
+        std::memcpy(&value, data + address, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void Store(size_t address, const T& value) const {
+        std::memcpy(data + address, &value, sizeof(T));
+    }
+};
+
+class ReservoirStorage {
+public:
+    void Resize(ReservoirLayout layout, uint32_t count) {
+        m_layout = layout;
+        m_count = count;
+        m_bytes.assign(static_cast<size_t>(count) * ReservoirElementBytes(layout), 0);
+    }
+
+    ReservoirLayout Layout() const { return m_layout; }
+    uint32_t Count() const { return m_count; }
+    size_t Bytes() const { return m_bytes.size(); }
+
+    template <ReservoirLayout L>
+    ReservoirView<L> View() {
+        assert(L == m_layout);
+        return {m_bytes.data(), m_count};
+    }
+
+private:
+    ReservoirLayout m_layout = ReservoirLayout::AoS;
+    uint32_t m_count = 0;
+    std::vector<uint8_t> m_bytes;
+};
+
+#define RESERVOIR_STORAGE_FIELD_ACCESSORS(S, name, type, stream, offset)                                \
+    template <ReservoirLayout L>                                                                        \
+    ReservoirCpp_##type Load##S##_##name(ReservoirView<L> buffer, uint32_t index) {                     \
+        return buffer.template Load<ReservoirCpp_##type>(                                               \
+            buffer.Address(offsetof(S, name), RESERVOIR_STREAM_##stream##_FIRST,                        \
+                           RESERVOIR_STREAM_##stream##_BYTES, offset, index));                          \
+    }                                                                                                   \
+    template <ReservoirLayout L>                                                                        \
+    void Store##S##_##name(ReservoirView<L> buffer, uint32_t index, const ReservoirCpp_##type& value) { \
+        buffer.Store(buffer.Address(offsetof(S, name), RESERVOIR_STREAM_##stream##_FIRST,               \
+                                    RESERVOIR_STREAM_##stream##_BYTES, offset, index), value);          \
+    }
+
+// Aggregate init: filling a local member by member makes GCC assemble it on
+// the stack and reload it with wider loads, which stalls store forwarding
+#define RESERVOIR_STORAGE_LOAD_MEMBER(S, name, type, stream, offset) Load##S##_##name(buffer, index),
+#define RESERVOIR_STORAGE_STORE_MEMBER(S, name, type, stream, offset) Store##S##_##name(buffer, index, r.name);
+
+#define RESERVOIR_STORAGE_ACCESSORS(S, FIELDS)                                                \
+    FIELDS(RESERVOIR_STORAGE_FIELD_ACCESSORS)                                                 \
+    template <ReservoirLayout L>                                                              \
+    S Load##S(ReservoirView<L> buffer, uint32_t index) {                                      \
+        if constexpr (L == ReservoirLayout::AoS) {                                            \
+            return buffer.template Load<S>(static_cast<size_t>(index) * RESERVOIR_AOS_BYTES); \
+        } else {                                                                              \
+            return S{FIELDS(RESERVOIR_STORAGE_LOAD_MEMBER)};                                  \
+        }                                                                                     \
+    }                                                                                         \
+    template <ReservoirLayout L>                                                              \
+    void Store##S(ReservoirView<L> buffer, uint32_t index, const S& r) {                      \
+        if constexpr (L == ReservoirLayout::AoS) {                                            \
+            buffer.Store(static_cast<size_t>(index) * RESERVOIR_AOS_BYTES, r);                \
+        } else {                                                                              \
+            FIELDS(RESERVOIR_STORAGE_STORE_MEMBER)                                            \
+        }                                                                                     \
+    }
+
+RESERVOIR_STORAGE_ACCESSORS(Reservoir_DI, RESERVOIR_DI_FIELDS)
+RESERVOIR_STORAGE_ACCESSORS(Reservoir_GI, RESERVOIR_GI_FIELDS)
+
+#endif //PATHTRACER_RESERVOIRSTORAGE_H
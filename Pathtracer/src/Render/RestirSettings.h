@@ -0,0 +1,26 @@
+#ifndef PATHTRACER_RESTIRSETTINGS_H
+#define PATHTRACER_RESTIRSETTINGS_H
+
+#include <cstdint>
+
+// Tuning #defines of Common_v6.hlsl as runtime values, defaults as shipped.
+// RestirDefines (ShaderPermutation.h) turns them back into -D arguments.
+struct RestirSettings {
+    uint32_t neeSamples = 4;    // nee_samples, per GI path vertex
+    uint32_t neeSamplesDI = 4;  // nee_samples_DI, light candidates of SampleRIS
+    uint32_t bsdfSamplesDI = 1; // bsdf_samples_DI, BSDF candidates of SampleRIS
+    uint32_t bounces = 3;
+    uint32_t temporalMCap = 16;       // temporal_M_cap
+    uint32_t temporalMCapGI = 16;     // temporal_M_cap_GI
+    float wSumThreshold = 5.0f;       // w_sum_threshold, RejectWsum of the GI reuse
+    float distanceThreshold = 0.1f;   // RejectDistance literal of the reuse passes
+    uint32_t spatialCandidateCount = 3; // spatial_candidate_count
+    uint32_t spatialMaxTries = 9;       // spatial_max_tries
+    uint32_t spatialRadius = 20;        // spatial_radius, pixels
+    float spatialExponent = 1.0f;       // spatial_exponent
+    uint32_t spatialMCap = 128;         // spatial_M_cap
+    uint32_t spatialMCapGI = 128;       // spatial_M_cap_GI
+    float jacobianThreshold = 5.0f;     // j_threshold
+};
+
+#endif //PATHTRACER_RESTIRSETTINGS_H
@@ -0,0 +1,147 @@
+#ifndef PATHTRACER_RNG_H
+#define PATHTRACER_RNG_H
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+
+// C++ port of RandomFloat and the per-pixel seeding of the raygen shaders
+// (Common_v6.hlsl / Pass_init_di_v7.hlsl). Same integer operations in the
+// same order, so a seed produces the same sequence as on the GPU.
+
+// 4 rounds of TEA over (seed.x, seed.y); returns v0 / 2^32
+inline float RandomFloat(glm::uvec2& seed) {
+    uint32_t v0 = seed.x;
+    uint32_t v1 = seed.y;
+    uint32_t sum = 0u;
+    const uint32_t delta = 0x9e3779b9u;
+
+    for (uint32_t i = 0u; i < 4u; i++) {
+        sum += delta;
+        v0 += ((v1 << 4u) + 0xA341316Cu) ^ (v1 + sum) ^ ((v1 >> 5u) + 0xC8013EA4u);
+        v1 += ((v0 << 4u) + 0xAD90777Du) ^ (v0 + sum) ^ ((v0 >> 5u) + 0x7E95761Eu);
+    }
+
+    seed.x = v0;
+    seed.y = v1;
+
+    // float(v0) rounds to nearest, so the top 128 values return exactly 1.0 like on the GPU
+    return static_cast<float>(v0) / 4294967296.0f;
+}
+
+// seed of a pixel for a given pass (1 = init pass, 2 = temporal/shading pass) and frame time
+inline glm::uvec2 SeedPixel(uint32_t x, uint32_t y, uint32_t pass, uint32_t time) {
+    constexpr uint32_t prime1_x = 73856093u;
+    constexpr uint32_t prime2_x = 19349663u;
+    constexpr uint32_t prime3_x = 83492791u;
+    constexpr uint32_t prime1_y = 37623481u;
+    constexpr uint32_t prime2_y = 51964263u;
+    constexpr uint32_t prime3_y = 68250729u;
+    constexpr uint32_t prime_time_x = 293803u;
+    constexpr uint32_t prime_time_y = 423977u;
+
+    glm::uvec2 seed;
+    seed.x = y * prime1_x ^ x * prime2_x ^ pass * prime3_x ^ time * prime_time_x;
+    seed.y = x * prime1_y ^ y * prime2_y ^ pass * prime3_y ^ time * prime_time_y;
+    return seed;
+}
+
+// Eight independent seeds, lane i usually pixel (x + i, y). Struct of arrays
+// so a lane group loads as one AVX2 register or two SSE2 registers.
+struct alignas(32) SeedLanes8 {
+    uint32_t x[8];
+    uint32_t y[8];
+};
+
+// SeedPixel for pixels (x0 + i, y), i = 0..7
+inline void SeedPixels8(uint32_t x0, uint32_t y, uint32_t pass, uint32_t time, SeedLanes8& seeds) {
+    for (uint32_t i = 0; i < 8; i++) {
+        const glm::uvec2 seed = SeedPixel(x0 + i, y, pass, time);
+        seeds.x[i] = seed.x;
+        seeds.y[i] = seed.y;
+    }
+}
+
+// RandomFloat on all eight lanes; out[i] is bit-identical to RandomFloat on
+// lane i alone. AVX2 when the compiler targets it, SSE2 on any other x86-64
+// build, scalar elsewhere. The uint -> float conversion adds the exactly
+// representable high and low halves, so it rounds once, like the scalar cast.
+inline void RandomFloat8(SeedLanes8& seeds, float out[8]) {
+#if defined(__AVX2__)
+    __m256i v0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(seeds.x));
+    __m256i v1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(seeds.y));
+    __m256i sum = _mm256_setzero_si256();
+    const __m256i delta = _mm256_set1_epi32(static_cast<int>(0x9e3779b9u));
+    const __m256i k0 = _mm256_set1_epi32(static_cast<int>(0xA341316Cu));
+    const __m256i k1 = _mm256_set1_epi32(static_cast<int>(0xC8013EA4u));
+    const __m256i k2 = _mm256_set1_epi32(static_cast<int>(0xAD90777Du));
+    const __m256i k3 = _mm256_set1_epi32(static_cast<int>(0x7E95761Eu));
+    for (int i = 0; i < 4; i++) {
+        sum = _mm256_add_epi32(sum, delta);
+        v0 = _mm256_add_epi32(v0, _mm256_xor_si256(_mm256_xor_si256(
+                 _mm256_add_epi32(_mm256_slli_epi32(v1, 4), k0), _mm256_add_epi32(v1, sum)),
+                 _mm256_add_epi32(_mm256_srli_epi32(v1, 5), k1)));
+        v1 = _mm256_add_epi32(v1, _mm256_xor_si256(_mm256_xor_si256(
+                 _mm256_add_epi32(_mm256_slli_epi32(v0, 4), k2), _mm256_add_epi32(v0, sum)),
+                 _mm256_add_epi32(_mm256_srli_epi32(v0, 5), k3)));
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(seeds.x), v0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(seeds.y), v1);
+
+    const __m256 hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(v0, 16)), _mm256_set1_ps(65536.0f));
+    const __m256 lo = _mm256_cvtepi32_ps(_mm256_and_si256(v0, _mm256_set1_epi32(0xFFFF)));
+    _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_add_ps(hi, lo), _mm256_set1_ps(1.0f / 4294967296.0f)));
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (int half = 0; half < 8; half += 4) {
+        __m128i v0 = _mm_load_si128(reinterpret_cast<const __m128i*>(seeds.x + half));
+        __m128i v1 = _mm_load_si128(reinterpret_cast<const __m128i*>(seeds.y + half));
+        __m128i sum = _mm_setzero_si128();
+        const __m128i delta = _mm_set1_epi32(static_cast<int>(0x9e3779b9u));
+        const __m128i k0 = _mm_set1_epi32(static_cast<int>(0xA341316Cu));
+        const __m128i k1 = _mm_set1_epi32(static_cast<int>(0xC8013EA4u));
+        const __m128i k2 = _mm_set1_epi32(static_cast<int>(0xAD90777Du));
+        const __m128i k3 = _mm_set1_epi32(static_cast<int>(0x7E95761Eu));
+        for (int i = 0; i < 4; i++) {
+            sum = _mm_add_epi32(sum, delta);
+            v0 = _mm_add_epi32(v0, _mm_xor_si128(_mm_xor_si128(
+                     _mm_add_epi32(_mm_slli_epi32(v1, 4), k0), _mm_add_epi32(v1, sum)),
+                     _mm_add_epi32(_mm_srli_epi32(v1, 5), k1)));
+            v1 = _mm_add_epi32(v1, _mm_xor_si128(_mm_xor_si128(
+                     _mm_add_epi32(_mm_slli_epi32(v0, 4), k2), _mm_add_epi32(v0, sum)),
+                     _mm_add_epi32(_mm_srli_epi32(v0, 5), k3)));
+        }
+        _mm_store_si128(reinterpret_cast<__m128i*>(seeds.x + half), v0);
+        _mm_store_si128(reinterpret_cast<__m128i*>(seeds.y + half), v1);
+
+        const __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v0, 16)), _mm_set1_ps(65536.0f));
+        const __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(v0, _mm_set1_epi32(0xFFFF)));
+        _mm_storeu_ps(out + half, _mm_mul_ps(_mm_add_ps(hi, lo), _mm_set1_ps(1.0f / 4294967296.0f)));
+    }
+#else
+    for (int i = 0; i < 8; i++) {
+        glm::uvec2 seed(seeds.x[i], seeds.y[i]);
+        out[i] = RandomFloat(seed);
+        seeds.x[i] = seed.x;
+        seeds.y[i] = seed.y;
+    }
+#endif
+}
+
+// Instruction set RandomFloat8 was compiled for
+inline const char* RandomFloat8Isa() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+#endif //PATHTRACER_RNG_H
@@ -0,0 +1,645 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// HLSL max: a NaN operand yields the other operand
+float ShaderMax(float a, float b) {
+    return std::isnan(a) ? b : (std::isnan(b) ? a : std::max(a, b));
+}
+
+bool IsNanOrInf(float v) {
+    return !std::isfinite(v);
+}
+
+bool IsFinite(const glm::vec3& v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+// Binary search of SampleLightNEE over the light cdf
+const CpuLightTriangle& PickLight(const CpuScene& scene, glm::uvec2& seed) {
+    return scene.emissiveTriangles[scene.SampleEmissiveTriangle(RandomFloat(seed))];
+}
+
+// Barycentric point of SampleLightNEE / SampleLightNEE_GI (two random numbers)
+glm::vec3 SampleLightPoint(const CpuLightTriangle& light, glm::uvec2& seed) {
+    float xi1 = RandomFloat(seed);
+    float xi2 = RandomFloat(seed);
+    if (xi1 + xi2 > 1.0f) {
+        xi1 = 1.0f - xi1;
+        xi2 = 1.0f - xi2;
+    }
+    const float u = 1.0f - xi1 - xi2;
+    const float v = xi1;
+    const float w = xi2;
+    return u * light.x + v * light.y + w * light.z;
+}
+
+// Mixed BRDF and (unscaled) mixed pdf towards -incidence, the block every sampler repeats
+void MixedLobes(const ShadingMaterial& material, const glm::vec3& normal, const glm::vec3& incidence,
+                const glm::vec3& outgoing, float pdfScale, glm::vec3& brdf, float& pdf) {
+    const glm::vec2 probs = CalculateStrategyProbabilities(material, glm::normalize(outgoing), normal);
+    const glm::vec3 brdf0 = EvaluateBRDF(0, material, normal, incidence, glm::normalize(outgoing));
+    const glm::vec3 brdf1 = EvaluateBRDF(1, material, normal, incidence, glm::normalize(outgoing));
+    const float pdf0 = BRDF_PDF(0, material, normal, incidence, outgoing) * pdfScale;
+    const float pdf1 = BRDF_PDF(1, material, normal, incidence, outgoing) * pdfScale;
+    brdf = SafeMultiply(probs.x, brdf0) + SafeMultiply(probs.y, brdf1);
+    pdf = SafeMultiply(probs.x, pdf0) + SafeMultiply(probs.y, pdf1);
+}
+
+// Light sample for RIS; pdf_light in area measure, pdf_bsdf converted to area measure
+void SampleLightNEE(const SceneTracer& tracer, float& pdf_light, float& pdf_bsdf, glm::vec3& incoming,
+                    float& p_hat, glm::uvec2& seed, const glm::vec3& worldOrigin, const glm::vec3& normal,
+                    const glm::vec3& outgoing, const ShadingMaterial& material, glm::vec3& emission,
+                    glm::vec3& x2, glm::vec3& n2, bool useVisibility) {
+    const CpuScene& scene = tracer.Scene();
+    const CpuLightTriangle& sampleLight = PickLight(scene, seed);
+    const glm::vec3 samplePoint = SampleLightPoint(sampleLight, seed);
+    x2 = samplePoint;
+
+    const glm::vec3 L = samplePoint - worldOrigin;
+    const float dist2 = glm::dot(L, L);
+    const float dist = std::sqrt(ShaderMax(dist2, kShaderEpsilon));
+    const glm::vec3 L_norm = glm::normalize(L);
+
+    const glm::vec3 cross_l = glm::cross(sampleLight.y - sampleLight.x, sampleLight.z - sampleLight.x);
+    glm::vec3 normal_l = glm::normalize(cross_l);
+    if (glm::dot(normal_l, -L_norm) < 0.0f) {
+        normal_l = -normal_l;
+    }
+    n2 = normal_l;
+
+    const float area_l = std::fabs(glm::length(cross_l) * 0.5f);
+    const float pdf_l = sampleLight.weight / ShaderMax(area_l, kShaderEpsilon);
+
+    const float cos_theta_x = glm::dot(normal, L_norm);
+    const float cos_theta_y = glm::dot(normal_l, -L_norm);
+
+    // Floored, so candidates behind the surface keep a tiny non-zero target
+    const float G = ShaderMax(cos_theta_y * cos_theta_x / dist2, kShaderEpsilon);
+    emission = sampleLight.emission;
+
+    glm::vec3 brdf_light;
+    float P;
+    MixedLobes(material, normal, -L_norm, outgoing, cos_theta_y / dist2, brdf_light, P);
+
+    float V = 1.0f;
+    if (useVisibility) {
+        V = tracer.Occluded(worldOrigin + kShadowBias * normal, L_norm, 0.0f, dist - kShadowBias * 2.0f) ? 0.0f
+                                                                                                            : 1.0f;
+    }
+
+    p_hat = LinearizeVector(sampleLight.emission * brdf_light * G * V);
+    pdf_light = ShaderMax(kShaderEpsilon, pdf_l);
+    pdf_bsdf = P;
+    incoming = -L_norm;
+}
+
+// BSDF sample for RIS; only emitters hit by the ray give a non-zero target
+void SampleLightBSDF(const SceneTracer& tracer, float& pdf_light, float& pdf_bsdf, glm::vec3& incoming,
+                     float& p_hat, glm::uvec2& seed, const glm::vec3& worldOrigin, const glm::vec3& normal,
+                     const glm::vec3& outgoing, const ShadingMaterial& material, uint32_t strategy,
+                     glm::vec3& emission, glm::vec3& x2, glm::vec3& n2) {
+    glm::vec3 sample, origin;
+    SampleBRDF(strategy, material, outgoing, normal, normal, sample, origin, worldOrigin, seed);
+
+    const CpuHitInfo samplePayload = tracer.TraceRay(worldOrigin, sample, kShadowBias, 10000.0f);
+
+    const CpuMaterial& material_ke = tracer.Material(samplePayload.materialID);
+    const float Ke = material_ke.Ke.x + material_ke.Ke.y + material_ke.Ke.z;
+    emission = material_ke.Ke;
+    x2 = samplePayload.hitPosition;
+    n2 = samplePayload.hitNormal;
+
+    if (Ke > kShaderEpsilon) {
+        const glm::vec3 L = samplePayload.hitPosition - worldOrigin;
+        const float dist = glm::length(L);
+        const float dist2 = dist * dist;
+        const float cos_theta = glm::dot(samplePayload.hitNormal, -sample);
+
+        pdf_light = (Ke / 3.0f) / tracer.Scene().emissiveTriangles[0].totalWeight;
+        incoming = -sample;
+
+        glm::vec3 brdf;
+        MixedLobes(material, normal, -sample, outgoing, cos_theta / dist2, brdf, pdf_bsdf);
+
+        const float ndot = glm::dot(normal, sample);
+        p_hat = LinearizeVector(brdf * material_ke.Ke * ndot * cos_theta / dist2);
+    } else {
+        p_hat = 0.0f;
+    }
+}
+
+// Light sample of a GI path vertex; both pdfs in solid angle measure
+glm::vec3 SampleLightNEE_GI(const SceneTracer& tracer, float& pdf_light, float& pdf_bsdf, glm::vec3& incoming,
+                            glm::vec3& x2_pos, glm::uvec2& seed, const glm::vec3& origin,
+                            const glm::vec3& normal, const glm::vec3& outgoing, glm::vec3 acc_l, float acc_pdf,
+                            glm::vec3& throughput, float& pdf, glm::vec3& emission,
+                            const ShadingMaterial& material, bool useVisibility) {
+    const CpuScene& scene = tracer.Scene();
+    const CpuLightTriangle& sampleLight = PickLight(scene, seed);
+    const glm::vec3 samplePoint = SampleLightPoint(sampleLight, seed);
+    x2_pos = samplePoint;
+
+    const glm::vec3 L = samplePoint - origin;
+    const float dist2 = glm::dot(L, L);
+    const float dist = std::sqrt(ShaderMax(dist2, kShaderEpsilon));
+    const glm::vec3 L_norm = glm::normalize(L);
+
+    const glm::vec3 cross_l = glm::cross(sampleLight.y - sampleLight.x, sampleLight.z - sampleLight.x);
+    glm::vec3 normal_l = glm::normalize(cross_l);
+    if (glm::dot(normal_l, -L_norm) < 0.0f) {
+        normal_l = -normal_l;
+    }
+
+    const float area_l = std::fabs(glm::length(cross_l) * 0.5f);
+    const float pdf_l = sampleLight.weight / ShaderMax(area_l, kShaderEpsilon);
+
+    float cos_theta_x = std::fabs(glm::dot(normal, L_norm));
+    if (cos_theta_x < kShaderEpsilon) {
+        cos_theta_x = 0.0f;
+    }
+    float cos_theta_y = std::fabs(glm::dot(normal_l, -L_norm));
+    if (cos_theta_y < kShaderEpsilon) {
+        cos_theta_y = 0.0f;
+    }
+
+    const float G = cos_theta_x;
+    const glm::vec3 emission_l = sampleLight.emission;
+
+    glm::vec3 brdf_light;
+    float P;
+    MixedLobes(material, normal, -L_norm, outgoing, 1.0f, brdf_light, P);
+
+    float V = 1.0f;
+    if (useVisibility) {
+        V = tracer.Occluded(origin + kShadowBias * glm::normalize(normal), L_norm, 0.5f * kShadowBias,
+                            ShaderMax(kShadowBias, dist - kShadowBias * 5.0f))
+                ? 0.0f
+                : 1.0f;
+    }
+    // pdf_light keeps its input value for grazing light samples
+    if (cos_theta_y > 0.0f) {
+        pdf_light = ShaderMax(kShaderEpsilon, pdf_l) * dist2 / cos_theta_y;
+    }
+    pdf_bsdf = P;
+    incoming = -L_norm;
+
+    acc_pdf *= pdf_light;
+    acc_l *= brdf_light * G * V;
+
+    throughput = brdf_light * G * V;
+    pdf = pdf_light;
+    emission = emission_l;
+
+    if (acc_pdf > 0.0f) {
+        return emission_l * acc_l / acc_pdf;
+    }
+    return glm::vec3(0.0f);
+}
+
+// BSDF sample of a GI path vertex; advances the path (acc_l, acc_pdf, new_*) when no emitter is hit
+glm::vec3 SampleLightBSDF_GI(const SceneTracer& tracer, float& pdf_light, float& pdf_bsdf, glm::vec3& incoming,
+                             glm::vec3& new_origin, glm::vec3& new_normal, glm::vec3& new_outgoing,
+                             ShadingMaterial& new_material, glm::uvec2& seed, uint32_t strategy,
+                             const glm::vec3& origin, const glm::vec3& normal, const glm::vec3& outgoing,
+                             glm::vec3& acc_l, float& acc_pdf, glm::vec3& throughput, float& pdf,
+                             glm::vec3& emission, const ShadingMaterial& material) {
+    glm::vec3 sample, adjustedOrigin;
+    SampleBRDF(strategy, material, outgoing, normal, normal, sample, adjustedOrigin, origin, seed);
+
+    const CpuHitInfo samplePayload = tracer.TraceRay(origin, sample, kShadowBias, 10000.0f);
+    ShadingMaterial mat_ke = MakeShadingMaterial(tracer.Material(samplePayload.materialID),
+                                                 samplePayload.materialID, true);
+
+    glm::vec3 brdf;
+    float P;
+    MixedLobes(material, normal, -sample, outgoing, 1.0f, brdf, P);
+    pdf_bsdf = P;
+    const float NdotL = glm::dot(normal, sample);
+
+    incoming = -sample;
+    acc_pdf *= pdf_bsdf;
+    acc_l *= brdf * NdotL;
+    throughput = brdf * NdotL;
+    pdf = pdf_bsdf;
+
+    if (glm::length(mat_ke.Ke) > 0.0f) {
+        // Emitter hit: treat as a light sample
+        const glm::vec3 L = samplePayload.hitPosition - origin;
+        const float dist = glm::length(L);
+        const float dist2 = dist * dist;
+        const float cos_theta = glm::dot(samplePayload.hitNormal, -sample);
+
+        pdf_light = (((mat_ke.Ke.x + mat_ke.Ke.y + mat_ke.Ke.z) / 3.0f) /
+                     tracer.Scene().emissiveTriangles[0].totalWeight) * dist2 / cos_theta;
+        emission = mat_ke.Ke;
+        return mat_ke.Ke * acc_l / acc_pdf;
+    }
+
+    new_origin = samplePayload.hitPosition;
+    new_normal = samplePayload.hitNormal;
+    new_outgoing = -sample;
+    new_material = mat_ke;
+    emission = glm::vec3(0.0f);
+    return glm::vec3(0.0f);
+}
+
+} // namespace
+
+static_assert(PIXEL_MAPPING != PIXEL_MAPPING_MORTON || (PIXEL_TILE_SIZE & (PIXEL_TILE_SIZE - 1)) == 0,
+              "Morton tiles must be a power of two");
+
+uint32_t MapPixelID(const glm::uvec2& dims, const glm::uvec2& index) {
+    return PixelIndex(PIXEL_MAPPING, PIXEL_TILE_SIZE, dims.x, index.x, index.y);
+}
+
+uint32_t MapGiPixelID(uint32_t giResolution, const glm::uvec2& dims, const glm::uvec2& index) {
+    return GiPixelIndex(giResolution, dims.x, index.x, index.y);
+}
+
+glm::uvec2 GiOwner(uint32_t giResolution, const glm::uvec2& pixel) {
+    return glm::uvec2(GiOwnerX(giResolution, pixel.x, pixel.y), GiOwnerY(giResolution, pixel.y));
+}
+
+float LinearizeVector(const glm::vec3& v) {
+    return glm::length(v);
+}
+
+bool IsValidReservoir(const Reservoir_DI& r) {
+    return glm::length(r.n2) > 0.0f && glm::length(ToFloat3(r.L2)) > 0.0f && r.w_sum > 0.0f && r.M > 0;
+}
+
+bool IsValidReservoir_GI(const Reservoir_GI& r) {
+    return r.w_sum > 0.0f && r.M > 0;
+}
+
+bool RejectDistance(const glm::vec3& x1, const glm::vec3& x2, const glm::vec3& camPos, float threshold) {
+    const float d1 = glm::length(x1 - camPos);
+    const float d2 = glm::length(x2 - camPos);
+    const float relativeDifference = std::abs(d1 - d2) / ShaderMax(d1, d2);
+    return relativeDifference > threshold;
+}
+
+bool RejectWsum(float w_sum, float threshold) {
+    return w_sum > threshold;
+}
+
+bool RejectNormal(const glm::vec3& n1, const glm::vec3& n2, float threshold) {
+    return glm::dot(n1, n2) < threshold;
+}
+
+bool RejectBelowSurface(const glm::vec3& d, const glm::vec3& n) {
+    return glm::dot(d, n) < 0.0f;
+}
+
+bool RejectJacobian(float J, float threshold) {
+    return J > threshold || J < 1.0f / threshold || std::isnan(J) || std::isinf(J);
+}
+
+glm::uvec2 GetRandomPixelCircleWeightedXY(uint32_t radius, float exponent, uint32_t w, uint32_t h, uint32_t x,
+                                          uint32_t y, glm::uvec2& seed) {
+    const int width = static_cast<int>(w);
+    const int height = static_cast<int>(h);
+    int newX, newY;
+    do {
+        const float u = RandomFloat(seed);
+        const float z = std::pow(u, exponent);
+        const float r = static_cast<float>(radius) * z;
+        const float angle = RandomFloat(seed) * 6.2831853f;
+        newX = static_cast<int>(x) + static_cast<int>(std::cos(angle) * r);
+        newY = static_cast<int>(y) + static_cast<int>(std::sin(angle) * r);
+
+        while (newX < 0 || newX >= width) {
+            newX = newX < 0 ? -newX : 2 * width - newX - 2;
+        }
+        while (newY < 0 || newY >= height) {
+            newY = newY < 0 ? -newY : 2 * height - newY - 2;
+        }
+    } while (newX == static_cast<int>(x) && newY == static_cast<int>(y));
+
+    return glm::uvec2(newX, newY);
+}
+
+uint32_t GetRandomPixelCircleWeighted(uint32_t radius, float exponent, uint32_t w, uint32_t h, uint32_t x,
+                                      uint32_t y, glm::uvec2& seed) {
+    return MapPixelID(glm::uvec2(w, h), GetRandomPixelCircleWeightedXY(radius, exponent, w, h, x, y, seed));
+}
+
+float Jacobian_Reconnection(const SampleData& sdata_r, const SampleData& sdata_q, const glm::vec3& x2q,
+                            const glm::vec3& n2q) {
+    const glm::vec3 vq = x2q - sdata_q.x1;
+    const glm::vec3 vr = x2q - sdata_r.x1;
+    const float cosPhi2q = std::abs(glm::dot(glm::normalize(-vq), glm::normalize(n2q)));
+    const float cosPhi2r = std::abs(glm::dot(glm::normalize(-vr), glm::normalize(n2q)));
+    const float len2_vq = glm::dot(vq, vq);
+    const float len2_vr = glm::dot(vr, vr);
+    return (cosPhi2q / cosPhi2r) * (len2_vr / len2_vq);
+}
+
+ShadingMaterial LoadMaterial(const SceneTracer& tracer, uint32_t materialID) {
+    if (materialID == kMissMaterialID) {
+        return MissMaterial();
+    }
+    return MakeShadingMaterial(tracer.Material(materialID), materialID, true);
+}
+
+float VisibilityCheck(const SceneTracer& tracer, const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& dir,
+                      float dist) {
+    const bool isHit = tracer.Occluded(x1 + glm::normalize(n1) * kShadowBias, dir, 0.0f,
+                                       ShaderMax(dist - 10.0f * kShadowBias, 2.0f * kShadowBias));
+    return isHit ? 0.0f : 1.0f;
+}
+
+glm::vec3 ReconnectDI(const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2, glm::vec3 n2,
+                      const glm::vec3& L, const glm::vec3& outgoing, const ShadingMaterial& material) {
+    const glm::vec3 dir = x2 - x1;
+    const float dist = glm::length(dir);
+
+    const float cosThetaX1 = ShaderMax(0.0f, glm::dot(n1, glm::normalize(dir)));
+    if (glm::dot(n2, glm::normalize(-dir)) < 0.0f) {
+        n2 = -n2;
+    }
+    const float cosThetaX2 = ShaderMax(0.0f, glm::dot(n2, glm::normalize(-dir)));
+
+    glm::vec3 F;
+    float unused;
+    MixedLobes(material, n1, glm::normalize(-dir), outgoing, 1.0f, F, unused);
+    return F * L * cosThetaX1 * cosThetaX2 / (dist * dist);
+}
+
+glm::vec3 ReconnectGI(const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2, const glm::vec3& /*n2*/,
+                      const glm::vec3& L, const glm::vec3& outgoing, const ShadingMaterial& material1) {
+    const glm::vec3 dir = x2 - x1;
+    const float cosThetaX1 = std::fabs(glm::dot(n1, glm::normalize(dir)));
+
+    glm::vec3 Fx1;
+    float unused;
+    MixedLobes(material1, n1, glm::normalize(-dir), outgoing, 1.0f, Fx1, unused);
+
+    const glm::vec3 fr = Fx1 * cosThetaX1 * L;
+    return IsFinite(fr) ? fr : glm::vec3(0.0f);
+}
+
+float GetP_Hat(const SceneTracer& tracer, const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2,
+               const glm::vec3& n2, const glm::vec3& L2, const glm::vec3& o, const ShadingMaterial& matOpt,
+               bool useVisibility) {
+    const float f_g = LinearizeVector(ReconnectDI(x1, n1, x2, n2, L2, o, matOpt));
+    float v = 1.0f;
+    if (useVisibility) {
+        v = VisibilityCheck(tracer, x1, n1, glm::normalize(x2 - x1), glm::length(x2 - x1));
+    }
+    return f_g * v;
+}
+
+glm::vec3 GetP_Hat_GI(const SceneTracer& tracer, const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2,
+                      const glm::vec3& n2, const glm::vec3& L2, const glm::vec3& o,
+                      const ShadingMaterial& matOpt1, bool useVisibility) {
+    const glm::vec3 f_g = ReconnectGI(x1, n1, x2, n2, L2, o, matOpt1);
+    float v = 1.0f;
+    if (useVisibility) {
+        v = VisibilityCheck(tracer, x1, n1, glm::normalize(x2 - x1), glm::length(x2 - x1));
+    }
+    return f_g * v;
+}
+
+float GetW(const Reservoir_DI& r, float p_hat) {
+    return p_hat > kShaderEpsilon ? r.w_sum / p_hat : 0.0f;
+}
+
+float GetW_GI(const Reservoir_GI& r, float p_hat) {
+    return p_hat > kShaderEpsilon ? r.w_sum / p_hat : 0.0f;
+}
+
+void SampleRIS(const SceneTracer& tracer, uint32_t M1, uint32_t M2, const glm::vec3& outgoing,
+               Reservoir_DI& reservoir, const CpuHitInfo& payload, const ShadingMaterial& matOpt,
+               glm::uvec2& seed) {
+    float p_strategy = 1.0f;
+    const uint32_t strategy = SelectSamplingStrategy(matOpt, outgoing, payload.hitNormal, seed, p_strategy);
+    const float m1 = static_cast<float>(M1);
+    const float m2 = static_cast<float>(M2);
+
+    for (uint32_t i = 0; i < M1; i++) {
+        float pdf_light = 0.0f;
+        float pdf_bsdf = 0.0f;
+        glm::vec3 incoming, emission, x2, n2;
+        float p_hat;
+        SampleLightNEE(tracer, pdf_light, pdf_bsdf, incoming, p_hat, seed, payload.hitPosition, payload.hitNormal,
+                       outgoing, matOpt, emission, x2, n2, false);
+
+        const float mi = pdf_light / (m1 * pdf_light + m2 * pdf_bsdf);
+        const float wi = mi * p_hat / pdf_light;
+        if (p_hat > 0.0f) {
+            UpdateReservoir(reservoir, wi, 0.0f, x2, n2, emission, seed);
+        }
+    }
+
+    for (uint32_t j = 0; j < M2; j++) {
+        float pdf_light = 0.0f;
+        float pdf_bsdf = 0.0f;
+        glm::vec3 incoming, emission, x2, n2;
+        float p_hat;
+        SampleLightBSDF(tracer, pdf_light, pdf_bsdf, incoming, p_hat, seed, payload.hitPosition, payload.hitNormal,
+                        outgoing, matOpt, strategy, emission, x2, n2);
+
+        const float mi = pdf_bsdf / (m1 * pdf_light + m2 * pdf_bsdf);
+        const float wi = mi * p_hat / pdf_bsdf;
+        if (p_hat > 0.0f) {
+            UpdateReservoir(reservoir, wi, 0.0f, x2, n2, emission, seed);
+        }
+    }
+    // Canonical weight
+    reservoir.M = 1;
+}
+
+glm::vec3 SamplePathSimple(const SceneTracer& tracer, const RestirSettings& settings, Reservoir_GI& reservoir,
+                           const glm::vec3& initPoint, const glm::vec3& initNormal, const glm::vec3& initOutgoing,
+                           const ShadingMaterial& initMaterial, glm::uvec2& seed) {
+    glm::vec3 acc_f(1.0f);              // throughput up to the current vertex
+    glm::vec3 acc_f_reconnection(1.0f); // throughput from the reconnection vertex
+    float acc_pdf = 1.0f;
+
+    glm::vec3 x1_shadow(0.0f);
+    glm::vec3 x2_shadow(0.0f);
+    glm::vec3 acc_L(0.0f);
+
+    glm::vec3 origin = initPoint;
+    glm::vec3 normal = initNormal;
+    glm::vec3 outgoing = glm::normalize(initOutgoing);
+    ShadingMaterial material = initMaterial;
+
+    // 1) First bounce: finds the reconnection vertex
+    {
+        float p_strategy;
+        const uint32_t strategy = SelectSamplingStrategy(material, outgoing, normal, seed, p_strategy);
+        glm::vec3 sample, adjustedOrigin;
+        SampleBRDF(strategy, material, outgoing, normal, normal, sample, adjustedOrigin, origin, seed);
+
+        const CpuHitInfo samplePayload = tracer.TraceRay(origin, sample, kShadowBias, 10000.0f);
+        const CpuMaterial& hitMaterial = tracer.Material(samplePayload.materialID);
+        if (glm::length(hitMaterial.Ke) > 0.0f) {
+            // Direct light hit: no GI sample for this pixel
+            return glm::vec3(0.0f);
+        }
+
+        const glm::vec3 incoming = glm::normalize(-sample);
+        glm::vec3 F;
+        float P;
+        MixedLobes(material, normal, incoming, outgoing, 1.0f, F, P);
+        const float NdotL = glm::dot(normal, sample);
+
+        acc_pdf *= P;
+        acc_f *= F * NdotL;
+
+        outgoing = incoming;
+        material = MakeShadingMaterial(hitMaterial, samplePayload.materialID, true);
+        normal = samplePayload.hitNormal;
+        origin = samplePayload.hitPosition;
+    }
+
+    // 2) Reconnection vertex
+    const glm::vec3 xn = origin;
+    const glm::vec3 nn = glm::normalize(normal);
+    const float neeSamples = static_cast<float>(settings.neeSamples);
+
+    // 3) Bounces with MIS-weighted NEE and BSDF sampling
+    for (uint32_t i = 0; i < settings.bounces; i++) {
+        float p_strategy = 1.0f;
+        uint32_t strategy = SelectSamplingStrategy(material, outgoing, normal, seed, p_strategy);
+
+        for (uint32_t j = 0; j < settings.neeSamples; j++) {
+            float pdf_light = 1.0f;
+            float pdf_bsdf = 1.0f;
+            glm::vec3 throughput_NEE(1.0f);
+            float pdf_NEE = 1.0f;
+            glm::vec3 emission_NEE(0.0f);
+            glm::vec3 incoming_NEE, x2;
+
+            const glm::vec3 contribution = SampleLightNEE_GI(
+                tracer, pdf_light, pdf_bsdf, incoming_NEE, x2, seed, origin, normal, outgoing, acc_f, acc_pdf,
+                throughput_NEE, pdf_NEE, emission_NEE, material, false);
+
+            const float mi = pdf_light / (neeSamples * pdf_light + pdf_bsdf);
+            const glm::vec3 E_reconnection = acc_f_reconnection * mi * emission_NEE * throughput_NEE;
+            const glm::vec3 E_path = mi * contribution;
+
+            float wi = LinearizeVector(E_path);
+            acc_L += mi * contribution;
+            if (IsNanOrInf(wi)) {
+                wi = 0.0f;
+            }
+
+            if (UpdateReservoir_GI(reservoir, wi, 0.0f, xn, glm::normalize(nn), E_reconnection, seed)) {
+                x1_shadow = origin + kShadowBias * glm::normalize(normal);
+                x2_shadow = x2;
+            }
+        }
+
+        float pdf_light = 1.0f;
+        float pdf_bsdf = 1.0f;
+        glm::vec3 throughput_BSDF(1.0f);
+        float pdf_BSDF = 1.0f;
+        glm::vec3 emission_BSDF(0.0f);
+        glm::vec3 incoming_BSDF, new_origin, new_normal, new_outgoing;
+        ShadingMaterial new_material;
+
+        strategy = SelectSamplingStrategy(material, outgoing, normal, seed, p_strategy);
+        const glm::vec3 contribution = SampleLightBSDF_GI(
+            tracer, pdf_light, pdf_bsdf, incoming_BSDF, new_origin, new_normal, new_outgoing, new_material, seed,
+            strategy, origin, normal, outgoing, acc_f, acc_pdf, throughput_BSDF, pdf_BSDF, emission_BSDF, material);
+
+        acc_f_reconnection *= throughput_BSDF;
+
+        if (glm::length(contribution) > 0.0f) {
+            const float mi = pdf_bsdf / (neeSamples * pdf_light + pdf_bsdf);
+            const glm::vec3 E_reconnection = acc_f_reconnection * mi * emission_BSDF;
+            const glm::vec3 E_path = mi * contribution;
+
+            float wi = LinearizeVector(E_path);
+            acc_L += E_path;
+            if (IsNanOrInf(wi)) {
+                wi = 0.0f;
+            }
+            UpdateReservoir_GI(reservoir, wi, 0.0f, xn, glm::normalize(nn), E_reconnection, seed);
+            break;
+        }
+        origin = new_origin;
+        material = new_material;
+        outgoing = new_outgoing;
+        normal = new_normal;
+    }
+
+    // Visibility of the selected NEE sample, tested once for the whole reservoir
+    if (settings.neeSamples > 0 && glm::length(x2_shadow - x1_shadow) > kShaderEpsilon) {
+        const float dist = glm::length(x2_shadow - x1_shadow);
+        const bool isHit = tracer.Occluded(x1_shadow, glm::normalize(x2_shadow - x1_shadow), 0.5f * kShadowBias,
+                                           ShaderMax(kShadowBias, dist - kShadowBias * 5.0f));
+        reservoir.w_sum *= isHit ? 0.0f : 1.0f;
+    }
+    return acc_L;
+}
+
+glm::vec2 GetLastFramePixelCoordinates_Float(const glm::vec3& worldPos, const glm::mat4& prevView,
+                                             const glm::mat4& prevProjection, const glm::vec2& resolution) {
+    const glm::vec4 clipPos = prevProjection * (prevView * glm::vec4(worldPos, 1.0f));
+    if (clipPos.w <= 0.0f) {
+        return glm::vec2(-1.0f, -1.0f);
+    }
+
+    const glm::vec2 ndc = glm::vec2(clipPos) / clipPos.w;
+    glm::vec2 screenUV = ndc * 0.5f + 0.5f;
+    screenUV.y = 1.0f - screenUV.y;
+    return screenUV * resolution;
+}
+
+glm::ivec2 GetBestReprojectedPixel_d(const glm::vec3& worldPos, const glm::mat4& prevView,
+                                     const glm::mat4& prevProjection, const glm::vec2& resolution) {
+    const glm::vec2 subPixelCoord = GetLastFramePixelCoordinates_Float(worldPos, prevView, prevProjection, resolution);
+    // HLSL round: halves away from zero
+    return glm::ivec2(static_cast<int>(std::round(subPixelCoord.x)), static_cast<int>(std::round(subPixelCoord.y)));
+}
+
+BilinearResult GetBestReprojectedPixelBilinear_CenterBased(const glm::vec3& worldPos, const glm::mat4& prevView,
+                                                           const glm::mat4& prevProjection,
+                                                           const glm::vec2& resolution) {
+    BilinearResult result;
+    for (int i = 0; i < 4; i++) {
+        result.coords[i] = glm::ivec2(-1, -1);
+        result.distances[i] = -1.0f;
+        result.weights[i] = 0.0f;
+    }
+
+    const glm::vec2 subPixelCoord = GetLastFramePixelCoordinates_Float(worldPos, prevView, prevProjection, resolution);
+    if (subPixelCoord.x < 0.0f || subPixelCoord.y < 0.0f || subPixelCoord.x >= resolution.x ||
+        subPixelCoord.y >= resolution.y) {
+        return result;
+    }
+
+    const int maxX = static_cast<int>(resolution.x) - 1;
+    const int maxY = static_cast<int>(resolution.y) - 1;
+    glm::ivec2 basePixel(static_cast<int>(std::floor(subPixelCoord.x)), static_cast<int>(std::floor(subPixelCoord.y)));
+    basePixel.x = glm::clamp(basePixel.x, 0, maxX);
+    basePixel.y = glm::clamp(basePixel.y, 0, maxY);
+
+    const glm::ivec2 nextX(std::min(basePixel.x + 1, maxX), basePixel.y);
+    const glm::ivec2 nextY(basePixel.x, std::min(basePixel.y + 1, maxY));
+    const glm::ivec2 nextXY(nextX.x, nextY.y);
+
+    const float fracX = glm::clamp(subPixelCoord.x - static_cast<float>(basePixel.x), 0.0f, 1.0f);
+    const float fracY = glm::clamp(subPixelCoord.y - static_cast<float>(basePixel.y), 0.0f, 1.0f);
+
+    result.coords[0] = basePixel;
+    result.coords[1] = nextX;
+    result.coords[2] = nextY;
+    result.coords[3] = nextXY;
+    for (int i = 0; i < 4; i++) {
+        result.distances[i] = glm::distance(subPixelCoord, glm::vec2(result.coords[i]));
+    }
+    result.weights[0] = (1.0f - fracX) * (1.0f - fracY);
+    result.weights[1] = fracX * (1.0f - fracY);
+    result.weights[2] = (1.0f - fracX) * fracY;
+    result.weights[3] = fracX * fracY;
+    return result;
+}
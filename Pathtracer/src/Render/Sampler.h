@@ -0,0 +1,104 @@
+#ifndef PATHTRACER_SAMPLER_H
+#define PATHTRACER_SAMPLER_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include "../../include/GiResolution.h"
+#include "../../include/PixelMapping.h"
+#include "Brdf.h"
+#include "Reservoir.h"
+#include "RestirSettings.h"
+#include "SceneTracer.h"
+
+// C++ port of the ReSTIR sampling code of Sampler_v6.hlsl and
+// Path_Sampler_v6.hlsl (Sampler_v7 / Path_Sampler_v7 are the same code).
+// Every function keeps the shader's arithmetic, including its quirks, and
+// draws random numbers in the same order, so a CPU pass fed the same seeds
+// makes the same decisions as the GPU up to floating point differences.
+// TraceRay goes through a SceneTracer.
+
+// Pixel -> buffer index of Common_v6.hlsl, scheme of PixelMapping.h
+uint32_t MapPixelID(const glm::uvec2& dims, const glm::uvec2& index);
+// Pixel -> GI reservoir index of a pixel that owns one (MapGiPixelID), for a
+// GI_RESOLUTION_* mode of GiResolution.h
+uint32_t MapGiPixelID(uint32_t giResolution, const glm::uvec2& dims, const glm::uvec2& index);
+// The owner standing in for a pixel in GI reuse (GiOwner)
+glm::uvec2 GiOwner(uint32_t giResolution, const glm::uvec2& pixel);
+
+float LinearizeVector(const glm::vec3& v);
+bool IsValidReservoir(const Reservoir_DI& r);
+bool IsValidReservoir_GI(const Reservoir_GI& r);
+
+// Candidate tests of Common_v6.hlsl
+bool RejectDistance(const glm::vec3& x1, const glm::vec3& x2, const glm::vec3& camPos, float threshold);
+bool RejectWsum(float w_sum, float threshold);
+bool RejectNormal(const glm::vec3& n1, const glm::vec3& n2, float threshold);
+bool RejectBelowSurface(const glm::vec3& d, const glm::vec3& n);
+bool RejectJacobian(float J, float threshold);
+
+// Random neighbor of (x, y) within radius, r = radius * u^exponent, mirrored
+// into the image, never the pixel itself; returns its MapPixelID index.
+// Two random numbers per attempt.
+uint32_t GetRandomPixelCircleWeighted(uint32_t radius, float exponent, uint32_t w, uint32_t h, uint32_t x,
+                                      uint32_t y, glm::uvec2& seed);
+// The same neighbor as pixel coordinates
+glm::uvec2 GetRandomPixelCircleWeightedXY(uint32_t radius, float exponent, uint32_t w, uint32_t h, uint32_t x,
+                                          uint32_t y, glm::uvec2& seed);
+
+// Solid angle Jacobian of moving the reconnection vertex (x2q, n2q) of pixel q to pixel r
+float Jacobian_Reconnection(const SampleData& sdata_r, const SampleData& sdata_q, const glm::vec3& x2q,
+                            const glm::vec3& n2q);
+
+// MaterialOptimized of materials[mID], or g_DefaultMissMaterial for the miss ID
+ShadingMaterial LoadMaterial(const SceneTracer& tracer, uint32_t materialID);
+
+float VisibilityCheck(const SceneTracer& tracer, const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& dir,
+                      float dist);
+glm::vec3 ReconnectDI(const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2, glm::vec3 n2,
+                      const glm::vec3& L, const glm::vec3& outgoing, const ShadingMaterial& material);
+glm::vec3 ReconnectGI(const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2, const glm::vec3& n2,
+                      const glm::vec3& L, const glm::vec3& outgoing, const ShadingMaterial& material1);
+float GetP_Hat(const SceneTracer& tracer, const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2,
+               const glm::vec3& n2, const glm::vec3& L2, const glm::vec3& o, const ShadingMaterial& matOpt,
+               bool useVisibility);
+glm::vec3 GetP_Hat_GI(const SceneTracer& tracer, const glm::vec3& x1, const glm::vec3& n1, const glm::vec3& x2,
+                      const glm::vec3& n2, const glm::vec3& L2, const glm::vec3& o,
+                      const ShadingMaterial& matOpt1, bool useVisibility);
+float GetW(const Reservoir_DI& r, float p_hat);
+float GetW_GI(const Reservoir_GI& r, float p_hat);
+
+// RIS over M1 light (NEE, no visibility) and M2 BSDF candidates at the
+// payload's hit point; sets reservoir.M to 1
+void SampleRIS(const SceneTracer& tracer, uint32_t M1, uint32_t M2, const glm::vec3& outgoing,
+               Reservoir_DI& reservoir, const CpuHitInfo& payload, const ShadingMaterial& matOpt,
+               glm::uvec2& seed);
+
+// BSDF path from the primary hit; fills the GI reservoir with the first
+// bounce as reconnection vertex and returns the path's radiance estimate
+glm::vec3 SamplePathSimple(const SceneTracer& tracer, const RestirSettings& settings, Reservoir_GI& reservoir,
+                           const glm::vec3& initPoint, const glm::vec3& initNormal, const glm::vec3& initOutgoing,
+                           const ShadingMaterial& initMaterial, glm::uvec2& seed);
+
+// Sub-pixel position of worldPos in the previous frame, (-1, -1) behind the
+// camera. The CPU scene is static, so the instance transforms of the shader
+// version (objectToWorldInverse / prevObjectToWorld) are the identity.
+glm::vec2 GetLastFramePixelCoordinates_Float(const glm::vec3& worldPos, const glm::mat4& prevView,
+                                             const glm::mat4& prevProjection, const glm::vec2& resolution);
+
+// Nearest previous pixel (round), what RayGen2 uses
+glm::ivec2 GetBestReprojectedPixel_d(const glm::vec3& worldPos, const glm::mat4& prevView,
+                                     const glm::mat4& prevProjection, const glm::vec2& resolution);
+
+struct BilinearResult {
+    glm::ivec2 coords[4];  // (-1, -1) when off-screen
+    float distances[4];    // from the sub-pixel position
+    float weights[4];      // bilinear, sum to ~1
+};
+
+// The four previous pixels around the reprojected position, pixel centers at integer coordinates
+BilinearResult GetBestReprojectedPixelBilinear_CenterBased(const glm::vec3& worldPos, const glm::mat4& prevView,
+                                                           const glm::mat4& prevProjection,
+                                                           const glm::vec2& resolution);
+
+#endif //PATHTRACER_SAMPLER_H
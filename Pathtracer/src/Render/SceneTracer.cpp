@@ -0,0 +1,59 @@
+#include "SceneTracer.h"
+
+#include <cmath>
+
+namespace {
+
+CpuMaterial ZeroMaterial() {
+    CpuMaterial material;
+    material.Kd = glm::vec4(0.0f);
+    material.Ks = glm::vec3(0.0f);
+    material.Ni = 0.0f;
+    return material;
+}
+
+} // namespace
+
+CpuHitInfo SceneTracer::TraceRay(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax,
+                                 BvhTraversalStats* stats) const {
+    BvhRay ray;
+    ray.origin = origin;
+    ray.direction = direction;
+    ray.tMin = tMin;
+    ray.tMax = tMax;
+
+    BvhHit hit;
+    CpuHitInfo payload;
+    if (!m_bvh.Intersect(ray, hit, stats)) {
+        return payload;
+    }
+
+    const uint32_t tri = hit.triangle;
+    const glm::vec3& p0 = m_scene.positions[m_scene.indices[3 * tri + 0]];
+    const glm::vec3& p1 = m_scene.positions[m_scene.indices[3 * tri + 1]];
+    const glm::vec3& p2 = m_scene.positions[m_scene.indices[3 * tri + 2]];
+
+    payload.hitPosition = origin + hit.t * direction; // WorldRayOrigin() + RayTCurrent() * WorldRayDirection()
+    payload.materialID = m_scene.triangleMaterial[tri];
+    payload.hitNormal = m_scene.ShadingNormal(tri, hit.u, hit.v);
+    payload.area = std::fabs(glm::length(glm::cross(p1 - p0, p2 - p0)) * 0.5f);
+    payload.objID = m_scene.triangleInstance[tri];
+    payload.triangle = tri;
+    payload.t = hit.t;
+    return payload;
+}
+
+bool SceneTracer::Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax,
+                           BvhTraversalStats* stats) const {
+    BvhRay ray;
+    ray.origin = origin;
+    ray.direction = direction;
+    ray.tMin = tMin;
+    ray.tMax = tMax;
+    return m_bvh.Occluded(ray, stats);
+}
+
+const CpuMaterial& SceneTracer::Material(uint32_t materialID) const {
+    static const CpuMaterial zero = ZeroMaterial();
+    return materialID < m_scene.materials.size() ? m_scene.materials[materialID] : zero;
+}
@@ -0,0 +1,51 @@
+#ifndef PATHTRACER_SCENETRACER_H
+#define PATHTRACER_SCENETRACER_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include "../Accel/Bvh.h"
+#include "../Scene/CpuScene.h"
+
+// TraceRay for the CPU passes: closest hit and shadow queries against a Bvh
+// over a CpuScene, returning what ClosestHit / Miss in Hit_v6.hlsl and
+// Miss_v6.hlsl write into the payload.
+
+constexpr uint32_t kMissMaterialID = 4294967294u; // Miss_v6.hlsl
+
+// HitInfo payload of Common_v6.hlsl
+struct CpuHitInfo {
+    glm::vec3 hitPosition = glm::vec3(0.0f);
+    uint32_t materialID = kMissMaterialID;
+    glm::vec3 hitNormal = glm::vec3(0.0f); // interpolated shading normal
+    float area = 0.0f;
+    uint32_t objID = 0;
+    // Not part of the GPU payload
+    uint32_t triangle = kBvhInvalidTriangle;
+    float t = 0.0f;
+
+    bool IsHit() const { return materialID != kMissMaterialID; }
+};
+
+class SceneTracer {
+public:
+    SceneTracer(const CpuScene& scene, const Bvh& bvh) : m_scene(scene), m_bvh(bvh) {}
+
+    CpuHitInfo TraceRay(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax,
+                        BvhTraversalStats* stats = nullptr) const;
+    // ShadowHitInfo.isHit
+    bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax,
+                  BvhTraversalStats* stats = nullptr) const;
+
+    // materials[mID]; out-of-range reads (the miss ID) return zeros like a D3D structured buffer
+    const CpuMaterial& Material(uint32_t materialID) const;
+
+    const CpuScene& Scene() const { return m_scene; }
+    const Bvh& Accel() const { return m_bvh; }
+
+private:
+    const CpuScene& m_scene;
+    const Bvh& m_bvh;
+};
+
+#endif //PATHTRACER_SCENETRACER_H
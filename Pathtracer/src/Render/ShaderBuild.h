@@ -0,0 +1,119 @@
+#ifndef PATHTRACER_SHADERBUILD_H
+#define PATHTRACER_SHADERBUILD_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Util/ThreadPool.h"
+
+// Compiles the ray tracing libraries of the pipeline as jobs on a thread pool
+// (nv_helpers_dx12::CompileShaderLibraries). Compiler objects are not thread
+// safe, so each pool thread creates its own on its first job and keeps it
+// for the rest of the build. A failing job does not stop the others: all
+// results come back in job order, the errors can be reported together, and
+// the caller assembles the pipeline only from a build without failures. The
+// report holds the wall time of the build and the summed time of the jobs,
+// an estimate of compiling them one after another. No compiler calls, so
+// scheduling and error collection are checked by tools/ShaderBuild.
+
+struct ShaderBuildOutput {
+    bool ok = false;
+    bool cached = false; // loaded from the shader cache, not compiled
+    std::string error;
+};
+
+struct ShaderBuildResult {
+    std::string name;
+    ShaderBuildOutput output;
+    double milliseconds = 0.0;
+    uint32_t thread = 0;
+};
+
+struct ShaderBuildReport {
+    std::vector<ShaderBuildResult> results; // in job order
+    uint32_t threads = 0;                   // of the pool
+    uint32_t compilers = 0;                 // compiler instances created
+    double wallMilliseconds = 0.0;
+    double jobMilliseconds = 0.0;           // sum over the jobs
+
+    uint32_t Failed() const {
+        uint32_t failed = 0;
+        for (const ShaderBuildResult& result : results) {
+            failed += result.output.ok ? 0 : 1;
+        }
+        return failed;
+    }
+
+    uint32_t Cached() const {
+        uint32_t cached = 0;
+        for (const ShaderBuildResult& result : results) {
+            cached += result.output.ok && result.output.cached ? 1 : 0;
+        }
+        return cached;
+    }
+
+    // The messages of all failed jobs, each under the name of its job
+    std::string Errors() const {
+        std::string errors;
+        for (const ShaderBuildResult& result : results) {
+            if (!result.output.ok) {
+                errors += result.name + ":\n" + result.output.error + "\n";
+            }
+        }
+        return errors;
+    }
+
+    // Time saved against running the jobs one after another. Jobs that share
+    // a core take longer each, so with more threads than free cores this
+    // overestimates.
+    double SavedMilliseconds() const { return jobMilliseconds - wallMilliseconds; }
+};
+
+// Runs compile(compiler, job) for every job on the pool. createCompiler is
+// called at most once per pool thread, on that thread; when it returns null
+// the jobs of the thread fail with an error instead.
+template <class Compiler>
+ShaderBuildReport BuildShaders(ThreadPool& pool, const std::vector<std::string>& names,
+                               const std::function<std::unique_ptr<Compiler>()>& createCompiler,
+                               const std::function<ShaderBuildOutput(Compiler&, uint32_t)>& compile) {
+    using Clock = std::chrono::steady_clock;
+    ShaderBuildReport report;
+    report.threads = pool.ThreadCount();
+    report.results.resize(names.size());
+    // Slot t is only touched by pool thread t
+    std::vector<std::unique_ptr<Compiler>> compilers(pool.ThreadCount());
+    std::vector<uint8_t> attempted(pool.ThreadCount(), 0);
+
+    const Clock::time_point start = Clock::now();
+    pool.ParallelFor(static_cast<uint32_t>(names.size()), [&](uint32_t job, uint32_t thread) {
+        const Clock::time_point jobStart = Clock::now();
+        ShaderBuildResult& result = report.results[job];
+        result.name = names[job];
+        result.thread = thread;
+        if (!attempted[thread]) {
+            attempted[thread] = 1;
+            compilers[thread] = createCompiler();
+        }
+        if (compilers[thread]) {
+            result.output = compile(*compilers[thread], job);
+        } else {
+            result.output.error = "no compiler on this thread";
+        }
+        result.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - jobStart).count();
+    });
+    report.wallMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    for (const std::unique_ptr<Compiler>& compiler : compilers) {
+        report.compilers += compiler ? 1 : 0;
+    }
+    for (const ShaderBuildResult& result : report.results) {
+        report.jobMilliseconds += result.milliseconds;
+    }
+    return report;
+}
+
+#endif //PATHTRACER_SHADERBUILD_H
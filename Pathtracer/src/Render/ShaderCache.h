@@ -0,0 +1,265 @@
+#ifndef PATHTRACER_SHADERCACHE_H
+#define PATHTRACER_SHADERCACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// On-disk cache of compiled DXIL libraries (nv_helpers_dx12::
+// ShaderLibraryCompiler). An entry is keyed by a hash of
+//   - the text of the shader file and of every file it includes, recursively,
+//     in include order; includes are followed whatever #if they sit in, so a
+//     change to any file the preprocessor might read is a miss;
+//   - the compiler arguments (defines, optimization, target profile);
+//   - the compiler version.
+// Entries are <directory>/<shader stem>-<key>.dxil with a small header
+// holding the key, size and a hash of the blob, so a truncated or otherwise
+// damaged file is a miss rather than a broken pipeline. Libraries compiled on
+// several threads may Load and Store at once, each under its own name. No
+// compiler calls, so keys and entries are checked by tools/ShaderCache.
+
+// FNV-1a, 64 bit
+class ShaderHash {
+public:
+    void Add(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            m_state = (m_state ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    // Length first, so the concatenation of two strings hashes differently
+    // from another split of the same characters
+    template <class Char>
+    void Add(const std::basic_string<Char>& text) {
+        const uint64_t size = text.size();
+        Add(&size, sizeof(size));
+        Add(text.data(), text.size() * sizeof(Char));
+    }
+
+    uint64_t Value() const { return m_state; }
+
+private:
+    uint64_t m_state = 14695981039346656037ull;
+};
+
+struct ShaderKey {
+    uint64_t value = 0;
+    std::vector<std::filesystem::path> files; // the shader, then its includes in first-seen order
+    std::vector<std::string> missing;         // includes that could not be opened
+};
+
+namespace shader_cache_detail {
+
+inline bool ReadFile(const std::filesystem::path& path, std::string& text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return true;
+}
+
+// Names of the #include "..." / <...> lines of a file, in order. Includes
+// commented out with /* */ are still listed, which only costs a rehash.
+inline std::vector<std::string> Includes(const std::string& text) {
+    std::vector<std::string> names;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t i = line.find_first_not_of(" \t");
+        if (i == std::string::npos || line[i] != '#') {
+            continue;
+        }
+        i = line.find_first_not_of(" \t", i + 1);
+        if (i == std::string::npos || line.compare(i, 7, "include") != 0) {
+            continue;
+        }
+        const size_t open = line.find_first_of("\"<", i + 7);
+        if (open == std::string::npos) {
+            continue;
+        }
+        const size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if (close != std::string::npos) {
+            names.push_back(line.substr(open + 1, close - open - 1));
+        }
+    }
+    return names;
+}
+
+inline void AddFile(const std::filesystem::path& path, const std::filesystem::path& root, ShaderHash& hash,
+                    ShaderKey& key) {
+    const std::filesystem::path normal = path.lexically_normal();
+    for (const std::filesystem::path& seen : key.files) {
+        if (seen == normal) {
+            // Included before: the include guard makes the second one empty
+            return;
+        }
+    }
+    std::string text;
+    if (!ReadFile(normal, text)) {
+        key.missing.push_back(normal.generic_string());
+        hash.Add(std::string("missing:") + normal.generic_string());
+        return;
+    }
+    key.files.push_back(normal);
+    hash.Add(normal.filename().generic_string());
+    hash.Add(text);
+    for (const std::string& name : Includes(text)) {
+        // Next to the including file first, then next to the shader
+        std::filesystem::path include = normal.parent_path() / name;
+        if (!std::filesystem::exists(include)) {
+            include = root / name;
+        }
+        AddFile(include, root, hash, key);
+    }
+}
+
+} // namespace shader_cache_detail
+
+// Key of a shader compiled with arguments (the target profile included) by
+// the compiler identified by compilerVersion
+template <class Char>
+ShaderKey ComputeShaderKey(const std::filesystem::path& shader, const std::vector<std::basic_string<Char>>& arguments,
+                           const std::string& compilerVersion) {
+    ShaderHash hash;
+    ShaderKey key;
+    hash.Add(compilerVersion);
+    for (const std::basic_string<Char>& argument : arguments) {
+        hash.Add(argument);
+    }
+    shader_cache_detail::AddFile(shader, shader.parent_path(), hash, key);
+    key.value = hash.Value();
+    return key;
+}
+
+struct ShaderCacheStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;   // no entry for the key
+    uint32_t rejected = 0; // an entry for the key, but damaged
+    uint32_t stores = 0;
+    uint32_t storeFailures = 0;
+    uint32_t pruned = 0;   // stale entries of the same shader removed by Store
+};
+
+class ShaderCache {
+public:
+    explicit ShaderCache(std::filesystem::path directory) : m_directory(std::move(directory)) {}
+
+    const std::filesystem::path& Directory() const { return m_directory; }
+
+    std::filesystem::path EntryPath(const std::string& name, uint64_t key) const {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+        return m_directory / (name + "-" + hex + ".dxil");
+    }
+
+    // The blob stored for name and key, if there is an intact one
+    bool Load(const std::string& name, uint64_t key, std::vector<uint8_t>& blob) {
+        std::string bytes;
+        if (!shader_cache_detail::ReadFile(EntryPath(name, key), bytes)) {
+            Count(&ShaderCacheStats::misses);
+            return false;
+        }
+        Header header;
+        if (bytes.size() < sizeof(Header)) {
+            Count(&ShaderCacheStats::rejected);
+            return false;
+        }
+        std::copy(bytes.data(), bytes.data() + sizeof(Header), reinterpret_cast<char*>(&header));
+        ShaderHash contents;
+        contents.Add(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header));
+        if (header.magic != kMagic || header.version != kVersion || header.key != key ||
+            header.size != bytes.size() - sizeof(Header) || header.contentHash != contents.Value()) {
+            Count(&ShaderCacheStats::rejected);
+            return false;
+        }
+        blob.assign(bytes.begin() + sizeof(Header), bytes.end());
+        Count(&ShaderCacheStats::hits);
+        return true;
+    }
+
+    // Writes the entry through a temporary file, so a reader never sees half
+    // of it, and removes the entries of name with other keys
+    bool Store(const std::string& name, uint64_t key, const void* blob, size_t size) {
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+        Header header;
+        header.key = key;
+        header.size = size;
+        ShaderHash contents;
+        contents.Add(blob, size);
+        header.contentHash = contents.Value();
+
+        const std::filesystem::path path = EntryPath(name, key);
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(static_cast<const char*>(blob), static_cast<std::streamsize>(size));
+            if (!file.good()) {
+                Count(&ShaderCacheStats::storeFailures);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            Count(&ShaderCacheStats::storeFailures);
+            return false;
+        }
+        Count(&ShaderCacheStats::stores);
+
+        const std::string prefix = name + "-";
+        for (const auto& entry : std::filesystem::directory_iterator(m_directory, error)) {
+            const std::string file = entry.path().filename().string();
+            if (entry.path() != path && file.size() == prefix.size() + 16 + 5 && file.compare(0, prefix.size(), prefix) == 0 &&
+                entry.path().extension() == ".dxil") {
+                std::error_code removeError;
+                if (std::filesystem::remove(entry.path(), removeError)) {
+                    Count(&ShaderCacheStats::pruned);
+                }
+            }
+        }
+        return true;
+    }
+
+    ShaderCacheStats Stats() const {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        return m_stats;
+    }
+
+private:
+    static constexpr uint32_t kMagic = 0x43495844; // "DXIC"
+    static constexpr uint32_t kVersion = 1;
+
+    struct Header {
+        uint32_t magic = kMagic;
+        uint32_t version = kVersion;
+        uint64_t key = 0;
+        uint64_t size = 0;
+        uint64_t contentHash = 0;
+    };
+
+    void Count(uint32_t ShaderCacheStats::*counter) {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.*counter += 1;
+    }
+
+    std::filesystem::path m_directory;
+    mutable std::mutex m_statsMutex;
+    ShaderCacheStats m_stats;
+};
+
+#endif //PATHTRACER_SHADERCACHE_H
@@ -0,0 +1,136 @@
+#ifndef PATHTRACER_SHADERPERMUTATION_H
+#define PATHTRACER_SHADERPERMUTATION_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "RestirSettings.h"
+#include "ShaderCache.h"
+
+// Variants of the ray tracing libraries specialized for a set of ReSTIR
+// tuning values. The tuning #defines of Common_v6.hlsl (and Common_v7.hlsl)
+// are guarded by #ifndef, so a permutation passes its values as -D arguments
+// to the compiler and they stay compile-time constants: loops keep constant
+// trip counts and candidate arrays are sized by them. A permutation without defines is
+// the shipped one, the values written in the shader. Each variant has shader
+// cache entries of its own (CacheSuffix), so switching back and forth between
+// presets compiles every variant once. No compiler calls, so the defines are
+// checked against the shader by tools/ShaderPermutation.
+
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+namespace shader_permutation_detail {
+
+// Shortest decimal that reads back as v, as an HLSL float literal ("5.0f")
+inline std::string FloatLiteral(float v) {
+    char text[32];
+    for (int precision = 6; precision <= 9; precision++) {
+        std::snprintf(text, sizeof(text), "%.*g", precision, static_cast<double>(v));
+        if (std::strtof(text, nullptr) == v) {
+            break;
+        }
+    }
+    std::string literal = text;
+    if (literal.find_first_of(".e") == std::string::npos) {
+        literal += ".0";
+    }
+    return literal + "f";
+}
+
+} // namespace shader_permutation_detail
+
+// The tuning #defines with the values of settings. distanceThreshold is a
+// literal of the reuse passes, not a #define, so no permutation changes it.
+inline std::vector<ShaderDefine> RestirDefines(const RestirSettings& settings) {
+    using shader_permutation_detail::FloatLiteral;
+    return {
+        {"nee_samples", std::to_string(settings.neeSamples)},
+        {"nee_samples_DI", std::to_string(settings.neeSamplesDI)},
+        {"bsdf_samples_DI", std::to_string(settings.bsdfSamplesDI)},
+        {"bounces", std::to_string(settings.bounces)},
+        {"spatial_candidate_count", std::to_string(settings.spatialCandidateCount)},
+        {"spatial_max_tries", std::to_string(settings.spatialMaxTries)},
+        {"spatial_radius", std::to_string(settings.spatialRadius)},
+        {"spatial_exponent", FloatLiteral(settings.spatialExponent)},
+        {"spatial_M_cap", std::to_string(settings.spatialMCap)},
+        {"spatial_M_cap_GI", std::to_string(settings.spatialMCapGI)},
+        {"temporal_M_cap", std::to_string(settings.temporalMCap)},
+        {"temporal_M_cap_GI", std::to_string(settings.temporalMCapGI)},
+        {"w_sum_threshold", FloatLiteral(settings.wSumThreshold)},
+        {"j_threshold", FloatLiteral(settings.jacobianThreshold)},
+    };
+}
+
+struct ShaderPermutation {
+    std::string name;
+    std::vector<ShaderDefine> defines; // none: the values written in the shader
+
+    // "-D", "name=value" for every define, to append to the compiler arguments
+    std::vector<std::string> Arguments() const {
+        std::vector<std::string> arguments;
+        for (const ShaderDefine& define : defines) {
+            arguments.push_back("-D");
+            arguments.push_back(define.name + "=" + define.value);
+        }
+        return arguments;
+    }
+
+    // Equal for permutations with the same defines, whatever their names; 0
+    // for the shipped one
+    uint64_t Id() const {
+        if (defines.empty()) {
+            return 0;
+        }
+        ShaderHash hash;
+        for (const ShaderDefine& define : defines) {
+            hash.Add(define.name);
+            hash.Add(define.value);
+        }
+        return hash.Value();
+    }
+
+    // Appended to a library's name in the shader cache: the variants of a
+    // library are kept side by side instead of replacing each other
+    std::string CacheSuffix() const {
+        if (defines.empty()) {
+            return "";
+        }
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(Id()));
+        return std::string(".") + hex;
+    }
+};
+
+inline ShaderPermutation MakePermutation(const std::string& name, const RestirSettings& settings) {
+    return {name, RestirDefines(settings)};
+}
+
+// The presets the renderer cycles through, the shipped values first
+inline std::vector<ShaderPermutation> RestirPresets() {
+    RestirSettings performance;
+    performance.neeSamples = 1;
+    performance.neeSamplesDI = 2;
+    performance.bounces = 1;
+    performance.spatialCandidateCount = 1;
+    performance.spatialMaxTries = 3;
+
+    RestirSettings quality;
+    quality.neeSamples = 8;
+    quality.neeSamplesDI = 8;
+    quality.bsdfSamplesDI = 2;
+    quality.bounces = 5;
+    quality.spatialCandidateCount = 5;
+    quality.spatialMaxTries = 15;
+    quality.spatialMCap = 256;
+    quality.spatialMCapGI = 256;
+
+    return {{"shipped", {}}, MakePermutation("performance", performance), MakePermutation("quality", quality)};
+}
+
+#endif //PATHTRACER_SHADERPERMUTATION_H
@@ -0,0 +1,186 @@
+#ifndef PATHTRACER_SHADERRELOAD_H
+#define PATHTRACER_SHADERRELOAD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "ShaderCache.h"
+
+// Hot reload of the ray tracing libraries while the renderer runs.
+// ShaderWatch holds the include closure of every library (ComputeShaderKey)
+// and the write times of the files in it, includes that could not be opened
+// among them. Poll reports the libraries with a file of their closure
+// changed, created or removed since the last poll, and reads the closures of
+// those again, so an #include added by the edit is watched from then on.
+// ShaderReloadSchedule decides when to rebuild: changes first settle for a
+// while, as editors save a file in several writes; one build runs at a time
+// and changes made during it wait for the next one; the libraries of a failed
+// build are rebuilt with the next change, since the same sources would fail
+// again. The renderer compiles in the background and swaps the state object
+// and the SBT in between frames (Renderer::UpdateShaderReload). No compiler
+// or GPU calls, so watching and scheduling are checked by tools/ShaderReload.
+
+class ShaderWatch {
+public:
+    ShaderWatch() = default;
+
+    // libraries: the file names of the libraries in dir
+    ShaderWatch(const std::filesystem::path& dir, const std::vector<std::string>& libraries)
+        : m_dir(dir), m_libraries(libraries), m_files(libraries.size()) {
+        for (uint32_t library = 0; library < m_libraries.size(); library++) {
+            Track(library);
+        }
+    }
+
+    // The libraries with a changed dependency since the last poll, in order
+    std::vector<uint32_t> Poll() {
+        std::vector<uint32_t> changed;
+        // Files shared by several libraries are looked at once
+        std::map<std::filesystem::path, std::filesystem::file_time_type> times;
+        for (uint32_t library = 0; library < m_libraries.size(); library++) {
+            bool dirty = false;
+            for (const std::pair<std::filesystem::path, std::filesystem::file_time_type>& file : m_files[library]) {
+                auto time = times.find(file.first);
+                if (time == times.end()) {
+                    time = times.emplace(file.first, WriteTime(file.first)).first;
+                }
+                dirty = dirty || time->second != file.second;
+            }
+            if (dirty) {
+                changed.push_back(library);
+                Track(library);
+            }
+        }
+        return changed;
+    }
+
+    // The files library depends on, the library first
+    std::vector<std::filesystem::path> Files(uint32_t library) const {
+        std::vector<std::filesystem::path> files;
+        for (const std::pair<std::filesystem::path, std::filesystem::file_time_type>& file : m_files[library]) {
+            files.push_back(file.first);
+        }
+        return files;
+    }
+
+    // The libraries that depend on file
+    std::vector<uint32_t> Dependents(const std::filesystem::path& file) const {
+        const std::filesystem::path normal = file.lexically_normal();
+        std::vector<uint32_t> dependents;
+        for (uint32_t library = 0; library < m_libraries.size(); library++) {
+            for (const std::pair<std::filesystem::path, std::filesystem::file_time_type>& tracked : m_files[library]) {
+                if (tracked.first == normal) {
+                    dependents.push_back(library);
+                    break;
+                }
+            }
+        }
+        return dependents;
+    }
+
+    const std::vector<std::string>& Libraries() const { return m_libraries; }
+    const std::filesystem::path& Directory() const { return m_dir; }
+
+private:
+    // A file that does not exist has the earliest time, so creating it is a
+    // change as well
+    static std::filesystem::file_time_type WriteTime(const std::filesystem::path& path) {
+        std::error_code error;
+        const std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+        return error ? std::filesystem::file_time_type::min() : time;
+    }
+
+    void Track(uint32_t library) {
+        const ShaderKey key =
+            ComputeShaderKey(m_dir / m_libraries[library], std::vector<std::string>{}, std::string());
+        std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>>& files = m_files[library];
+        files.clear();
+        // A missing library is among the missing files
+        for (const std::filesystem::path& file : key.files) {
+            files.emplace_back(file, WriteTime(file));
+        }
+        for (const std::string& missing : key.missing) {
+            files.emplace_back(std::filesystem::path(missing), WriteTime(missing));
+        }
+    }
+
+    std::filesystem::path m_dir;
+    std::vector<std::string> m_libraries;
+    std::vector<std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>>> m_files;
+};
+
+struct ShaderReloadStats {
+    uint32_t changes = 0;  // polls that reported changed libraries
+    uint32_t builds = 0;   // builds started
+    uint32_t failures = 0; // builds finished with errors
+};
+
+// Times are in milliseconds on any steady clock
+class ShaderReloadSchedule {
+public:
+    explicit ShaderReloadSchedule(double settleMilliseconds = 250.0) : m_settle(settleMilliseconds) {}
+
+    // The sources of libraries changed at now
+    void Changed(const std::vector<uint32_t>& libraries, double now) {
+        if (libraries.empty()) {
+            return;
+        }
+        m_stats.changes++;
+        Merge(m_pending, libraries);
+        m_lastChange = now;
+    }
+
+    // The libraries to rebuild when a build may start at now: nothing changed
+    // for the settle time and no build is running. Empty otherwise.
+    std::vector<uint32_t> Start(double now) {
+        if (m_building || m_pending.empty() || now - m_lastChange < m_settle) {
+            return {};
+        }
+        std::vector<uint32_t> build = m_failed;
+        Merge(build, m_pending);
+        m_pending.clear();
+        m_failed.clear();
+        m_building = true;
+        m_build = build;
+        m_stats.builds++;
+        return build;
+    }
+
+    // The build started last is done; without ok its libraries are built
+    // again with the next change
+    void Finished(bool ok) {
+        if (!ok) {
+            m_stats.failures++;
+            m_failed = m_build;
+        }
+        m_build.clear();
+        m_building = false;
+    }
+
+    bool Building() const { return m_building; }
+    bool Pending() const { return !m_pending.empty(); }
+    const ShaderReloadStats& Stats() const { return m_stats; }
+
+private:
+    static void Merge(std::vector<uint32_t>& into, const std::vector<uint32_t>& libraries) {
+        into.insert(into.end(), libraries.begin(), libraries.end());
+        std::sort(into.begin(), into.end());
+        into.erase(std::unique(into.begin(), into.end()), into.end());
+    }
+
+    double m_settle;
+    double m_lastChange = 0.0;
+    bool m_building = false;
+    std::vector<uint32_t> m_pending; // changed since the last build started
+    std::vector<uint32_t> m_build;   // of the running build
+    std::vector<uint32_t> m_failed;  // of the last build, when it failed
+    ShaderReloadStats m_stats;
+};
+
+#endif //PATHTRACER_SHADERRELOAD_H
@@ -0,0 +1,377 @@
+#include "SpatialPass.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+#include "Mis.h"
+#include "Rng.h"
+
+namespace {
+
+// Structured buffer reads past the end return zeros
+const SampleData kZeroSample{};
+const Reservoir_DI kZeroReservoir{};
+const Reservoir_GI kZeroReservoirGI{};
+
+bool HasEmission(const SampleData& s) {
+    return glm::length(ToFloat3(s.L1)) != 0.0f;
+}
+
+// The mirroring of GetRandomPixelCircleWeighted
+int Mirror(int v, int size) {
+    while (v < 0 || v >= size) {
+        v = v < 0 ? -v : 2 * size - v - 2;
+    }
+    return v;
+}
+
+// Candidate lists of one pixel: neighbor indices passing the tests, like the
+// shader's first two loops. The shader also tests mID != 4294967294, which
+// can never fail on the 16-bit field.
+struct Candidates {
+    uint32_t di[kMaxSpatialCandidates];
+    uint32_t gi[kMaxSpatialCandidates];        // GI reservoir elements
+    uint32_t giSamples[kMaxSpatialCandidates]; // SampleData elements of the same pixels
+    uint32_t countDI = 0;
+    uint32_t countGI = 0;
+    uint32_t attemptsDI = 0;
+    uint32_t attemptsGI = 0;
+};
+
+// accept(pixel, slot) tests a neighbor and, if it passes, records it in slot
+template <typename Accept>
+uint32_t GatherCandidates(const SpatialSettings& settings, uint32_t w, uint32_t h, uint32_t x, uint32_t y,
+                          glm::uvec2& seed, uint32_t& attempts, const Accept& accept) {
+    const RestirSettings& restir = settings.restir;
+    const uint32_t wanted = std::min(restir.spatialCandidateCount, kMaxSpatialCandidates);
+    uint32_t key = 0;
+    if (settings.selection == NeighborSelection::DiskTable) {
+        const DiskOffsetTable& table = *settings.table;
+        key = std::min(static_cast<uint32_t>(RandomFloat(seed) * static_cast<float>(table.rotations * table.count)),
+                       table.rotations * table.count - 1);
+    }
+
+    uint32_t found = 0;
+    uint32_t attempt = 0;
+    for (; attempt < restir.spatialMaxTries && found < wanted; attempt++) {
+        const glm::uvec2 pixel =
+            settings.selection == NeighborSelection::DiskTable
+                ? GetTablePixelXY(*settings.table, key, attempt, w, h, x, y)
+                : GetRandomPixelCircleWeightedXY(restir.spatialRadius, restir.spatialExponent, w, h, x, y, seed);
+        if (accept(pixel, found)) {
+            found++;
+        }
+    }
+    attempts = attempt;
+    return found;
+}
+
+} // namespace
+
+void DiskOffsetTable::Build(uint32_t radius, float exponent, uint32_t offsetCount, uint32_t rotationCount) {
+    count = std::max(1u, offsetCount);
+    rotations = std::max(1u, rotationCount);
+    offsets.resize(static_cast<size_t>(count) * rotations);
+
+    // Golden ratio step through the spiral, so consecutive attempts land far apart
+    stride = std::max(1u, static_cast<uint32_t>(std::lround(count * 0.6180339887)));
+    while (std::gcd(stride, count) != 1) {
+        stride++;
+    }
+
+    // Radii below one pixel always truncate to the center, which the shader rejects and redraws
+    const float uMin = radius > 1 ? std::pow(1.0f / static_cast<float>(radius), 1.0f / exponent) : 0.0f;
+    const float goldenAngle = 2.3999632297f;
+    for (uint32_t k = 0; k < rotations; k++) {
+        const float rotation = 6.2831853f * static_cast<float>(k) / static_cast<float>(rotations);
+        for (uint32_t i = 0; i < count; i++) {
+            const float u = uMin + (1.0f - uMin) * (static_cast<float>(i) + 0.5f) / static_cast<float>(count);
+            const float r = static_cast<float>(radius) * std::pow(u, exponent);
+            const float angle = rotation + goldenAngle * static_cast<float>(i);
+            int ox = static_cast<int>(std::cos(angle) * r);
+            int oy = static_cast<int>(std::sin(angle) * r);
+            if (ox == 0 && oy == 0) {
+                // Just above one pixel on a diagonal: step along the dominant axis instead
+                if (std::abs(std::cos(angle)) >= std::abs(std::sin(angle))) {
+                    ox = std::cos(angle) < 0.0f ? -1 : 1;
+                } else {
+                    oy = std::sin(angle) < 0.0f ? -1 : 1;
+                }
+            }
+            offsets[static_cast<size_t>(k) * count + i] = {static_cast<int16_t>(ox), static_cast<int16_t>(oy)};
+        }
+    }
+}
+
+glm::uvec2 GetTablePixelXY(const DiskOffsetTable& table, uint32_t key, uint32_t attempt, uint32_t w, uint32_t h,
+                           uint32_t x, uint32_t y) {
+    const uint32_t rotation = key / table.count;
+    const uint32_t index = (key + attempt * table.stride) % table.count;
+    const DiskOffsetTable::Offset offset = table.offsets[static_cast<size_t>(rotation) * table.count + index];
+    const int newX = Mirror(static_cast<int>(x) + offset.x, static_cast<int>(w));
+    const int newY = Mirror(static_cast<int>(y) + offset.y, static_cast<int>(h));
+    return glm::uvec2(newX, newY);
+}
+
+uint32_t GetTablePixel(const DiskOffsetTable& table, uint32_t key, uint32_t attempt, uint32_t w, uint32_t h,
+                       uint32_t x, uint32_t y) {
+    return MapPixelID(glm::uvec2(w, h), GetTablePixelXY(table, key, attempt, w, h, x, y));
+}
+
+double SpatialStats::MeanCandidatesDI() const {
+    uint64_t pixels = 0, sum = 0;
+    for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+        pixels += candidatesDI[i];
+        sum += candidatesDI[i] * i;
+    }
+    return pixels ? static_cast<double>(sum) / static_cast<double>(pixels) : 0.0;
+}
+
+double SpatialStats::MeanCandidatesGI() const {
+    uint64_t pixels = 0, sum = 0;
+    for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+        pixels += candidatesGI[i];
+        sum += candidatesGI[i] * i;
+    }
+    return pixels ? static_cast<double>(sum) / static_cast<double>(pixels) : 0.0;
+}
+
+glm::vec3 SpatialPassPixel(const SceneTracer& tracer, const glm::vec3& cameraOrigin, const SpatialSettings& settings,
+                           uint32_t x, uint32_t y, const RestirFrame& current, RestirFrame& last,
+                           SpatialStats* stats, glm::vec3* indirect) {
+    const uint32_t w = current.width;
+    const uint32_t h = current.height;
+    const glm::uvec2 dims(w, h);
+    const uint32_t pixelIdx = MapPixelID(dims, glm::uvec2(x, y));
+    if (indirect) {
+        *indirect = glm::vec3(0.0f);
+    }
+    if (pixelIdx >= current.samples.size()) {
+        return glm::vec3(0.0f);
+    }
+    const SampleData& sdata_current = current.samples[pixelIdx];
+    if (HasEmission(sdata_current)) {
+        return ToFloat3(sdata_current.L1);
+    }
+    const bool ownsGI = current.OwnsGI(x, y);
+    const uint32_t giPixelIdx = current.GiIndex(x, y);
+
+    const RestirSettings& restir = settings.restir;
+    glm::uvec2 seed = SeedPixel(x, y, 3, settings.time);
+    const uint32_t mID = sdata_current.mID;
+    const ShadingMaterial matOpt = LoadMaterial(tracer, mID);
+    const float M_cap = static_cast<float>(restir.spatialMCap);
+    const float M_cap_GI = static_cast<float>(restir.spatialMCapGI);
+
+    const auto sampleAt = [&](uint32_t i) -> const SampleData& {
+        return i < current.samples.size() ? current.samples[i] : kZeroSample;
+    };
+    const auto reservoirAt = [&](uint32_t i) -> const Reservoir_DI& {
+        return i < current.reservoirsDI.size() ? current.reservoirsDI[i] : kZeroReservoir;
+    };
+    const auto reservoirGIAt = [&](uint32_t i) -> const Reservoir_GI& {
+        return i < current.reservoirsGI.size() ? current.reservoirsGI[i] : kZeroReservoirGI;
+    };
+
+    Candidates candidates;
+    float M_sum_DI = std::min(M_cap, static_cast<float>(current.reservoirsDI[pixelIdx].M));
+    float M_sum_GI = std::min(M_cap_GI, static_cast<float>(reservoirGIAt(giPixelIdx).M));
+
+    candidates.countDI = GatherCandidates(settings, w, h, x, y, seed, candidates.attemptsDI,
+                                          [&](const glm::uvec2& pixel, uint32_t slot) {
+        const uint32_t pixel_r = MapPixelID(dims, pixel);
+        const SampleData& s = sampleAt(pixel_r);
+        const Reservoir_DI& r = reservoirAt(pixel_r);
+        const bool accepted = !RejectNormal(sdata_current.n1, s.n1, 0.9f) &&
+                              !RejectDistance(sdata_current.x1, s.x1, cameraOrigin, restir.distanceThreshold) &&
+                              IsValidReservoir(r) && !HasEmission(s) && s.mID == sdata_current.mID;
+        if (accepted) {
+            candidates.di[slot] = pixel_r;
+            M_sum_DI += std::min(M_cap, static_cast<float>(r.M));
+        }
+        return accepted;
+    });
+
+    // GI neighbors are the owners standing in for the picked pixels
+    const auto acceptGI = [&](const glm::uvec2& pixel, uint32_t slot) {
+        const glm::uvec2 owner = GiOwner(current.giResolution, pixel);
+        const uint32_t pixel_r = MapPixelID(dims, owner);
+        const uint32_t gi_r = MapGiPixelID(current.giResolution, dims, owner);
+        const SampleData& s = sampleAt(pixel_r);
+        const Reservoir_GI& r = reservoirGIAt(gi_r);
+        const bool accepted =
+            owner != glm::uvec2(x, y) && matOpt.Pr_Pm_Ps_Pc.x > 0.3f &&
+            !RejectDistance(sdata_current.x1, s.x1, cameraOrigin, restir.distanceThreshold) &&
+            !RejectBelowSurface(glm::normalize(r.xn - sdata_current.x1), sdata_current.n1) &&
+            !RejectWsum(r.w_sum, restir.wSumThreshold) && IsValidReservoir_GI(r) &&
+            !RejectJacobian(Jacobian_Reconnection(s, sdata_current, r.xn, r.nn), restir.jacobianThreshold) &&
+            !HasEmission(s) && s.mID == sdata_current.mID;
+        if (accepted) {
+            candidates.gi[slot] = gi_r;
+            candidates.giSamples[slot] = pixel_r;
+            M_sum_GI += std::min(M_cap_GI, static_cast<float>(r.M));
+        }
+        return accepted;
+    };
+    if (ownsGI) {
+        candidates.countGI = GatherCandidates(settings, w, h, x, y, seed, candidates.attemptsGI, acceptGI);
+    }
+
+    const Reservoir_DI canonical = current.reservoirsDI[pixelIdx];
+    const Reservoir_GI canonical_gi = reservoirGIAt(giPixelIdx);
+    Reservoir_DI reservoir_current = canonical;
+    Reservoir_GI reservoir_current_gi = canonical_gi;
+
+    const float mi_c = GenPairwiseMIS_canonical(tracer, current.reservoirsDI, current.samples, canonical,
+                                                candidates.di, candidates.countDI, sdata_current, M_sum_DI, M_cap,
+                                                matOpt);
+    const float w_c = mi_c * GetP_Hat(tracer, sdata_current.x1, sdata_current.n1, canonical.x2, canonical.n2,
+                                      ToFloat3(canonical.L2), sdata_current.o, matOpt, false) * canonical.W;
+
+    const float mi_c_gi = GenPairwiseMIS_canonical_GI(tracer, current.reservoirsGI, current.samples, canonical_gi,
+                                                      candidates.gi, candidates.giSamples, candidates.countGI,
+                                                      sdata_current, M_sum_GI, M_cap_GI, matOpt);
+    const glm::vec3 f_c = GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1, canonical_gi.xn, canonical_gi.nn,
+                                      ToFloat3(canonical_gi.E3), sdata_current.o, matOpt, false);
+    const float w_c_gi = mi_c_gi * LinearizeVector(f_c) * canonical_gi.W;
+
+    reservoir_current.M = static_cast<uint16_t>(std::min(M_cap, static_cast<float>(canonical.M)));
+    reservoir_current.w_sum = w_c;
+    reservoir_current_gi.M = static_cast<uint16_t>(std::min(M_cap_GI, static_cast<float>(canonical_gi.M)));
+    reservoir_current_gi.w_sum = w_c_gi;
+
+    for (uint32_t v = 0; v < candidates.countDI; v++) {
+        const uint32_t spatial_candidate = candidates.di[v];
+        const Reservoir_DI& neighbor = current.reservoirsDI[spatial_candidate];
+        const float mi_s = GenPairwiseMIS_noncanonical(tracer, current.reservoirsDI, current.samples, canonical,
+                                                       spatial_candidate, sdata_current, M_sum_DI, M_cap, matOpt);
+        const float w_s = mi_s * GetP_Hat(tracer, sdata_current.x1, sdata_current.n1, neighbor.x2, neighbor.n2,
+                                          ToFloat3(neighbor.L2), sdata_current.o, matOpt, false) * neighbor.W;
+        UpdateReservoir(reservoir_current, w_s, std::min(M_cap, static_cast<float>(neighbor.M)), neighbor.x2,
+                        neighbor.n2, ToFloat3(neighbor.L2), seed);
+    }
+
+    for (uint32_t v = 0; v < candidates.countGI; v++) {
+        const uint32_t spatial_candidate = candidates.gi[v];
+        const uint32_t spatial_sample = candidates.giSamples[v];
+        const Reservoir_GI& neighbor = current.reservoirsGI[spatial_candidate];
+        // The shader passes spatial_M_cap here, not spatial_M_cap_GI
+        const float mi_s_gi = GenPairwiseMIS_noncanonical_GI(tracer, current.reservoirsGI, current.samples,
+                                                             canonical_gi, spatial_candidate, spatial_sample,
+                                                             sdata_current, M_sum_GI, M_cap, matOpt);
+        const float j_gi = Jacobian_Reconnection(current.samples[spatial_sample], sdata_current, neighbor.xn,
+                                                 neighbor.nn);
+        const glm::vec3 f_gi = GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1, neighbor.xn, neighbor.nn,
+                                           ToFloat3(neighbor.E3), sdata_current.o, matOpt, true);
+        const float w_s_gi = mi_s_gi * LinearizeVector(f_gi) * neighbor.W * j_gi;
+        if (j_gi != 0.0f) {
+            UpdateReservoir_GI(reservoir_current_gi, w_s_gi, std::min(M_cap_GI, static_cast<float>(neighbor.M)),
+                               neighbor.xn, neighbor.nn, ToFloat3(neighbor.E3), seed);
+        }
+    }
+
+    const glm::vec3 L2 = ToFloat3(reservoir_current.L2);
+    const float p_hat = GetP_Hat(tracer, sdata_current.x1, sdata_current.n1, reservoir_current.x2,
+                                 reservoir_current.n2, L2, sdata_current.o, matOpt, true);
+    reservoir_current.W = GetW(reservoir_current, p_hat);
+    glm::vec3 accumulation = ReconnectDI(sdata_current.x1, sdata_current.n1, reservoir_current.x2,
+                                         reservoir_current.n2, L2, sdata_current.o, matOpt) * reservoir_current.W;
+
+    glm::vec3 gi(0.0f);
+    bool fallback = false;
+    if (ownsGI) {
+        const glm::vec3 f_gi_final = GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1,
+                                                 reservoir_current_gi.xn, reservoir_current_gi.nn,
+                                                 ToFloat3(reservoir_current_gi.E3), sdata_current.o, matOpt, false);
+        reservoir_current_gi.W = GetW_GI(reservoir_current_gi, LinearizeVector(f_gi_final));
+        gi = f_gi_final * reservoir_current_gi.W;
+        last.reservoirsGI[giPixelIdx] = reservoir_current_gi;
+    } else {
+        gi = UpsampleGIPixel(tracer, cameraOrigin, settings.giUpsample, x, y, current, sdata_current, matOpt,
+                             &fallback);
+    }
+    accumulation += gi;
+
+    last.reservoirsDI[pixelIdx] = reservoir_current;
+    last.samples[pixelIdx] = sdata_current;
+
+    if (stats) {
+        stats->candidatesDI[candidates.countDI]++;
+        stats->attemptsDI += candidates.attemptsDI;
+        if (ownsGI) {
+            stats->candidatesGI[candidates.countGI]++;
+            stats->attemptsGI += candidates.attemptsGI;
+        } else {
+            stats->giUpsampled++;
+            stats->giFallbacks += fallback;
+        }
+    }
+    if (indirect) {
+        *indirect = gi;
+    }
+    return accumulation;
+}
+
+double RunSpatialPass(const SceneTracer& tracer, ThreadPool& pool, const glm::vec3& cameraOrigin,
+                      const SpatialSettings& settings, const RestirFrame& current, RestirFrame& last,
+                      std::vector<glm::vec3>* output, SpatialStats* stats, std::vector<glm::vec3>* outputGI) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    if (last.width != current.width || last.height != current.height ||
+        last.giResolution != current.giResolution) {
+        last.Resize(current.width, current.height, current.giResolution);
+    }
+    if (output) {
+        output->assign(static_cast<size_t>(current.width) * current.height, glm::vec3(0.0f));
+    }
+    if (outputGI) {
+        outputGI->assign(static_cast<size_t>(current.width) * current.height, glm::vec3(0.0f));
+    }
+    if (stats) {
+        *stats = SpatialStats{};
+    }
+
+    std::mutex statsMutex;
+    const uint32_t tileSize = std::max(1u, settings.tileSize);
+    const uint32_t tilesX = (current.width + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (current.height + tileSize - 1) / tileSize;
+    pool.ParallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t) {
+        const uint32_t x0 = (tile % tilesX) * tileSize;
+        const uint32_t y0 = (tile / tilesX) * tileSize;
+        const uint32_t x1 = std::min(x0 + tileSize, current.width);
+        const uint32_t y1 = std::min(y0 + tileSize, current.height);
+        SpatialStats tileStats;
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                glm::vec3 gi;
+                const glm::vec3 color =
+                    SpatialPassPixel(tracer, cameraOrigin, settings, x, y, current, last, &tileStats, &gi);
+                if (output) {
+                    (*output)[static_cast<size_t>(y) * current.width + x] = color;
+                }
+                if (outputGI) {
+                    (*outputGI)[static_cast<size_t>(y) * current.width + x] = gi;
+                }
+            }
+        }
+        if (stats) {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+                stats->candidatesDI[i] += tileStats.candidatesDI[i];
+                stats->candidatesGI[i] += tileStats.candidatesGI[i];
+            }
+            stats->attemptsDI += tileStats.attemptsDI;
+            stats->attemptsGI += tileStats.attemptsGI;
+            stats->giUpsampled += tileStats.giUpsampled;
+            stats->giFallbacks += tileStats.giFallbacks;
+        }
+    });
+
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    if (stats) {
+        stats->seconds = seconds;
+    }
+    return seconds;
+}
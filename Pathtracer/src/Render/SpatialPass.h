@@ -0,0 +1,88 @@
+#ifndef PATHTRACER_SPATIALPASS_H
+#define PATHTRACER_SPATIALPASS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../Util/ThreadPool.h"
+#include "GiUpsample.h"
+#include "InitPass.h"
+
+// CPU version of the spatial reuse + shading pass (RayGen_v6_pass3.hlsl /
+// Pass_spat_di_v7.hlsl + Pass_spat_gi_v7.hlsl): picks neighbors around every
+// shaded pixel, combines their reservoirs with pairwise MIS, shades the
+// result and stores it as next frame's history. The neighbor picker is
+// either the shader's or a table driven alternative. Pixels that own no GI
+// reservoir (GiResolution.h) skip GI reuse and reconstruct GI with
+// UpsampleGIPixel.
+
+enum class NeighborSelection : uint32_t {
+    Circle,    // GetRandomPixelCircleWeighted: pow, cos, sin and mirroring per attempt
+    DiskTable, // DiskOffsetTable, one random number per candidate list
+};
+
+// Integer pixel offsets on a Fibonacci spiral with the radial density of
+// GetRandomPixelCircleWeighted (r = radius * u^exponent, truncated like the
+// shader), in `rotations` copies rotated by 2 pi / rotations. No offset is
+// (0, 0). int16 pairs, so the table fits a constant buffer.
+struct DiskOffsetTable {
+    struct Offset {
+        int16_t x;
+        int16_t y;
+    };
+
+    uint32_t count = 0;     // offsets per rotation
+    uint32_t rotations = 0;
+    uint32_t stride = 1;    // step between attempts, coprime with count
+    std::vector<Offset> offsets; // rotation-major
+
+    void Build(uint32_t radius, float exponent, uint32_t offsetCount = 64, uint32_t rotationCount = 16);
+    size_t Bytes() const { return offsets.size() * sizeof(Offset); }
+};
+
+// Neighbor index for one attempt; key = uint(u * rotations * count) picks the
+// rotation and the starting offset of the pixel
+uint32_t GetTablePixel(const DiskOffsetTable& table, uint32_t key, uint32_t attempt, uint32_t w, uint32_t h,
+                       uint32_t x, uint32_t y);
+// The same neighbor as pixel coordinates
+glm::uvec2 GetTablePixelXY(const DiskOffsetTable& table, uint32_t key, uint32_t attempt, uint32_t w, uint32_t h,
+                           uint32_t x, uint32_t y);
+
+struct SpatialSettings {
+    RestirSettings restir;
+    uint32_t time = 0; // CameraParams.time, seeds the frame
+    uint32_t tileSize = 8;
+    NeighborSelection selection = NeighborSelection::Circle;
+    const DiskOffsetTable* table = nullptr; // required for DiskTable
+    GiUpsampleFilter giUpsample = GiUpsampleFilter::Guided;
+};
+
+constexpr uint32_t kMaxSpatialCandidates = 16;
+
+struct SpatialStats {
+    uint64_t candidatesDI[kMaxSpatialCandidates + 1] = {}; // pixels by accepted neighbor count
+    uint64_t candidatesGI[kMaxSpatialCandidates + 1] = {};
+    uint64_t attemptsDI = 0;
+    uint64_t attemptsGI = 0;  // GI counts are over the pixels owning a GI reservoir
+    uint64_t giUpsampled = 0; // pixels that reconstructed GI
+    uint64_t giFallbacks = 0; // of those, the ones no tap passed for
+    double seconds = 0.0;
+
+    double MeanCandidatesDI() const;
+    double MeanCandidatesGI() const;
+};
+
+// One pixel of RayGen3(); reads current, writes the pixel's history into last
+// and returns the linear color (gOutput before accumulation and gamma).
+// indirect, if given, receives the GI part of it.
+glm::vec3 SpatialPassPixel(const SceneTracer& tracer, const glm::vec3& cameraOrigin, const SpatialSettings& settings,
+                           uint32_t x, uint32_t y, const RestirFrame& current, RestirFrame& last,
+                           SpatialStats* stats = nullptr, glm::vec3* indirect = nullptr);
+
+// Whole frame, tile-parallel. output, outputGI (row-major) and stats may be null. Returns seconds.
+double RunSpatialPass(const SceneTracer& tracer, ThreadPool& pool, const glm::vec3& cameraOrigin,
+                      const SpatialSettings& settings, const RestirFrame& current, RestirFrame& last,
+                      std::vector<glm::vec3>* output = nullptr, SpatialStats* stats = nullptr,
+                      std::vector<glm::vec3>* outputGI = nullptr);
+
+#endif //PATHTRACER_SPATIALPASS_H
@@ -0,0 +1,344 @@
+#include "TemporalPass.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Mis.h"
+#include "Rng.h"
+
+namespace {
+
+// Structured buffer reads past the end return zeros
+const SampleData kZeroSample{};
+const Reservoir_DI kZeroReservoir{};
+const Reservoir_GI kZeroReservoirGI{};
+
+bool HasEmission(const SampleData& s) {
+    return glm::length(ToFloat3(s.L1)) != 0.0f;
+}
+
+TemporalOutcome TestDI(const RestirFrame& last, uint32_t index, const SampleData& sdata_current,
+                       const glm::vec3& origin, const RestirSettings& settings) {
+    const bool inRange = index < last.samples.size();
+    const SampleData& sdata_last = inRange ? last.samples[index] : kZeroSample;
+    const Reservoir_DI& reservoir_last = inRange ? last.reservoirsDI[index] : kZeroReservoir;
+
+    if (HasEmission(sdata_last)) {
+        return TemporalOutcome::LastEmissive;
+    }
+    if (!IsValidReservoir(reservoir_last)) {
+        return TemporalOutcome::InvalidReservoir;
+    }
+    if (RejectDistance(sdata_current.x1, sdata_last.x1, origin, settings.distanceThreshold)) {
+        return TemporalOutcome::Distance;
+    }
+    if (reservoir_last.x2.x == 0.0f || reservoir_last.x2.y == 0.0f || reservoir_last.x2.z == 0.0f) {
+        return TemporalOutcome::EmptySample;
+    }
+    if (sdata_last.mID != sdata_current.mID) {
+        return TemporalOutcome::Material;
+    }
+    return TemporalOutcome::Accepted;
+}
+
+// index is the owner's SampleData element, giIndex its GI reservoir
+TemporalOutcome TestGI(const RestirFrame& last, uint32_t index, uint32_t giIndex, const SampleData& sdata_current,
+                       const glm::vec3& origin, const RestirSettings& settings) {
+    const bool inRange = index < last.samples.size() && giIndex < last.reservoirsGI.size();
+    const SampleData& sdata_last = inRange ? last.samples[index] : kZeroSample;
+    const Reservoir_GI& reservoir_last = inRange ? last.reservoirsGI[giIndex] : kZeroReservoirGI;
+
+    if (HasEmission(sdata_last)) {
+        return TemporalOutcome::LastEmissive;
+    }
+    if (RejectWsum(reservoir_last.w_sum, settings.wSumThreshold)) {
+        return TemporalOutcome::WsumThreshold;
+    }
+    if (RejectDistance(sdata_current.x1, sdata_last.x1, origin, settings.distanceThreshold)) {
+        return TemporalOutcome::Distance;
+    }
+    if (!IsValidReservoir_GI(reservoir_last)) {
+        return TemporalOutcome::InvalidReservoir;
+    }
+    if (sdata_last.mID != sdata_current.mID) {
+        return TemporalOutcome::Material;
+    }
+    return TemporalOutcome::Accepted;
+}
+
+// Previous-frame pixels to try, best first. The shader only rejects the
+// (-1, -1) sentinel and reads whatever MapPixelID makes of other off-screen
+// coordinates; those are rejected here.
+uint32_t ReprojectionCandidates(const TemporalCamera& camera, ReprojectionMode mode, const glm::vec3& x1,
+                                uint32_t width, uint32_t height, glm::ivec2 (&pixels)[4]) {
+    const glm::vec2 dims(static_cast<float>(width), static_cast<float>(height));
+    const auto onScreen = [&](const glm::ivec2& p) {
+        return p.x >= 0 && p.y >= 0 && p.x < static_cast<int>(width) && p.y < static_cast<int>(height);
+    };
+
+    if (mode == ReprojectionMode::Nearest) {
+        pixels[0] = GetBestReprojectedPixel_d(x1, camera.prevView, camera.prevProjection, dims);
+        return onScreen(pixels[0]) ? 1u : 0u;
+    }
+
+    const BilinearResult bilinear =
+        GetBestReprojectedPixelBilinear_CenterBased(x1, camera.prevView, camera.prevProjection, dims);
+    if (!onScreen(bilinear.coords[0])) {
+        return 0;
+    }
+    int order[4] = {0, 1, 2, 3};
+    std::stable_sort(order, order + 4, [&](int a, int b) { return bilinear.weights[a] > bilinear.weights[b]; });
+
+    // Clamping at the border can repeat a corner
+    uint32_t count = 0;
+    for (int i : order) {
+        if (std::find(pixels, pixels + count, bilinear.coords[i]) == pixels + count) {
+            pixels[count++] = bilinear.coords[i];
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+const char* TemporalOutcomeName(TemporalOutcome outcome) {
+    switch (outcome) {
+    case TemporalOutcome::Accepted: return "accepted";
+    case TemporalOutcome::Skipped: return "skipped";
+    case TemporalOutcome::OffScreen: return "off-screen";
+    case TemporalOutcome::LastEmissive: return "last emissive";
+    case TemporalOutcome::WsumThreshold: return "w_sum threshold";
+    case TemporalOutcome::Distance: return "distance";
+    case TemporalOutcome::InvalidReservoir: return "invalid reservoir";
+    case TemporalOutcome::EmptySample: return "empty sample";
+    case TemporalOutcome::Material: return "material";
+    default: return "?";
+    }
+}
+
+TemporalCamera MakeTemporalCamera(const CpuCamera& current, const CpuCamera& previous, uint32_t width,
+                                  uint32_t height) {
+    return {current.eye, previous.View(), previous.Projection(width, height)};
+}
+
+double TemporalStats::AcceptanceDI() const {
+    const uint64_t looked = pixels.size() - outcomesDI[static_cast<size_t>(TemporalOutcome::Skipped)];
+    return looked ? static_cast<double>(outcomesDI[0]) / static_cast<double>(looked) : 0.0;
+}
+
+double TemporalStats::AcceptanceGI() const {
+    const uint64_t looked = pixels.size() - outcomesGI[static_cast<size_t>(TemporalOutcome::Skipped)];
+    return looked ? static_cast<double>(outcomesGI[0]) / static_cast<double>(looked) : 0.0;
+}
+
+void TemporalStats::Tally(const RestirSettings& settings) {
+    std::fill(std::begin(outcomesDI), std::end(outcomesDI), 0);
+    std::fill(std::begin(outcomesGI), std::end(outcomesGI), 0);
+    std::fill(std::begin(cornersDI), std::end(cornersDI), 0);
+    std::fill(std::begin(cornersGI), std::end(cornersGI), 0);
+    histogramDI.assign(2 * settings.temporalMCap + 1, 0);
+    histogramGI.assign(2 * settings.temporalMCapGI + 1, 0);
+
+    for (const TemporalPixelStats& p : pixels) {
+        outcomesDI[static_cast<size_t>(p.outcomeDI)]++;
+        outcomesGI[static_cast<size_t>(p.outcomeGI)]++;
+        if (p.outcomeDI == TemporalOutcome::Accepted) {
+            cornersDI[p.cornerDI]++;
+        }
+        if (p.outcomeGI == TemporalOutcome::Accepted) {
+            cornersGI[p.cornerGI]++;
+        }
+        if (p.outcomeDI != TemporalOutcome::Skipped) {
+            histogramDI[std::min<size_t>(p.M_DI, histogramDI.size() - 1)]++;
+        }
+        if (p.outcomeGI != TemporalOutcome::Skipped) {
+            histogramGI[std::min<size_t>(p.M_GI, histogramGI.size() - 1)]++;
+        }
+    }
+}
+
+TemporalPixelStats TemporalPassPixel(const SceneTracer& tracer, const TemporalCamera& camera,
+                                     const TemporalSettings& settings, uint32_t x, uint32_t y,
+                                     const RestirFrame& last, RestirFrame& current) {
+    const glm::uvec2 dims(current.width, current.height);
+    const uint32_t pixelIdx = MapPixelID(dims, glm::uvec2(x, y));
+    TemporalPixelStats stats;
+    if (pixelIdx >= current.samples.size()) {
+        return stats;
+    }
+
+    const bool ownsGI = current.OwnsGI(x, y);
+    const uint32_t giPixelIdx = current.GiIndex(x, y);
+    Reservoir_DI reservoir_current = current.reservoirsDI[pixelIdx];
+    Reservoir_GI reservoir_gi_current = ownsGI ? current.reservoirsGI[giPixelIdx] : kZeroReservoirGI;
+    const SampleData sdata_current = current.samples[pixelIdx];
+    stats.M_DI = reservoir_current.M;
+    stats.M_GI = reservoir_gi_current.M;
+    if (HasEmission(sdata_current)) {
+        return stats;
+    }
+
+    glm::uvec2 seed = SeedPixel(x, y, 2, settings.time);
+    const RestirSettings& restir = settings.restir;
+
+    glm::ivec2 candidates[4];
+    const uint32_t candidateCount =
+        ReprojectionCandidates(camera, settings.reprojection, sdata_current.x1, current.width, current.height,
+                               candidates);
+
+    // First candidate that passes, otherwise the reason the best one failed
+    uint32_t lastIdxDI = 0, lastIdxGI = 0;
+    stats.outcomeDI = stats.outcomeGI = TemporalOutcome::OffScreen;
+    for (uint32_t i = 0; i < candidateCount && stats.outcomeDI != TemporalOutcome::Accepted; i++) {
+        const uint32_t index = MapPixelID(dims, glm::uvec2(candidates[i]));
+        const TemporalOutcome outcome = TestDI(last, index, sdata_current, camera.origin, restir);
+        if (i == 0 || outcome == TemporalOutcome::Accepted) {
+            stats.outcomeDI = outcome;
+            stats.cornerDI = static_cast<uint8_t>(i);
+            lastIdxDI = index;
+        }
+    }
+    // GI history lives at the owner standing in for the reprojected pixel
+    if (!ownsGI) {
+        stats.outcomeGI = TemporalOutcome::Skipped;
+    }
+    for (uint32_t i = 0; ownsGI && i < candidateCount && stats.outcomeGI != TemporalOutcome::Accepted; i++) {
+        const glm::uvec2 owner = GiOwner(last.giResolution, glm::uvec2(candidates[i]));
+        const uint32_t index = MapPixelID(dims, owner);
+        const uint32_t giIndex = MapGiPixelID(last.giResolution, dims, owner);
+        const TemporalOutcome outcome = TestGI(last, index, giIndex, sdata_current, camera.origin, restir);
+        if (i == 0 || outcome == TemporalOutcome::Accepted) {
+            stats.outcomeGI = outcome;
+            stats.cornerGI = static_cast<uint8_t>(i);
+            lastIdxGI = giIndex;
+        }
+    }
+
+    const ShadingMaterial matOpt = LoadMaterial(tracer, sdata_current.mID);
+
+    if (stats.outcomeDI == TemporalOutcome::Accepted) {
+        const Reservoir_DI& reservoir_last = last.reservoirsDI[lastIdxDI];
+        const float M_cap = static_cast<float>(restir.temporalMCap);
+        const float M_sum = std::min(M_cap, static_cast<float>(reservoir_current.M)) +
+                            std::min(M_cap, static_cast<float>(reservoir_last.M));
+        float mi_c = GenPairwiseMIS_canonical_temporal(reservoir_current, reservoir_last, M_sum, M_cap);
+        float mi_t = GenPairwiseMIS_noncanonical_temporal(reservoir_current, reservoir_last, M_sum, M_cap);
+        if (glm::length(reservoir_last.n2) == 0.0f) {
+            mi_c = 1.0f;
+            mi_t = 0.0f;
+        }
+
+        const float w_c = mi_c * GetP_Hat(tracer, sdata_current.x1, sdata_current.n1, reservoir_current.x2,
+                                          reservoir_current.n2, ToFloat3(reservoir_current.L2), sdata_current.o,
+                                          matOpt, false) * reservoir_current.W;
+        const float w_t = mi_t * GetP_Hat(tracer, sdata_current.x1, sdata_current.n1, reservoir_last.x2,
+                                          reservoir_last.n2, ToFloat3(reservoir_last.L2), sdata_current.o, matOpt,
+                                          true) * reservoir_last.W;
+
+        reservoir_current.M = static_cast<uint16_t>(std::min<uint32_t>(restir.temporalMCap, reservoir_current.M));
+        reservoir_current.w_sum = w_c;
+        UpdateReservoir(reservoir_current, w_t, std::min(M_cap, static_cast<float>(reservoir_last.M)),
+                        reservoir_last.x2, reservoir_last.n2, ToFloat3(reservoir_last.L2), seed);
+
+        const float p_hat = GetP_Hat(tracer, sdata_current.x1, sdata_current.n1, reservoir_current.x2,
+                                     reservoir_current.n2, ToFloat3(reservoir_current.L2), sdata_current.o, matOpt,
+                                     false);
+        reservoir_current.W = GetW(reservoir_current, p_hat);
+    }
+
+    if (stats.outcomeGI == TemporalOutcome::Accepted) {
+        const Reservoir_GI& reservoir_gi_last = last.reservoirsGI[lastIdxGI];
+        const float M_cap = static_cast<float>(restir.temporalMCapGI);
+        const float M_sum_gi = std::min(M_cap, static_cast<float>(reservoir_gi_current.M)) +
+                               std::min(M_cap, static_cast<float>(reservoir_gi_last.M));
+        const float mi_c_gi = GenPairwiseMIS_canonical_temporal_GI(reservoir_gi_current, reservoir_gi_last,
+                                                                   M_sum_gi, M_cap);
+        const float mi_t_gi = GenPairwiseMIS_noncanonical_temporal_GI(reservoir_gi_current, reservoir_gi_last,
+                                                                      M_sum_gi, M_cap);
+
+        const glm::vec3 f_c = GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1, reservoir_gi_current.xn,
+                                          reservoir_gi_current.nn, ToFloat3(reservoir_gi_current.E3),
+                                          sdata_current.o, matOpt, false);
+        const float w_c_gi = mi_c_gi * LinearizeVector(f_c) * reservoir_gi_current.W;
+        const glm::vec3 f_t = GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1, reservoir_gi_last.xn,
+                                          reservoir_gi_last.nn, ToFloat3(reservoir_gi_last.E3), sdata_current.o,
+                                          matOpt, true);
+        const float w_t_gi = mi_t_gi * LinearizeVector(f_t) * reservoir_gi_last.W;
+
+        reservoir_gi_current.M =
+            static_cast<uint16_t>(std::min<uint32_t>(restir.temporalMCapGI, reservoir_gi_current.M));
+        reservoir_gi_current.w_sum = w_c_gi;
+        UpdateReservoir_GI(reservoir_gi_current, w_t_gi, std::min(M_cap, static_cast<float>(reservoir_gi_last.M)),
+                           reservoir_gi_last.xn, reservoir_gi_last.nn, ToFloat3(reservoir_gi_last.E3), seed);
+
+        const glm::vec3 f = GetP_Hat_GI(tracer, sdata_current.x1, sdata_current.n1, reservoir_gi_current.xn,
+                                        reservoir_gi_current.nn, ToFloat3(reservoir_gi_current.E3),
+                                        sdata_current.o, matOpt, false);
+        reservoir_gi_current.W = GetW_GI(reservoir_gi_current, LinearizeVector(f));
+    }
+
+    current.reservoirsDI[pixelIdx] = reservoir_current;
+    if (ownsGI) {
+        current.reservoirsGI[giPixelIdx] = reservoir_gi_current;
+    }
+    stats.M_DI = reservoir_current.M;
+    stats.M_GI = reservoir_gi_current.M;
+    return stats;
+}
+
+double RunTemporalPass(const SceneTracer& tracer, ThreadPool& pool, const TemporalCamera& camera,
+                       const TemporalSettings& settings, const RestirFrame& last, RestirFrame& current,
+                       TemporalStats* stats) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    if (stats) {
+        stats->width = current.width;
+        stats->height = current.height;
+        stats->pixels.assign(static_cast<size_t>(current.width) * current.height, TemporalPixelStats{});
+    }
+
+    const uint32_t tileSize = std::max(1u, settings.tileSize);
+    const uint32_t tilesX = (current.width + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (current.height + tileSize - 1) / tileSize;
+    pool.ParallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t) {
+        const uint32_t x0 = (tile % tilesX) * tileSize;
+        const uint32_t y0 = (tile / tilesX) * tileSize;
+        const uint32_t x1 = std::min(x0 + tileSize, current.width);
+        const uint32_t y1 = std::min(y0 + tileSize, current.height);
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                const TemporalPixelStats pixel = TemporalPassPixel(tracer, camera, settings, x, y, last, current);
+                if (stats) {
+                    stats->pixels[static_cast<size_t>(y) * current.width + x] = pixel;
+                }
+            }
+        }
+    });
+
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    if (stats) {
+        stats->Tally(settings.restir);
+        stats->seconds = seconds;
+    }
+    return seconds;
+}
+
+void StoreLastFrame(const RestirFrame& current, RestirFrame& last) {
+    if (last.width != current.width || last.height != current.height ||
+        last.giResolution != current.giResolution) {
+        last.Resize(current.width, current.height, current.giResolution);
+    }
+    const glm::uvec2 dims(current.width, current.height);
+    for (uint32_t y = 0; y < current.height; y++) {
+        for (uint32_t x = 0; x < current.width; x++) {
+            const uint32_t i = MapPixelID(dims, glm::uvec2(x, y));
+            if (!HasEmission(current.samples[i])) {
+                last.reservoirsDI[i] = current.reservoirsDI[i];
+                last.samples[i] = current.samples[i];
+                if (current.OwnsGI(x, y)) {
+                    const uint32_t g = current.GiIndex(x, y);
+                    last.reservoirsGI[g] = current.reservoirsGI[g];
+                }
+            }
+        }
+    }
+}
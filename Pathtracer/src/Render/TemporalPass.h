@@ -0,0 +1,99 @@
+#ifndef PATHTRACER_TEMPORALPASS_H
+#define PATHTRACER_TEMPORALPASS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../Scene/CpuScene.h"
+#include "../Util/ThreadPool.h"
+#include "InitPass.h"
+
+// CPU version of the temporal reuse pass (RayGen_v6_pass2.hlsl /
+// Pass_temp_di_v7.hlsl + Pass_temp_gi_v7.hlsl): reprojects every shaded
+// pixel into the previous frame, tests the reservoirs found there and
+// combines them with the current ones using the pairwise MIS weights and the
+// temporal M caps. Records why each candidate was accepted or rejected.
+
+enum class ReprojectionMode : uint32_t {
+    Nearest,  // GetBestReprojectedPixel_d, what the shader uses
+    Bilinear, // GetBestReprojectedPixelBilinear_CenterBased, corners by weight until one passes
+};
+
+// Result of a pixel's temporal candidate: the first failing test, in the order of the shader
+enum class TemporalOutcome : uint8_t {
+    Accepted,
+    Skipped,          // emissive primary hit, the pass leaves the pixel alone; GI: owns no GI reservoir
+    OffScreen,        // behind the camera or outside the previous frame
+    LastEmissive,     // previous pixel saw an emitter
+    WsumThreshold,    // GI only: RejectWsum
+    Distance,         // RejectDistance
+    InvalidReservoir, // IsValidReservoir / IsValidReservoir_GI
+    EmptySample,      // DI only: x2 has a zero component
+    Material,         // different material ID
+    Count
+};
+
+const char* TemporalOutcomeName(TemporalOutcome outcome);
+
+// CameraParams read by the pass
+struct TemporalCamera {
+    glm::vec3 origin;     // init_orig, eye of the current frame
+    glm::mat4 prevView;
+    glm::mat4 prevProjection;
+};
+
+TemporalCamera MakeTemporalCamera(const CpuCamera& current, const CpuCamera& previous, uint32_t width,
+                                  uint32_t height);
+
+struct TemporalSettings {
+    RestirSettings restir;
+    uint32_t time = 0; // CameraParams.time, seeds the frame
+    uint32_t tileSize = 8;
+    ReprojectionMode reprojection = ReprojectionMode::Nearest;
+};
+
+// Per pixel, in launch order (y * width + x)
+struct TemporalPixelStats {
+    TemporalOutcome outcomeDI = TemporalOutcome::Skipped;
+    TemporalOutcome outcomeGI = TemporalOutcome::Skipped;
+    uint8_t cornerDI = 0; // weight rank of the bilinear corner taken, 0 for nearest
+    uint8_t cornerGI = 0;
+    uint16_t M_DI = 0;    // M after reuse
+    uint16_t M_GI = 0;
+};
+
+struct TemporalStats {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<TemporalPixelStats> pixels;
+
+    // Totals over pixels, filled by RunTemporalPass
+    uint64_t outcomesDI[static_cast<size_t>(TemporalOutcome::Count)] = {};
+    uint64_t outcomesGI[static_cast<size_t>(TemporalOutcome::Count)] = {};
+    uint64_t cornersDI[4] = {};
+    uint64_t cornersGI[4] = {};
+    std::vector<uint64_t> histogramDI; // M after reuse, one bin per value up to 2 * M cap
+    std::vector<uint64_t> histogramGI;
+    double seconds = 0.0;
+
+    // Accepted over pixels the pass looked at (all but Skipped)
+    double AcceptanceDI() const;
+    double AcceptanceGI() const;
+    void Tally(const RestirSettings& settings);
+};
+
+// One pixel of RayGen2(); reads last, updates the pixel's entries in current
+TemporalPixelStats TemporalPassPixel(const SceneTracer& tracer, const TemporalCamera& camera,
+                                     const TemporalSettings& settings, uint32_t x, uint32_t y,
+                                     const RestirFrame& last, RestirFrame& current);
+
+// Whole frame, tile-parallel; both frames must have the same size. stats may be null. Returns seconds.
+double RunTemporalPass(const SceneTracer& tracer, ThreadPool& pool, const TemporalCamera& camera,
+                       const TemporalSettings& settings, const RestirFrame& last, RestirFrame& current,
+                       TemporalStats* stats = nullptr);
+
+// End of RayGen3: shaded pixels become next frame's history, emissive ones
+// keep whatever an earlier frame left there
+void StoreLastFrame(const RestirFrame& current, RestirFrame& last);
+
+#endif //PATHTRACER_TEMPORALPASS_H
@@ -0,0 +1,336 @@
+#ifndef PATHTRACER_TLSF_H
+#define PATHTRACER_TLSF_H
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit placement of resources in a memory range (the
+// renderer's ID3D12Heaps, Renderer::CreatePlacedBuffer). Free blocks are kept
+// in lists by size class: the first level is the power of two of the size,
+// the second splits it into 16 linear steps, and two levels of bitmaps find
+// the first non-empty list that holds blocks at least as large as a request.
+// Allocate and Free are O(1); a free block is merged with its free neighbors
+// right away, so no two free blocks are ever adjacent. Offsets and sizes are
+// in bytes, multiples of the granularity given to the constructor. No device
+// calls, so the allocator is fuzzed and timed by tools/TlsfAllocator.
+
+constexpr uint64_t kTlsfNone = ~0ull;
+
+struct TlsfAllocation {
+    uint64_t offset = kTlsfNone;
+    uint64_t size = 0;         // placed bytes, padding for the alignment excluded
+    uint32_t block = ~0u;      // for Free
+};
+
+struct TlsfStats {
+    uint64_t usedBytes = 0;     // live allocations, rounded to the granularity
+    uint64_t freeBytes = 0;
+    uint64_t largestFree = 0;   // the largest request Allocate can still place
+    uint64_t allocations = 0;   // Allocate calls that succeeded
+    uint64_t failures = 0;      // Allocate calls that found no block
+    uint32_t liveBlocks = 0;
+    uint32_t freeBlocks = 0;
+
+    // 0 when all free memory is one block, towards 1 as it splinters
+    double Fragmentation() const {
+        return freeBytes ? 1.0 - static_cast<double>(largestFree) / static_cast<double>(freeBytes) : 0.0;
+    }
+};
+
+class TlsfAllocator {
+public:
+    // capacity is rounded down and granularity up to a power of two
+    TlsfAllocator(uint64_t capacity, uint64_t granularity = 256) {
+        for (auto& level : m_heads) {
+            for (uint32_t& head : level) {
+                head = kNoBlock;
+            }
+        }
+        while ((1ull << m_granularityLog2) < granularity) {
+            m_granularityLog2++;
+        }
+        m_granularity = 1ull << m_granularityLog2;
+        m_capacity = capacity >> m_granularityLog2 << m_granularityLog2;
+        if (m_capacity) {
+            const uint32_t block = NewBlock();
+            m_blocks[block].offset = 0;
+            m_blocks[block].size = m_capacity;
+            InsertFree(block);
+        }
+    }
+
+    uint64_t Capacity() const { return m_capacity; }
+    uint64_t Granularity() const { return m_granularity; }
+
+    // size bytes at a power of two alignment; offset kTlsfNone when no free
+    // block fits
+    TlsfAllocation Allocate(uint64_t size, uint64_t alignment) {
+        TlsfAllocation result;
+        size = RoundUp(size ? size : 1, m_granularity);
+        alignment = alignment > m_granularity ? alignment : m_granularity;
+        // A block of size + alignment - granularity holds an aligned range
+        // wherever it starts
+        const uint64_t search = size + alignment - m_granularity;
+        const uint32_t block = FindFree(search);
+        if (block == kNoBlock) {
+            m_stats.failures++;
+            return result;
+        }
+        RemoveFree(block);
+
+        const uint64_t aligned = RoundUp(m_blocks[block].offset, alignment);
+        if (aligned > m_blocks[block].offset) {
+            // The front padding stays free; its physical predecessor is not
+            // free, the block was
+            const uint32_t front = Split(block, aligned - m_blocks[block].offset);
+            InsertFree(block);
+            Place(front, size);
+            return Finish(front, size, result);
+        }
+        Place(block, size);
+        return Finish(block, size, result);
+    }
+
+    void Free(const TlsfAllocation& allocation) {
+        uint32_t block = allocation.block;
+        if (allocation.offset == kTlsfNone || block >= m_blocks.size() || m_blocks[block].free) {
+            return;
+        }
+        m_stats.usedBytes -= m_blocks[block].size;
+        m_stats.liveBlocks--;
+        const uint32_t prev = m_blocks[block].prevPhys;
+        if (prev != kNoBlock && m_blocks[prev].free) {
+            RemoveFree(prev);
+            Merge(prev, block);
+            block = prev;
+        }
+        const uint32_t next = m_blocks[block].nextPhys;
+        if (next != kNoBlock && m_blocks[next].free) {
+            RemoveFree(next);
+            Merge(block, next);
+        }
+        InsertFree(block);
+    }
+
+    TlsfStats Stats() const {
+        TlsfStats stats = m_stats;
+        stats.freeBytes = m_capacity - stats.usedBytes;
+        // The largest free block is in the highest non-empty list
+        for (int fl = kFirstLevels - 1; fl >= 0 && !stats.largestFree; fl--) {
+            if (!(m_flBitmap & (1ull << fl))) {
+                continue;
+            }
+            const uint32_t sl = Log2(m_slBitmap[fl]);
+            for (uint32_t b = m_heads[fl][sl]; b != kNoBlock; b = m_blocks[b].nextFree) {
+                stats.largestFree = m_blocks[b].size > stats.largestFree ? m_blocks[b].size : stats.largestFree;
+            }
+        }
+        return stats;
+    }
+
+    // Walks the physical blocks: they tile the range, free ones are never
+    // adjacent and each is in the list of its size. For the checks.
+    bool Validate() const {
+        uint64_t offset = 0;
+        bool previousFree = false;
+        uint32_t freeCount = 0;
+        for (uint32_t b = m_first; b != kNoBlock; b = m_blocks[b].nextPhys) {
+            const Block& block = m_blocks[b];
+            if (block.offset != offset || block.size == 0 || block.size % m_granularity != 0) {
+                return false;
+            }
+            if (block.free) {
+                if (previousFree) {
+                    return false;
+                }
+                uint32_t fl, sl;
+                Mapping(block.size, fl, sl);
+                bool listed = false;
+                for (uint32_t f = m_heads[fl][sl]; f != kNoBlock && !listed; f = m_blocks[f].nextFree) {
+                    listed = f == b;
+                }
+                if (!listed) {
+                    return false;
+                }
+                freeCount++;
+            }
+            previousFree = block.free;
+            offset += block.size;
+        }
+        return offset == m_capacity && freeCount == m_stats.freeBlocks;
+    }
+
+private:
+    static constexpr uint32_t kNoBlock = ~0u;
+    static constexpr uint32_t kSlBits = 4;
+    static constexpr uint32_t kSlCount = 1u << kSlBits;
+    static constexpr int kFirstLevels = 64 - kSlBits + 1;
+
+    struct Block {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t prevPhys = kNoBlock;
+        uint32_t nextPhys = kNoBlock;
+        uint32_t prevFree = kNoBlock;
+        uint32_t nextFree = kNoBlock;
+        bool free = false;
+    };
+
+    static uint64_t RoundUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static uint32_t Log2(uint64_t value) { return static_cast<uint32_t>(std::bit_width(value)) - 1; }
+
+    static uint32_t LowestBit(uint64_t value) { return static_cast<uint32_t>(std::countr_zero(value)); }
+
+    // List of a size in granules: sizes below 16 granules have a list each,
+    // above that 16 lists per power of two
+    void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl) const {
+        const uint64_t units = size >> m_granularityLog2;
+        if (units < kSlCount) {
+            fl = 0;
+            sl = static_cast<uint32_t>(units);
+            return;
+        }
+        const uint32_t log = Log2(units);
+        fl = log - kSlBits + 1;
+        sl = static_cast<uint32_t>(units >> (log - kSlBits)) - kSlCount;
+    }
+
+    // A free block of at least size bytes: the request is rounded up to the
+    // next list boundary, so every block of that list or any later one fits
+    uint32_t FindFree(uint64_t size) const {
+        uint64_t units = size >> m_granularityLog2;
+        if (units >= kSlCount) {
+            units += (1ull << (Log2(units) - kSlBits)) - 1;
+        }
+        uint32_t fl, sl;
+        Mapping(units << m_granularityLog2, fl, sl);
+        if (fl >= static_cast<uint32_t>(kFirstLevels)) {
+            return kNoBlock;
+        }
+        uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+        if (!slMap) {
+            const uint64_t flMap = fl + 1 < 64 ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+            if (!flMap) {
+                return kNoBlock;
+            }
+            fl = LowestBit(flMap);
+            slMap = m_slBitmap[fl];
+        }
+        return m_heads[fl][LowestBit(slMap)];
+    }
+
+    void InsertFree(uint32_t b) {
+        uint32_t fl, sl;
+        Mapping(m_blocks[b].size, fl, sl);
+        Block& block = m_blocks[b];
+        block.free = true;
+        block.prevFree = kNoBlock;
+        block.nextFree = m_heads[fl][sl];
+        if (block.nextFree != kNoBlock) {
+            m_blocks[block.nextFree].prevFree = b;
+        }
+        m_heads[fl][sl] = b;
+        m_flBitmap |= 1ull << fl;
+        m_slBitmap[fl] |= 1u << sl;
+        m_stats.freeBlocks++;
+    }
+
+    void RemoveFree(uint32_t b) {
+        uint32_t fl, sl;
+        Mapping(m_blocks[b].size, fl, sl);
+        Block& block = m_blocks[b];
+        if (block.prevFree != kNoBlock) {
+            m_blocks[block.prevFree].nextFree = block.nextFree;
+        } else {
+            m_heads[fl][sl] = block.nextFree;
+        }
+        if (block.nextFree != kNoBlock) {
+            m_blocks[block.nextFree].prevFree = block.prevFree;
+        }
+        if (m_heads[fl][sl] == kNoBlock) {
+            m_slBitmap[fl] &= ~(1u << sl);
+            if (!m_slBitmap[fl]) {
+                m_flBitmap &= ~(1ull << fl);
+            }
+        }
+        block.free = false;
+        m_stats.freeBlocks--;
+    }
+
+    // Cuts the first size bytes off block b; returns the block of the rest
+    uint32_t Split(uint32_t b, uint64_t size) {
+        const uint32_t rest = NewBlock();
+        Block& block = m_blocks[b];
+        Block& tail = m_blocks[rest];
+        tail.offset = block.offset + size;
+        tail.size = block.size - size;
+        tail.prevPhys = b;
+        tail.nextPhys = block.nextPhys;
+        if (tail.nextPhys != kNoBlock) {
+            m_blocks[tail.nextPhys].prevPhys = rest;
+        }
+        block.size = size;
+        block.nextPhys = rest;
+        return rest;
+    }
+
+    // Appends the physical successor next to block b
+    void Merge(uint32_t b, uint32_t next) {
+        m_blocks[b].size += m_blocks[next].size;
+        m_blocks[b].nextPhys = m_blocks[next].nextPhys;
+        if (m_blocks[b].nextPhys != kNoBlock) {
+            m_blocks[m_blocks[b].nextPhys].prevPhys = b;
+        }
+        m_unused.push_back(next);
+    }
+
+    // Keeps size bytes of the taken block b, the rest goes back as free
+    void Place(uint32_t b, uint64_t size) {
+        if (m_blocks[b].size > size) {
+            InsertFree(Split(b, size));
+        }
+    }
+
+    TlsfAllocation Finish(uint32_t b, uint64_t size, TlsfAllocation& result) {
+        result.offset = m_blocks[b].offset;
+        result.size = size;
+        result.block = b;
+        m_stats.usedBytes += m_blocks[b].size;
+        m_stats.allocations++;
+        m_stats.liveBlocks++;
+        return result;
+    }
+
+    uint32_t NewBlock() {
+        uint32_t b;
+        if (!m_unused.empty()) {
+            b = m_unused.back();
+            m_unused.pop_back();
+            m_blocks[b] = Block();
+        } else {
+            b = static_cast<uint32_t>(m_blocks.size());
+            m_blocks.emplace_back();
+        }
+        if (m_blocks.size() == 1) {
+            m_first = b;
+        }
+        return b;
+    }
+
+    uint64_t m_capacity = 0;
+    uint64_t m_granularity = 1;
+    uint32_t m_granularityLog2 = 0;
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unused; // recycled entries of m_blocks
+    uint32_t m_first = kNoBlock;    // physical block at offset 0
+    uint64_t m_flBitmap = 0;
+    uint32_t m_slBitmap[kFirstLevels] = {};
+    uint32_t m_heads[kFirstLevels][kSlCount]; // first free block of each list
+    TlsfStats m_stats;
+};
+
+#endif //PATHTRACER_TLSF_H
@@ -0,0 +1,101 @@
+#ifndef PATHTRACER_UPLOADRING_H
+#define PATHTRACER_UPLOADRING_H
+
+#include <cstdint>
+#include <deque>
+
+// Offsets into the renderer's single persistently mapped upload buffer
+// (Renderer::m_uploadBuffer). Allocations are linear from a head that wraps
+// around; the space comes back once the fence value of the frame (or loading
+// flush) that used it has completed. Per-frame constants and the staging
+// copies of static buffers both come from here. No device calls, so the
+// allocator is checked by tools/UploadRing.
+
+constexpr uint64_t kUploadRingFull = ~0ull;
+
+struct UploadRingStats {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;          // requested, over all frames
+    uint64_t lastFrameBytes = 0; // requested by the last ended frame
+    uint64_t paddingBytes = 0;   // alignment and the skipped end when the head wraps
+    uint64_t peakUsed = 0;
+    uint64_t fullCount = 0;      // Allocate calls that found no room
+    uint64_t frames = 0;         // EndFrame calls
+};
+
+class UploadRing {
+public:
+    explicit UploadRing(uint64_t capacity) : m_capacity(capacity) {}
+
+    uint64_t Capacity() const { return m_capacity; }
+
+    // Bytes not yet retired, padding included
+    uint64_t Used() const { return m_used; }
+
+    // Offset of size bytes at a power of two alignment, or kUploadRingFull if
+    // there is no room until older frames retire
+    uint64_t Allocate(uint64_t size, uint64_t alignment) {
+        const uint64_t mask = (alignment ? alignment : 1) - 1;
+        uint64_t offset = (m_head + mask) & ~mask;
+        uint64_t padding = offset - m_head;
+        if (offset + size > m_capacity) {
+            // Skip the end of the buffer, an allocation never wraps
+            padding = m_capacity - m_head;
+            offset = 0;
+        }
+        if (m_used + padding + size > m_capacity) {
+            m_stats.fullCount++;
+            return kUploadRingFull;
+        }
+        m_head = offset + size;
+        m_used += padding + size;
+        m_frameUsed += padding + size;
+        m_frameBytes += size;
+        m_stats.allocations++;
+        m_stats.bytes += size;
+        m_stats.paddingBytes += padding;
+        if (m_used > m_stats.peakUsed) {
+            m_stats.peakUsed = m_used;
+        }
+        return offset;
+    }
+
+    // The allocations since the last call are free once fenceValue completes
+    void EndFrame(uint64_t fenceValue) {
+        m_pending.push_back({fenceValue, m_frameUsed});
+        m_stats.lastFrameBytes = m_frameBytes;
+        m_stats.frames++;
+        m_frameUsed = 0;
+        m_frameBytes = 0;
+    }
+
+    // Frees the frames whose fence value is at most completedValue
+    void Retire(uint64_t completedValue) {
+        while (!m_pending.empty() && m_pending.front().fenceValue <= completedValue) {
+            m_used -= m_pending.front().used;
+            m_pending.pop_front();
+        }
+        // Nothing live: start over at the front, the whole buffer is contiguous again
+        if (m_used == 0) {
+            m_head = 0;
+        }
+    }
+
+    const UploadRingStats& Stats() const { return m_stats; }
+
+private:
+    struct PendingFrame {
+        uint64_t fenceValue;
+        uint64_t used; // padding included
+    };
+
+    uint64_t m_capacity;
+    uint64_t m_head = 0;
+    uint64_t m_used = 0;
+    uint64_t m_frameUsed = 0;  // of the frame being recorded
+    uint64_t m_frameBytes = 0; // requested by the frame being recorded
+    std::deque<PendingFrame> m_pending;
+    UploadRingStats m_stats;
+};
+
+#endif //PATHTRACER_UPLOADRING_H
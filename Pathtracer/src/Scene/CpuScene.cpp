@@ -0,0 +1,293 @@
+#include "CpuScene.h"
+
+// The DX12 executable gets its tinyobj implementation from ObjLoader.h; the
+// portable library is its own link unit and carries its own copy.
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../../lib/tiny_obj_loader.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include "../Render/Brdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        // +0 and -0 compare equal, so they have to hash equal as well
+        auto h = [](float f) { return std::hash<float>()(f == 0.0f ? 0.0f : f); };
+        return h(p.x) ^ h(p.y) << 1 ^ h(p.z) << 2;
+    }
+};
+
+} // namespace
+
+void CpuCameraRays::Generate(float x, float y, glm::vec3& origin, glm::vec3& direction) const {
+    glm::vec2 d = (glm::vec2(x, y) /
+                   glm::vec2(static_cast<float>(width), static_cast<float>(height))) * 2.0f - 1.0f;
+    glm::vec4 target = projectionI * glm::vec4(d.x, -d.y, 1.0f, 1.0f);
+    origin = glm::vec3(viewI * glm::vec4(0, 0, 0, 1));
+    direction = glm::normalize(glm::vec3(viewI * glm::vec4(glm::vec3(target), 0.0f)));
+}
+
+glm::mat4 CpuCamera::View() const {
+    return glm::lookAt(eye, center, up);
+}
+
+glm::mat4 CpuCamera::Projection(uint32_t width, uint32_t height) const {
+    return glm::perspective(glm::radians(fovY), static_cast<float>(width) / static_cast<float>(height), zNear, zFar);
+}
+
+CpuCameraRays CpuCamera::Rays(uint32_t width, uint32_t height) const {
+    return {glm::inverse(View()), glm::inverse(Projection(width, height)), width, height};
+}
+
+void CpuCamera::GenerateRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                            glm::vec3& origin, glm::vec3& direction) const {
+    Rays(width, height).Generate(static_cast<float>(x), static_cast<float>(y), origin, direction);
+}
+
+bool CpuScene::LoadObj(const std::string& path, const glm::mat4& objectToWorld,
+                       const std::string& materialSearchPath) {
+    tinyobj::ObjReaderConfig readerConfig;
+    if (!materialSearchPath.empty()) {
+        readerConfig.mtl_search_path = materialSearchPath;
+    }
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(path, readerConfig)) {
+        std::cerr << "TinyObjReader: " << reader.Error();
+        return false;
+    }
+
+    const auto& attrib = reader.GetAttrib();
+    const auto& shapes = reader.GetShapes();
+    const auto& fileMaterials = reader.GetMaterials();
+
+    // Default material first, exactly like ObjLoader::loadObjFile
+    const uint32_t materialOffset = static_cast<uint32_t>(materials.size()) + 1;
+    CpuMaterial defaultMaterial;
+    defaultMaterial.Pr_Pm_Ps_Pc = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+    materials.push_back(defaultMaterial);
+
+    for (const auto& mat : fileMaterials) {
+        CpuMaterial m;
+        m.Kd = glm::vec4(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], mat.dissolve);
+        m.Pr_Pm_Ps_Pc = glm::vec4(mat.roughness, mat.metallic, mat.sheen, mat.clearcoat_thickness);
+        m.Ke = glm::vec3(mat.emission[0], mat.emission[1], mat.emission[2]);
+        m.Ks = glm::vec3(mat.specular[0], mat.specular[1], mat.specular[2]);
+        GenerateEssLUT(m, static_cast<uint32_t>(materials.size()));
+        materials.push_back(m);
+    }
+
+    const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(objectToWorld));
+    const uint32_t instanceID = static_cast<uint32_t>(instanceFirstTriangle.size());
+    instanceFirstTriangle.push_back(TriangleCount());
+
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> uniqueVertices;
+    for (const auto& shape : shapes) {
+        size_t indexOffset = 0;
+        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+            const int fv = shape.mesh.num_face_vertices[f];
+            const int materialID = f < shape.mesh.material_ids.size() ? shape.mesh.material_ids[f] : -1;
+
+            for (int v = 0; v < fv; v++) {
+                const tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
+                const glm::vec3 pos(attrib.vertices[3 * idx.vertex_index + 0],
+                                    attrib.vertices[3 * idx.vertex_index + 1],
+                                    attrib.vertices[3 * idx.vertex_index + 2]);
+
+                auto it = uniqueVertices.find(pos);
+                if (it == uniqueVertices.end()) {
+                    glm::vec3 normal(0.0f);
+                    if (idx.normal_index >= 0) {
+                        normal = glm::vec3(attrib.normals[3 * idx.normal_index + 0],
+                                           attrib.normals[3 * idx.normal_index + 1],
+                                           attrib.normals[3 * idx.normal_index + 2]);
+                    }
+                    // Hit_v6.hlsl only uses a vertex normal if every component is non-zero
+                    const bool usable = normal.x != 0.0f && normal.y != 0.0f && normal.z != 0.0f;
+
+                    it = uniqueVertices.emplace(pos, static_cast<uint32_t>(positions.size())).first;
+                    positions.push_back(glm::vec3(objectToWorld * glm::vec4(pos, 1.0f)));
+                    normals.push_back(usable ? normalMatrix * normal : glm::vec3(0.0f));
+                }
+                indices.push_back(it->second);
+            }
+
+            if (fv == 3) {
+                triangleMaterial.push_back(static_cast<uint32_t>(materialID + static_cast<int>(materialOffset)));
+                triangleInstance.push_back(instanceID);
+            }
+            indexOffset += fv;
+        }
+    }
+    CollectEmissiveTriangles();
+    return true;
+}
+
+bool CpuScene::LoadDefault(const std::string& assetDir) {
+    if (!LoadObj(assetDir + "garage.obj", glm::mat4(1.0f), assetDir)) {
+        return false;
+    }
+    // Scale -> Rotate -> Translate of Renderer::OnUpdate
+    const glm::mat4 monkeTransform = glm::rotate(glm::mat4(1.0f), 1.57f, glm::vec3(0.0f, 1.0f, 0.0f));
+    return LoadObj(assetDir + "monke.obj", monkeTransform, assetDir);
+}
+
+PreSplitStats CpuScene::PreSplit(const PreSplitSettings& settings) {
+    struct SplitVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+
+    PreSplitStats total;
+    std::vector<glm::vec3> newPositions, newNormals;
+    std::vector<uint32_t> newIndices, newMaterials, newInstances, newFirstTriangle;
+
+    for (size_t instance = 0; instance < instanceFirstTriangle.size(); instance++) {
+        const uint32_t first = instanceFirstTriangle[instance];
+        const uint32_t last = instance + 1 < instanceFirstTriangle.size()
+                              ? instanceFirstTriangle[instance + 1] : TriangleCount();
+
+        // Local copy of this instance's mesh, as the renderer would have it per model
+        std::vector<SplitVertex> vertices;
+        std::vector<uint32_t> localIndices;
+        std::unordered_map<uint32_t, uint32_t> remap;
+        std::vector<uint32_t> materials, instances;
+        for (uint32_t t = first; t < last; t++) {
+            for (int i = 0; i < 3; i++) {
+                const uint32_t index = indices[3 * t + i];
+                auto it = remap.find(index);
+                if (it == remap.end()) {
+                    it = remap.emplace(index, static_cast<uint32_t>(vertices.size())).first;
+                    vertices.push_back({positions[index], normals[index]});
+                }
+                localIndices.push_back(it->second);
+            }
+            materials.push_back(triangleMaterial[t]);
+            instances.push_back(triangleInstance[t]);
+        }
+
+        const PreSplitStats stats = PreSplitTriangles(
+                vertices, localIndices, settings,
+                [](const SplitVertex& v) { return v.position; },
+                [](const SplitVertex& a, const SplitVertex& b, float u) {
+                    // Unused normals stay zero so Hit_v6.hlsl keeps falling back to the flat normal
+                    const bool usable = a.normal != glm::vec3(0.0f) && b.normal != glm::vec3(0.0f);
+                    return SplitVertex{a.position + (b.position - a.position) * u,
+                                       usable ? a.normal + (b.normal - a.normal) * u : glm::vec3(0.0f)};
+                },
+                [&](uint32_t from, uint32_t) {
+                    materials.push_back(materials[from]);
+                    instances.push_back(instances[from]);
+                });
+        total.inputTriangles += stats.inputTriangles;
+        total.outputTriangles += stats.outputTriangles;
+        total.addedVertices += stats.addedVertices;
+        total.maxAreaFractionBefore = std::max(total.maxAreaFractionBefore, stats.maxAreaFractionBefore);
+        total.maxAreaFractionAfter = std::max(total.maxAreaFractionAfter, stats.maxAreaFractionAfter);
+
+        const uint32_t vertexBase = static_cast<uint32_t>(newPositions.size());
+        newFirstTriangle.push_back(static_cast<uint32_t>(newIndices.size() / 3));
+        for (const SplitVertex& v : vertices) {
+            newPositions.push_back(v.position);
+            newNormals.push_back(v.normal);
+        }
+        for (const uint32_t index : localIndices) {
+            newIndices.push_back(vertexBase + index);
+        }
+        newMaterials.insert(newMaterials.end(), materials.begin(), materials.end());
+        newInstances.insert(newInstances.end(), instances.begin(), instances.end());
+    }
+
+    positions.swap(newPositions);
+    normals.swap(newNormals);
+    indices.swap(newIndices);
+    triangleMaterial.swap(newMaterials);
+    triangleInstance.swap(newInstances);
+    instanceFirstTriangle.swap(newFirstTriangle);
+    CollectEmissiveTriangles();
+    return total;
+}
+
+void CpuScene::CollectEmissiveTriangles() {
+    emissiveTriangles.clear();
+    for (uint32_t t = 0; t < TriangleCount(); t++) {
+        const CpuMaterial& material = materials[triangleMaterial[t]];
+        if (material.Ke.x + material.Ke.y + material.Ke.z <= 0.0f) {
+            continue;
+        }
+        CpuLightTriangle light{};
+        light.x = positions[indices[3 * t + 0]];
+        light.y = positions[indices[3 * t + 1]];
+        light.z = positions[indices[3 * t + 2]];
+        light.triangle = t;
+        light.instanceID = triangleInstance[t];
+        light.emission = material.Ke;
+        // Renderer::ComputeTriangleWeight
+        const float area = 0.5f * glm::length(glm::cross(light.y - light.x, light.z - light.x));
+        light.weight = area * (material.Ke.x + material.Ke.y + material.Ke.z) / 3.0f;
+        emissiveTriangles.push_back(light);
+    }
+
+    std::stable_sort(emissiveTriangles.begin(), emissiveTriangles.end(),
+                     [](const CpuLightTriangle& a, const CpuLightTriangle& b) { return a.weight > b.weight; });
+
+    float totalWeight = 0.0f;
+    for (const CpuLightTriangle& light : emissiveTriangles) {
+        totalWeight += light.weight;
+    }
+    float cumulativeWeight = 0.0f;
+    for (CpuLightTriangle& light : emissiveTriangles) {
+        light.weight /= totalWeight;
+        cumulativeWeight += light.weight;
+        light.cdf = cumulativeWeight;
+        light.totalWeight = totalWeight;
+    }
+    if (!emissiveTriangles.empty()) {
+        emissiveTriangles.back().cdf = 1.0f;
+    }
+}
+
+uint32_t CpuScene::SampleEmissiveTriangle(float u) const {
+    int left = 0;
+    int right = static_cast<int>(emissiveTriangles.size()) - 1;
+    uint32_t selected = 0;
+    while (left <= right) {
+        const int mid = left + (right - left) / 2;
+        if (u < emissiveTriangles[mid].cdf) {
+            selected = static_cast<uint32_t>(mid);
+            right = mid - 1;
+        } else {
+            left = mid + 1;
+        }
+    }
+    return selected;
+}
+
+glm::vec3 CpuScene::GeometricNormal(uint32_t triangle) const {
+    const glm::vec3& p0 = positions[indices[3 * triangle + 0]];
+    const glm::vec3& p1 = positions[indices[3 * triangle + 1]];
+    const glm::vec3& p2 = positions[indices[3 * triangle + 2]];
+    return glm::normalize(glm::cross(p1 - p0, p2 - p0));
+}
+
+glm::vec3 CpuScene::ShadingNormal(uint32_t triangle, float u, float v) const {
+    const glm::vec3 flatNormal = GeometricNormal(triangle);
+    const float barycentrics[3] = {1.0f - u - v, u, v};
+
+    glm::vec3 smoothNormal(0.0f);
+    for (int i = 0; i < 3; i++) {
+        const glm::vec3& n = normals[indices[3 * triangle + i]];
+        smoothNormal += (n != glm::vec3(0.0f) ? n : flatNormal) * barycentrics[i];
+    }
+
+    if (glm::length(smoothNormal) > 0.0001f) {
+        return glm::normalize(smoothNormal);
+    }
+    return flatNormal;
+}
@@ -0,0 +1,106 @@
+#ifndef PATHTRACER_CPUSCENE_H
+#define PATHTRACER_CPUSCENE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "../Accel/PreSplit.h"
+
+// Portable mirror of the scene the DX12 renderer builds in Renderer::OnInit.
+// Geometry is flattened into world space (one triangle list for all instances)
+// so CPU tools can trace it without a device. Loading follows ObjLoader:
+// vertices are deduplicated by position only, every model gets a default
+// material in front of its file materials, and faces without a material map
+// onto that default.
+
+// Same layout as Material in Vertex.h / Common_v7.hlsl (128 bytes)
+struct CpuMaterial {
+    glm::vec4 Kd = {1, 1, 1, 1};
+    glm::vec3 Ks = {1, 1, 1};  float Ni = 1;
+    glm::vec3 Ke = {0, 0, 0};  float pad0 = 0;
+    glm::vec4 Pr_Pm_Ps_Pc = {0, 0, 0, 0};
+    float LUT[16] = {0};
+};
+static_assert(sizeof(CpuMaterial) == 128, "CpuMaterial must match the HLSL Material layout");
+
+// Inverse camera matrices for one resolution, as RayGen receives them in CameraParams
+struct CpuCameraRays {
+    glm::mat4 viewI;
+    glm::mat4 projectionI;
+    uint32_t width;
+    uint32_t height;
+
+    // Primary ray as built in RayGen; (x, y) is the pixel corner unless jittered
+    void Generate(float x, float y, glm::vec3& origin, glm::vec3& direction) const;
+};
+
+// Default camera of Renderer::CreateCameraBuffer / manipulator setup
+struct CpuCamera {
+    glm::vec3 eye = {-1.5f, 1.5f, 3.5f};
+    glm::vec3 center = {0.0f, 1.0f, 0.0f};
+    glm::vec3 up = {0.0f, 1.0f, 0.0f};
+    float fovY = 60.0f; // degrees
+    float zNear = 0.1f;
+    float zFar = 1000.0f;
+
+    glm::mat4 View() const;
+    glm::mat4 Projection(uint32_t width, uint32_t height) const;
+    CpuCameraRays Rays(uint32_t width, uint32_t height) const;
+
+    // Primary ray as built in RayGen: pixel corner, no jitter. Rebuilds the
+    // matrices on every call; use Rays() for whole images.
+    void GenerateRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                     glm::vec3& origin, glm::vec3& direction) const;
+};
+
+// Emissive triangle of Renderer::CollectEmissiveTriangles. The GPU buffer
+// (LightTriangle) keeps object space positions and converts them with the
+// instance transform; here they are already in world space.
+struct CpuLightTriangle {
+    glm::vec3 x, y, z;
+    uint32_t triangle;  // index into the scene's triangle list
+    uint32_t instanceID;
+    glm::vec3 emission;
+    float weight;       // normalized area * avg(Ke)
+    float cdf;
+    float totalWeight;  // sum of the unnormalized weights
+};
+
+class CpuScene {
+public:
+    // Loads an OBJ and appends it as a new instance transformed by objectToWorld
+    bool LoadObj(const std::string& path, const glm::mat4& objectToWorld = glm::mat4(1.0f),
+                 const std::string& materialSearchPath = "");
+
+    // garage.obj + monke.obj from assetDir with the instance transforms of Renderer::OnUpdate
+    bool LoadDefault(const std::string& assetDir);
+
+    // Runs the DXR pre-split pass over the loaded geometry, per instance like CreateVB would
+    PreSplitStats PreSplit(const PreSplitSettings& settings);
+
+    // Rebuilds emissiveTriangles from the current geometry; called by LoadObj and PreSplit
+    void CollectEmissiveTriangles();
+
+    // CDF lookup of SampleLightTriangle in Sampler_v6.hlsl
+    uint32_t SampleEmissiveTriangle(float u) const;
+
+    uint32_t TriangleCount() const { return static_cast<uint32_t>(indices.size() / 3); }
+
+    // Interpolated shading normal, same fallback rules as Hit_v6.hlsl
+    glm::vec3 ShadingNormal(uint32_t triangle, float u, float v) const;
+    glm::vec3 GeometricNormal(uint32_t triangle) const;
+
+    std::vector<glm::vec3> positions;       // world space
+    std::vector<glm::vec3> normals;         // world space, zero if the OBJ had none
+    std::vector<uint32_t> indices;          // 3 per triangle
+    std::vector<uint32_t> triangleMaterial; // per triangle, index into materials
+    std::vector<uint32_t> triangleInstance; // per triangle, InstanceID() on the GPU
+    std::vector<uint32_t> instanceFirstTriangle;
+    std::vector<CpuMaterial> materials;
+    std::vector<CpuLightTriangle> emissiveTriangles; // sorted by weight, descending
+    CpuCamera camera;
+};
+
+#endif //PATHTRACER_CPUSCENE_H
@@ -0,0 +1,79 @@
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+bool WritePfm(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    // Negative scale = little endian; PFM stores the bottom row first
+    std::fprintf(file, "PF\n%u %u\n-1.0\n", width, height);
+    for (uint32_t y = height; y-- > 0;) {
+        std::fwrite(&pixels[static_cast<size_t>(y) * width], sizeof(glm::vec3), width, file);
+    }
+    return std::fclose(file) == 0;
+}
+
+bool WriteHdr(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", height, width);
+
+    std::vector<uint8_t> scanline(static_cast<size_t>(width) * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const glm::vec3& c = pixels[static_cast<size_t>(y) * width + x];
+            const float r = std::max(c.r, 0.0f), g = std::max(c.g, 0.0f), b = std::max(c.b, 0.0f);
+            const float v = std::max(r, std::max(g, b));
+            uint8_t* rgbe = &scanline[static_cast<size_t>(x) * 4];
+            if (!(v >= 1e-32f) || !std::isfinite(v)) {
+                std::memset(rgbe, 0, 4);
+                continue;
+            }
+            int e;
+            const float scale = std::frexp(v, &e) * 256.0f / v;
+            rgbe[0] = static_cast<uint8_t>(r * scale);
+            rgbe[1] = static_cast<uint8_t>(g * scale);
+            rgbe[2] = static_cast<uint8_t>(b * scale);
+            rgbe[3] = static_cast<uint8_t>(e + 128);
+        }
+        std::fwrite(scanline.data(), 1, scanline.size(), file);
+    }
+    return std::fclose(file) == 0;
+}
+
+bool WriteImage(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels) {
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".hdr") == 0) {
+        return WriteHdr(path, width, height, pixels);
+    }
+    return WritePfm(path, width, height, pixels);
+}
+
+bool ReadPfm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<glm::vec3>& pixels) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[3] = {0};
+    float scale = 0.0f;
+    if (std::fscanf(file, "%2s %u %u %f", magic, &width, &height, &scale) != 4 || std::strcmp(magic, "PF") != 0 ||
+        scale >= 0.0f) {
+        std::fclose(file);
+        return false; // only little endian RGB maps, as written by WritePfm
+    }
+    std::fgetc(file); // single whitespace after the header
+
+    pixels.resize(static_cast<size_t>(width) * height);
+    bool ok = true;
+    for (uint32_t y = height; y-- > 0 && ok;) {
+        ok = std::fread(&pixels[static_cast<size_t>(y) * width], sizeof(glm::vec3), width, file) == width;
+    }
+    std::fclose(file);
+    return ok;
+}
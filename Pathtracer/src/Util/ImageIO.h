@@ -0,0 +1,22 @@
+#ifndef PATHTRACER_IMAGEIO_H
+#define PATHTRACER_IMAGEIO_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Linear HDR image output for the CPU renderers. pixels are row-major,
+// top row first, like the renderer's output texture.
+
+// Portable float map: uncompressed 32-bit floats, lossless
+bool WritePfm(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels);
+// Radiance RGBE (.hdr), flat scanlines; readable by most image viewers
+bool WriteHdr(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels);
+// Picks the writer from the file extension (.pfm or .hdr)
+bool WriteImage(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels);
+
+bool ReadPfm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<glm::vec3>& pixels);
+
+#endif //PATHTRACER_IMAGEIO_H
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    m_threadCount = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t i = 0; i < m_threadCount; i++) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (uint32_t i = 1; i < m_threadCount; i++) {
+        m_threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [&] { return m_busyWorkers == 0; });
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    {
+        // Workers that woke up late for the previous call may still be
+        // scanning the (empty) queues with its task; wait them out first
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [&] { return m_busyWorkers == 0; });
+
+        for (uint32_t t = 0; t < m_threadCount; t++) {
+            const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * t / m_threadCount);
+            const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (t + 1) / m_threadCount);
+            std::lock_guard<std::mutex> queueLock(m_queues[t]->mutex);
+            for (uint32_t i = begin; i < end; i++) {
+                m_queues[t]->items.push_back(i);
+            }
+        }
+        m_remaining.store(count, std::memory_order_relaxed);
+        m_task = &task;
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    RunTasks(0, task);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&] { return m_remaining.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::WorkerLoop(uint32_t threadIndex) {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        const std::function<void(uint32_t, uint32_t)>* task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+            if (m_stop) {
+                return;
+            }
+            seenGeneration = m_generation;
+            task = m_task;
+            m_busyWorkers++;
+        }
+
+        RunTasks(threadIndex, *task);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busyWorkers--;
+        }
+        m_done.notify_all();
+    }
+}
+
+void ThreadPool::RunTasks(uint32_t threadIndex, const std::function<void(uint32_t, uint32_t)>& task) {
+    uint32_t index;
+    while (Pop(threadIndex, index) || Steal(threadIndex, index)) {
+        task(index, threadIndex);
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // Lock so the notification cannot slip in between the caller's predicate check and its wait
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::Pop(uint32_t threadIndex, uint32_t& index) {
+    Queue& queue = *m_queues[threadIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.items.empty()) {
+        return false;
+    }
+    index = queue.items.front();
+    queue.items.pop_front();
+    return true;
+}
+
+bool ThreadPool::Steal(uint32_t threadIndex, uint32_t& index) {
+    for (uint32_t i = 1; i < m_threadCount; i++) {
+        Queue& victim = *m_queues[(threadIndex + i) % m_threadCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.items.empty()) {
+            index = victim.items.back();
+            victim.items.pop_back();
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
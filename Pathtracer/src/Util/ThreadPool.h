@@ -0,0 +1,64 @@
+#ifndef PATHTRACER_THREADPOOL_H
+#define PATHTRACER_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing pool for the CPU renderers. ParallelFor deals the
+// index range out in contiguous blocks, one per thread, so neighbouring tiles
+// stay on the same core; a thread that runs dry steals single indices from
+// the far end of another thread's block. The calling thread works as thread 0.
+class ThreadPool {
+public:
+    // threadCount = 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t ThreadCount() const { return m_threadCount; }
+
+    // Runs task(index, threadIndex) for every index in [0, count) and returns
+    // once all of them are done. threadIndex < ThreadCount() can be used to
+    // pick per-thread scratch data. Not reentrant.
+    void ParallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& task);
+
+    // Indices executed by a thread other than the one they were dealt to
+    uint64_t StealCount() const { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<uint32_t> items;
+    };
+
+    void WorkerLoop(uint32_t threadIndex);
+    void RunTasks(uint32_t threadIndex, const std::function<void(uint32_t, uint32_t)>& task);
+    bool Pop(uint32_t threadIndex, uint32_t& index);
+    bool Steal(uint32_t threadIndex, uint32_t& index);
+
+    uint32_t m_threadCount = 1;
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void(uint32_t, uint32_t)>* m_task = nullptr;
+    uint64_t m_generation = 0;
+    uint32_t m_busyWorkers = 0;
+    bool m_stop = false;
+
+    std::atomic<uint32_t> m_remaining{0};
+    std::atomic<uint64_t> m_steals{0};
+};
+
+#endif //PATHTRACER_THREADPOOL_H
@@ -0,0 +1,212 @@
+// Acceleration structure quality and traversal statistics for the default scene.
+//
+//   AccelStats [assetDir] [width] [height] [table|csv|json] [outFile]
+//
+// Builds the scene with every builder and reports SAH cost, EPO, the leaf
+// size histogram and the node / triangle tests per ray of primary, shadow
+// and one-bounce diffuse rays from the scene camera. The ray sets are
+// generated once from the binned SAH baseline, so every row traces exactly
+// the same rays; all numbers are step counts, independent of the machine.
+// csv / json are meant to be checked in or diffed between builds.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Accel/BvhStats.h"
+#include "../src/Accel/RayBatch.h"
+#include "../src/Scene/CpuScene.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+struct Config {
+    const char* name;
+    BvhBuildSettings settings;
+    bool preSplit;
+};
+
+struct RaySetStats {
+    const char* name;
+    size_t rays = 0;
+    double nodesPerRay = 0.0;
+    double trianglesPerRay = 0.0;
+    double hitRate = 0.0; // closest hit found, or occluded for shadow rays
+};
+
+struct Row {
+    const char* name;
+    uint32_t triangles;
+    BvhQuality quality;
+    RaySetStats raySets[3];
+};
+
+RaySetStats Trace(const char* name, const Bvh& bvh, const std::vector<BvhRay>& rays, bool shadow) {
+    BvhTraversalStats stats;
+    size_t hits = 0;
+    for (const BvhRay& ray : rays) {
+        BvhHit hit;
+        hits += shadow ? bvh.Occluded(ray, &stats) : bvh.Intersect(ray, hit, &stats);
+    }
+
+    RaySetStats result;
+    result.name = name;
+    result.rays = rays.size();
+    if (!rays.empty()) {
+        result.nodesPerRay = static_cast<double>(stats.nodeTests) / static_cast<double>(stats.rays);
+        result.trianglesPerRay = static_cast<double>(stats.triangleTests) / static_cast<double>(stats.rays);
+        result.hitRate = static_cast<double>(hits) / static_cast<double>(rays.size());
+    }
+    return result;
+}
+
+std::string Histogram(const std::vector<uint32_t>& histogram, const char* separator) {
+    std::string s;
+    for (size_t i = 0; i < histogram.size(); i++) {
+        s += (i > 0 ? separator : "") + std::to_string(histogram[i]);
+    }
+    return s;
+}
+
+void WriteTable(FILE* out, const std::vector<Row>& rows) {
+    std::fprintf(out, "%-20s %9s %8s %7s %5s %7s %8s %8s | %-13s | %-13s | %-13s | %s\n", "", "", "", "", "", "", "", "",
+                 "primary", "shadow", "diffuse", "");
+    std::fprintf(out, "%-20s %9s %8s %7s %5s %7s %8s %8s | %6s %6s | %6s %6s | %6s %6s | %s\n", "builder", "triangles",
+                 "refs", "nodes", "depth", "leaf", "SAH", "EPO", "nodes", "tris", "nodes", "tris", "nodes", "tris",
+                 "leaf size histogram (0..n)");
+    for (const Row& row : rows) {
+        const BvhQuality& q = row.quality;
+        std::fprintf(out, "%-20s %9u %8u %7u %5u %7.2f %8.2f %8.4f", row.name, row.triangles, q.references,
+                     q.nodeCount, q.maxDepth, q.averageLeafSize, q.sahCost, q.epo);
+        for (const RaySetStats& r : row.raySets) {
+            std::fprintf(out, " | %6.2f %6.2f", r.nodesPerRay, r.trianglesPerRay);
+        }
+        std::fprintf(out, " | %s\n", Histogram(q.leafSizeHistogram, " ").c_str());
+    }
+    if (!rows.empty()) {
+        for (const RaySetStats& r : rows[0].raySets) {
+            std::fprintf(out, "%s: %zu rays, %.1f%% %s\n", r.name, r.rays, 100.0 * r.hitRate,
+                         std::strcmp(r.name, "shadow") == 0 ? "occluded" : "hit");
+        }
+    }
+}
+
+void WriteCsv(FILE* out, const std::vector<Row>& rows) {
+    std::fprintf(out, "builder,triangles,references,nodes,leaves,max_depth,avg_leaf_depth,avg_leaf_size,sah,epo");
+    for (const char* set : {"primary", "shadow", "diffuse"}) {
+        std::fprintf(out, ",%s_rays,%s_nodes_per_ray,%s_tris_per_ray,%s_hit_rate", set, set, set, set);
+    }
+    std::fprintf(out, ",leaf_size_histogram\n");
+    for (const Row& row : rows) {
+        const BvhQuality& q = row.quality;
+        std::fprintf(out, "%s,%u,%u,%u,%u,%u,%.4f,%.4f,%.6f,%.6f", row.name, row.triangles, q.references,
+                     q.nodeCount, q.leafCount, q.maxDepth, q.averageLeafDepth, q.averageLeafSize, q.sahCost, q.epo);
+        for (const RaySetStats& r : row.raySets) {
+            std::fprintf(out, ",%zu,%.4f,%.4f,%.4f", r.rays, r.nodesPerRay, r.trianglesPerRay, r.hitRate);
+        }
+        std::fprintf(out, ",%s\n", Histogram(q.leafSizeHistogram, ";").c_str());
+    }
+}
+
+void WriteJson(FILE* out, const std::vector<Row>& rows) {
+    std::fprintf(out, "[\n");
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        const BvhQuality& q = row.quality;
+        std::fprintf(out, "  {\n    \"builder\": \"%s\",\n    \"triangles\": %u,\n    \"references\": %u,\n"
+                          "    \"nodes\": %u,\n    \"leaves\": %u,\n    \"maxDepth\": %u,\n"
+                          "    \"avgLeafDepth\": %.4f,\n    \"avgLeafSize\": %.4f,\n"
+                          "    \"sah\": %.6f,\n    \"epo\": %.6f,\n    \"leafSizeHistogram\": [%s],\n",
+                     row.name, row.triangles, q.references, q.nodeCount, q.leafCount, q.maxDepth,
+                     q.averageLeafDepth, q.averageLeafSize, q.sahCost, q.epo,
+                     Histogram(q.leafSizeHistogram, ", ").c_str());
+        for (size_t s = 0; s < 3; s++) {
+            const RaySetStats& r = row.raySets[s];
+            std::fprintf(out, "    \"%s\": {\"rays\": %zu, \"nodesPerRay\": %.4f, \"trisPerRay\": %.4f, "
+                              "\"hitRate\": %.4f}%s\n",
+                         r.name, r.rays, r.nodesPerRay, r.trianglesPerRay, r.hitRate, s < 2 ? "," : "");
+        }
+        std::fprintf(out, "  }%s\n", i + 1 < rows.size() ? "," : "");
+    }
+    std::fprintf(out, "]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 640;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 360;
+    const std::string format = argc > 4 ? argv[4] : "table";
+    const char* outPath = argc > 5 ? argv[5] : nullptr;
+    if (format != "table" && format != "csv" && format != "json") {
+        std::fprintf(stderr, "Unknown format '%s', expected table, csv or json\n", format.c_str());
+        return 1;
+    }
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+
+    std::vector<Config> configs;
+    configs.push_back({"binned SAH", {}, false});
+    Config sbvh{"SBVH", {}, false};
+    sbvh.settings.builder = BvhBuilder::Sbvh;
+    configs.push_back(sbvh);
+    configs.push_back({"pre-split + SAH", {}, true});
+
+    // Fixed ray sets from the baseline
+    Bvh baseline;
+    baseline.Build(scene.positions, scene.indices);
+    const std::vector<BvhRay> primary = GeneratePrimaryRays(scene, width, height);
+    std::vector<BvhHit> primaryHits(primary.size());
+    for (size_t i = 0; i < primary.size(); i++) {
+        baseline.Intersect(primary[i], primaryHits[i]);
+    }
+    const std::vector<BvhRay> shadow = GenerateShadowRays(scene, primary, primaryHits, 4321);
+    const std::vector<BvhRay> diffuse = GenerateDiffuseRays(scene, primary, primaryHits, 1234);
+
+    std::vector<Row> rows;
+    for (const Config& config : configs) {
+        CpuScene variant = scene;
+        if (config.preSplit) {
+            variant.PreSplit({});
+        }
+        Bvh bvh;
+        bvh.Build(variant.positions, variant.indices, config.settings);
+
+        Row row{config.name, variant.TriangleCount(), ComputeBvhQuality(bvh, variant.positions, variant.indices), {}};
+        row.raySets[0] = Trace("primary", bvh, primary, false);
+        row.raySets[1] = Trace("shadow", bvh, shadow, true);
+        row.raySets[2] = Trace("diffuse", bvh, diffuse, false);
+        rows.push_back(row);
+    }
+
+    FILE* out = stdout;
+    if (outPath) {
+        out = std::fopen(outPath, "w");
+        if (!out) {
+            std::fprintf(stderr, "Cannot open %s for writing\n", outPath);
+            return 1;
+        }
+    }
+    if (format == "csv") {
+        WriteCsv(out, rows);
+    } else if (format == "json") {
+        WriteJson(out, rows);
+    } else {
+        WriteTable(out, rows);
+    }
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
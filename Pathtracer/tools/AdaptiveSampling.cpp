@@ -0,0 +1,218 @@
+// Time to a target error with adaptive per-tile sampling vs uniform sampling
+// in the reference path tracer, on the default scene.
+//
+//   AdaptiveSampling [assetDir] [width] [height] [errorTarget] [referenceSpp] [threads] [timeBudget] [outPrefix]
+//
+// Renders a reference with referenceSpp samples per pixel from its own seed,
+// then adds uniform passes until the relative RMSE against it drops below
+// errorTarget, then runs RenderAdaptive with errorTarget as tile threshold
+// until the same holds (or the optional time budget in seconds is spent). The
+// measured error has the reference's own noise, as estimated from its half
+// buffers, taken out. Reports the render time to reach the target for both,
+// and when the half-buffer estimate alone would have stopped them. outPrefix
+// writes <prefix>_uniform.pfm, <prefix>_adaptive.pfm and <prefix>_spp.pfm
+// (samples per pixel of the adaptive run).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/ReferenceRenderer.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ImageIO.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+// Relative RMSE of the luminance, same definition as EstimateError, minus the
+// reference's own error (independent noise adds in quadrature)
+double RelativeRmse(const std::vector<glm::vec3>& estimate, const std::vector<glm::vec3>& reference,
+                    double referenceError) {
+    double squaredError = 0.0, sumReference = 0.0;
+    for (size_t i = 0; i < estimate.size(); i++) {
+        const double d = Luminance(estimate[i]) - Luminance(reference[i]);
+        squaredError += d * d;
+        sumReference += Luminance(reference[i]);
+    }
+    if (sumReference <= 0.0) {
+        return 0.0;
+    }
+    const double n = static_cast<double>(estimate.size());
+    const double measured = std::sqrt(squaredError / n) / (sumReference / n);
+    return std::sqrt(std::max(0.0, measured * measured - referenceError * referenceError));
+}
+
+struct RunResult {
+    double secondsToTarget = -1.0; // render time when the measured error first reached the target
+    uint64_t samplesToTarget = 0;
+    double secondsToEstimate = -1.0; // same for EstimateError
+    uint64_t samplesToEstimate = 0;
+    double seconds = 0.0;          // whole run
+    double error = 0.0;            // measured at the end
+    double estimatedError = 0.0;   // EstimateError at the end
+    uint64_t samples = 0;
+    std::vector<glm::vec3> image;
+};
+
+void PrintRun(const char* name, const RunResult& run, uint32_t pixels) {
+    std::printf("  %-8s %7.2f s, %7.1f spp, estimated %.4f, measured %.4f", name, run.seconds,
+                static_cast<double>(run.samples) / pixels, run.estimatedError, run.error);
+    if (run.secondsToEstimate >= 0.0) {
+        std::printf("  | estimate at target after %7.2f s, %7.1f spp", run.secondsToEstimate,
+                    static_cast<double>(run.samplesToEstimate) / pixels);
+    }
+    if (run.secondsToTarget >= 0.0) {
+        std::printf("  | target after %7.2f s, %7.1f spp\n", run.secondsToTarget,
+                    static_cast<double>(run.samplesToTarget) / pixels);
+    } else {
+        std::printf("  | target not reached\n");
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 320;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 180;
+    const float errorTarget = argc > 4 ? static_cast<float>(std::atof(argv[4])) : 0.05f;
+    const uint32_t referenceSpp = argc > 5 ? static_cast<uint32_t>(std::atoi(argv[5])) : 1024;
+    const uint32_t threads = argc > 6 ? static_cast<uint32_t>(std::atoi(argv[6])) : 0;
+    const double timeBudget = argc > 7 ? std::atof(argv[7]) : 0.0;
+    const std::string outPrefix = argc > 8 ? argv[8] : "";
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(threads);
+    const uint32_t pixels = width * height;
+
+    ReferenceSettings settings;
+    settings.width = width;
+    settings.height = height;
+    AdaptiveSettings adaptive;
+    adaptive.errorTarget = errorTarget;
+    adaptive.timeBudget = timeBudget;
+    std::printf("Adaptive sampling: %ux%u, target relative RMSE %.4f, %u px tiles, %u + %u spp passes, "
+                "%u threads\n", width, height, errorTarget, settings.tileSize, adaptive.initialSamples,
+                adaptive.passSamples, pool.ThreadCount());
+
+    ReferenceRenderer renderer(tracer, pool);
+    ReferenceSettings referenceSettings = settings;
+    referenceSettings.seed = 1;
+    renderer.Reset(referenceSettings);
+    renderer.Render(referenceSpp);
+    const std::vector<glm::vec3> reference = renderer.Image();
+    const double referenceError = renderer.EstimateError();
+    std::printf("reference: %u spp in %.2f s, estimated error %.4f\n", referenceSpp, renderer.Stats().seconds,
+                referenceError);
+    if (referenceError > errorTarget / 3.0f) {
+        std::printf("  warning: the reference is not much cleaner than the target, raise referenceSpp\n");
+    }
+
+    // Uniform: the same passes on every tile until the measured error reaches the target
+    RunResult uniform;
+    renderer.Reset(settings);
+    renderer.Render(adaptive.initialSamples);
+    while (true) {
+        uniform.image = renderer.Image();
+        uniform.error = RelativeRmse(uniform.image, reference, referenceError);
+        if (uniform.secondsToEstimate < 0.0 && renderer.EstimateError() <= errorTarget) {
+            uniform.secondsToEstimate = renderer.Stats().seconds;
+            uniform.samplesToEstimate = renderer.TotalSampleCount();
+        }
+        if (uniform.error <= errorTarget) {
+            uniform.secondsToTarget = renderer.Stats().seconds;
+            uniform.samplesToTarget = renderer.TotalSampleCount();
+            break;
+        }
+        if (renderer.SampleCount() + adaptive.passSamples > adaptive.maxSamples ||
+            (timeBudget > 0.0 && renderer.Stats().seconds >= timeBudget)) {
+            break;
+        }
+        renderer.Render(adaptive.passSamples);
+    }
+    uniform.seconds = renderer.Stats().seconds;
+    uniform.estimatedError = renderer.EstimateError();
+    uniform.samples = renderer.TotalSampleCount();
+
+    // Adaptive: the tiles are picked against the target, but the run only
+    // stops, like the uniform one, once the measured error is there
+    RunResult adaptiveRun;
+    renderer.Reset(settings);
+    AdaptiveSettings measured = adaptive;
+    measured.tileThreshold = errorTarget;
+    measured.errorTarget = 0.0f;
+    const AdaptiveStats stats = renderer.RenderAdaptive(measured, [&](const AdaptiveStats& pass) {
+        if (adaptiveRun.secondsToEstimate < 0.0 && pass.estimatedError <= errorTarget) {
+            adaptiveRun.secondsToEstimate = pass.seconds;
+            adaptiveRun.samplesToEstimate = renderer.TotalSampleCount();
+        }
+        if (RelativeRmse(renderer.Image(), reference, referenceError) <= errorTarget) {
+            adaptiveRun.secondsToTarget = pass.seconds;
+            adaptiveRun.samplesToTarget = renderer.TotalSampleCount();
+            return false;
+        }
+        return true;
+    });
+    adaptiveRun.image = renderer.Image();
+    adaptiveRun.seconds = stats.seconds;
+    adaptiveRun.error = RelativeRmse(adaptiveRun.image, reference, referenceError);
+    adaptiveRun.estimatedError = stats.estimatedError;
+    adaptiveRun.samples = renderer.TotalSampleCount();
+
+    uint32_t minSamples = ~0u, maxSamples = 0;
+    for (uint32_t t = 0; t < renderer.TileCount(); t++) {
+        minSamples = std::min(minSamples, renderer.TileSampleCount(t));
+        maxSamples = std::max(maxSamples, renderer.TileSampleCount(t));
+    }
+    std::printf("adaptive: %u passes, last pass %u of %u tiles above %.4f, tile spp %u..%u\n", stats.passes,
+                stats.activeTiles, renderer.TileCount(), stats.tileThreshold, minSamples, maxSamples);
+    PrintRun("uniform", uniform, pixels);
+    PrintRun("adaptive", adaptiveRun, pixels);
+    if (uniform.secondsToTarget > 0.0 && adaptiveRun.secondsToTarget > 0.0) {
+        std::printf("time to target: %.2fx faster adaptive (%.2fx fewer samples)\n",
+                    uniform.secondsToTarget / adaptiveRun.secondsToTarget,
+                    static_cast<double>(uniform.samplesToTarget) / static_cast<double>(adaptiveRun.samplesToTarget));
+    }
+
+    if (!outPrefix.empty()) {
+        std::vector<glm::vec3> samplesPerPixel(pixels);
+        for (uint32_t t = 0; t < renderer.TileCount(); t++) {
+            uint32_t x0, y0, x1, y1;
+            renderer.TileBounds(t, x0, y0, x1, y1);
+            for (uint32_t y = y0; y < y1; y++) {
+                for (uint32_t x = x0; x < x1; x++) {
+                    samplesPerPixel[y * width + x] = glm::vec3(static_cast<float>(renderer.TileSampleCount(t)));
+                }
+            }
+        }
+        if (!WritePfm(outPrefix + "_uniform.pfm", width, height, uniform.image) ||
+            !WritePfm(outPrefix + "_adaptive.pfm", width, height, adaptiveRun.image) ||
+            !WritePfm(outPrefix + "_spp.pfm", width, height, samplesPerPixel)) {
+            std::fprintf(stderr, "Cannot write %s_*.pfm\n", outPrefix.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
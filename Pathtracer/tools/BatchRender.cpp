@@ -0,0 +1,412 @@
+// Headless batch renderer for nightly performance and quality runs: renders a
+// camera path with the CPU backends, no window or device needed.
+//
+//   BatchRender [--scene default|file.obj]... [--assets dir] [--camera orbit:deg|path.txt]
+//               [--size WxH] [--frames n] [--backend reference|restir] [--spp n] [--bounces n]
+//               [--nee n] [--seed n] [--threads n] [--format hdr|pfm] [--out prefix]
+//               [--help]
+//
+// --scene may repeat; every OBJ becomes one instance, "default" loads the
+// garage + monke scene of Renderer::OnInit from --assets. The camera either
+// orbits the scene's camera around its center by deg degrees per frame or
+// follows a keyframe file, one keyframe per line:
+//
+//   frame  eye.x eye.y eye.z  center.x center.y center.z  [fovY]
+//
+// linearly interpolated between keyframes and held before the first / after
+// the last ('#' starts a comment). The reference backend renders --spp
+// samples per frame with --bounces scattering vertices, every frame from its
+// own seed; the restir backend (--nee light candidates, --bounces - 1 bounces
+// after the reconnection vertex) runs the init, temporal and spatial passes once
+// per frame with history carried over, like the GPU renderer. Frames go to
+// <prefix>_0000.hdr (.pfm) and the per-frame timings and statistics to
+// <prefix>_timing.csv.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/InitPass.h"
+#include "../src/Render/ReferenceRenderer.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Render/SpatialPass.h"
+#include "../src/Render/TemporalPass.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ImageIO.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+enum class Backend {
+    Reference,
+    Restir,
+};
+
+struct Options {
+    std::vector<std::string> scenes;
+    std::string assetDir = PATHTRACER_ASSET_DIR;
+    std::string camera = "orbit:0";
+    uint32_t width = 960;
+    uint32_t height = 540;
+    uint32_t frames = 1;
+    Backend backend = Backend::Reference;
+    uint32_t spp = 16;
+    uint32_t bounces = 4;
+    uint32_t nee = 4;
+    uint32_t seed = 0;
+    uint32_t threads = 0;
+    std::string format = "hdr";
+    std::string out = "batch";
+    bool help = false;
+};
+
+struct Keyframe {
+    float frame;
+    glm::vec3 eye;
+    glm::vec3 center;
+    float fovY;
+};
+
+struct FrameTiming {
+    double seconds = 0.0; // whole frame, without the image write
+    double initSeconds = 0.0;
+    double temporalSeconds = 0.0;
+    double spatialSeconds = 0.0;
+    uint64_t rays = 0;
+    uint64_t shadowRays = 0;
+    double meanLuminance = 0.0;
+};
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+bool ParseSize(const std::string& text, uint32_t& width, uint32_t& height) {
+    const size_t x = text.find('x');
+    if (x == std::string::npos) {
+        return false;
+    }
+    width = static_cast<uint32_t>(std::atoi(text.substr(0, x).c_str()));
+    height = static_cast<uint32_t>(std::atoi(text.substr(x + 1).c_str()));
+    return width > 0 && height > 0;
+}
+
+// The options with their defaults
+void PrintUsage(std::FILE* out) {
+    const Options defaults;
+    std::fprintf(out,
+                 "Usage: BatchRender [options]\n"
+                 "  --scene default|file.obj   scene to load, may repeat (default)\n"
+                 "  --assets dir               assets of the default scene (%s)\n"
+                 "  --camera orbit:deg|path    orbit by deg per frame or keyframe file (%s)\n"
+                 "  --size WxH                 image size (%ux%u)\n"
+                 "  --frames n                 frames to render (%u)\n"
+                 "  --backend reference|restir renderer (reference)\n"
+                 "  --spp n                    reference samples per pixel (%u)\n"
+                 "  --bounces n                scattering vertices (%u)\n"
+                 "  --nee n                    restir light candidates (%u)\n"
+                 "  --seed n                   first seed (%u)\n"
+                 "  --threads n                worker threads, 0 for all cores (%u)\n"
+                 "  --format hdr|pfm           image format (%s)\n"
+                 "  --out prefix               output file prefix (%s)\n"
+                 "  --help, -h                 print this text\n",
+                 defaults.assetDir.c_str(), defaults.camera.c_str(), defaults.width, defaults.height,
+                 defaults.frames, defaults.spp, defaults.bounces, defaults.nee, defaults.seed, defaults.threads,
+                 defaults.format.c_str(), defaults.out.c_str());
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string key = argv[i];
+        if (key == "--help" || key == "-h") {
+            options.help = true;
+            return true;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", key.c_str());
+            return false;
+        }
+        const std::string value = argv[++i];
+        const uint32_t number = static_cast<uint32_t>(std::atoi(value.c_str()));
+        if (key == "--scene") {
+            options.scenes.push_back(value);
+        } else if (key == "--assets") {
+            options.assetDir = value;
+        } else if (key == "--camera") {
+            options.camera = value;
+        } else if (key == "--size") {
+            if (!ParseSize(value, options.width, options.height)) {
+                std::fprintf(stderr, "Bad size '%s', expected WxH\n", value.c_str());
+                return false;
+            }
+        } else if (key == "--frames") {
+            options.frames = std::max(number, 1u);
+        } else if (key == "--backend") {
+            if (value == "reference") {
+                options.backend = Backend::Reference;
+            } else if (value == "restir") {
+                options.backend = Backend::Restir;
+            } else {
+                std::fprintf(stderr, "Unknown backend '%s', expected reference or restir\n", value.c_str());
+                return false;
+            }
+        } else if (key == "--spp") {
+            options.spp = std::max(number, 1u);
+        } else if (key == "--bounces") {
+            options.bounces = std::max(number, 1u);
+        } else if (key == "--nee") {
+            options.nee = std::max(number, 1u);
+        } else if (key == "--seed") {
+            options.seed = number;
+        } else if (key == "--threads") {
+            options.threads = number;
+        } else if (key == "--format") {
+            if (value != "hdr" && value != "pfm") {
+                std::fprintf(stderr, "Unknown format '%s', expected hdr or pfm\n", value.c_str());
+                return false;
+            }
+            options.format = value;
+        } else if (key == "--out") {
+            options.out = value;
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", key.c_str());
+            return false;
+        }
+    }
+    if (options.scenes.empty()) {
+        options.scenes.push_back("default");
+    }
+    return true;
+}
+
+bool LoadScene(const Options& options, CpuScene& scene) {
+    for (const std::string& name : options.scenes) {
+        bool loaded;
+        if (name == "default") {
+            loaded = scene.LoadDefault(options.assetDir);
+        } else {
+            const size_t slash = name.find_last_of("/\\");
+            loaded = scene.LoadObj(name, glm::mat4(1.0f), slash == std::string::npos ? "" : name.substr(0, slash + 1));
+        }
+        if (!loaded) {
+            std::fprintf(stderr, "Failed to load scene %s\n", name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadKeyframes(const std::string& path, float defaultFov, std::vector<Keyframe>& keys) {
+    std::ifstream file(path);
+    if (!file) {
+        std::fprintf(stderr, "Cannot open camera path %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        Keyframe key{};
+        if (!(stream >> key.frame)) {
+            continue; // blank or comment
+        }
+        if (!(stream >> key.eye.x >> key.eye.y >> key.eye.z >> key.center.x >> key.center.y >> key.center.z)) {
+            std::fprintf(stderr, "%s:%u: expected frame, eye and center\n", path.c_str(), lineNumber);
+            return false;
+        }
+        if (!(stream >> key.fovY)) {
+            key.fovY = defaultFov;
+        }
+        keys.push_back(key);
+    }
+    if (keys.empty()) {
+        std::fprintf(stderr, "%s has no keyframes\n", path.c_str());
+        return false;
+    }
+    std::stable_sort(keys.begin(), keys.end(), [](const Keyframe& a, const Keyframe& b) { return a.frame < b.frame; });
+    return true;
+}
+
+CpuCamera OrbitCamera(const CpuCamera& base, float degrees) {
+    CpuCamera camera = base;
+    const glm::vec3 offset = base.eye - base.center;
+    const float angle = glm::radians(degrees);
+    const float c = std::cos(angle), s = std::sin(angle);
+    camera.eye = base.center + glm::vec3(c * offset.x + s * offset.z, offset.y, -s * offset.x + c * offset.z);
+    return camera;
+}
+
+CpuCamera KeyframeCamera(const CpuCamera& base, const std::vector<Keyframe>& keys, float frame) {
+    size_t next = 0;
+    while (next < keys.size() && keys[next].frame <= frame) {
+        next++;
+    }
+    const Keyframe& a = keys[next == 0 ? 0 : next - 1];
+    const Keyframe& b = keys[std::min(next, keys.size() - 1)];
+    const float t = b.frame > a.frame ? std::clamp((frame - a.frame) / (b.frame - a.frame), 0.0f, 1.0f) : 0.0f;
+    CpuCamera camera = base;
+    camera.eye = glm::mix(a.eye, b.eye, t);
+    camera.center = glm::mix(a.center, b.center, t);
+    camera.fovY = a.fovY + (b.fovY - a.fovY) * t;
+    return camera;
+}
+
+std::string FramePath(const Options& options, uint32_t frame) {
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%04u.", frame);
+    return options.out + number + options.format;
+}
+
+double MeanLuminance(const std::vector<glm::vec3>& image) {
+    double sum = 0.0;
+    size_t count = 0;
+    for (const glm::vec3& c : image) {
+        const float l = Luminance(c);
+        if (std::isfinite(l)) {
+            sum += l;
+            count++;
+        }
+    }
+    return count ? sum / static_cast<double>(count) : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(stderr);
+        return 1;
+    }
+    if (options.help) {
+        PrintUsage(stdout);
+        return 0;
+    }
+
+    CpuScene scene;
+    if (!LoadScene(options, scene)) {
+        return 1;
+    }
+    const CpuCamera baseCamera = scene.camera;
+    float degreesPerFrame = 0.0f;
+    std::vector<Keyframe> keys;
+    if (options.camera.rfind("orbit:", 0) == 0) {
+        degreesPerFrame = static_cast<float>(std::atof(options.camera.c_str() + 6));
+    } else if (!ReadKeyframes(options.camera, baseCamera.fovY, keys)) {
+        return 1;
+    }
+
+    const auto buildStart = std::chrono::high_resolution_clock::now();
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    const double buildSeconds =
+        std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - buildStart).count();
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(options.threads);
+
+    const bool reference = options.backend == Backend::Reference;
+    std::printf("Batch render: %s backend, %ux%u, %u frames, %u triangles (BVH %.2f s), %u threads\n",
+                reference ? "reference" : "restir", options.width, options.height, options.frames,
+                scene.TriangleCount(), buildSeconds, pool.ThreadCount());
+
+    const std::string csvPath = options.out + "_timing.csv";
+    std::FILE* csv = std::fopen(csvPath.c_str(), "w");
+    if (!csv) {
+        std::fprintf(stderr, "Cannot write %s\n", csvPath.c_str());
+        return 1;
+    }
+    std::fprintf(csv, "frame,backend,width,height,spp,bounces,seconds,init_seconds,temporal_seconds,"
+                      "spatial_seconds,rays,shadow_rays,mean_luminance\n");
+
+    // Reference backend
+    ReferenceSettings referenceSettings;
+    referenceSettings.width = options.width;
+    referenceSettings.height = options.height;
+    referenceSettings.maxBounces = options.bounces;
+    ReferenceRenderer renderer(tracer, pool);
+
+    // ReSTIR backend; the passes keep their state across frames
+    InitPassSettings initSettings;
+    TemporalSettings temporalSettings;
+    SpatialSettings spatialSettings;
+    for (RestirSettings* restir : {&initSettings.restir, &temporalSettings.restir, &spatialSettings.restir}) {
+        // maxBounces counts the reconnection vertex, RestirSettings::bounces only the bounces after it
+        restir->bounces = std::max(options.bounces, 2u) - 1;
+        restir->neeSamples = restir->neeSamplesDI = options.nee;
+    }
+    RestirFrame current, last;
+    if (!reference) {
+        current.Resize(options.width, options.height);
+        last.Resize(options.width, options.height);
+    }
+
+    std::vector<glm::vec3> image;
+    CpuCamera previous{};
+    double totalSeconds = 0.0;
+    for (uint32_t f = 0; f < options.frames; f++) {
+        const CpuCamera camera = keys.empty() ? OrbitCamera(baseCamera, degreesPerFrame * static_cast<float>(f))
+                                              : KeyframeCamera(baseCamera, keys, static_cast<float>(f));
+        if (f == 0) {
+            previous = camera;
+        }
+
+        FrameTiming timing;
+        const auto start = std::chrono::high_resolution_clock::now();
+        if (reference) {
+            // The renderer takes its camera from the scene
+            scene.camera = camera;
+            referenceSettings.seed = options.seed + f;
+            renderer.Reset(referenceSettings);
+            renderer.Render(options.spp);
+            image = renderer.Image();
+            timing.rays = renderer.Stats().rays;
+            timing.shadowRays = renderer.Stats().shadowRays;
+        } else {
+            initSettings.time = temporalSettings.time = spatialSettings.time = options.seed + f;
+            timing.initSeconds = RunInitPass(tracer, pool, camera.Rays(options.width, options.height), initSettings,
+                                             current);
+            timing.temporalSeconds =
+                RunTemporalPass(tracer, pool, MakeTemporalCamera(camera, previous, options.width, options.height),
+                                temporalSettings, last, current);
+            timing.spatialSeconds =
+                RunSpatialPass(tracer, pool, camera.eye, spatialSettings, current, last, &image);
+        }
+        timing.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        timing.meanLuminance = MeanLuminance(image);
+        previous = camera;
+        totalSeconds += timing.seconds;
+
+        const std::string path = FramePath(options, f);
+        if (!WriteImage(path, options.width, options.height, image)) {
+            std::fprintf(stderr, "Cannot write %s\n", path.c_str());
+            std::fclose(csv);
+            return 1;
+        }
+        std::fprintf(csv, "%u,%s,%u,%u,%u,%u,%.6f,%.6f,%.6f,%.6f,%llu,%llu,%.6f\n", f,
+                     reference ? "reference" : "restir", options.width, options.height, reference ? options.spp : 1u,
+                     options.bounces, timing.seconds, timing.initSeconds, timing.temporalSeconds,
+                     timing.spatialSeconds, static_cast<unsigned long long>(timing.rays),
+                     static_cast<unsigned long long>(timing.shadowRays), timing.meanLuminance);
+        std::fflush(csv);
+        std::printf("frame %4u  %8.3f s  mean %.4f  %s\n", f, timing.seconds, timing.meanLuminance, path.c_str());
+    }
+    std::fclose(csv);
+    std::printf("%u frames in %.2f s (%.3f s/frame), timings in %s\n", options.frames, totalSeconds,
+                totalSeconds / options.frames, csvPath.c_str());
+    return 0;
+}
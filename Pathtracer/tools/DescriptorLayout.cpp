@@ -0,0 +1,249 @@
+// Checks of the descriptor heap allocator and the binding table generated
+// from kDescriptorBindings (DescriptorLayout.h), without a device.
+//
+//   DescriptorLayout [operations]
+//
+// Prints the heap slots of the renderer's bindings and the descriptor ranges
+// of the ray generation and hit root signatures, and checks that every
+// binding is in exactly one range of each signature that sees it, that no
+// two bindings share a slot or a register, and that a binding resized to more
+// descriptors moves without renumbering the others. The persistent ranges are
+// then fuzzed with random allocations and frees against a shadow copy of the
+// heap, and the per-frame ranges replayed over a few frames. Any failure makes
+// the exit code 1.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Render/DescriptorLayout.h"
+#include "../src/Render/Rng.h"
+
+namespace {
+
+// Renderer::PersistentDescriptors, FrameCount, FrameDescriptors
+constexpr uint32_t kPersistent = 64;
+constexpr uint32_t kFramesInFlight = 2;
+constexpr uint32_t kPerFrame = 16;
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+std::string Describe(const DescriptorRange& r) {
+    std::string s = DescriptorTypeName(r.type) + std::to_string(r.shaderRegister);
+    if (r.count > 1) {
+        s += "-" + std::string(DescriptorTypeName(r.type)) + std::to_string(r.shaderRegister + r.count - 1);
+    }
+    if (r.space) {
+        s += " space" + std::to_string(r.space);
+    }
+    return s + "@" + std::to_string(r.heapOffset);
+}
+
+void ExpectRanges(const char* name, const BindingTable& table, uint8_t visibility,
+                  const std::vector<std::string>& expected) {
+    const std::vector<DescriptorRange> ranges = table.Ranges(visibility);
+    std::string got, want;
+    for (const DescriptorRange& r : ranges) {
+        got += (got.empty() ? "" : ", ") + Describe(r);
+    }
+    for (const std::string& e : expected) {
+        want += (want.empty() ? "" : ", ") + e;
+    }
+    std::printf("  %-7s %s\n", name, got.c_str());
+    if (got != want) {
+        std::printf("      expected %s\n", want.c_str());
+        g_failures++;
+    }
+
+    // Every visible binding in exactly one range, at its slot and register
+    for (const DescriptorBinding& b : kDescriptorBindings) {
+        uint32_t found = 0;
+        for (const DescriptorRange& r : ranges) {
+            if (r.type == b.type && r.space == b.space && b.shaderRegister >= r.shaderRegister &&
+                b.shaderRegister < r.shaderRegister + r.count) {
+                found++;
+                Check(r.heapOffset + (b.shaderRegister - r.shaderRegister) == table.Slot(b.binding),
+                      "a range maps a register to the slot of its binding");
+            }
+        }
+        Check(found == ((b.visibility & visibility) ? 1u : 0u), "a binding is in one range of each signature");
+    }
+}
+
+void RendererTable() {
+    std::printf("renderer bindings (%u persistent, %u x %u per frame)\n", kPersistent, kFramesInFlight, kPerFrame);
+    DescriptorAllocator allocator(kPersistent, kFramesInFlight, kPerFrame);
+    const BindingTable table = AllocateBindingTable(allocator);
+    for (const DescriptorBinding& b : kDescriptorBindings) {
+        std::printf("  %2u %s%u %s\n", table.Slot(b.binding), DescriptorTypeName(b.type), b.shaderRegister, b.name);
+    }
+    for (uint32_t i = 0; i < static_cast<uint32_t>(Binding::Count); i++) {
+        // The heap order of the hand-numbered layout before the table
+        Check(table.slots[i] == i, "bindings keep their slots");
+        for (uint32_t j = 0; j < i; j++) {
+            const DescriptorBinding& a = kDescriptorBindings[i];
+            const DescriptorBinding& b = kDescriptorBindings[j];
+            Check(a.binding != b.binding, "one row per binding");
+            Check(!(a.type == b.type && a.space == b.space && a.shaderRegister == b.shaderRegister &&
+                    (a.visibility & b.visibility)),
+                  "no register is bound twice in a signature");
+        }
+    }
+    ExpectRanges("raygen", table, kVisibleRayGen, {"u0@0", "t0@1", "b0@2", "t3-t6@3", "u1-u7@7"});
+    ExpectRanges("hit", table, kVisibleHit, {"t0@1", "t3-t6@3"});
+}
+
+void Resize() {
+    std::printf("resizing a binding\n");
+    DescriptorAllocator allocator(kPersistent, kFramesInFlight, kPerFrame);
+    BindingTable table = AllocateBindingTable(allocator);
+    const BindingTable before = table;
+
+    // Materials grows to an array of 4 views: its old slot is freed, the new
+    // range comes from the free space after the others
+    allocator.FreePersistent(table.Slot(Binding::Materials), 1);
+    const uint32_t slot = allocator.AllocatePersistent(4);
+    table.slots[static_cast<uint32_t>(Binding::Materials)] = slot;
+    std::printf("  materials: slot %u -> %u..%u\n", before.Slot(Binding::Materials), slot, slot + 3);
+    Check(slot != kDescriptorNone && slot >= static_cast<uint32_t>(Binding::Count), "resized range allocated");
+    for (uint32_t i = 0; i < static_cast<uint32_t>(Binding::Count); i++) {
+        if (i != static_cast<uint32_t>(Binding::Materials)) {
+            Check(table.slots[i] == before.slots[i], "the other bindings keep their slots");
+        }
+    }
+    // A freed single slot is reused by the next one-descriptor allocation
+    Check(allocator.AllocatePersistent(1) == before.Slot(Binding::Materials), "freed slot reused");
+}
+
+void PersistentFuzz(uint32_t operations) {
+    std::printf("persistent ranges, %u random operations\n", operations);
+    DescriptorAllocator allocator(kPersistent, kFramesInFlight, kPerFrame);
+    std::vector<int> owner(kPersistent, -1);
+    struct Live {
+        uint32_t first, count;
+    };
+    std::vector<Live> live;
+    glm::uvec2 seed(5u, 11u);
+    uint32_t failures = 0, allocations = 0, full = 0;
+    auto fail = [&](const char* what) {
+        if (failures++ < 8) {
+            std::printf("  FAILED: %s\n", what);
+        }
+    };
+
+    for (uint32_t op = 0; op < operations; op++) {
+        if (live.empty() || RandomFloat(seed) < 0.55f) {
+            const uint32_t count = 1 + static_cast<uint32_t>(RandomFloat(seed) * RandomFloat(seed) * 12.0f);
+            const uint32_t first = allocator.AllocatePersistent(count);
+            // Longest free run of the shadow heap
+            uint32_t run = 0, longest = 0;
+            for (int o : owner) {
+                run = o < 0 ? run + 1 : 0;
+                longest = run > longest ? run : longest;
+            }
+            if (first == kDescriptorNone) {
+                full++;
+                if (longest >= count) {
+                    fail("no range returned although one is free");
+                }
+                continue;
+            }
+            allocations++;
+            if (first + count > kPersistent) {
+                fail("range outside the persistent part of the heap");
+                continue;
+            }
+            for (uint32_t i = first; i < first + count; i++) {
+                if (owner[i] >= 0) {
+                    fail("range overlaps a live range");
+                    break;
+                }
+                owner[i] = static_cast<int>(live.size());
+            }
+            live.push_back({first, count});
+        } else {
+            const size_t index = static_cast<size_t>(RandomFloat(seed) * live.size()) % live.size();
+            const Live range = live[index];
+            allocator.FreePersistent(range.first, range.count);
+            live[index] = live.back();
+            live.pop_back();
+            std::fill(owner.begin(), owner.end(), -1);
+            for (size_t i = 0; i < live.size(); i++) {
+                for (uint32_t s = live[i].first; s < live[i].first + live[i].count; s++) {
+                    owner[s] = static_cast<int>(i);
+                }
+            }
+        }
+        uint32_t used = 0;
+        for (const Live& l : live) {
+            used += l.count;
+        }
+        if (used != allocator.Stats().persistentUsed) {
+            fail("used count differs from the live ranges");
+        }
+    }
+    for (const Live& l : live) {
+        allocator.FreePersistent(l.first, l.count);
+    }
+    if (allocator.LargestFreeRange() != kPersistent) {
+        fail("free ranges do not merge back into the whole heap");
+    }
+    std::printf("  %u allocations, %u found no range, peak %u of %u descriptors\n", allocations, full,
+                allocator.Stats().persistentPeak, kPersistent);
+    g_failures += failures;
+}
+
+void FrameRanges() {
+    std::printf("per-frame ranges\n");
+    DescriptorAllocator allocator(kPersistent, kFramesInFlight, kPerFrame);
+    std::vector<uint32_t> previous[kFramesInFlight];
+    for (uint32_t frame = 0; frame < 8; frame++) {
+        const uint32_t slot = frame % kFramesInFlight;
+        allocator.BeginFrame(slot);
+        std::vector<uint32_t> used;
+        uint32_t total = 0;
+        for (uint32_t count : {3u, 1u, 4u, 8u, 2u}) {
+            const uint32_t first = allocator.AllocateFrame(count);
+            if (total + count > kPerFrame) {
+                Check(first == kDescriptorNone, "a full frame range refuses more");
+                continue;
+            }
+            total += count;
+            Check(first != kDescriptorNone, "frame range allocated");
+            Check(first >= kPersistent + slot * kPerFrame && first + count <= kPersistent + (slot + 1) * kPerFrame,
+                  "inside the slice of the frame slot");
+            for (uint32_t i = first; i < first + count; i++) {
+                used.push_back(i);
+            }
+        }
+        // The slot starts over once its previous frame has retired
+        if (!previous[slot].empty()) {
+            Check(used == previous[slot], "a slot reuses its slice from the start");
+        }
+        previous[slot] = used;
+    }
+    Check(allocator.Capacity() == kPersistent + kFramesInFlight * kPerFrame, "heap size");
+    std::printf("  peak %u of %u per frame, %u refused\n", allocator.Stats().framePeak, kPerFrame,
+                allocator.Stats().frameFailures);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t operations = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+    RendererTable();
+    Resize();
+    PersistentFuzz(operations);
+    FrameRanges();
+    std::printf("Descriptor checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+// Frame pacing of the renderer's frame context ring (FrameRing.h) against a
+// simulated GPU, without a device.
+//
+//   FrameRing [frames] [cpuMs] [gpuMs]
+//
+// The mock queue runs submitted frames back to back on a single timeline and
+// completes a signaled fence value when the work queued before it is done.
+// Each frame records for cpuMs of CPU time (OnUpdate + PopulateCommandList)
+// and then costs gpuMs on the GPU, every 8th frame three times that to model
+// spikes. Checks that a slot is never handed out while a frame using it is
+// still on the GPU, that at most framesInFlight frames are queued and that
+// WaitIdle leaves nothing pending; any failure makes the exit code 1. Then
+// prints frame time, GPU utilization and CPU stalls for 1 (the old
+// WaitForPreviousFrame after every Present), 2 and 3 frames in flight on a
+// CPU bound, a balanced and a GPU bound load.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/Render/FrameRing.h"
+
+namespace {
+
+class MockGpu : public FrameFence {
+public:
+    double now = 0.0;      // CPU time, ms
+    double stalled = 0.0;  // CPU time spent in WaitFor
+    double busy = 0.0;     // GPU time spent on frames
+    uint32_t failures = 0;
+
+    // ExecuteCommandLists of work taking ms on the GPU
+    void Submit(double ms) {
+        const double start = std::max(now, m_freeAt);
+        m_freeAt = start + ms;
+        busy += ms;
+    }
+
+    // Time at which the GPU is done with everything submitted so far
+    double FreeAt() const { return m_freeAt; }
+
+    void Signal(uint64_t value) override {
+        if (!m_signals.empty() && m_signals.back().value >= value) {
+            std::printf("  fence value %llu signaled out of order\n", static_cast<unsigned long long>(value));
+            failures++;
+        }
+        m_signals.push_back({value, m_freeAt});
+    }
+
+    uint64_t CompletedValue() override {
+        uint64_t completed = 0;
+        for (const SignalPoint& s : m_signals) {
+            if (s.time <= now) {
+                completed = std::max(completed, s.value);
+            }
+        }
+        return completed;
+    }
+
+    void WaitFor(uint64_t value) override {
+        for (const SignalPoint& s : m_signals) {
+            if (s.value >= value) {
+                stalled += std::max(0.0, s.time - now);
+                now = std::max(now, s.time);
+                return;
+            }
+        }
+        std::printf("  wait for fence value %llu that is never signaled\n", static_cast<unsigned long long>(value));
+        failures++;
+    }
+
+private:
+    struct SignalPoint {
+        uint64_t value;
+        double time;
+    };
+    std::vector<SignalPoint> m_signals;
+    double m_freeAt = 0.0;
+};
+
+struct Result {
+    double frameMs = 0.0;
+    double gpuUtilization = 0.0;
+    double stallMs = 0.0;
+    uint64_t frameWaits = 0;
+    uint32_t failures = 0;
+};
+
+Result Simulate(uint32_t framesInFlight, uint32_t frames, double cpuMs, double gpuMs) {
+    MockGpu gpu;
+    FrameRing ring(framesInFlight);
+    auto check = [&](bool ok, const char* what, uint32_t frame) {
+        if (!ok) {
+            std::printf("  %u in flight, frame %u: %s\n", framesInFlight, frame, what);
+            gpu.failures++;
+        }
+    };
+
+    // Loading, as in OnInit
+    gpu.Submit(5.0 * gpuMs);
+    ring.WaitIdle(gpu);
+    check(gpu.CompletedValue() + 1 == ring.NextValue(), "work pending after WaitIdle", 0);
+    const double start = gpu.now;
+
+    std::vector<double> slotDone(framesInFlight, 0.0); // GPU end of the last frame per slot
+    std::vector<double> frameDone;
+    for (uint32_t f = 0; f < frames; f++) {
+        const uint32_t slot = ring.BeginFrame(gpu);
+        check(slot == f % framesInFlight, "slots out of order", f);
+        check(slotDone[slot] <= gpu.now, "slot reused while its frame is on the GPU", f);
+        const size_t queued = std::count_if(frameDone.begin(), frameDone.end(), [&](double t) { return t > gpu.now; });
+        check(queued < framesInFlight, "more frames queued than in flight", f);
+        check(ring.Retired(slot, gpu.CompletedValue()), "slot not retired after BeginFrame", f);
+
+        gpu.now += cpuMs;
+        gpu.Submit(f % 8 == 7 ? 3.0 * gpuMs : gpuMs);
+        ring.EndFrame(gpu);
+        slotDone[slot] = gpu.FreeAt();
+        frameDone.push_back(gpu.FreeAt());
+    }
+    const double end = gpu.FreeAt();
+    ring.WaitIdle(gpu);
+    check(gpu.CompletedValue() + 1 == ring.NextValue(), "work pending after WaitIdle", frames);
+    check(gpu.now >= end, "WaitIdle returned before the GPU finished", frames);
+
+    Result result;
+    result.frameMs = (end - start) / frames;
+    result.gpuUtilization = 100.0 * (gpu.busy - 5.0 * gpuMs) / (end - start);
+    result.stallMs = gpu.stalled / frames;
+    result.frameWaits = ring.Stats().frameWaits;
+    result.failures = gpu.failures;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1000;
+    const double cpuMs = argc > 2 ? std::atof(argv[2]) : 0.0;
+    const double gpuMs = argc > 3 ? std::atof(argv[3]) : 0.0;
+
+    struct Load {
+        const char* name;
+        double cpuMs, gpuMs;
+    };
+    std::vector<Load> loads = {{"CPU bound", 6.0, 3.0}, {"balanced", 5.0, 5.0}, {"GPU bound", 2.0, 8.0}};
+    if (cpuMs > 0.0 && gpuMs > 0.0) {
+        loads = {{"given", cpuMs, gpuMs}};
+    }
+
+    uint32_t failures = 0;
+    std::printf("%u frames, GPU cost x3 every 8th frame\n", frames);
+    std::printf("%-10s %5s %5s  %-9s %10s %8s %10s %8s\n", "load", "cpu", "gpu", "in flight", "frame ms", "GPU %",
+                "stall ms", "waits");
+    for (const Load& load : loads) {
+        for (uint32_t framesInFlight = 1; framesInFlight <= 3; framesInFlight++) {
+            const Result r = Simulate(framesInFlight, frames, load.cpuMs, load.gpuMs);
+            failures += r.failures;
+            std::printf("%-10s %5.1f %5.1f  %-9u %10.2f %8.1f %10.2f %8llu\n", load.name, load.cpuMs, load.gpuMs,
+                        framesInFlight, r.frameMs, r.gpuUtilization, r.stallMs,
+                        static_cast<unsigned long long>(r.frameWaits));
+        }
+    }
+    std::printf("Ring checks: %s\n", failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+// Reduced resolution ReSTIR GI (GiResolution.h) against full resolution on
+// the default scene.
+//
+//   GiUpsampling [assetDir] [width] [height] [frames] [referenceFrames] [threads]
+//
+// First checks the mapping of GiResolution.h on a few image sizes: owners
+// get distinct GI elements below GiBufferCount, every other pixel has at
+// least one tap, taps and GiOwner land on owners. Exits with 1 if one fails.
+// Then renders `frames` frames of the still default camera (init, temporal,
+// spatial) at full resolution, half resolution and checkerboard, the latter
+// two with the guided (depth / normal / material aware) and the bilinear
+// filter, and compares their GI output against the mean GI of
+// `referenceFrames` full resolution frames seeded apart from the others. GI
+// bias and relative RMSE are printed for the last frame and the mean over
+// all frames, over all shaded pixels and over the edge pixels alone (a
+// neighbor with another material or a depth step beyond
+// GI_UPSAMPLE_DEPTH_TOLERANCE), where the filter matters. With GI paths
+// traced per frame, pass times, fallbacks and the GI buffer sizes at 1080p
+// and 4K.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/GiUpsample.h"
+#include "../src/Render/InitPass.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Render/SpatialPass.h"
+#include "../src/Render/TemporalPass.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+// Seeds the reference frames apart from the compared ones
+constexpr uint32_t kReferenceTimeOffset = 1000;
+
+const char* ModeName(uint32_t mode) {
+    return mode == GI_RESOLUTION_FULL ? "full" : mode == GI_RESOLUTION_HALF ? "half" : "checkerboard";
+}
+
+bool CheckLayout(uint32_t mode, uint32_t width, uint32_t height) {
+    const uint32_t count = GiBufferCount(mode, width, height);
+    std::vector<bool> used(count, false);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const glm::uvec2 owner = GiOwner(mode, glm::uvec2(x, y));
+            if (owner.x >= width || owner.y >= height || !IsGiPixel(mode, owner.x, owner.y)) {
+                std::printf("FAIL %s %ux%u: owner (%u, %u) of (%u, %u)\n", ModeName(mode), width, height, owner.x,
+                            owner.y, x, y);
+                return false;
+            }
+            if (IsGiPixel(mode, x, y)) {
+                const uint32_t i = GiPixelIndex(mode, width, x, y);
+                if (i >= count || used[i]) {
+                    std::printf("FAIL %s %ux%u: element %u of (%u, %u)\n", ModeName(mode), width, height, i, x, y);
+                    return false;
+                }
+                used[i] = true;
+                continue;
+            }
+            uint32_t taps = 0;
+            for (uint32_t k = 0; k < GI_UPSAMPLE_TAPS; k++) {
+                const uint32_t tap = GiUpsampleTap(mode, width, height, x, y, k);
+                if (tap == GI_NO_TAP) {
+                    continue;
+                }
+                const uint32_t tx = tap & 0xFFFFu, ty = tap >> 16;
+                if (tx >= width || ty >= height || !IsGiPixel(mode, tx, ty)) {
+                    std::printf("FAIL %s %ux%u: tap (%u, %u) of (%u, %u)\n", ModeName(mode), width, height, tx, ty,
+                                x, y);
+                    return false;
+                }
+                taps++;
+            }
+            if (taps == 0) {
+                std::printf("FAIL %s %ux%u: no tap for (%u, %u)\n", ModeName(mode), width, height, x, y);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+// Relative difference of the means and relative RMSE over the pixels in mask
+void Compare(const char* name, const std::vector<glm::vec3>& estimate, const std::vector<glm::vec3>& reference,
+             const std::vector<bool>& mask) {
+    double sumEstimate = 0.0, sumReference = 0.0, squaredError = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < estimate.size(); i++) {
+        if (!mask[i] || !std::isfinite(Luminance(estimate[i]))) {
+            continue;
+        }
+        const double e = Luminance(estimate[i]);
+        const double r = Luminance(reference[i]);
+        sumEstimate += e;
+        sumReference += r;
+        squaredError += (e - r) * (e - r);
+        count++;
+    }
+    if (count == 0 || sumReference <= 0.0) {
+        std::printf("    %-16s no shaded pixels\n", name);
+        return;
+    }
+    std::printf("    %-16s bias %+7.2f%%  relative RMSE %.3f\n", name,
+                100.0 * (sumEstimate - sumReference) / sumReference,
+                std::sqrt(squaredError / static_cast<double>(count)) / (sumReference / static_cast<double>(count)));
+}
+
+struct RunResult {
+    std::vector<glm::vec3> lastFrame; // GI only
+    std::vector<glm::vec3> mean;
+    std::vector<bool> shaded;         // not emissive, not a miss
+    std::vector<bool> edge;           // shaded, next to another material or a depth step
+    uint64_t giPaths = 0;
+    uint64_t upsampled = 0;
+    uint64_t fallbacks = 0;
+    double initSeconds = 0.0;
+    double spatialSeconds = 0.0;
+};
+
+RunResult Render(const SceneTracer& tracer, ThreadPool& pool, const CpuCamera& camera, uint32_t mode,
+                 GiUpsampleFilter filter, uint32_t width, uint32_t height, uint32_t frames, uint32_t timeOffset) {
+    InitPassSettings initSettings;
+    TemporalSettings temporalSettings;
+    SpatialSettings settings;
+    settings.giUpsample = filter;
+    RestirFrame current, last;
+    current.Resize(width, height, mode);
+    last.Resize(width, height, mode);
+
+    RunResult result;
+    result.mean.assign(static_cast<size_t>(width) * height, glm::vec3(0.0f));
+    std::vector<glm::vec3> gi;
+    SpatialStats stats;
+    const CpuCameraRays rays = camera.Rays(width, height);
+    for (uint32_t f = 0; f < frames; f++) {
+        initSettings.time = temporalSettings.time = settings.time = timeOffset + f;
+        result.initSeconds += RunInitPass(tracer, pool, rays, initSettings, current);
+        RunTemporalPass(tracer, pool, MakeTemporalCamera(camera, camera, width, height), temporalSettings, last,
+                        current);
+        result.spatialSeconds +=
+            RunSpatialPass(tracer, pool, camera.eye, settings, current, last, nullptr, &stats, &gi);
+        for (size_t i = 0; i < gi.size(); i++) {
+            result.mean[i] += gi[i] / static_cast<float>(frames);
+        }
+        for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+            result.giPaths += stats.candidatesGI[i];
+        }
+        result.upsampled += stats.giUpsampled;
+        result.fallbacks += stats.giFallbacks;
+    }
+    result.lastFrame = gi;
+
+    const glm::uvec2 dims(width, height);
+    const auto sampleAt = [&](uint32_t x, uint32_t y) -> const SampleData& {
+        return current.samples[MapPixelID(dims, glm::uvec2(x, y))];
+    };
+    const auto isShaded = [&](const SampleData& s) {
+        return !(glm::length(ToFloat3(s.L1)) > 0.0f) && glm::length(s.n1) > 0.0f;
+    };
+    result.shaded.assign(gi.size(), false);
+    result.edge.assign(gi.size(), false);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const SampleData& s = sampleAt(x, y);
+            if (!isShaded(s)) {
+                continue;
+            }
+            const size_t i = static_cast<size_t>(y) * width + x;
+            result.shaded[i] = true;
+            const float depth = glm::length(s.x1 - camera.eye);
+            const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+            for (const auto& o : offsets) {
+                const int nx = static_cast<int>(x) + o[0], ny = static_cast<int>(y) + o[1];
+                if (nx < 0 || ny < 0 || nx >= static_cast<int>(width) || ny >= static_cast<int>(height)) {
+                    continue;
+                }
+                const SampleData& n = sampleAt(nx, ny);
+                if (n.mID != s.mID ||
+                    std::abs(glm::length(n.x1 - camera.eye) - depth) > GI_UPSAMPLE_DEPTH_TOLERANCE * depth) {
+                    result.edge[i] = true;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+double GiBufferMB(uint32_t mode, uint32_t width, uint32_t height) {
+    // g_Reservoirs_current_gi and g_Reservoirs_last_gi
+    return 2.0 * GiBufferCount(mode, width, height) * RESERVOIR_ELEMENT_BYTES / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 320;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 180;
+    const uint32_t frames = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 8;
+    const uint32_t referenceFrames = argc > 5 ? static_cast<uint32_t>(std::atoi(argv[5])) : 64;
+    const uint32_t threads = argc > 6 ? static_cast<uint32_t>(std::atoi(argv[6])) : 0;
+
+    const uint32_t modes[] = {GI_RESOLUTION_FULL, GI_RESOLUTION_HALF, GI_RESOLUTION_CHECKERBOARD};
+    const uint32_t sizes[][2] = {{1, 1}, {2, 1}, {7, 5}, {16, 9}, {33, 17}, {width, height}};
+    for (uint32_t mode : modes) {
+        for (const auto& size : sizes) {
+            if (!CheckLayout(mode, size[0], size[1])) {
+                return 1;
+            }
+        }
+    }
+    std::printf("GiResolution.h mapping checks passed\n");
+    std::printf("GI buffers (current + last, %u B elements):\n", RESERVOIR_ELEMENT_BYTES);
+    for (uint32_t mode : modes) {
+        std::printf("  %-13s 1080p %6.1f MB  4K %6.1f MB\n", ModeName(mode), GiBufferMB(mode, 1920, 1080),
+                    GiBufferMB(mode, 3840, 2160));
+    }
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(threads);
+    std::printf("%ux%u, %u frames, reference %u full resolution frames, %u threads\n", width, height, frames,
+                referenceFrames, pool.ThreadCount());
+
+    const RunResult reference = Render(tracer, pool, scene.camera, GI_RESOLUTION_FULL, GiUpsampleFilter::Guided,
+                                       width, height, referenceFrames, kReferenceTimeOffset);
+
+    struct Config {
+        uint32_t mode;
+        GiUpsampleFilter filter;
+    };
+    const Config configs[] = {
+        {GI_RESOLUTION_FULL, GiUpsampleFilter::Guided},
+        {GI_RESOLUTION_HALF, GiUpsampleFilter::Guided},
+        {GI_RESOLUTION_HALF, GiUpsampleFilter::Bilinear},
+        {GI_RESOLUTION_CHECKERBOARD, GiUpsampleFilter::Guided},
+        {GI_RESOLUTION_CHECKERBOARD, GiUpsampleFilter::Bilinear},
+    };
+    for (const Config& config : configs) {
+        const RunResult result =
+            Render(tracer, pool, scene.camera, config.mode, config.filter, width, height, frames, 0);
+        if (config.mode == GI_RESOLUTION_FULL) {
+            std::printf("%s:\n", ModeName(config.mode));
+        } else {
+            std::printf("%s, %s:\n", ModeName(config.mode), GiUpsampleFilterName(config.filter));
+        }
+        std::printf("    GI paths %.0f / frame, upsampled %.0f / frame (%.2f%% fallbacks), init %.3f s, "
+                    "spatial %.3f s\n",
+                    static_cast<double>(result.giPaths) / frames, static_cast<double>(result.upsampled) / frames,
+                    result.upsampled ? 100.0 * static_cast<double>(result.fallbacks) / result.upsampled : 0.0,
+                    result.initSeconds, result.spatialSeconds);
+        Compare("last frame", result.lastFrame, reference.mean, reference.shaded);
+        Compare("mean", result.mean, reference.mean, reference.shaded);
+        Compare("last frame edge", result.lastFrame, reference.mean, reference.edge);
+        Compare("mean edge", result.mean, reference.mean, reference.edge);
+    }
+    return 0;
+}
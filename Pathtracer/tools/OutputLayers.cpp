@@ -0,0 +1,94 @@
+// Resident memory of the raytracing output array (OutputLayers.h) and checks
+// of the slice plan, without a device.
+//
+//   OutputLayers [width] [height]
+//
+// Replays the 'C' key over the display levels of the renderer in both debug
+// layer modes, checks that every shown level has a slice inside the array,
+// that slices are never shared except the scratch slice and that the array
+// only grows when Select() says so; any failure makes the exit code 1. Then
+// prints the resident size at 1080p and 4K (and width x height if given):
+// all 60 layers up front, the default single slice, and after cycling
+// through every level.
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include "../src/Render/OutputLayers.h"
+
+namespace {
+
+// m_displayLevels of Renderer.h
+const std::vector<uint32_t> kDisplayLevels = {0, 10, 11, 12, 13, 14, 15, 16, 17, 20, 21, 22, 23, 24, 25, 26, 27, 28};
+
+const char* ModeName(DebugLayerMode mode) {
+    return mode == DebugLayerMode::Scratch ? "scratch" : "on demand";
+}
+
+// Cycles twice through the levels; returns the number of failed checks
+uint32_t CheckPlan(DebugLayerMode mode, OutputLayerPlan& plan) {
+    uint32_t failures = 0;
+    auto check = [&](bool ok, const char* what, uint32_t level) {
+        if (!ok) {
+            std::printf("  %s, level %u: %s\n", ModeName(mode), level, what);
+            failures++;
+        }
+    };
+    check(plan.ResidentSlices() == 1 && plan.Slice(0) == 0, "presentation is not the only slice", 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t level : kDisplayLevels) {
+            const uint32_t before = plan.ResidentSlices();
+            const bool grew = plan.Select(level);
+            check(grew == (plan.ResidentSlices() != before), "growth not reported", level);
+            check(pass == 0 || !grew, "grew on the second cycle", level);
+            check(plan.Slice(level) < plan.ResidentSlices(), "slice outside the array", level);
+        }
+    }
+    std::set<uint32_t> slices;
+    for (uint32_t level : kDisplayLevels) {
+        const uint32_t slice = plan.Slice(level);
+        const bool shared = !slices.insert(slice).second;
+        check(!shared || (mode == DebugLayerMode::Scratch && slice == 1), "slice shared", level);
+    }
+    const uint32_t expected = mode == DebugLayerMode::Scratch ? 2 : static_cast<uint32_t>(kDisplayLevels.size());
+    check(plan.ResidentSlices() == expected, "unexpected array size", 0);
+    check(!plan.Select(kOutputLogicalLayers) && plan.Slice(kOutputLogicalLayers) == kNoOutputSlice,
+          "level outside the array accepted", kOutputLogicalLayers);
+    return failures;
+}
+
+double Megabytes(uint64_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    OutputLayerPlan scratch(DebugLayerMode::Scratch), onDemand(DebugLayerMode::OnDemand);
+    const OutputLayerPlan initial;
+    uint32_t failures = CheckPlan(DebugLayerMode::Scratch, scratch);
+    failures += CheckPlan(DebugLayerMode::OnDemand, onDemand);
+    std::printf("Slice plan over %zu display levels: %s\n", kDisplayLevels.size(), failures ? "FAIL" : "ok");
+
+    struct Resolution {
+        const char* name;
+        uint32_t width, height;
+    };
+    std::vector<Resolution> resolutions = {{"1080p", 1920, 1080}, {"4K", 3840, 2160}};
+    if (argc > 2) {
+        resolutions.push_back({"custom", static_cast<uint32_t>(std::atoi(argv[1])),
+                               static_cast<uint32_t>(std::atoi(argv[2]))});
+    }
+    std::printf("Resident MB, R8G8B8A8 slices of 64 KB tiles:\n");
+    std::printf("  %-8s %11s %9s %9s %11s %9s\n", "", "60 layers", "default", "scratch", "on demand", "saved");
+    for (const Resolution& r : resolutions) {
+        const uint64_t all = initial.AllLayersBytes(r.width, r.height);
+        const uint64_t resident = initial.ResidentBytes(r.width, r.height);
+        std::printf("  %-8s %11.1f %9.1f %9.1f %11.1f %9.1f\n", r.name, Megabytes(all), Megabytes(resident),
+                    Megabytes(scratch.ResidentBytes(r.width, r.height)),
+                    Megabytes(onDemand.ResidentBytes(r.width, r.height)), Megabytes(all - resident));
+    }
+    return failures ? 1 : 0;
+}
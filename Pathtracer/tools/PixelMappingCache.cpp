@@ -0,0 +1,242 @@
+// Cache behavior of the pixel mapping schemes of PixelMapping.h, replaying
+// the buffer accesses of the three raygen passes through a two level cache.
+//
+//   PixelMappingCache [width] [height] [attempts] [l1KB] [l2KB]
+//
+// Six buffers (current / last of DI, GI, SampleData) with the element sizes
+// of ReservoirLayout.h. Launch indices are issued in 8x4 groups (one wave),
+// groups row-major over the image. Per pixel:
+//   init      store SampleData, DI, GI (RayGen1)
+//   temporal  load current SampleData, DI, GI; load last SampleData, DI, GI
+//             at the reprojected pixel, a pan of (3, 1) pixels per frame;
+//             store current (RayGen2)
+//   spatial   load own SampleData, DI, GI; per DI and per GI attempt the
+//             neighbor's SampleData, the first spatial_candidate_count
+//             neighbors' reservoir; store last (RayGen3)
+// Neighbors come from GetRandomPixelCircleWeighted with the seeds of the
+// spatial pass; every pixel makes `attempts` attempts (about 4.6 on the
+// default scene, see ReservoirCompression). Both caches are LRU, 128 byte
+// lines, write-allocate; L2 sees the L1 misses, and DRAM traffic is L2
+// misses times the line size. A single L1 stands for the one of the SM the
+// wave runs on, so its hit rate is an upper bound.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/Render/Rng.h"
+#include "../src/Render/Sampler.h"
+
+namespace {
+
+constexpr uint32_t kLineBytes = 128;
+constexpr uint32_t kGroupWidth = 8;
+constexpr uint32_t kGroupHeight = 4;
+constexpr int kPanX = 3;
+constexpr int kPanY = 1;
+
+class Cache {
+public:
+    Cache(uint64_t bytes, uint32_t ways) : m_ways(ways) {
+        m_sets = static_cast<uint32_t>(bytes / kLineBytes / ways);
+        m_tags.assign(static_cast<size_t>(m_sets) * ways, ~0ull);
+    }
+
+    // true on a hit; the line becomes the most recent of its set either way
+    bool Access(uint64_t line) {
+        uint64_t* set = &m_tags[(line % m_sets) * m_ways];
+        uint32_t way = 0;
+        while (way < m_ways - 1 && set[way] != line) {
+            way++;
+        }
+        const bool hit = set[way] == line;
+        for (; way > 0; way--) {
+            set[way] = set[way - 1];
+        }
+        set[0] = line;
+        return hit;
+    }
+
+private:
+    uint32_t m_ways;
+    uint32_t m_sets = 0;
+    std::vector<uint64_t> m_tags; // per set, most recent first
+};
+
+struct Counters {
+    uint64_t accesses = 0;
+    uint64_t l1Hits = 0;
+    uint64_t l2Accesses = 0;
+    uint64_t l2Hits = 0;
+};
+
+enum Buffer : uint32_t { SampleCurrent, SampleLast, DICurrent, DILast, GICurrent, GILast, BufferCount };
+
+struct Scheme {
+    const char* name;
+    uint32_t mapping;
+    uint32_t tileSize;
+};
+
+class Replay {
+public:
+    Replay(const Scheme& scheme, uint32_t width, uint32_t height, uint64_t l1Bytes, uint64_t l2Bytes)
+        : m_scheme(scheme), m_width(width), m_height(height), m_l1(l1Bytes, 4), m_l2(l2Bytes, 16) {
+        const uint64_t count = PixelBufferCount(scheme.mapping, scheme.tileSize, width, height);
+        uint64_t base = 0;
+        for (uint32_t b = 0; b < BufferCount; b++) {
+            m_elementBytes[b] = b <= SampleLast ? SAMPLE_DATA_BYTES : RESERVOIR_ELEMENT_BYTES;
+            m_base[b] = base;
+            // Buffers start on 64 KB boundaries like placed resources
+            base += (count * m_elementBytes[b] + 0xFFFF) & ~0xFFFFull;
+        }
+        m_bufferBytes = base;
+    }
+
+    uint64_t BufferBytes() const { return m_bufferBytes; }
+
+    void Touch(Buffer buffer, uint32_t x, uint32_t y, Counters& counters) {
+        const uint64_t index = PixelIndex(m_scheme.mapping, m_scheme.tileSize, m_width, x, y);
+        const uint64_t first = m_base[buffer] + index * m_elementBytes[buffer];
+        const uint64_t last = first + m_elementBytes[buffer] - 1;
+        for (uint64_t line = first / kLineBytes; line <= last / kLineBytes; line++) {
+            counters.accesses++;
+            if (m_l1.Access(line)) {
+                counters.l1Hits++;
+                continue;
+            }
+            counters.l2Accesses++;
+            counters.l2Hits += m_l2.Access(line);
+        }
+    }
+
+    // Calls pixel(x, y) in launch order
+    template <typename F>
+    void ForEachPixel(F&& pixel) {
+        for (uint32_t gy = 0; gy < m_height; gy += kGroupHeight) {
+            for (uint32_t gx = 0; gx < m_width; gx += kGroupWidth) {
+                for (uint32_t y = gy; y < gy + kGroupHeight && y < m_height; y++) {
+                    for (uint32_t x = gx; x < gx + kGroupWidth && x < m_width; x++) {
+                        pixel(x, y);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    Scheme m_scheme;
+    uint32_t m_width, m_height;
+    Cache m_l1, m_l2;
+    uint64_t m_base[BufferCount] = {};
+    uint32_t m_elementBytes[BufferCount] = {};
+    uint64_t m_bufferBytes = 0;
+};
+
+struct Result {
+    Counters passes[3];
+    uint64_t bufferBytes = 0;
+};
+
+Result Run(const Scheme& scheme, uint32_t width, uint32_t height, uint32_t attempts, uint64_t l1Bytes,
+           uint64_t l2Bytes) {
+    const RestirSettings restir;
+    Replay replay(scheme, width, height, l1Bytes, l2Bytes);
+    Result result;
+    result.bufferBytes = replay.BufferBytes();
+
+    Counters& init = result.passes[0];
+    replay.ForEachPixel([&](uint32_t x, uint32_t y) {
+        replay.Touch(SampleCurrent, x, y, init);
+        replay.Touch(DICurrent, x, y, init);
+        replay.Touch(GICurrent, x, y, init);
+    });
+
+    Counters& temporal = result.passes[1];
+    replay.ForEachPixel([&](uint32_t x, uint32_t y) {
+        replay.Touch(SampleCurrent, x, y, temporal);
+        const int px = static_cast<int>(x) - kPanX;
+        const int py = static_cast<int>(y) - kPanY;
+        if (px >= 0 && py >= 0) {
+            replay.Touch(SampleLast, px, py, temporal);
+            replay.Touch(DILast, px, py, temporal);
+            replay.Touch(GILast, px, py, temporal);
+        }
+        replay.Touch(DICurrent, x, y, temporal);
+        replay.Touch(GICurrent, x, y, temporal);
+        // Store current: the lines were just loaded
+        replay.Touch(DICurrent, x, y, temporal);
+        replay.Touch(GICurrent, x, y, temporal);
+        replay.Touch(SampleCurrent, x, y, temporal);
+    });
+
+    Counters& spatial = result.passes[2];
+    const uint32_t reservoirReads = std::min(attempts, restir.spatialCandidateCount);
+    replay.ForEachPixel([&](uint32_t x, uint32_t y) {
+        replay.Touch(SampleCurrent, x, y, spatial);
+        replay.Touch(DICurrent, x, y, spatial);
+        replay.Touch(GICurrent, x, y, spatial);
+        glm::uvec2 seed = SeedPixel(x, y, 3, 0);
+        for (Buffer reservoirs : {DICurrent, GICurrent}) {
+            for (uint32_t attempt = 0; attempt < attempts; attempt++) {
+                const glm::uvec2 n = GetRandomPixelCircleWeightedXY(restir.spatialRadius, restir.spatialExponent,
+                                                                     width, height, x, y, seed);
+                replay.Touch(SampleCurrent, n.x, n.y, spatial);
+                if (attempt < reservoirReads) {
+                    replay.Touch(reservoirs, n.x, n.y, spatial);
+                }
+            }
+        }
+        replay.Touch(DILast, x, y, spatial);
+        replay.Touch(GILast, x, y, spatial);
+        replay.Touch(SampleLast, x, y, spatial);
+    });
+    return result;
+}
+
+double Rate(uint64_t hits, uint64_t total) {
+    return total ? 100.0 * static_cast<double>(hits) / static_cast<double>(total) : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t width = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1920;
+    const uint32_t height = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 1080;
+    const uint32_t attempts = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 5;
+    const uint64_t l1Bytes = (argc > 4 ? std::atoll(argv[4]) : 128) * 1024ull;
+    const uint64_t l2Bytes = (argc > 5 ? std::atoll(argv[5]) : 4096) * 1024ull;
+
+    const Scheme schemes[] = {
+        {"row-major", PIXEL_MAPPING_ROW_MAJOR, 1}, {"tiled 4", PIXEL_MAPPING_TILED, 4},
+        {"tiled 8", PIXEL_MAPPING_TILED, 8},       {"tiled 16", PIXEL_MAPPING_TILED, 16},
+        {"morton 8", PIXEL_MAPPING_MORTON, 8},     {"morton 16", PIXEL_MAPPING_MORTON, 16},
+        {"morton 64", PIXEL_MAPPING_MORTON, 64},
+    };
+
+    std::printf("%ux%u, %u spatial attempts, L1 %llu KB, L2 %llu KB, %u B lines; built with %s %u\n", width, height,
+                attempts, static_cast<unsigned long long>(l1Bytes / 1024),
+                static_cast<unsigned long long>(l2Bytes / 1024), kLineBytes,
+                PIXEL_MAPPING == PIXEL_MAPPING_ROW_MAJOR ? "row-major"
+                : PIXEL_MAPPING == PIXEL_MAPPING_TILED   ? "tiled"
+                                                         : "morton",
+                PIXEL_TILE_SIZE);
+    std::printf("%-10s %8s   %-17s %-17s %-17s %10s\n", "", "buffers", "init L1 / L2 %", "temporal L1 / L2 %",
+                "spatial L1 / L2 %", "DRAM MB");
+    for (const Scheme& scheme : schemes) {
+        const auto start = std::chrono::steady_clock::now();
+        const Result result = Run(scheme, width, height, attempts, l1Bytes, l2Bytes);
+        uint64_t dramLines = 0;
+        std::printf("%-10s %6.1fMB  ", scheme.name, static_cast<double>(result.bufferBytes) / 1e6);
+        for (int p = 0; p < 3; p++) {
+            const Counters& c = result.passes[p];
+            dramLines += c.l2Accesses - c.l2Hits;
+            std::printf(" %6.2f / %6.2f   ", Rate(c.l1Hits, c.accesses), Rate(c.l2Hits, c.l2Accesses));
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%9.1f  (%.1fs)\n", static_cast<double>(dramLines * kLineBytes) / 1e6, seconds);
+    }
+    return 0;
+}
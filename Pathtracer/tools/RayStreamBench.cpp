@@ -0,0 +1,120 @@
+// Compares single-ray BVH traversal against the sorted ray stream on the
+// diffuse bounces of the default scene.
+//
+//   RayStreamBench [assetDir] [width] [height] [bounces] [packetSize]
+//
+// Bounce rays are generated once per depth from the single-ray results
+// (cosine-weighted hemisphere, fixed seed) and then traced by every method,
+// so all methods see the exact same batch and their hits are cross-checked.
+// Bounce batches are shuffled, as they would arrive from a wavefront queue;
+// "unsorted" cuts packets straight from that order.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Accel/RayBatch.h"
+#include "../src/Accel/RayStream.h"
+#include "../src/Scene/CpuScene.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+double TimeBestOf(int repeats, const std::function<void()>& fn) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        const auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+size_t CountMismatches(const std::vector<BvhHit>& a, const std::vector<BvhHit>& b) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].IsHit() != b[i].IsHit() ||
+            (a[i].IsHit() && a[i].triangle != b[i].triangle && std::fabs(a[i].t - b[i].t) > 1e-5f * a[i].t)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 960;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 540;
+    const uint32_t bounces = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 3;
+    const uint32_t packetSize = argc > 5 ? static_cast<uint32_t>(std::atoi(argv[5])) : 16;
+    constexpr int repeats = 3;
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+
+    Bvh bvh;
+    const double buildTime = TimeBestOf(1, [&] { bvh.Build(scene.positions, scene.indices); });
+    std::printf("Scene: %u triangles, BVH %zu nodes, built in %.2f ms\n", scene.TriangleCount(),
+                bvh.Nodes().size(), buildTime * 1e3);
+
+    RayStreamSettings sortedSettings;
+    sortedSettings.packetSize = packetSize;
+    RayStreamSettings unsortedSettings = sortedSettings;
+    unsortedSettings.sort = false;
+    RayStream sortedStream(bvh, sortedSettings);
+    RayStream unsortedStream(bvh, unsortedSettings);
+
+    std::vector<BvhRay> rays = GeneratePrimaryRays(scene, width, height);
+
+    std::printf("\n%-7s %9s %12s %12s %12s %9s %9s %10s %10s\n", "depth", "rays", "single", "stream",
+                "unsorted", "speedup", "lanes", "nodes/ray", "mismatch");
+    for (uint32_t depth = 0; depth <= bounces && !rays.empty(); depth++) {
+        std::vector<BvhHit> singleHits(rays.size()), sortedHits, unsortedHits;
+        BvhTraversalStats singleStats, sortedStats;
+        RayStreamStats streamStats;
+
+        const double singleTime = TimeBestOf(repeats, [&] {
+            for (size_t i = 0; i < rays.size(); i++) {
+                bvh.Intersect(rays[i], singleHits[i]);
+            }
+        });
+        const double sortedTime = TimeBestOf(repeats, [&] { sortedStream.Intersect(rays, sortedHits); });
+        const double unsortedTime = TimeBestOf(repeats, [&] { unsortedStream.Intersect(rays, unsortedHits); });
+
+        // Untimed pass for the traversal counters
+        for (size_t i = 0; i < rays.size(); i++) {
+            BvhHit hit;
+            bvh.Intersect(rays[i], hit, &singleStats);
+        }
+        sortedStream.Intersect(rays, sortedHits, &sortedStats, &streamStats);
+
+        const double mrays = static_cast<double>(rays.size()) * 1e-6;
+        std::printf("%-7s %9zu %8.2f Mr/s %8.2f Mr/s %8.2f Mr/s %8.2fx %8.1f%% %5.1f/%4.1f %10zu\n",
+                    depth == 0 ? "primary" : ("bounce" + std::to_string(depth)).c_str(), rays.size(),
+                    mrays / singleTime, mrays / sortedTime, mrays / unsortedTime, singleTime / sortedTime,
+                    100.0 * streamStats.LaneUtilization(sortedStream.Settings().packetSize),
+                    static_cast<double>(singleStats.nodeTests) / static_cast<double>(singleStats.rays),
+                    static_cast<double>(sortedStats.nodeTests) / static_cast<double>(sortedStats.rays),
+                    CountMismatches(singleHits, sortedHits) + CountMismatches(singleHits, unsortedHits));
+
+        // Next depth: cosine-weighted diffuse bounce from every hit
+        rays = GenerateDiffuseRays(scene, rays, singleHits, 1234 + depth);
+    }
+    std::printf("\nnodes/ray: single / stream (active lanes per packet node fetch)\n");
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Headless CPU reference render of the default scene.
+//
+//   ReferenceRender [assetDir] [width] [height] [spp] [out.pfm|out.hdr] [threads|sweep] [bounces]
+//
+// Renders spp samples per pixel with the ReferenceRenderer and writes linear
+// HDR output (PFM unless the name ends in .hdr). threads = 0 uses every
+// core. "sweep" renders the same image with 1, 2, 4, ... threads up to the
+// core count and reports the speedup over one thread instead of writing it.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/ReferenceRenderer.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ImageIO.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+struct RunResult {
+    ReferenceStats stats;
+    uint32_t threads = 0;
+    uint64_t steals = 0;
+    std::vector<glm::vec3> image;
+};
+
+RunResult Run(const SceneTracer& tracer, const ReferenceSettings& settings, uint32_t spp, uint32_t threads) {
+    ThreadPool pool(threads);
+    ReferenceRenderer renderer(tracer, pool);
+    renderer.Reset(settings);
+    renderer.Render(spp);
+
+    RunResult result;
+    result.stats = renderer.Stats();
+    result.threads = pool.ThreadCount();
+    result.steals = pool.StealCount();
+    result.image = renderer.Image();
+    return result;
+}
+
+void Print(const RunResult& r) {
+    const double s = r.stats.seconds;
+    std::printf("%2u threads: %8.3f s  %8.3f Mpaths/s  %8.3f Mrays/s (%llu closest, %llu shadow)  %llu steals\n",
+                r.threads, s, static_cast<double>(r.stats.paths) / s * 1e-6,
+                static_cast<double>(r.stats.rays + r.stats.shadowRays) / s * 1e-6,
+                static_cast<unsigned long long>(r.stats.rays), static_cast<unsigned long long>(r.stats.shadowRays),
+                static_cast<unsigned long long>(r.steals));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    ReferenceSettings settings;
+    settings.width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 480;
+    settings.height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 270;
+    const uint32_t spp = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 16;
+    const std::string outPath = argc > 5 ? argv[5] : "reference.pfm";
+    const std::string threadArg = argc > 6 ? argv[6] : "0";
+    if (argc > 7) {
+        settings.maxBounces = static_cast<uint32_t>(std::atoi(argv[7]));
+    }
+    // Antialiased ground truth; the ReSTIR comparisons pass their own settings
+    settings.jitter = true;
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+
+    std::printf("Reference: %u triangles, %zu emissive, %ux%u, %u spp, %u bounces\n", scene.TriangleCount(),
+                scene.emissiveTriangles.size(), settings.width, settings.height, spp, settings.maxBounces);
+
+    if (threadArg == "sweep") {
+        const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+        double single = 0.0;
+        for (uint32_t threads = 1;; threads = std::min(threads * 2, cores)) {
+            const RunResult r = Run(tracer, settings, spp, threads);
+            Print(r);
+            if (threads == 1) {
+                single = r.stats.seconds;
+            }
+            std::printf("            speedup %.2fx, efficiency %.0f%%\n", single / r.stats.seconds,
+                        100.0 * single / r.stats.seconds / threads);
+            if (threads == cores) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    const uint32_t threads = static_cast<uint32_t>(std::atoi(threadArg.c_str()));
+    const RunResult r = Run(tracer, settings, spp, threads);
+    Print(r);
+    if (!WriteImage(outPath, settings.width, settings.height, r.image)) {
+        std::fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+        return 1;
+    }
+    std::printf("Wrote %s\n", outPath.c_str());
+    return 0;
+}
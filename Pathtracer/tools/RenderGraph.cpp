@@ -0,0 +1,199 @@
+// Checks of the render graph compiler (RenderGraph.h) on known pass setups,
+// without a device.
+//
+//   RenderGraph
+//
+// Each setup is compiled and its barrier list printed, one line per pass in
+// execution order as "level pass: barriers", and compared with the expected
+// list; a mismatch, a wrong cull / alias result or a missing error makes the
+// exit code 1. The first setup is the renderer's frame as declared in
+// Renderer::CreateRenderGraph.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../src/Render/RenderGraph.h"
+#include "../src/Render/Reservoir.h"
+
+namespace {
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+std::string Describe(const RenderGraph& graph, const GraphBarrier& b) {
+    const std::string& name = graph.ResourceName(b.resource);
+    switch (b.type) {
+        case GraphBarrierType::Transition:
+            return name + ": " + GraphStateName(b.before) + "->" + GraphStateName(b.after);
+        case GraphBarrierType::Uav:
+            return "uav " + name;
+        case GraphBarrierType::Aliasing:
+            return "alias " + graph.ResourceName(b.previous) + "->" + name;
+    }
+    return "?";
+}
+
+std::vector<std::string> Lines(const RenderGraph& graph, const CompiledGraph& compiled) {
+    auto join = [&](const std::vector<GraphBarrier>& barriers) {
+        std::string s;
+        for (const GraphBarrier& b : barriers) {
+            s += (s.empty() ? " " : ", ") + Describe(graph, b);
+        }
+        return s;
+    };
+    std::vector<std::string> lines;
+    for (const GraphStep& step : compiled.steps) {
+        lines.push_back(std::to_string(step.level) + " " + graph.PassName(step.pass) + ":" + join(step.barriers));
+    }
+    lines.push_back("final:" + join(compiled.finalBarriers));
+    return lines;
+}
+
+void Expect(const char* name, const RenderGraph& graph, const CompiledGraph& compiled,
+            const std::vector<std::string>& expected) {
+    std::printf("%s\n", name);
+    if (!compiled.error.empty()) {
+        std::printf("  error: %s\n", compiled.error.c_str());
+        g_failures++;
+        return;
+    }
+    const std::vector<std::string> lines = Lines(graph, compiled);
+    for (size_t i = 0; i < std::max(lines.size(), expected.size()); i++) {
+        const std::string got = i < lines.size() ? lines[i] : "(missing)";
+        const bool same = i < expected.size() && got == expected[i];
+        std::printf("  %s %s\n", same ? " " : "!", got.c_str());
+        if (!same) {
+            std::printf("      expected %s\n", i < expected.size() ? expected[i].c_str() : "(nothing)");
+            g_failures++;
+        }
+    }
+}
+
+constexpr GraphState kUav = GraphState::UnorderedAccess;
+
+void RendererFrame() {
+    // Mirrors Renderer::CreateRenderGraph, sizes at 1920x1080 with a full resolution GI
+    RenderGraph graph;
+    const uint32_t output = graph.Import("output", GraphState::CopySource, GraphState::CopySource);
+    const uint32_t backBuffer = graph.Import("back_buffer", GraphState::Present, GraphState::Present);
+    const uint32_t permanent = graph.Import("permanent", kUav, kUav);
+    const uint32_t lastDi = graph.Import("reservoirs_last_di", kUav, kUav);
+    const uint32_t lastGi = graph.Import("reservoirs_last_gi", kUav, kUav);
+    const uint32_t samplesLast = graph.Import("samples_last", kUav, kUav);
+    const uint32_t di = graph.CreateTransient("reservoirs_di", 1920ull * 1080 * sizeof(Reservoir_DI), kUav);
+    const uint32_t gi = graph.CreateTransient("reservoirs_gi", 1920ull * 1080 * sizeof(Reservoir_GI), kUav);
+    const uint32_t samples = graph.CreateTransient("samples", 1920ull * 1080 * sizeof(SampleData), kUav);
+
+    graph.AddPass("init", {{di, kUav, true}, {gi, kUav, true}, {samples, kUav, true}});
+    graph.AddPass("temporal", {{di, kUav, true}, {gi, kUav, true}, {samples, kUav, true},
+                               {lastDi, kUav, false}, {lastGi, kUav, false}, {samplesLast, kUav, false}});
+    graph.AddPass("spatial", {{di, kUav, false}, {gi, kUav, false}, {samples, kUav, false},
+                              {permanent, kUav, true}, {lastDi, kUav, true}, {lastGi, kUav, true},
+                              {samplesLast, kUav, true}, {output, kUav, true}});
+    graph.AddPass("present_copy", {{output, GraphState::CopySource, false},
+                                   {backBuffer, GraphState::CopyDest, true}});
+
+    const CompiledGraph compiled = graph.Compile();
+    Expect("renderer frame", graph, compiled,
+           {"0 init:",
+            "1 temporal: uav reservoirs_di, uav reservoirs_gi, uav samples",
+            "2 spatial: uav reservoirs_di, uav reservoirs_gi, uav samples, uav reservoirs_last_di, "
+            "uav reservoirs_last_gi, uav samples_last, output: copy_source->uav",
+            "3 present_copy: output: uav->copy_source, back_buffer: present->copy_dest",
+            "final: back_buffer: copy_dest->present"});
+    Check(compiled.culledPasses == 0, "no pass of the frame is culled");
+    Check(compiled.aliasedBytes == compiled.transientBytes, "the frame's transients all overlap");
+    // PopulateCommandList before the graph: UAV(nullptr) after the first two
+    // dispatches, output to UAV and back, back buffer to render target, copy
+    // dest, render target and present
+    std::printf("  barriers: %u UAV + %u transitions (hand-written: 2 global UAV + 6 transitions)\n",
+                compiled.BarrierCount(GraphBarrierType::Uav), compiled.BarrierCount(GraphBarrierType::Transition));
+}
+
+void IndependentReaders() {
+    RenderGraph graph;
+    const uint32_t a = graph.CreateTransient("a", 1024, kUav);
+    const uint32_t b = graph.Import("b", kUav, kUav);
+    const uint32_t c = graph.Import("c", kUav, kUav);
+    graph.AddPass("write_a", {{a, kUav, true}});
+    graph.AddPass("read_a_1", {{a, kUav, false}, {b, kUav, true}});
+    graph.AddPass("read_a_2", {{a, kUav, false}, {c, kUav, true}});
+    graph.AddPass("write_b", {{b, kUav, true}});
+    const CompiledGraph compiled = graph.Compile();
+    Expect("independent readers share a level and one barrier", graph, compiled,
+           {"0 write_a:", "1 read_a_1: uav a", "1 read_a_2:", "2 write_b: uav b", "final:"});
+}
+
+void Culling() {
+    RenderGraph graph;
+    const uint32_t out = graph.Import("out", kUav, kUav);
+    const uint32_t debug = graph.CreateTransient("debug", 1024, kUav);
+    const uint32_t scratch = graph.CreateTransient("scratch", 1024, kUav);
+    graph.AddPass("shade", {{out, kUav, true}});
+    graph.AddPass("debug_view", {{debug, kUav, true}});
+    graph.AddPass("scratch_write", {{scratch, kUav, true}});
+    graph.AddPass("scratch_read", {{scratch, kUav, false}}, true);
+    const CompiledGraph compiled = graph.Compile();
+    Expect("passes nobody reads are culled", graph, compiled,
+           {"0 shade:", "0 scratch_write:", "1 scratch_read: uav scratch", "final:"});
+    Check(compiled.culledPasses == 1, "one pass culled");
+    Check(compiled.aliasSlot[debug] == kGraphNone, "a culled transient gets no memory");
+}
+
+void Aliasing() {
+    RenderGraph graph;
+    const uint32_t t1 = graph.CreateTransient("t1", 8 << 20, kUav);
+    const uint32_t t2 = graph.CreateTransient("t2", 4 << 20, kUav);
+    const uint32_t t3 = graph.CreateTransient("t3", 8 << 20, kUav);
+    const uint32_t out = graph.Import("out", kUav, kUav);
+    graph.AddPass("a", {{t1, kUav, true}});
+    graph.AddPass("b", {{t1, kUav, false}, {t2, kUav, true}});
+    graph.AddPass("c", {{t2, kUav, false}, {t3, kUav, true}});
+    graph.AddPass("d", {{t3, GraphState::ShaderResource, false}, {out, kUav, true}});
+    const CompiledGraph compiled = graph.Compile();
+    Expect("disjoint transient lifetimes alias", graph, compiled,
+           {"0 a:", "1 b: uav t1", "2 c: uav t2, alias t1->t3", "3 d: t3: uav->srv", "final: t3: srv->uav"});
+    Check(compiled.aliasSlot[t1] == compiled.aliasSlot[t3] && compiled.aliasSlot[t1] != compiled.aliasSlot[t2],
+          "t1 and t3 share a slot, t2 does not");
+    Check(compiled.transientBytes == (20u << 20) && compiled.aliasedBytes == (12u << 20), "alias slot sizes");
+    std::printf("  transient memory: %llu KB, aliased %llu KB\n",
+                static_cast<unsigned long long>(compiled.transientBytes >> 10),
+                static_cast<unsigned long long>(compiled.aliasedBytes >> 10));
+}
+
+void Errors() {
+    std::printf("invalid graphs\n");
+    RenderGraph readFirst;
+    const uint32_t t = readFirst.CreateTransient("t", 1024, kUav);
+    const uint32_t out = readFirst.Import("out", kUav, kUav);
+    readFirst.AddPass("read", {{t, kUav, false}, {out, kUav, true}});
+    const CompiledGraph a = readFirst.Compile();
+    std::printf("  %s\n", a.error.c_str());
+    Check(!a.error.empty(), "reading a transient before it is written fails");
+
+    RenderGraph twice;
+    const uint32_t r = twice.Import("r", kUav, kUav);
+    twice.AddPass("twice", {{r, kUav, true}, {r, GraphState::ShaderResource, false}});
+    const CompiledGraph b = twice.Compile();
+    std::printf("  %s\n", b.error.c_str());
+    Check(!b.error.empty(), "a resource listed twice in a pass fails");
+}
+
+} // namespace
+
+int main() {
+    RendererFrame();
+    IndependentReaders();
+    Culling();
+    Aliasing();
+    Errors();
+    std::printf("Graph checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
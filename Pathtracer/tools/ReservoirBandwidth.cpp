@@ -0,0 +1,311 @@
+// Memory traffic of the reservoir buffers in the AoS and SoA layouts of
+// ReservoirLayout.h, replaying the reservoir accesses of each ReSTIR pass.
+//
+//   ReservoirBandwidth [width] [height] [iterations] [threads]
+//
+// Four buffers (current / last, DI / GI) in each layout, filled with valid
+// reservoirs. Per pixel, in MapPixelID order:
+//   init      store DI + GI (RayGen1)
+//   temporal  load current and reprojected last DI + GI, store current (RayGen2)
+//   search    spatial candidate tests: M of the pixel, then per attempt the
+//             fields IsValidReservoir / RejectBelowSurface / RejectWsum /
+//             Jacobian read, M of accepted neighbors (RayGen3, first loops)
+//   resample  canonical DI + GI, the reservoir fields of 3 neighbors each,
+//             store last (RayGen3, resampling and history)
+// Neighbors are picked before timing. "field bytes" are the bytes the pass
+// asks for, the same for both layouts; GB/s is field bytes over time.
+// Timings are the best of the iterations.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/Render/ReservoirStorage.h"
+#include "../src/Render/Rng.h"
+#include "../src/Render/Sampler.h"
+#include "../src/Util/ThreadPool.h"
+
+namespace {
+
+struct Buffers {
+    ReservoirStorage currentDI, lastDI, currentGI, lastGI;
+
+    void Resize(ReservoirLayout layout, uint32_t count) {
+        currentDI.Resize(layout, count);
+        lastDI.Resize(layout, count);
+        currentGI.Resize(layout, count);
+        lastGI.Resize(layout, count);
+    }
+    size_t Bytes() const { return currentDI.Bytes() + lastDI.Bytes() + currentGI.Bytes() + lastGI.Bytes(); }
+};
+
+struct Pass {
+    const char* name;
+    double fieldBytesPerPixel; // average
+    double seconds[2];         // AoS, SoA
+};
+
+Reservoir_DI MakeReservoirDI(glm::uvec2& seed) {
+    Reservoir_DI r;
+    r.x2 = glm::vec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed));
+    r.n2 = glm::normalize(glm::vec3(RandomFloat(seed), 1.0f, RandomFloat(seed)));
+    r.L2 = ToHalf3(glm::vec3(1.0f + RandomFloat(seed)));
+    r.w_sum = 1.0f + RandomFloat(seed);
+    r.W = RandomFloat(seed);
+    r.M = static_cast<uint16_t>(1 + RandomFloat(seed) * 16.0f);
+    return r;
+}
+
+Reservoir_GI MakeReservoirGI(glm::uvec2& seed) {
+    Reservoir_GI r;
+    r.xn = glm::vec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed));
+    r.nn = glm::normalize(glm::vec3(RandomFloat(seed), 1.0f, RandomFloat(seed)));
+    r.E3 = ToHalf3(glm::vec3(1.0f + RandomFloat(seed)));
+    r.w_sum = 1.0f + RandomFloat(seed);
+    r.W = RandomFloat(seed);
+    r.M = static_cast<uint16_t>(1 + RandomFloat(seed) * 16.0f);
+    return r;
+}
+
+template <ReservoirLayout L>
+struct Views {
+    ReservoirView<L> currentDI, lastDI, currentGI, lastGI;
+
+    explicit Views(Buffers& b)
+        : currentDI(b.currentDI.View<L>()), lastDI(b.lastDI.View<L>()), currentGI(b.currentGI.View<L>()),
+          lastGI(b.lastGI.View<L>()) {}
+};
+
+template <ReservoirLayout L>
+void Fill(const Views<L>& b, uint32_t count) {
+    glm::uvec2 seed(7, 11);
+    for (uint32_t i = 0; i < count; i++) {
+        StoreReservoir_DI(b.currentDI, i, MakeReservoirDI(seed));
+        StoreReservoir_DI(b.lastDI, i, MakeReservoirDI(seed));
+        StoreReservoir_GI(b.currentGI, i, MakeReservoirGI(seed));
+        StoreReservoir_GI(b.lastGI, i, MakeReservoirGI(seed));
+    }
+}
+
+// Neighbor indices of the spatial pass, picked up front so only the
+// reservoir accesses are timed. Candidate tests accept 3 of 4 neighbors.
+struct Neighbors {
+    uint32_t tries = 0;
+    std::vector<uint32_t> searchDI, searchGI; // tries per pixel, unused slots ~0u
+    std::vector<uint32_t> candidatesDI, candidatesGI; // spatialCandidateCount per pixel
+
+    void Build(const RestirSettings& restir, uint32_t width, uint32_t height) {
+        tries = restir.spatialMaxTries;
+        const size_t pixels = static_cast<size_t>(width) * height;
+        searchDI.assign(pixels * tries, ~0u);
+        searchGI.assign(pixels * tries, ~0u);
+        candidatesDI.assign(pixels * restir.spatialCandidateCount, 0);
+        candidatesGI.assign(pixels * restir.spatialCandidateCount, 0);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const size_t p = static_cast<size_t>(y) * width + x;
+                glm::uvec2 seed = SeedPixel(x, y, 3, 0);
+                for (int gi = 0; gi < 2; gi++) {
+                    std::vector<uint32_t>& search = gi ? searchGI : searchDI;
+                    std::vector<uint32_t>& candidates = gi ? candidatesGI : candidatesDI;
+                    uint32_t found = 0;
+                    for (uint32_t a = 0; a < tries && found < restir.spatialCandidateCount; a++) {
+                        const uint32_t r = GetRandomPixelCircleWeighted(restir.spatialRadius, restir.spatialExponent,
+                                                                        width, height, x, y, seed);
+                        search[p * tries + a] = r;
+                        if (RandomFloat(seed) < 0.75f) {
+                            candidates[p * restir.spatialCandidateCount + found++] = r;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Best of iterations; row(y) runs one image row and returns a checksum
+template <typename Row>
+double Time(ThreadPool& pool, uint32_t height, uint32_t iterations, std::vector<float>& sums, const Row& row) {
+    double best = 1e30;
+    for (uint32_t it = 0; it < iterations; it++) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        pool.ParallelFor(height, [&](uint32_t y, uint32_t thread) { sums[thread] += row(y); });
+        best = std::min(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+struct Bench {
+    ThreadPool& pool;
+    uint32_t width, height, iterations;
+    const Neighbors& neighbors;
+    uint32_t candidateCount;
+    Reservoir_DI storedDI;
+    Reservoir_GI storedGI;
+    std::vector<float> sums;
+};
+
+// Runs the passes on buffers in layout L, into passes[*].seconds[column]
+template <ReservoirLayout L>
+void TimePasses(Bench& bench, Buffers& buffers, Pass* passes, int column) {
+    const Views<L> b(buffers);
+    Fill(b, buffers.currentDI.Count());
+    const Neighbors& neighbors = bench.neighbors;
+    const uint32_t width = bench.width, height = bench.height, candidateCount = bench.candidateCount;
+    const glm::uvec2 dims(width, height);
+
+    passes[0].seconds[column] = Time(bench.pool, height, bench.iterations, bench.sums, [&](uint32_t y) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t i = MapPixelID(dims, glm::uvec2(x, y));
+            StoreReservoir_DI(b.currentDI, i, bench.storedDI);
+            StoreReservoir_GI(b.currentGI, i, bench.storedGI);
+        }
+        return 0.0f;
+    });
+
+    passes[1].seconds[column] = Time(bench.pool, height, bench.iterations, bench.sums, [&](uint32_t y) {
+        float sum = 0.0f;
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t i = MapPixelID(dims, glm::uvec2(x, y));
+            // Reprojected a couple of pixels away, like a slow camera pan
+            const uint32_t j = MapPixelID(dims, glm::uvec2(std::min(x + 2, width - 1), std::min(y + 1, height - 1)));
+            Reservoir_DI di = LoadReservoir_DI(b.currentDI, i);
+            Reservoir_GI gi = LoadReservoir_GI(b.currentGI, i);
+            const Reservoir_DI lastDI = LoadReservoir_DI(b.lastDI, j);
+            const Reservoir_GI lastGI = LoadReservoir_GI(b.lastGI, j);
+            di.w_sum = 0.5f * (di.w_sum + lastDI.w_sum);
+            gi.w_sum = 0.5f * (gi.w_sum + lastGI.w_sum);
+            StoreReservoir_DI(b.currentDI, i, di);
+            StoreReservoir_GI(b.currentGI, i, gi);
+            sum += lastDI.x2.x + lastGI.xn.x + lastDI.n2.y + lastGI.nn.y + lastDI.W + lastGI.W +
+                   lastDI.M + lastGI.M + static_cast<float>(lastDI.L2.x + lastGI.E3.x);
+        }
+        return sum;
+    });
+
+    passes[2].seconds[column] = Time(bench.pool, height, bench.iterations, bench.sums, [&](uint32_t y) {
+        float sum = 0.0f;
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t i = MapPixelID(dims, glm::uvec2(x, y));
+            const size_t p = static_cast<size_t>(y) * width + x;
+            const uint32_t* searchDI = &neighbors.searchDI[p * neighbors.tries];
+            const uint32_t* searchGI = &neighbors.searchGI[p * neighbors.tries];
+            sum += static_cast<float>(LoadReservoir_DI_M(b.currentDI, i) + LoadReservoir_GI_M(b.currentGI, i));
+            for (uint32_t a = 0; a < neighbors.tries && searchDI[a] != ~0u; a++) {
+                const uint32_t r = searchDI[a];
+                sum += LoadReservoir_DI_n2(b.currentDI, r).x + LoadReservoir_DI_w_sum(b.currentDI, r) +
+                       static_cast<float>(LoadReservoir_DI_L2(b.currentDI, r).x + LoadReservoir_DI_M(b.currentDI, r));
+            }
+            for (uint32_t a = 0; a < neighbors.tries && searchGI[a] != ~0u; a++) {
+                const uint32_t r = searchGI[a];
+                sum += LoadReservoir_GI_xn(b.currentGI, r).x + LoadReservoir_GI_w_sum(b.currentGI, r) +
+                       LoadReservoir_GI_nn(b.currentGI, r).y + LoadReservoir_GI_M(b.currentGI, r);
+            }
+        }
+        return sum;
+    });
+
+    passes[3].seconds[column] = Time(bench.pool, height, bench.iterations, bench.sums, [&](uint32_t y) {
+        float sum = 0.0f;
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t i = MapPixelID(dims, glm::uvec2(x, y));
+            const size_t p = static_cast<size_t>(y) * width + x;
+            const uint32_t* candidatesDI = &neighbors.candidatesDI[p * candidateCount];
+            const uint32_t* candidatesGI = &neighbors.candidatesGI[p * candidateCount];
+            Reservoir_DI di = LoadReservoir_DI(b.currentDI, i);
+            Reservoir_GI gi = LoadReservoir_GI(b.currentGI, i);
+            for (uint32_t c = 0; c < candidateCount; c++) {
+                const uint32_t r = candidatesDI[c];
+                sum += LoadReservoir_DI_x2(b.currentDI, r).x + LoadReservoir_DI_n2(b.currentDI, r).y +
+                       LoadReservoir_DI_W(b.currentDI, r) + LoadReservoir_DI_M(b.currentDI, r) +
+                       static_cast<float>(LoadReservoir_DI_L2(b.currentDI, r).z);
+            }
+            for (uint32_t c = 0; c < candidateCount; c++) {
+                const uint32_t r = candidatesGI[c];
+                sum += LoadReservoir_GI_xn(b.currentGI, r).x + LoadReservoir_GI_nn(b.currentGI, r).y +
+                       LoadReservoir_GI_W(b.currentGI, r) + LoadReservoir_GI_M(b.currentGI, r) +
+                       static_cast<float>(LoadReservoir_GI_E3(b.currentGI, r).z);
+            }
+            di.W = sum;
+            gi.W = sum;
+            StoreReservoir_DI(b.lastDI, i, di);
+            StoreReservoir_GI(b.lastGI, i, gi);
+        }
+        return sum;
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t width = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1920;
+    const uint32_t height = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 1080;
+    const uint32_t iterations = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 5;
+    const uint32_t threads = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 0;
+    ThreadPool pool(threads);
+    const RestirSettings restir;
+    // MapPixelID pads to whole 4x4 tiles
+    const uint32_t count = ((width + 3) / 4) * ((height + 3) / 4) * 16;
+
+    std::printf("Reservoir layouts: %ux%u, %u iterations, %u threads, active layout %s\n", width, height,
+                iterations, pool.ThreadCount(), RESERVOIR_LAYOUT == RESERVOIR_LAYOUT_SOA ? "SoA" : "AoS");
+    std::printf("  AoS %u B per reservoir; SoA %u B: position %u, normal %u, radiance %u, weight %u\n",
+                RESERVOIR_AOS_BYTES, RESERVOIR_SOA_BYTES, RESERVOIR_STREAM_POSITION_BYTES,
+                RESERVOIR_STREAM_NORMAL_BYTES, RESERVOIR_STREAM_RADIANCE_BYTES, RESERVOIR_STREAM_WEIGHT_BYTES);
+
+    // Field sizes of the accesses below
+    constexpr double kFull = 40.0;
+    constexpr double kTestDI = 12 + 6 + 4 + 2;         // n2, L2, w_sum, M
+    constexpr double kTestGI = 12 + 4 + 2 + 12;        // xn, w_sum, M, nn
+    constexpr double kCandidate = 12 + 12 + 6 + 4 + 2; // position, normal, radiance, W, M
+
+    Neighbors neighbors;
+    neighbors.Build(restir, width, height);
+    uint64_t attemptsDI = 0, attemptsGI = 0;
+    for (size_t i = 0; i < neighbors.searchDI.size(); i++) {
+        attemptsDI += neighbors.searchDI[i] != ~0u;
+        attemptsGI += neighbors.searchGI[i] != ~0u;
+    }
+    const double pixels = static_cast<double>(width) * height;
+    const uint32_t candidateCount = restir.spatialCandidateCount;
+
+    Pass passes[] = {
+        {"init", 2 * kFull, {}},
+        {"temporal", 6 * kFull, {}},
+        {"search", 4 + (attemptsDI * kTestDI + attemptsGI * kTestGI) / pixels, {}},
+        {"resample", 4 * kFull + candidateCount * 2 * kCandidate, {}},
+    };
+
+    glm::uvec2 seed(3, 5);
+    Bench bench{pool, width, height, iterations, neighbors, candidateCount,
+                MakeReservoirDI(seed), MakeReservoirGI(seed), std::vector<float>(pool.ThreadCount(), 0.0f)};
+    {
+        Buffers buffers;
+        buffers.Resize(ReservoirLayout::AoS, count);
+        std::printf("  %.1f MB of reservoirs in AoS, ", buffers.Bytes() / 1e6);
+        TimePasses<ReservoirLayout::AoS>(bench, buffers, passes, 0);
+    }
+    {
+        Buffers buffers;
+        buffers.Resize(ReservoirLayout::SoA, count);
+        std::printf("%.1f MB in SoA\n", buffers.Bytes() / 1e6);
+        TimePasses<ReservoirLayout::SoA>(bench, buffers, passes, 1);
+    }
+
+    std::printf("%-9s %12s %10s %10s %10s %10s %8s\n", "pass", "field B/px", "AoS ms", "AoS GB/s", "SoA ms",
+                "SoA GB/s", "SoA/AoS");
+    for (const Pass& pass : passes) {
+        const double bytes = pass.fieldBytesPerPixel * pixels;
+        std::printf("%-9s %12.1f %10.2f %10.2f %10.2f %10.2f %7.2fx\n", pass.name, pass.fieldBytesPerPixel,
+                    pass.seconds[0] * 1e3, bytes / pass.seconds[0] / 1e9, pass.seconds[1] * 1e3,
+                    bytes / pass.seconds[1] / 1e9, pass.seconds[0] / pass.seconds[1]);
+    }
+    // Keeps the loads from being optimized away
+    volatile float sink = 0.0f;
+    for (float s : bench.sums) {
+        sink = sink + s;
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+// Round-trip error of the packed reservoir encoding (ReservoirPacking.h,
+// Compression_v7.hlsl) and the bandwidth it would save.
+//
+//   ReservoirCompression [assetDir] [width] [height] [frames] [threads]
+//
+// 1. Random inputs through every packing function, checked against the
+//    error bounds of the encoding; any violation makes the exit code 1.
+// 2. The CPU ReSTIR passes on the default scene, twice from the same seeds:
+//    once as is and once with every reservoir and SampleData buffer packed
+//    and unpacked after each pass, like storing them packed on the GPU.
+//    Prints the per-field error on the first frame's buffers and the
+//    difference of the last frame's images.
+// 3. Reservoir and SampleData bytes per frame of the three raygen passes at
+//    1080p and 4K, unpacked, without the SampleData debug channel and
+//    packed, with the spatial attempt and neighbor counts of run 2; and the
+//    size of the two SampleData buffers.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/InitPass.h"
+#include "../src/Render/ReservoirCompression.h"
+#include "../src/Render/Rng.h"
+#include "../src/Render/Sampler.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Render/SpatialPass.h"
+#include "../src/Render/TemporalPass.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+// In double, acos of a float dot product is off by more than the bounds
+double AngleDegrees(const glm::vec3& a, const glm::vec3& b) {
+    const glm::dvec3 da(a), db(b);
+    return glm::degrees(std::atan2(glm::length(glm::cross(da, db)), glm::dot(da, db)));
+}
+
+glm::vec3 RandomDirection(glm::uvec2& seed) {
+    const float z = RandomFloat(seed) * 2.0f - 1.0f;
+    const float phi = RandomFloat(seed) * 6.2831853f;
+    const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// 10^[lo, hi), log-uniform
+float RandomLog(glm::uvec2& seed, float lo, float hi) {
+    return std::pow(10.0f, lo + (hi - lo) * RandomFloat(seed));
+}
+
+struct Check {
+    const char* name;
+    double worst = 0.0;
+    double bound;
+    uint64_t failures = 0;
+
+    void Add(double error) {
+        worst = std::max(worst, error);
+        failures += !(error <= bound);
+    }
+    void Print() const {
+        std::printf("  %-28s worst %.3g, bound %.3g  %s\n", name, worst, bound, failures ? "FAIL" : "ok");
+    }
+};
+
+// Octahedral bound: half a code step in each axis, sqrt(2) / steps, stretched
+// at most 3x near the folded edges of the octahedron
+double OctahedralBound(uint32_t bits) {
+    return glm::degrees(3.0 * std::sqrt(2.0) / static_cast<double>((1u << bits) - 1));
+}
+
+// Part 1; returns the number of failed checks
+uint32_t CheckBounds(uint32_t count) {
+    glm::uvec2 seed(17, 23);
+    Check sampleNormal{"sample normal angle (deg)", 0.0, OctahedralBound(PACKED_OCT_BITS)};
+    Check normal{"reservoir normal angle (deg)", 0.0, OctahedralBound(PACKED_RESERVOIR_OCT_BITS)};
+    // Half a mantissa step of the shared exponent, plus float rounding
+    Check radiance{"radiance error / max channel", 0.0, 1.001 / (1 << PACKED_RGB9E5_MANTISSA_BITS)};
+    Check weight{"W relative error", 0.0, std::ldexp(1.0, -(23 - PACKED_W_DROPPED_BITS) - 1)};
+    Check wsum{"w_sum relative error", 0.0, std::ldexp(1.0, -(23 - PACKED_W_SUM_DROPPED_BITS) - 1)};
+    Check m{"M error", 0.0, 0.0};
+    Check position{"position error", 0.0, 0.0};
+    Check zero{"zero / sign / clamp cases", 0.0, 0.0};
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::vec3 n = RandomDirection(seed);
+        sampleNormal.Add(AngleDegrees(n, UnpackOctahedral(PackOctahedral(n, PACKED_OCT_BITS), PACKED_OCT_BITS)));
+
+        const glm::vec3 c = glm::vec3(RandomLog(seed, -4.0f, 4.0f), RandomLog(seed, -4.0f, 4.0f),
+                                      RandomLog(seed, -4.0f, 4.0f));
+        const glm::vec3 cd = UnpackRGB9E5(PackRGB9E5(c));
+        const float maxc = std::max(c.x, std::max(c.y, c.z));
+        radiance.Add(std::max(std::abs(cd.x - c.x), std::max(std::abs(cd.y - c.y), std::abs(cd.z - c.z))) / maxc);
+
+        Reservoir_DI r;
+        r.x2 = (glm::vec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)) - 0.5f) * 100.0f;
+        r.n2 = n;
+        r.W = RandomLog(seed, -8.0f, 8.0f);
+        // Inside the 5 bit exponent range
+        r.w_sum = RandomLog(seed, -4.0f, 4.0f);
+        r.M = static_cast<uint16_t>(RandomFloat(seed) * (PACKED_M_MAX + 1));
+        const Reservoir_DI rd = UnpackReservoir_DI(PackReservoir_DI(r));
+        position.Add(glm::length(rd.x2 - r.x2));
+        normal.Add(AngleDegrees(n, rd.n2));
+        weight.Add(std::abs(rd.W - r.W) / r.W);
+        wsum.Add(std::abs(rd.w_sum - r.w_sum) / r.w_sum);
+        m.Add(std::abs(static_cast<double>(rd.M) - r.M));
+    }
+    // M clamps instead of wrapping; w_sum out of range keeps its relation
+    // to 0 and to w_sum_threshold
+    zero.Add(UnpackM(PackNormalM(glm::vec3(0.0f, 0.0f, 1.0f), 5000)) == PACKED_M_MAX ? 0.0 : 1.0);
+    zero.Add(UnpackWsum(PackWeights(1.0f, 1e-20f)) > 0.0f ? 0.0 : 1.0);
+    zero.Add(UnpackWsum(PackWeights(1.0f, 1e20f)) > 5.0f ? 0.0 : 1.0);
+    zero.Add(UnpackWsum(PackWeights(1.0f, -1.0f)) == 0.0f ? 0.0 : 1.0);
+    const Reservoir_DI empty = UnpackReservoir_DI(PackReservoir_DI(Reservoir_DI{}));
+    zero.Add(glm::length(empty.x2) + glm::length(empty.n2) + glm::length(ToFloat3(empty.L2)) + empty.W +
+             empty.w_sum + empty.M);
+    zero.Add(glm::length(UnpackRGB9E5(PackRGB9E5(glm::vec3(0.0f)))));
+
+    std::printf("Round trip of %u random values:\n", count);
+    uint32_t failed = 0;
+    for (const Check* check : {&sampleNormal, &normal, &radiance, &weight, &wsum, &m, &position, &zero}) {
+        check->Print();
+        failed += check->failures != 0;
+    }
+    return failed;
+}
+
+void RoundTrip(RestirFrame& frame) {
+    for (size_t i = 0; i < frame.samples.size(); i++) {
+        frame.reservoirsDI[i] = UnpackReservoir_DI(PackReservoir_DI(frame.reservoirsDI[i]));
+        frame.reservoirsGI[i] = UnpackReservoir_GI(PackReservoir_GI(frame.reservoirsGI[i]));
+        frame.samples[i] = UnpackSampleData(PackSampleData(frame.samples[i]));
+    }
+}
+
+struct FieldError {
+    double sum = 0.0;
+    double worst = 0.0;
+    uint64_t count = 0;
+
+    void Add(double e) {
+        sum += e;
+        worst = std::max(worst, e);
+        count++;
+    }
+    void Print(const char* name) const {
+        std::printf("  %-22s mean %.3g, worst %.3g over %llu values\n", name, count ? sum / count : 0.0, worst,
+                    static_cast<unsigned long long>(count));
+    }
+};
+
+// Part 2: field errors of one frame's buffers
+void PrintFieldErrors(const RestirFrame& frame) {
+    FieldError normal, radiance, w, m, sampleNormal, sampleRadiance;
+    // w_sum is only compared against 0 and w_sum_threshold; count changed outcomes
+    const float threshold = RestirSettings{}.wSumThreshold;
+    uint64_t wsumFlips = 0, wsumCount = 0;
+    auto radianceError = [](const glm::vec3& a, const glm::vec3& b) {
+        const float maxc = std::max(a.x, std::max(a.y, a.z));
+        return maxc > 0.0f ? glm::length(b - a) / maxc : glm::length(b);
+    };
+    for (size_t i = 0; i < frame.samples.size(); i++) {
+        const Reservoir_DI& di = frame.reservoirsDI[i];
+        const Reservoir_GI& gi = frame.reservoirsGI[i];
+        const Reservoir_DI dd = UnpackReservoir_DI(PackReservoir_DI(di));
+        const Reservoir_GI gd = UnpackReservoir_GI(PackReservoir_GI(gi));
+        const SampleData sd = UnpackSampleData(PackSampleData(frame.samples[i]));
+        for (int k = 0; k < 2; k++) {
+            const glm::vec3 n = k ? gi.nn : di.n2, nd = k ? gd.nn : dd.n2;
+            const glm::vec3 L = ToFloat3(k ? gi.E3 : di.L2), Ld = ToFloat3(k ? gd.E3 : dd.L2);
+            const float W = k ? gi.W : di.W, Wd = k ? gd.W : dd.W;
+            const float wSum = k ? gi.w_sum : di.w_sum, wSumd = k ? gd.w_sum : dd.w_sum;
+            if (glm::length(n) > 0.0f) {
+                normal.Add(AngleDegrees(glm::normalize(n), nd));
+            }
+            radiance.Add(radianceError(L, Ld));
+            if (W > 0.0f) {
+                w.Add(std::abs(Wd - W) / W);
+            }
+            wsumFlips += (wSum > 0.0f) != (wSumd > 0.0f) || RejectWsum(wSum, threshold) != RejectWsum(wSumd, threshold);
+            wsumCount++;
+            m.Add(std::abs(static_cast<double>(k ? gd.M : dd.M) - (k ? gi.M : di.M)));
+        }
+        if (glm::length(frame.samples[i].n1) > 0.0f) {
+            sampleNormal.Add(AngleDegrees(glm::normalize(frame.samples[i].n1), sd.n1));
+        }
+        sampleRadiance.Add(radianceError(ToFloat3(frame.samples[i].L1), ToFloat3(sd.L1)));
+    }
+    std::printf("Field error on frame 0 (DI + GI reservoirs, SampleData):\n");
+    normal.Print("normal (deg)");
+    radiance.Print("radiance / max channel");
+    w.Print("W relative");
+    std::printf("  %-22s %llu of %llu changed against 0 or w_sum_threshold\n", "w_sum",
+                static_cast<unsigned long long>(wsumFlips), static_cast<unsigned long long>(wsumCount));
+    m.Print("M");
+    sampleNormal.Print("sample n1 (deg)");
+    sampleRadiance.Print("sample L1 / max channel");
+}
+
+struct RunResult {
+    std::vector<glm::vec3> image;
+    SpatialStats stats;
+    uint64_t shaded = 0;
+};
+
+RunResult Render(const SceneTracer& tracer, ThreadPool& pool, const CpuCamera& camera, uint32_t width,
+                 uint32_t height, uint32_t frames, bool packed) {
+    InitPassSettings initSettings;
+    TemporalSettings temporalSettings;
+    SpatialSettings spatialSettings;
+    RestirFrame current, last;
+    current.Resize(width, height);
+    last.Resize(width, height);
+    RunResult result;
+    for (uint32_t f = 0; f < frames; f++) {
+        initSettings.time = temporalSettings.time = spatialSettings.time = f;
+        RunInitPass(tracer, pool, camera.Rays(width, height), initSettings, current);
+        if (packed) {
+            if (f == 0) {
+                PrintFieldErrors(current);
+            }
+            RoundTrip(current);
+        }
+        RunTemporalPass(tracer, pool, MakeTemporalCamera(camera, camera, width, height), temporalSettings, last,
+                        current);
+        if (packed) {
+            RoundTrip(current);
+        }
+        SpatialStats stats;
+        RunSpatialPass(tracer, pool, camera.eye, spatialSettings, current, last, &result.image, &stats);
+        if (packed) {
+            RoundTrip(last);
+        }
+        for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+            result.stats.candidatesDI[i] += stats.candidatesDI[i];
+            result.stats.candidatesGI[i] += stats.candidatesGI[i];
+            result.shaded += stats.candidatesDI[i];
+        }
+        result.stats.attemptsDI += stats.attemptsDI;
+        result.stats.attemptsGI += stats.attemptsGI;
+    }
+    return result;
+}
+
+// Part 3: element reads and writes per pixel of RayGen_v6_pass1..3
+struct Accesses {
+    double di = 0.0, gi = 0.0, samples = 0.0;
+
+    double Bytes(double reservoirBytes, double sampleBytes) const {
+        return (di + gi) * reservoirBytes + samples * sampleBytes;
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 320;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 180;
+    const uint32_t frames = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 4;
+    const uint32_t threads = argc > 5 ? static_cast<uint32_t>(std::atoi(argv[5])) : 0;
+
+    std::printf("Packed reservoirs: %u B (unpacked %zu), SampleData %u B (unpacked %zu)\n", PACKED_RESERVOIR_BYTES,
+                sizeof(Reservoir_DI), PACKED_SAMPLE_BYTES, sizeof(SampleData));
+    const uint32_t failed = CheckBounds(1000000);
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(threads);
+
+    std::printf("ReSTIR on the default scene, %ux%u, %u frames, %u threads\n", width, height, frames,
+                pool.ThreadCount());
+    const RunResult plain = Render(tracer, pool, scene.camera, width, height, frames, false);
+    const RunResult packed = Render(tracer, pool, scene.camera, width, height, frames, true);
+    double sumPlain = 0.0, sumPacked = 0.0, squared = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < plain.image.size(); i++) {
+        const double a = Luminance(plain.image[i]), b = Luminance(packed.image[i]);
+        if (!std::isfinite(a) || !std::isfinite(b)) {
+            continue;
+        }
+        sumPlain += a;
+        sumPacked += b;
+        squared += (a - b) * (a - b);
+        count++;
+    }
+    if (count > 0 && sumPlain > 0.0) {
+        std::printf("Last frame, packed vs unpacked: mean %+.3f%%, relative RMSE %.4f\n",
+                    100.0 * (sumPacked - sumPlain) / sumPlain,
+                    std::sqrt(squared / static_cast<double>(count)) / (sumPlain / static_cast<double>(count)));
+    }
+
+    // Per pixel, from the loads and stores of the raygen shaders; partial
+    // loads of a reservoir count as one element
+    const double perShaded = packed.shaded ? 1.0 / static_cast<double>(packed.shaded) : 0.0;
+    const double attemptsDI = packed.stats.attemptsDI * perShaded;
+    const double attemptsGI = packed.stats.attemptsGI * perShaded;
+    const double candidatesDI = packed.stats.MeanCandidatesDI();
+    const double candidatesGI = packed.stats.MeanCandidatesGI();
+    const Accesses passes[] = {
+        {1, 1, 1}, // init: store all three
+        {3, 3, 2}, // temporal: current and last, store current
+        // spatial: own, search, resample neighbors, store last
+        {2 + attemptsDI + candidatesDI, 2 + attemptsGI + candidatesGI, 2 + attemptsDI + attemptsGI + candidatesGI},
+    };
+    Accesses total;
+    for (const Accesses& pass : passes) {
+        total.di += pass.di;
+        total.gi += pass.gi;
+        total.samples += pass.samples;
+    }
+    std::printf("Per pixel and frame: %.1f DI + %.1f GI reservoirs, %.1f SampleData (%.2f / %.2f spatial attempts)\n",
+                total.di, total.gi, total.samples, attemptsDI, attemptsGI);
+    // SampleData with the debug channel, without it (SAMPLE_DATA_DEBUG 0), packed
+    const double unpackedBytes = total.Bytes(RESERVOIR_AOS_BYTES, SAMPLE_DATA_DEBUG_BYTES);
+    const double releaseBytes = total.Bytes(RESERVOIR_AOS_BYTES, SAMPLE_DATA_RELEASE_BYTES);
+    const double packedBytes = total.Bytes(PACKED_RESERVOIR_BYTES, PACKED_SAMPLE_BYTES);
+    const struct {
+        const char* name;
+        double pixels;
+    } resolutions[] = {{"1080p", 1920.0 * 1080.0}, {"4K", 3840.0 * 2160.0}};
+    std::printf("  MB/frame          unpacked   no debug     packed\n");
+    for (const auto& r : resolutions) {
+        std::printf("  %-14s %11.1f %10.1f %10.1f   (saved at 60 fps: %.1f / %.1f GB/s)\n", r.name,
+                    unpackedBytes * r.pixels / 1e6, releaseBytes * r.pixels / 1e6, packedBytes * r.pixels / 1e6,
+                    (unpackedBytes - releaseBytes) * r.pixels * 60.0 / 1e9,
+                    (unpackedBytes - packedBytes) * r.pixels * 60.0 / 1e9);
+    }
+    // m_sampleBuffer_current and _last
+    std::printf("SampleData buffers (current + last), this build %u B per pixel:\n", SAMPLE_DATA_BYTES);
+    for (const auto& r : resolutions) {
+        std::printf("  %-5s %6.1f MB with debug, %6.1f MB without, %6.1f MB packed\n", r.name,
+                    2.0 * SAMPLE_DATA_DEBUG_BYTES * r.pixels / 1e6, 2.0 * SAMPLE_DATA_RELEASE_BYTES * r.pixels / 1e6,
+                    2.0 * PACKED_SAMPLE_BYTES * r.pixels / 1e6);
+    }
+    return failed ? 1 : 0;
+}
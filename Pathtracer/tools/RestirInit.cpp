@@ -0,0 +1,279 @@
+// CPU run of the initial ReSTIR sampling pass on the default scene.
+//
+//   RestirInit [assetDir] [width] [height] [frame|bias|sweep] [frames] [threads] [dumpPrefix]
+//
+// frame  one init pass: time, reservoir statistics and, with dumpPrefix,
+//        the raw Reservoir_DI / Reservoir_GI / SampleData buffers
+//        (<prefix>_di.bin, _gi.bin, _sample.bin) in GPU layout
+// bias   averages the DI (ReconnectDI * W) and GI (f * W_GI) estimates of
+//        frames passes with different seeds and compares them against the
+//        reference path tracer: direct light only, and full paths minus direct
+// sweep  cost and single-frame DI error for 1..32 light candidates
+//
+// The estimates are what the shading pass would output without temporal and
+// spatial reuse; an unbiased pass converges to the reference.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/InitPass.h"
+#include "../src/Render/ReferenceRenderer.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+struct Estimate {
+    glm::vec3 di = glm::vec3(0.0f);
+    glm::vec3 gi = glm::vec3(0.0f);
+};
+
+// The shading pass without reuse: emitters show Ke, everything else DI + GI
+Estimate Shade(const SceneTracer& tracer, const RestirFrame& frame, uint32_t x, uint32_t y) {
+    const uint32_t i = MapPixelID(glm::uvec2(frame.width, frame.height), glm::uvec2(x, y));
+    Estimate e;
+    if (i >= frame.samples.size()) {
+        return e; // out-of-range UAV reads return zeros
+    }
+    const SampleData& s = frame.samples[i];
+    const Reservoir_DI& r = frame.reservoirsDI[i];
+    const Reservoir_GI& g = frame.reservoirsGI[i];
+
+    const glm::vec3 L1 = ToFloat3(s.L1);
+    if (glm::length(L1) > 0.0f) {
+        e.di = L1;
+        return e;
+    }
+    const ShadingMaterial mat = MakeShadingMaterial(tracer.Material(s.mID), s.mID, true);
+    e.di = ReconnectDI(s.x1, s.n1, r.x2, r.n2, ToFloat3(r.L2), s.o, mat) * r.W;
+    e.gi = GetP_Hat_GI(tracer, s.x1, s.n1, g.xn, g.nn, ToFloat3(g.E3), s.o, mat, false) * g.W;
+    return e;
+}
+
+bool IsFinite(const glm::vec3& v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+template <typename T>
+bool WriteBuffer(const std::string& path, const std::vector<T>& buffer) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::fwrite(buffer.data(), sizeof(T), buffer.size(), file);
+    return std::fclose(file) == 0;
+}
+
+std::vector<glm::vec3> Reference(const SceneTracer& tracer, ThreadPool& pool, uint32_t width, uint32_t height,
+                                 uint32_t maxBounces, uint32_t spp) {
+    ReferenceSettings settings;
+    settings.width = width;
+    settings.height = height;
+    settings.maxBounces = maxBounces;
+    settings.halfPrecisionMaterials = true;
+    ReferenceRenderer renderer(tracer, pool);
+    renderer.Reset(settings);
+    renderer.Render(spp);
+    return renderer.Image();
+}
+
+// Relative difference of the image means and relative RMSE, emitters and misses excluded
+void Compare(const char* name, const std::vector<glm::vec3>& estimate, const std::vector<glm::vec3>& reference,
+             const std::vector<bool>& mask) {
+    double sumEstimate = 0.0, sumReference = 0.0, squaredError = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < estimate.size(); i++) {
+        if (!mask[i]) {
+            continue;
+        }
+        const double e = Luminance(estimate[i]);
+        const double r = Luminance(reference[i]);
+        sumEstimate += e;
+        sumReference += r;
+        squaredError += (e - r) * (e - r);
+        count++;
+    }
+    if (count == 0 || sumReference <= 0.0) {
+        std::printf("%-6s no shaded pixels\n", name);
+        return;
+    }
+    const double meanReference = sumReference / static_cast<double>(count);
+    std::printf("%-6s mean %.5f  reference %.5f  bias %+.2f%%  relative RMSE %.3f\n", name,
+                sumEstimate / static_cast<double>(count), meanReference,
+                100.0 * (sumEstimate - sumReference) / sumReference,
+                std::sqrt(squaredError / static_cast<double>(count)) / meanReference);
+}
+
+void PrintFrameStats(const RestirFrame& frame, double seconds) {
+    // RestirFrame::Resize sizes the buffers with PixelBufferCount, so none should be lost
+    size_t lost = 0;
+    for (uint32_t y = 0; y < frame.height; y++) {
+        for (uint32_t x = 0; x < frame.width; x++) {
+            lost += MapPixelID(glm::uvec2(frame.width, frame.height), glm::uvec2(x, y)) >= frame.samples.size();
+        }
+    }
+    size_t emissive = 0, validDI = 0, validGI = 0;
+    double W = 0.0, wSum = 0.0, WGI = 0.0;
+    for (size_t i = 0; i < frame.samples.size(); i++) {
+        if (glm::length(ToFloat3(frame.samples[i].L1)) > 0.0f) {
+            emissive++;
+        }
+        if (IsValidReservoir(frame.reservoirsDI[i])) {
+            validDI++;
+            W += frame.reservoirsDI[i].W;
+            wSum += frame.reservoirsDI[i].w_sum;
+        }
+        if (IsValidReservoir_GI(frame.reservoirsGI[i])) {
+            validGI++;
+            WGI += frame.reservoirsGI[i].W;
+        }
+    }
+    const double pixels = static_cast<double>(frame.width) * frame.height;
+    std::printf("%ux%u: %.3f s, %.3f Mpixels/s\n", frame.width, frame.height, seconds, pixels / seconds * 1e-6);
+    std::printf("buffers: %zu + %zu + %zu bytes per pixel, %.1f MB\n", sizeof(Reservoir_DI), sizeof(Reservoir_GI),
+                sizeof(SampleData), static_cast<double>(frame.Bytes()) / (1024.0 * 1024.0));
+    std::printf("emissive primary hits %.1f%%, valid DI reservoirs %.1f%% (mean W %.4g, w_sum %.4g), "
+                "valid GI reservoirs %.1f%% (mean W %.4g)\n",
+                100.0 * emissive / pixels, 100.0 * validDI / pixels, validDI ? W / validDI : 0.0,
+                validDI ? wSum / validDI : 0.0, 100.0 * validGI / pixels, validGI ? WGI / validGI : 0.0);
+    if (lost > 0) {
+        std::printf("%zu pixels map past the end of the buffers and are dropped\n",
+                    lost);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 1920;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 1080;
+    const std::string mode = argc > 4 ? argv[4] : "frame";
+    const uint32_t frames = argc > 5 ? static_cast<uint32_t>(std::atoi(argv[5])) : 64;
+    const uint32_t threads = argc > 6 ? static_cast<uint32_t>(std::atoi(argv[6])) : 0;
+    const std::string dumpPrefix = argc > 7 ? argv[7] : "";
+    if (mode != "frame" && mode != "bias" && mode != "sweep") {
+        std::fprintf(stderr, "Unknown mode '%s', expected frame, bias or sweep\n", mode.c_str());
+        return 1;
+    }
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(threads);
+    const CpuCameraRays camera = scene.camera.Rays(width, height);
+
+    RestirFrame frame;
+    frame.Resize(width, height);
+    InitPassSettings settings;
+    std::printf("Init pass: %u triangles, %zu emissive, %u threads, %u light + %u BSDF candidates\n",
+                scene.TriangleCount(), scene.emissiveTriangles.size(), pool.ThreadCount(),
+                settings.restir.neeSamplesDI, settings.restir.bsdfSamplesDI);
+
+    if (mode == "frame") {
+        PrintFrameStats(frame, RunInitPass(tracer, pool, camera, settings, frame));
+        if (!dumpPrefix.empty()) {
+            if (!WriteBuffer(dumpPrefix + "_di.bin", frame.reservoirsDI) ||
+                !WriteBuffer(dumpPrefix + "_gi.bin", frame.reservoirsGI) ||
+                !WriteBuffer(dumpPrefix + "_sample.bin", frame.samples)) {
+                std::fprintf(stderr, "Cannot write %s_*.bin\n", dumpPrefix.c_str());
+                return 1;
+            }
+            std::printf("Wrote %s_di.bin, %s_gi.bin, %s_sample.bin\n", dumpPrefix.c_str(), dumpPrefix.c_str(),
+                        dumpPrefix.c_str());
+        }
+        return 0;
+    }
+
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const uint32_t referenceSpp = 256;
+    const std::vector<glm::vec3> referenceDI = Reference(tracer, pool, width, height, 1, referenceSpp);
+
+    // Only pixels with a shaded primary hit carry an estimate worth comparing
+    std::vector<bool> mask(pixels, false);
+    RunInitPass(tracer, pool, camera, settings, frame);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t i = MapPixelID(glm::uvec2(width, height), glm::uvec2(x, y));
+            if (i >= frame.samples.size()) {
+                continue;
+            }
+            const SampleData& s = frame.samples[i];
+            mask[static_cast<size_t>(y) * width + x] = s.mID != static_cast<uint16_t>(kMissMaterialID) &&
+                                                       !(glm::length(ToFloat3(s.L1)) > 0.0f);
+        }
+    }
+
+    if (mode == "sweep") {
+        std::printf("reference: direct light, %u spp\n", referenceSpp);
+        for (uint32_t candidates = 1; candidates <= 32; candidates *= 2) {
+            settings.restir.neeSamplesDI = candidates;
+            const double seconds = RunInitPass(tracer, pool, camera, settings, frame);
+            std::vector<glm::vec3> di(pixels);
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    di[static_cast<size_t>(y) * width + x] = Shade(tracer, frame, x, y).di;
+                }
+            }
+            std::printf("%2u light candidates: %8.3f s  ", candidates, seconds);
+            Compare("DI", di, referenceDI, mask);
+        }
+        return 0;
+    }
+
+    // bias: mean over frames, seeded by time like consecutive GPU frames
+    std::vector<glm::vec3> di(pixels, glm::vec3(0.0f)), gi(pixels, glm::vec3(0.0f));
+    size_t nonFinite = 0;
+    double seconds = 0.0;
+    for (uint32_t f = 0; f < frames; f++) {
+        settings.time = f;
+        seconds += RunInitPass(tracer, pool, camera, settings, frame);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const Estimate e = Shade(tracer, frame, x, y);
+                const size_t i = static_cast<size_t>(y) * width + x;
+                if (IsFinite(e.di) && IsFinite(e.gi)) {
+                    di[i] += e.di;
+                    gi[i] += e.gi;
+                } else {
+                    nonFinite++;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < pixels; i++) {
+        di[i] /= static_cast<float>(frames);
+        gi[i] /= static_cast<float>(frames);
+    }
+
+    std::vector<glm::vec3> referenceGI = Reference(tracer, pool, width, height, 4, referenceSpp);
+    for (size_t i = 0; i < pixels; i++) {
+        referenceGI[i] -= referenceDI[i];
+    }
+
+    std::printf("%u frames in %.3f s, %zu non-finite estimates dropped; reference %u spp\n", frames, seconds,
+                nonFinite, referenceSpp);
+    Compare("DI", di, referenceDI, mask);
+    Compare("GI", gi, referenceGI, mask);
+    return 0;
+}
@@ -0,0 +1,267 @@
+// CPU run of the full ReSTIR frame (init, temporal, spatial + shading) on the
+// default scene, comparing the shader's neighbor picker against the
+// low-discrepancy disk offset table.
+//
+//   RestirSpatial [assetDir] [width] [height] [frames] [circle|table|both] [degreesPerFrame]
+//                 [referenceSpp] [threads] [outPrefix]
+//
+// First times neighbor selection alone (every attempt of every pixel, no
+// candidate tests). Then renders the camera path once per picker from the
+// same seeds and prints the spatial pass time, attempts and accepted
+// neighbors per pixel. With referenceSpp > 0 the last frame and, for a still
+// camera (degreesPerFrame 0), the mean over all frames like the renderer's
+// accumulation are compared against the reference path tracer. outPrefix
+// writes <prefix>_<picker>.pfm with the last frame's output.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/InitPass.h"
+#include "../src/Render/ReferenceRenderer.h"
+#include "../src/Render/Rng.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Render/SpatialPass.h"
+#include "../src/Render/TemporalPass.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ImageIO.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+// Relative difference of the means and relative RMSE over the pixels in mask
+void Compare(const char* name, const std::vector<glm::vec3>& estimate, const std::vector<glm::vec3>& reference,
+             const std::vector<bool>& mask) {
+    double sumEstimate = 0.0, sumReference = 0.0, squaredError = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < estimate.size(); i++) {
+        if (!mask[i] || !std::isfinite(Luminance(estimate[i]))) {
+            continue;
+        }
+        const double e = Luminance(estimate[i]);
+        const double r = Luminance(reference[i]);
+        sumEstimate += e;
+        sumReference += r;
+        squaredError += (e - r) * (e - r);
+        count++;
+    }
+    if (count == 0 || sumReference <= 0.0) {
+        std::printf("  %-12s no shaded pixels\n", name);
+        return;
+    }
+    std::printf("  %-12s bias %+7.2f%%  relative RMSE %.3f\n", name,
+                100.0 * (sumEstimate - sumReference) / sumReference,
+                std::sqrt(squaredError / static_cast<double>(count)) / (sumReference / static_cast<double>(count)));
+}
+
+CpuCamera OrbitCamera(const CpuCamera& base, float degrees) {
+    CpuCamera camera = base;
+    const glm::vec3 offset = base.eye - base.center;
+    const float angle = glm::radians(degrees);
+    const float c = std::cos(angle), s = std::sin(angle);
+    camera.eye = base.center + glm::vec3(c * offset.x + s * offset.z, offset.y, -s * offset.x + c * offset.z);
+    return camera;
+}
+
+// ns per neighbor pick over spatial_max_tries attempts of every pixel
+double TimeSelection(const SpatialSettings& settings, uint32_t width, uint32_t height) {
+    const RestirSettings& restir = settings.restir;
+    uint64_t checksum = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            glm::uvec2 seed = SeedPixel(x, y, 3, 0);
+            if (settings.selection == NeighborSelection::DiskTable) {
+                const DiskOffsetTable& table = *settings.table;
+                const uint32_t key = std::min(
+                    static_cast<uint32_t>(RandomFloat(seed) * static_cast<float>(table.rotations * table.count)),
+                    table.rotations * table.count - 1);
+                for (uint32_t a = 0; a < restir.spatialMaxTries; a++) {
+                    checksum += GetTablePixel(table, key, a, width, height, x, y);
+                }
+            } else {
+                for (uint32_t a = 0; a < restir.spatialMaxTries; a++) {
+                    checksum += GetRandomPixelCircleWeighted(restir.spatialRadius, restir.spatialExponent, width,
+                                                             height, x, y, seed);
+                }
+            }
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    // Keeps the picks from being optimized away
+    volatile uint64_t sink = checksum;
+    (void)sink;
+    return seconds * 1e9 / (static_cast<double>(width) * height * restir.spatialMaxTries);
+}
+
+struct PickerResult {
+    std::vector<glm::vec3> lastFrame;
+    std::vector<glm::vec3> mean;
+    std::vector<bool> mask; // shaded pixels of the last frame
+};
+
+PickerResult RenderPath(const SceneTracer& tracer, ThreadPool& pool, const CpuCamera& baseCamera,
+                        const SpatialSettings& spatialSettings, uint32_t width, uint32_t height, uint32_t frames,
+                        float degreesPerFrame) {
+    InitPassSettings initSettings;
+    TemporalSettings temporalSettings;
+    SpatialSettings settings = spatialSettings;
+    RestirFrame current, last;
+    current.Resize(width, height);
+    last.Resize(width, height);
+
+    PickerResult result;
+    result.mean.assign(static_cast<size_t>(width) * height, glm::vec3(0.0f));
+    std::vector<glm::vec3> output;
+    SpatialStats stats, total;
+    double initSeconds = 0.0, temporalSeconds = 0.0;
+
+    CpuCamera previous = baseCamera;
+    for (uint32_t f = 0; f < frames; f++) {
+        const CpuCamera camera = OrbitCamera(baseCamera, degreesPerFrame * static_cast<float>(f));
+        initSettings.time = temporalSettings.time = settings.time = f;
+        initSeconds += RunInitPass(tracer, pool, camera.Rays(width, height), initSettings, current);
+        temporalSeconds += RunTemporalPass(tracer, pool, MakeTemporalCamera(camera, previous, width, height),
+                                           temporalSettings, last, current);
+        RunSpatialPass(tracer, pool, camera.eye, settings, current, last, &output, &stats);
+        previous = camera;
+
+        for (size_t i = 0; i < output.size(); i++) {
+            result.mean[i] += output[i] / static_cast<float>(frames);
+        }
+        for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+            total.candidatesDI[i] += stats.candidatesDI[i];
+            total.candidatesGI[i] += stats.candidatesGI[i];
+        }
+        total.attemptsDI += stats.attemptsDI;
+        total.attemptsGI += stats.attemptsGI;
+        total.seconds += stats.seconds;
+    }
+    result.lastFrame = output;
+
+    result.mask.assign(output.size(), false);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t i = MapPixelID(glm::uvec2(width, height), glm::uvec2(x, y));
+            result.mask[static_cast<size_t>(y) * width + x] =
+                i < current.samples.size() && !(glm::length(ToFloat3(current.samples[i].L1)) > 0.0f);
+        }
+    }
+
+    uint64_t shaded = 0;
+    for (uint32_t i = 0; i <= kMaxSpatialCandidates; i++) {
+        shaded += total.candidatesDI[i];
+    }
+    const double perPixel = shaded ? 1.0 / static_cast<double>(shaded) : 0.0;
+    std::printf("  init %.3f s, temporal %.3f s, spatial %.3f s over %u frames\n", initSeconds, temporalSeconds,
+                total.seconds, frames);
+    std::printf("  per shaded pixel: DI %.2f attempts, %.2f neighbors  GI %.2f attempts, %.2f neighbors\n",
+                total.attemptsDI * perPixel, total.MeanCandidatesDI(), total.attemptsGI * perPixel,
+                total.MeanCandidatesGI());
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 480;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 272;
+    const uint32_t frames = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 8;
+    const std::string mode = argc > 5 ? argv[5] : "both";
+    const float degreesPerFrame = argc > 6 ? static_cast<float>(std::atof(argv[6])) : 0.0f;
+    const uint32_t referenceSpp = argc > 7 ? static_cast<uint32_t>(std::atoi(argv[7])) : 32;
+    const uint32_t threads = argc > 8 ? static_cast<uint32_t>(std::atoi(argv[8])) : 0;
+    const std::string outPrefix = argc > 9 ? argv[9] : "";
+    if (mode != "circle" && mode != "table" && mode != "both") {
+        std::fprintf(stderr, "Unknown picker '%s', expected circle, table or both\n", mode.c_str());
+        return 1;
+    }
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(threads);
+
+    SpatialSettings settings;
+    DiskOffsetTable table;
+    table.Build(settings.restir.spatialRadius, settings.restir.spatialExponent);
+    settings.table = &table;
+    std::printf("Spatial reuse: %ux%u, %u frames, %.2f degrees/frame, radius %u, %u candidates in %u tries, "
+                "%u threads\n",
+                width, height, frames, degreesPerFrame, settings.restir.spatialRadius,
+                settings.restir.spatialCandidateCount, settings.restir.spatialMaxTries, pool.ThreadCount());
+    std::printf("disk table: %u offsets x %u rotations, stride %u, %zu bytes\n", table.count, table.rotations,
+                table.stride, table.Bytes());
+
+    std::vector<NeighborSelection> pickers;
+    if (mode != "table") {
+        pickers.push_back(NeighborSelection::Circle);
+    }
+    if (mode != "circle") {
+        pickers.push_back(NeighborSelection::DiskTable);
+    }
+
+    for (NeighborSelection picker : pickers) {
+        settings.selection = picker;
+        std::printf("%-6s selection: %.2f ns per attempt\n", picker == NeighborSelection::Circle ? "circle" : "table",
+                    TimeSelection(settings, width, height));
+    }
+
+    std::vector<glm::vec3> reference;
+    if (referenceSpp > 0) {
+        ReferenceSettings referenceSettings;
+        referenceSettings.width = width;
+        referenceSettings.height = height;
+        referenceSettings.halfPrecisionMaterials = true;
+        // At the last camera position; the tracer reads the camera from the scene
+        const CpuCamera baseCamera = scene.camera;
+        scene.camera = OrbitCamera(baseCamera, degreesPerFrame * static_cast<float>(frames - 1));
+        ReferenceRenderer renderer(tracer, pool);
+        renderer.Reset(referenceSettings);
+        renderer.Render(referenceSpp);
+        reference = renderer.Image();
+        scene.camera = baseCamera;
+    }
+
+    for (NeighborSelection picker : pickers) {
+        const char* name = picker == NeighborSelection::Circle ? "circle" : "table";
+        settings.selection = picker;
+        std::printf("%s:\n", name);
+        const PickerResult result =
+            RenderPath(tracer, pool, scene.camera, settings, width, height, frames, degreesPerFrame);
+        if (!reference.empty()) {
+            Compare("last frame", result.lastFrame, reference, result.mask);
+            if (degreesPerFrame == 0.0f) {
+                Compare("mean", result.mean, reference, result.mask);
+            }
+        }
+        if (!outPrefix.empty()) {
+            const std::string path = outPrefix + "_" + name + ".pfm";
+            if (!WritePfm(path, width, height, result.lastFrame)) {
+                std::fprintf(stderr, "Cannot write %s\n", path.c_str());
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
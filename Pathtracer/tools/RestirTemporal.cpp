@@ -0,0 +1,292 @@
+// CPU run of the init + temporal reuse passes over a camera path on the
+// default scene.
+//
+//   RestirTemporal [assetDir] [width] [height] [frames] [nearest|bilinear] [degreesPerFrame]
+//                  [referenceSpp] [threads] [statsPrefix]
+//
+// The camera orbits the scene center by degreesPerFrame per frame (0 keeps it
+// still). Every frame prints the pass times, the temporal acceptance rates and
+// the mean M after reuse; at the end the rejection reasons are summed over
+// frames 1.. (frame 0 has no history) and the M distribution of the last frame
+// is printed. With referenceSpp > 0 the last frame's DI and GI estimates,
+// with and without temporal reuse, are compared against the reference path
+// tracer. statsPrefix writes <prefix>_accept.pfm: per-pixel acceptance rate
+// over the path (R: DI, G: GI) and the last frame's M_DI / (2 * cap) in B.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Render/InitPass.h"
+#include "../src/Render/ReferenceRenderer.h"
+#include "../src/Render/SceneTracer.h"
+#include "../src/Render/TemporalPass.h"
+#include "../src/Scene/CpuScene.h"
+#include "../src/Util/ImageIO.h"
+#include "../src/Util/ThreadPool.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+struct Estimate {
+    glm::vec3 di = glm::vec3(0.0f);
+    glm::vec3 gi = glm::vec3(0.0f);
+};
+
+// What the shading pass outputs for the frame's reservoirs, row-major; non-finite values become zero
+void Shade(const SceneTracer& tracer, const RestirFrame& frame, std::vector<glm::vec3>& di,
+           std::vector<glm::vec3>& gi) {
+    di.assign(static_cast<size_t>(frame.width) * frame.height, glm::vec3(0.0f));
+    gi.assign(di.size(), glm::vec3(0.0f));
+    for (uint32_t y = 0; y < frame.height; y++) {
+        for (uint32_t x = 0; x < frame.width; x++) {
+            const uint32_t i = MapPixelID(glm::uvec2(frame.width, frame.height), glm::uvec2(x, y));
+            if (i >= frame.samples.size()) {
+                continue;
+            }
+            const SampleData& s = frame.samples[i];
+            if (glm::length(ToFloat3(s.L1)) > 0.0f) {
+                continue;
+            }
+            const Reservoir_DI& r = frame.reservoirsDI[i];
+            const Reservoir_GI& g = frame.reservoirsGI[i];
+            const ShadingMaterial mat = MakeShadingMaterial(tracer.Material(s.mID), s.mID, true);
+            Estimate e;
+            e.di = ReconnectDI(s.x1, s.n1, r.x2, r.n2, ToFloat3(r.L2), s.o, mat) * r.W;
+            e.gi = GetP_Hat_GI(tracer, s.x1, s.n1, g.xn, g.nn, ToFloat3(g.E3), s.o, mat, false) * g.W;
+            const size_t p = static_cast<size_t>(y) * frame.width + x;
+            if (std::isfinite(e.di.x + e.di.y + e.di.z) && std::isfinite(e.gi.x + e.gi.y + e.gi.z)) {
+                di[p] = e.di;
+                gi[p] = e.gi;
+            }
+        }
+    }
+}
+
+float Luminance(const glm::vec3& c) {
+    return (c.x + c.y + c.z) / 3.0f;
+}
+
+std::vector<glm::vec3> Reference(const SceneTracer& tracer, ThreadPool& pool, uint32_t width, uint32_t height,
+                                 uint32_t maxBounces, uint32_t spp) {
+    ReferenceSettings settings;
+    settings.width = width;
+    settings.height = height;
+    settings.maxBounces = maxBounces;
+    settings.halfPrecisionMaterials = true;
+    ReferenceRenderer renderer(tracer, pool);
+    renderer.Reset(settings);
+    renderer.Render(spp);
+    return renderer.Image();
+}
+
+// Relative RMSE over the pixels in mask
+double RelativeRmse(const std::vector<glm::vec3>& estimate, const std::vector<glm::vec3>& reference,
+                    const std::vector<bool>& mask) {
+    double sumReference = 0.0, squaredError = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < estimate.size(); i++) {
+        if (mask[i]) {
+            const double e = Luminance(estimate[i]);
+            const double r = Luminance(reference[i]);
+            sumReference += r;
+            squaredError += (e - r) * (e - r);
+            count++;
+        }
+    }
+    if (count == 0 || sumReference <= 0.0) {
+        return 0.0;
+    }
+    return std::sqrt(squaredError / static_cast<double>(count)) / (sumReference / static_cast<double>(count));
+}
+
+double MeanM(const std::vector<uint64_t>& histogram) {
+    uint64_t count = 0, sum = 0;
+    for (size_t m = 0; m < histogram.size(); m++) {
+        count += histogram[m];
+        sum += histogram[m] * m;
+    }
+    return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+}
+
+void PrintHistogram(const char* name, const std::vector<uint64_t>& histogram) {
+    uint64_t count = 0;
+    for (uint64_t c : histogram) {
+        count += c;
+    }
+    std::printf("M after reuse, %s:", name);
+    for (size_t m = 0; m < histogram.size(); m++) {
+        if (histogram[m] > 0) {
+            std::printf(" %zu:%.1f%%", m, 100.0 * histogram[m] / static_cast<double>(count));
+        }
+    }
+    std::printf("\n");
+}
+
+CpuCamera OrbitCamera(const CpuCamera& base, float degrees) {
+    CpuCamera camera = base;
+    const glm::vec3 offset = base.eye - base.center;
+    const float angle = glm::radians(degrees);
+    const float c = std::cos(angle), s = std::sin(angle);
+    camera.eye = base.center + glm::vec3(c * offset.x + s * offset.z, offset.y, -s * offset.x + c * offset.z);
+    return camera;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 480;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 272;
+    const uint32_t frames = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 16;
+    const std::string mode = argc > 5 ? argv[5] : "nearest";
+    const float degreesPerFrame = argc > 6 ? static_cast<float>(std::atof(argv[6])) : 0.5f;
+    const uint32_t referenceSpp = argc > 7 ? static_cast<uint32_t>(std::atoi(argv[7])) : 32;
+    const uint32_t threads = argc > 8 ? static_cast<uint32_t>(std::atoi(argv[8])) : 0;
+    const std::string statsPrefix = argc > 9 ? argv[9] : "";
+    if (mode != "nearest" && mode != "bilinear") {
+        std::fprintf(stderr, "Unknown reprojection '%s', expected nearest or bilinear\n", mode.c_str());
+        return 1;
+    }
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+    BvhBuildSettings buildSettings;
+    buildSettings.builder = BvhBuilder::Sbvh;
+    Bvh bvh;
+    bvh.Build(scene.positions, scene.indices, buildSettings);
+    SceneTracer tracer(scene, bvh);
+    ThreadPool pool(threads);
+
+    InitPassSettings initSettings;
+    TemporalSettings temporalSettings;
+    temporalSettings.reprojection = mode == "bilinear" ? ReprojectionMode::Bilinear : ReprojectionMode::Nearest;
+    std::printf("Temporal reuse: %ux%u, %u frames, %.2f degrees/frame, %s reprojection, M cap %u / %u, "
+                "%u threads\n",
+                width, height, frames, degreesPerFrame, mode.c_str(), temporalSettings.restir.temporalMCap,
+                temporalSettings.restir.temporalMCapGI, pool.ThreadCount());
+
+    const size_t pixels = static_cast<size_t>(width) * height;
+    RestirFrame current, last;
+    current.Resize(width, height);
+    last.Resize(width, height);
+    TemporalStats stats;
+    uint64_t outcomesDI[static_cast<size_t>(TemporalOutcome::Count)] = {};
+    uint64_t outcomesGI[static_cast<size_t>(TemporalOutcome::Count)] = {};
+    std::vector<uint32_t> acceptedDI(pixels, 0), acceptedGI(pixels, 0), tested(pixels, 0);
+    std::vector<glm::vec3> initDI, initGI, reuseDI, reuseGI;
+    double initSeconds = 0.0, temporalSeconds = 0.0;
+
+    CpuCamera previous = scene.camera;
+    for (uint32_t f = 0; f < frames; f++) {
+        const CpuCamera camera = OrbitCamera(scene.camera, degreesPerFrame * static_cast<float>(f));
+        initSettings.time = f;
+        temporalSettings.time = f;
+
+        const double init = RunInitPass(tracer, pool, camera.Rays(width, height), initSettings, current);
+        if (f + 1 == frames) {
+            Shade(tracer, current, initDI, initGI);
+        }
+        const double temporal = RunTemporalPass(tracer, pool, MakeTemporalCamera(camera, previous, width, height),
+                                                temporalSettings, last, current, &stats);
+        StoreLastFrame(current, last);
+        previous = camera;
+        initSeconds += init;
+        temporalSeconds += temporal;
+
+        std::printf("frame %3u: init %.3f s, temporal %.3f s, accepted DI %5.1f%% GI %5.1f%%, mean M DI %.2f "
+                    "GI %.2f\n",
+                    f, init, temporal, 100.0 * stats.AcceptanceDI(), 100.0 * stats.AcceptanceGI(),
+                    MeanM(stats.histogramDI), MeanM(stats.histogramGI));
+        if (f == 0) {
+            continue;
+        }
+        for (size_t o = 0; o < static_cast<size_t>(TemporalOutcome::Count); o++) {
+            outcomesDI[o] += stats.outcomesDI[o];
+            outcomesGI[o] += stats.outcomesGI[o];
+        }
+        for (size_t i = 0; i < pixels; i++) {
+            const TemporalPixelStats& p = stats.pixels[i];
+            if (p.outcomeDI != TemporalOutcome::Skipped) {
+                tested[i]++;
+                acceptedDI[i] += p.outcomeDI == TemporalOutcome::Accepted;
+                acceptedGI[i] += p.outcomeGI == TemporalOutcome::Accepted;
+            }
+        }
+    }
+    Shade(tracer, current, reuseDI, reuseGI);
+
+    std::printf("\ninit %.3f s, temporal %.3f s total (temporal %.1f%% of init)\n", initSeconds, temporalSeconds,
+                initSeconds > 0.0 ? 100.0 * temporalSeconds / initSeconds : 0.0);
+    uint64_t looked = 0;
+    for (size_t o = 0; o < static_cast<size_t>(TemporalOutcome::Count); o++) {
+        looked += o == static_cast<size_t>(TemporalOutcome::Skipped) ? 0 : outcomesDI[o];
+    }
+    std::printf("%-18s %8s %8s\n", "outcome", "DI", "GI");
+    for (size_t o = 0; o < static_cast<size_t>(TemporalOutcome::Count); o++) {
+        if (o == static_cast<size_t>(TemporalOutcome::Skipped) || (outcomesDI[o] == 0 && outcomesGI[o] == 0)) {
+            continue;
+        }
+        std::printf("%-18s %7.2f%% %7.2f%%\n", TemporalOutcomeName(static_cast<TemporalOutcome>(o)),
+                    looked ? 100.0 * outcomesDI[o] / static_cast<double>(looked) : 0.0,
+                    looked ? 100.0 * outcomesGI[o] / static_cast<double>(looked) : 0.0);
+    }
+    if (temporalSettings.reprojection == ReprojectionMode::Bilinear) {
+        std::printf("bilinear corner taken (by weight rank), last frame: DI %llu/%llu/%llu/%llu  "
+                    "GI %llu/%llu/%llu/%llu\n",
+                    (unsigned long long)stats.cornersDI[0], (unsigned long long)stats.cornersDI[1],
+                    (unsigned long long)stats.cornersDI[2], (unsigned long long)stats.cornersDI[3],
+                    (unsigned long long)stats.cornersGI[0], (unsigned long long)stats.cornersGI[1],
+                    (unsigned long long)stats.cornersGI[2], (unsigned long long)stats.cornersGI[3]);
+    }
+    PrintHistogram("DI", stats.histogramDI);
+    PrintHistogram("GI", stats.histogramGI);
+
+    if (!statsPrefix.empty()) {
+        std::vector<glm::vec3> image(pixels, glm::vec3(0.0f));
+        const float maxM = 2.0f * static_cast<float>(temporalSettings.restir.temporalMCap);
+        for (size_t i = 0; i < pixels; i++) {
+            if (tested[i] > 0) {
+                image[i].x = static_cast<float>(acceptedDI[i]) / static_cast<float>(tested[i]);
+                image[i].y = static_cast<float>(acceptedGI[i]) / static_cast<float>(tested[i]);
+            }
+            image[i].z = static_cast<float>(stats.pixels[i].M_DI) / maxM;
+        }
+        const std::string path = statsPrefix + "_accept.pfm";
+        if (!WritePfm(path, width, height, image)) {
+            std::fprintf(stderr, "Cannot write %s\n", path.c_str());
+            return 1;
+        }
+        std::printf("Wrote %s\n", path.c_str());
+    }
+
+    if (referenceSpp == 0) {
+        return 0;
+    }
+    // Reference at the last camera position; the tracer reads the camera from the scene
+    scene.camera = OrbitCamera(scene.camera, degreesPerFrame * static_cast<float>(frames - 1));
+    const std::vector<glm::vec3> referenceDI = Reference(tracer, pool, width, height, 1, referenceSpp);
+    std::vector<glm::vec3> referenceGI = Reference(tracer, pool, width, height, 4, referenceSpp);
+    for (size_t i = 0; i < pixels; i++) {
+        referenceGI[i] -= referenceDI[i];
+    }
+    std::vector<bool> mask(pixels, false);
+    for (size_t i = 0; i < pixels; i++) {
+        mask[i] = stats.pixels[i].outcomeDI != TemporalOutcome::Skipped;
+    }
+    std::printf("last frame vs %u spp reference, relative RMSE   no reuse   temporal\n", referenceSpp);
+    std::printf("  DI %35.3f %10.3f\n", RelativeRmse(initDI, referenceDI, mask),
+                RelativeRmse(reuseDI, referenceDI, mask));
+    std::printf("  GI %35.3f %10.3f\n", RelativeRmse(initGI, referenceGI, mask),
+                RelativeRmse(reuseGI, referenceGI, mask));
+    return 0;
+}
@@ -0,0 +1,319 @@
+// Bit exactness, statistical quality and throughput of the shader RNG
+// (RandomFloat / SeedPixel in Rng.h) against PCG.
+//
+//   RngBench [width] [height] [draws]
+//
+// exact    SeedPixels8 + RandomFloat8 against SeedPixel + RandomFloat for
+//          every pixel of a width x height frame, 16 draws per pixel,
+//          compared bit for bit
+// quality  lightweight bit tests (frequency, per-bit bias, byte and pair
+//          chi-square, lag-1 correlation, runs) on three streams: draws
+//          draws of one pixel, the first draw of every pixel, and the first
+//          draw of one pixel over draws frames. Scores are z values; |z| > 4
+//          (p < 1e-4) is flagged
+// speed    draws per second for 8 interleaved pixels, the way a wave or a
+//          CPU tile consumes them
+//
+// PCG32 (O'Neill) and the stateless PCG hash (Jarzynski & Olano) get the same
+// SeedPixel seeds, so only the generator differs.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/Render/Rng.h"
+
+namespace {
+
+// Raw 32-bit words of the three generators; TeaNext is RandomFloat's v0
+uint32_t TeaNext(glm::uvec2& seed) {
+    RandomFloat(seed);
+    return seed.x;
+}
+
+struct Pcg32 {
+    uint64_t state = 0;
+    uint64_t inc = 1;
+
+    explicit Pcg32(const glm::uvec2& seed) {
+        inc = (static_cast<uint64_t>(seed.y) << 1u) | 1u;
+        Next();
+        state += seed.x;
+        Next();
+    }
+
+    uint32_t Next() {
+        const uint64_t old = state;
+        state = old * 6364136223846793005ull + inc;
+        const uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        const uint32_t rot = static_cast<uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+    }
+};
+
+uint32_t PcgHash(uint32_t input) {
+    const uint32_t state = input * 747796405u + 2891336453u;
+    const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float ToFloat(uint32_t v) {
+    return static_cast<float>(v) / 4294967296.0f;
+}
+
+// A generator as the tests see it: a fresh stream from a SeedPixel seed, then words
+struct Generator {
+    const char* name;
+    std::function<std::function<uint32_t()>(const glm::uvec2&)> make;
+};
+
+std::vector<Generator> Generators() {
+    return {
+        {"TEA", [](const glm::uvec2& seed) {
+             return std::function<uint32_t()>([s = seed]() mutable { return TeaNext(s); });
+         }},
+        {"PCG32", [](const glm::uvec2& seed) {
+             return std::function<uint32_t()>([p = Pcg32(seed)]() mutable { return p.Next(); });
+         }},
+        {"PCG hash", [](const glm::uvec2& seed) {
+             return std::function<uint32_t()>([s = seed.x ^ seed.y]() mutable { return s = PcgHash(s); });
+         }},
+    };
+}
+
+struct TestScores {
+    double frequency = 0.0;
+    double worstBit = 0.0;
+    double bytes = 0.0;
+    double pairs = 0.0;
+    double correlation = 0.0;
+    double runs = 0.0;
+};
+
+TestScores RunTests(const std::vector<uint32_t>& words) {
+    TestScores scores;
+    const double n = static_cast<double>(words.size());
+
+    uint64_t ones = 0;
+    uint64_t bitOnes[32] = {};
+    uint64_t byteBins[256] = {};
+    uint64_t pairBins[256] = {};
+    for (size_t i = 0; i < words.size(); i++) {
+        const uint32_t w = words[i];
+        for (int b = 0; b < 32; b++) {
+            bitOnes[b] += (w >> b) & 1u;
+        }
+        byteBins[w >> 24u]++;
+        if (i % 2 == 1) {
+            pairBins[((words[i - 1] >> 28u) << 4u) | (w >> 28u)]++;
+        }
+    }
+    for (int b = 0; b < 32; b++) {
+        ones += bitOnes[b];
+        const double z = (static_cast<double>(bitOnes[b]) - n * 0.5) / std::sqrt(n * 0.25);
+        scores.worstBit = std::max(scores.worstBit, std::abs(z));
+    }
+    scores.frequency = (static_cast<double>(ones) - n * 16.0) / std::sqrt(n * 8.0);
+
+    // Chi-square with 255 degrees of freedom, as a z value
+    const auto chiSquareZ = [](const uint64_t (&bins)[256], double count) {
+        const double expected = count / 256.0;
+        double chi2 = 0.0;
+        for (uint64_t observed : bins) {
+            chi2 += (static_cast<double>(observed) - expected) * (static_cast<double>(observed) - expected) / expected;
+        }
+        return (chi2 - 255.0) / std::sqrt(2.0 * 255.0);
+    };
+    scores.bytes = chiSquareZ(byteBins, n);
+    scores.pairs = chiSquareZ(pairBins, std::floor(n / 2.0));
+
+    double sum = 0.0, sumSq = 0.0, sumLag = 0.0;
+    for (size_t i = 0; i < words.size(); i++) {
+        const double u = ToFloat(words[i]) - 0.5;
+        sum += u;
+        sumSq += u * u;
+        if (i > 0) {
+            sumLag += u * (ToFloat(words[i - 1]) - 0.5);
+        }
+    }
+    const double mean = sum / n;
+    const double variance = sumSq / n - mean * mean;
+    scores.correlation = variance > 0.0 ? (sumLag / (n - 1.0) - mean * mean) / variance * std::sqrt(n) : 0.0;
+
+    // Runs of the top bit
+    uint64_t runs = 1;
+    for (size_t i = 1; i < words.size(); i++) {
+        runs += (words[i] >> 31u) != (words[i - 1] >> 31u);
+    }
+    const double p = static_cast<double>(bitOnes[31]) / n;
+    const double expectedRuns = 2.0 * n * p * (1.0 - p) + 1.0;
+    const double runsSigma = std::sqrt(2.0 * n * p * (1.0 - p) * (2.0 * n * p * (1.0 - p) - 1.0) / (n - 1.0));
+    scores.runs = runsSigma > 0.0 ? (static_cast<double>(runs) - expectedRuns) / runsSigma : 0.0;
+    return scores;
+}
+
+void PrintScores(const char* generator, const char* stream, const TestScores& s) {
+    const auto cell = [](double z) {
+        static char buffers[6][16];
+        static int next = 0;
+        char* b = buffers[next++ % 6];
+        std::snprintf(b, 16, "%+7.2f%s", z, std::abs(z) > 4.0 ? "!" : " ");
+        return b;
+    };
+    std::printf("%-9s %-9s %s %s %s %s %s %s\n", generator, stream, cell(s.frequency), cell(s.worstBit),
+                cell(s.bytes), cell(s.pairs), cell(s.correlation), cell(s.runs));
+}
+
+// Draws of 8 interleaved pixels per block, `draws` per pixel; returns draws per second
+template <typename Block>
+double Throughput(uint32_t width, uint32_t height, uint32_t draws, float& checksum, const Block& block) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x + 8 <= width; x += 8) {
+            checksum += block(x, y, draws);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    return static_cast<double>(width / 8 * 8) * height * draws / seconds;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t width = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1920;
+    const uint32_t height = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 1080;
+    const uint32_t draws = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 1u << 22u;
+
+    // Bit exactness of the 8-lane path
+    uint64_t seedMismatches = 0, drawMismatches = 0, comparisons = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x += 8) {
+            SeedLanes8 lanes;
+            SeedPixels8(x, y, 1, 7, lanes);
+            glm::uvec2 scalar[8];
+            for (uint32_t i = 0; i < 8; i++) {
+                scalar[i] = SeedPixel(x + i, y, 1, 7);
+                seedMismatches += scalar[i].x != lanes.x[i] || scalar[i].y != lanes.y[i];
+            }
+            for (int d = 0; d < 16; d++) {
+                float simd[8];
+                RandomFloat8(lanes, simd);
+                for (uint32_t i = 0; i < 8; i++) {
+                    const float expected = RandomFloat(scalar[i]);
+                    drawMismatches += std::memcmp(&expected, &simd[i], sizeof(float)) != 0;
+                    comparisons++;
+                }
+            }
+        }
+    }
+    std::printf("exact: RandomFloat8 (%s) vs RandomFloat, %llu draws: %llu seed and %llu draw mismatches\n",
+                RandomFloat8Isa(), static_cast<unsigned long long>(comparisons),
+                static_cast<unsigned long long>(seedMismatches), static_cast<unsigned long long>(drawMismatches));
+
+    // Quality
+    std::printf("\n%-9s %-9s %8s %8s %8s %8s %8s %8s\n", "generator", "stream", "freq", "max bit", "bytes", "pairs",
+                "lag-1", "runs");
+    for (const Generator& generator : Generators()) {
+        std::vector<uint32_t> words(draws);
+        std::function<uint32_t()> next = generator.make(SeedPixel(0, 0, 1, 0));
+        for (uint32_t& w : words) {
+            w = next();
+        }
+        PrintScores(generator.name, "sequence", RunTests(words));
+
+        words.assign(static_cast<size_t>(width) * height, 0);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                words[static_cast<size_t>(y) * width + x] = generator.make(SeedPixel(x, y, 1, 0))();
+            }
+        }
+        PrintScores(generator.name, "pixels", RunTests(words));
+
+        words.assign(draws, 0);
+        for (uint32_t t = 0; t < draws; t++) {
+            words[t] = generator.make(SeedPixel(width / 2, height / 2, 1, t))();
+        }
+        PrintScores(generator.name, "frames", RunTests(words));
+    }
+
+    // RandomFloat returns exactly 1.0 for the top 128 words, which the shader's [0, 1) users do not expect
+    glm::uvec2 seed = SeedPixel(0, 0, 1, 0);
+    uint64_t ones = 0;
+    for (uint32_t i = 0; i < draws; i++) {
+        ones += RandomFloat(seed) >= 1.0f;
+    }
+    std::printf("RandomFloat == 1.0: %llu of %u draws (expected %.3f)\n", static_cast<unsigned long long>(ones),
+                draws, draws * 128.0 / 4294967296.0);
+
+    // Throughput
+    const uint32_t perPixel = 64;
+    float checksum = 0.0f;
+    const double teaScalar = Throughput(width, height, perPixel, checksum, [](uint32_t x, uint32_t y, uint32_t n) {
+        glm::uvec2 seeds[8];
+        for (uint32_t i = 0; i < 8; i++) {
+            seeds[i] = SeedPixel(x + i, y, 1, 0);
+        }
+        float sum = 0.0f;
+        for (uint32_t d = 0; d < n; d++) {
+            for (uint32_t i = 0; i < 8; i++) {
+                sum += RandomFloat(seeds[i]);
+            }
+        }
+        return sum;
+    });
+    const double teaSimd = Throughput(width, height, perPixel, checksum, [](uint32_t x, uint32_t y, uint32_t n) {
+        SeedLanes8 lanes;
+        SeedPixels8(x, y, 1, 0, lanes);
+        float sum = 0.0f;
+        float out[8];
+        for (uint32_t d = 0; d < n; d++) {
+            RandomFloat8(lanes, out);
+            for (float v : out) {
+                sum += v;
+            }
+        }
+        return sum;
+    });
+    const double pcg32 = Throughput(width, height, perPixel, checksum, [](uint32_t x, uint32_t y, uint32_t n) {
+        Pcg32 rngs[8] = {Pcg32(SeedPixel(x, y, 1, 0)),     Pcg32(SeedPixel(x + 1, y, 1, 0)),
+                         Pcg32(SeedPixel(x + 2, y, 1, 0)), Pcg32(SeedPixel(x + 3, y, 1, 0)),
+                         Pcg32(SeedPixel(x + 4, y, 1, 0)), Pcg32(SeedPixel(x + 5, y, 1, 0)),
+                         Pcg32(SeedPixel(x + 6, y, 1, 0)), Pcg32(SeedPixel(x + 7, y, 1, 0))};
+        float sum = 0.0f;
+        for (uint32_t d = 0; d < n; d++) {
+            for (Pcg32& rng : rngs) {
+                sum += ToFloat(rng.Next());
+            }
+        }
+        return sum;
+    });
+    const double pcgHash = Throughput(width, height, perPixel, checksum, [](uint32_t x, uint32_t y, uint32_t n) {
+        uint32_t states[8];
+        for (uint32_t i = 0; i < 8; i++) {
+            const glm::uvec2 s = SeedPixel(x + i, y, 1, 0);
+            states[i] = s.x ^ s.y;
+        }
+        float sum = 0.0f;
+        for (uint32_t d = 0; d < n; d++) {
+            for (uint32_t& state : states) {
+                state = PcgHash(state);
+                sum += ToFloat(state);
+            }
+        }
+        return sum;
+    });
+
+    std::printf("\nthroughput, %ux%u pixels x %u draws, 8 pixels interleaved:\n", width, height, perPixel);
+    std::printf("  TEA scalar      %8.1f M draws/s\n", teaScalar * 1e-6);
+    std::printf("  TEA x8 %-8s%8.1f M draws/s  (%.2fx scalar)\n", RandomFloat8Isa(), teaSimd * 1e-6,
+                teaSimd / teaScalar);
+    std::printf("  PCG32           %8.1f M draws/s  (%.2fx TEA scalar)\n", pcg32 * 1e-6, pcg32 / teaScalar);
+    std::printf("  PCG hash        %8.1f M draws/s  (%.2fx TEA scalar)\n", pcgHash * 1e-6, pcgHash / teaScalar);
+    std::printf("(checksum %g)\n", checksum);
+    return drawMismatches == 0 && seedMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Binned SAH vs. SBVH vs. pre-split geometry on the default scene.
+//
+//   SbvhBench [assetDir] [width] [height]
+//
+// Every configuration traces the same primary and one-bounce diffuse rays
+// (generated once from the binned SAH baseline) with single-ray traversal and
+// reports traversal steps, triangle tests and throughput relative to binned SAH.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/Accel/Bvh.h"
+#include "../src/Accel/RayBatch.h"
+#include "../src/Scene/CpuScene.h"
+
+#ifndef PATHTRACER_ASSET_DIR
+#define PATHTRACER_ASSET_DIR "./"
+#endif
+
+namespace {
+
+struct Config {
+    const char* name;
+    BvhBuildSettings settings;
+    bool preSplit;
+    PreSplitSettings preSplitSettings;
+};
+
+struct Measurement {
+    double nodesPerRay = 0.0;
+    double trianglesPerRay = 0.0;
+    double mraysPerSecond = 0.0;
+};
+
+Measurement Measure(const Bvh& bvh, const std::vector<BvhRay>& rays, int repeats) {
+    BvhTraversalStats stats;
+    BvhHit hit;
+    for (const BvhRay& ray : rays) {
+        bvh.Intersect(ray, hit, &stats);
+    }
+
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (const BvhRay& ray : rays) {
+            bvh.Intersect(ray, hit);
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+
+    Measurement m;
+    m.nodesPerRay = static_cast<double>(stats.nodeTests) / static_cast<double>(stats.rays);
+    m.trianglesPerRay = static_cast<double>(stats.triangleTests) / static_cast<double>(stats.rays);
+    m.mraysPerSecond = static_cast<double>(rays.size()) * 1e-6 / best;
+    return m;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : PATHTRACER_ASSET_DIR;
+    const uint32_t width = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 640;
+    const uint32_t height = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 360;
+    constexpr int repeats = 5;
+
+    CpuScene scene;
+    if (!scene.LoadDefault(assetDir)) {
+        std::fprintf(stderr, "Failed to load scene from %s\n", assetDir.c_str());
+        return 1;
+    }
+
+    std::vector<Config> configs;
+    configs.push_back({"binned SAH", {}, false, {}});
+    for (const float budget : {0.1f, 0.3f, 1.0f}) {
+        Config c{"", {}, false, {}};
+        c.settings.builder = BvhBuilder::Sbvh;
+        c.settings.splitBudget = budget;
+        c.name = budget == 0.1f ? "SBVH 10%" : budget == 0.3f ? "SBVH 30%" : "SBVH 100%";
+        configs.push_back(c);
+    }
+    for (const float budget : {0.25f, 1.0f}) {
+        Config c{budget == 0.25f ? "pre-split 25% + SAH" : "pre-split 100% + SAH", {}, true, {}};
+        c.preSplitSettings.splitBudget = budget;
+        configs.push_back(c);
+    }
+
+    // Fixed ray sets from the baseline
+    Bvh baseline;
+    baseline.Build(scene.positions, scene.indices);
+    const std::vector<BvhRay> primary = GeneratePrimaryRays(scene, width, height);
+    std::vector<BvhHit> primaryHits(primary.size());
+    for (size_t i = 0; i < primary.size(); i++) {
+        baseline.Intersect(primary[i], primaryHits[i]);
+    }
+    const std::vector<BvhRay> diffuse = GenerateDiffuseRays(scene, primary, primaryHits, 1234);
+
+    std::printf("%-22s %9s %8s %9s | %-25s | %-25s\n", "", "", "", "", "primary", "diffuse");
+    std::printf("%-22s %9s %8s %9s | %7s %6s %10s | %7s %6s %10s\n", "builder", "triangles", "refs",
+                "build ms", "nodes", "tris", "Mrays/s", "nodes", "tris", "Mrays/s");
+
+    Measurement basePrimary, baseDiffuse;
+    for (size_t c = 0; c < configs.size(); c++) {
+        const Config& config = configs[c];
+        CpuScene variant = scene;
+        if (config.preSplit) {
+            variant.PreSplit(config.preSplitSettings);
+        }
+
+        Bvh bvh;
+        const auto start = std::chrono::high_resolution_clock::now();
+        bvh.Build(variant.positions, variant.indices, config.settings);
+        const double buildMs = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+
+        const Measurement p = Measure(bvh, primary, repeats);
+        const Measurement d = Measure(bvh, diffuse, repeats);
+        if (c == 0) {
+            basePrimary = p;
+            baseDiffuse = d;
+        }
+        std::printf("%-22s %9u %8zu %9.2f | %7.2f %6.2f %5.2f %+4.0f%% | %7.2f %6.2f %5.2f %+4.0f%%\n",
+                    config.name, variant.TriangleCount(), bvh.LeafTriangleIds().size(), buildMs,
+                    p.nodesPerRay, p.trianglesPerRay, p.mraysPerSecond,
+                    100.0 * (p.mraysPerSecond / basePrimary.mraysPerSecond - 1.0),
+                    d.nodesPerRay, d.trianglesPerRay, d.mraysPerSecond,
+                    100.0 * (d.mraysPerSecond / baseDiffuse.mraysPerSecond - 1.0));
+    }
+    return 0;
+}
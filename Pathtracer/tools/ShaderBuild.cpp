@@ -0,0 +1,235 @@
+// Checks of the parallel shader library build (ShaderBuild.h) on the
+// renderer's ray tracing libraries, without a compiler.
+//
+//   ShaderBuild [threads] [work]
+//
+// The stand-in compiler reads the include closure of a library and hashes it
+// work times, so a job costs in proportion to the source it compiles as DXC
+// does. The libraries are built one after another on a single thread, then on
+// a pool of the given number of threads: every job has to run once, results
+// come back in job order with the same blobs, a compiler instance is created
+// at most once per thread and never used by two jobs at a time. Failing jobs
+// must not stop the others and their errors are reported together, a
+// compiler that cannot be created fails the jobs instead of the pool, and a
+// shared shader cache serves a second build entirely. Prints the wall time of
+// both builds and the time saved; on a single core there is nothing to save.
+// Any failure makes the exit code 1.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "../src/Render/ShaderBuild.h"
+#include "../src/Render/ShaderCache.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Renderer::CreateRaytracingPipeline
+const std::vector<std::string> kLibraries = {
+    "RayGen_v6_pass1.hlsl", "RayGen_v6_pass2.hlsl", "RayGen_v6_pass3.hlsl",
+    "Miss_v6.hlsl",         "Hit_v6.hlsl",          "ShadowRay.hlsl",
+};
+const std::vector<std::string> kArguments = {"-O3", "lib_6_7"};
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+struct StandInCompiler {
+    std::thread::id owner = std::this_thread::get_id();
+    std::atomic<bool> busy{false};
+    uint32_t jobs = 0;
+};
+
+// What the jobs of one build saw
+struct Run {
+    std::vector<std::atomic<uint32_t>> runs;
+    std::vector<uint64_t> blobs;
+    std::atomic<uint32_t> created{0};
+    std::atomic<uint32_t> shared{0};     // a compiler used by another thread or by two jobs at once
+    explicit Run(size_t jobs) : runs(jobs), blobs(jobs, 0) {}
+};
+
+// Hashes the closure of library work times; the "blob" is the last hash
+uint64_t StandInCompile(const fs::path& shader, uint32_t work) {
+    const ShaderKey key = ComputeShaderKey(shader, kArguments, std::string("stand-in"));
+    std::string source;
+    for (const fs::path& file : key.files) {
+        std::ifstream in(file, std::ios::binary);
+        source.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint64_t blob = key.value;
+    for (uint32_t i = 0; i < work; i++) {
+        ShaderHash hash;
+        hash.Add(&blob, sizeof(blob));
+        hash.Add(source);
+        blob = hash.Value();
+    }
+    return blob;
+}
+
+// failing: jobs whose compile reports an error; createEvery: 0 creates every
+// compiler, n > 0 fails the creation on every n-th call
+ShaderBuildReport Build(ThreadPool& pool, const fs::path& dir, uint32_t work, Run& run,
+                        const std::vector<uint32_t>& failing = {}, uint32_t createEvery = 0,
+                        ShaderCache* cache = nullptr) {
+    return BuildShaders<StandInCompiler>(
+        pool, kLibraries,
+        [&]() -> std::unique_ptr<StandInCompiler> {
+            const uint32_t call = run.created.fetch_add(1) + 1;
+            if (createEvery && call % createEvery == 0) {
+                return nullptr;
+            }
+            return std::make_unique<StandInCompiler>();
+        },
+        [&](StandInCompiler& compiler, uint32_t job) {
+            ShaderBuildOutput output;
+            if (compiler.busy.exchange(true) || compiler.owner != std::this_thread::get_id()) {
+                run.shared++;
+            }
+            compiler.jobs++;
+            run.runs[job]++;
+            const std::string name = fs::path(kLibraries[job]).stem().string();
+            const fs::path shader = dir / kLibraries[job];
+            bool failed = false;
+            for (uint32_t f : failing) {
+                failed = failed || f == job;
+            }
+            std::vector<uint8_t> stored;
+            if (failed) {
+                output.error = kLibraries[job] + "(1,1): error: stand-in failure";
+            } else if (cache && cache->Load(name, ComputeShaderKey(shader, kArguments, std::string("stand-in")).value,
+                                            stored) && stored.size() == sizeof(uint64_t)) {
+                std::copy(stored.begin(), stored.end(), reinterpret_cast<uint8_t*>(&run.blobs[job]));
+                output.ok = output.cached = true;
+            } else {
+                run.blobs[job] = StandInCompile(shader, work);
+                if (cache) {
+                    cache->Store(name, ComputeShaderKey(shader, kArguments, std::string("stand-in")).value,
+                                 &run.blobs[job], sizeof(uint64_t));
+                }
+                output.ok = true;
+            }
+            compiler.busy = false;
+            return output;
+        });
+}
+
+void PrintReport(const char* what, const ShaderBuildReport& report) {
+    std::printf("  %-9s %u threads, %u compilers, %7.1f ms wall, %7.1f ms of jobs, %7.1f ms saved\n", what,
+                report.threads, report.compilers, report.wallMilliseconds, report.jobMilliseconds,
+                report.SavedMilliseconds());
+}
+
+void CheckRun(const Run& run, const ShaderBuildReport& report, uint32_t threads) {
+    for (size_t job = 0; job < kLibraries.size(); job++) {
+        // Jobs of a thread without a compiler never reach it
+        const bool noCompiler = report.results[job].output.error == "no compiler on this thread";
+        Check(run.runs[job] == (noCompiler ? 0u : 1u), "every job runs once");
+        Check(report.results[job].name == kLibraries[job], "results in job order");
+        Check(report.results[job].thread < threads, "job on a pool thread");
+    }
+    Check(run.shared == 0, "a compiler is used by its own thread only, one job at a time");
+    Check(run.created <= threads && run.created <= kLibraries.size(), "at most one compiler per thread");
+    Check(report.compilers <= run.created, "compiler count");
+}
+
+void Builds(const fs::path& dir, uint32_t threads, uint32_t work) {
+    std::printf("builds (hardware threads: %u)\n", std::thread::hardware_concurrency());
+    ThreadPool serialPool(1);
+    Run serial(kLibraries.size());
+    const ShaderBuildReport one = Build(serialPool, dir, work, serial);
+    PrintReport("serial", one);
+    CheckRun(serial, one, 1);
+    Check(one.Failed() == 0 && one.compilers == 1, "serial build");
+
+    ThreadPool pool(threads);
+    Run parallel(kLibraries.size());
+    const ShaderBuildReport many = Build(pool, dir, work, parallel);
+    PrintReport("parallel", many);
+    CheckRun(parallel, many, threads);
+    Check(many.Failed() == 0, "parallel build");
+    Check(parallel.blobs == serial.blobs, "the same blobs as the serial build");
+    for (const ShaderBuildResult& result : many.results) {
+        std::printf("    %-21s thread %u %6.1f ms\n", result.name.c_str(), result.thread, result.milliseconds);
+    }
+    std::printf("  startup: %.1f ms serial, %.1f ms parallel (%.2fx)\n", one.wallMilliseconds, many.wallMilliseconds,
+                many.wallMilliseconds > 0.0 ? one.wallMilliseconds / many.wallMilliseconds : 0.0);
+}
+
+void Errors(const fs::path& dir, uint32_t threads) {
+    std::printf("errors\n");
+    ThreadPool pool(threads);
+    Run run(kLibraries.size());
+    const ShaderBuildReport report = Build(pool, dir, 1, run, {4, 1});
+    CheckRun(run, report, threads);
+    const std::string errors = report.Errors();
+    std::printf("%s", errors.c_str());
+    Check(report.Failed() == 2, "two failed jobs");
+    const size_t first = errors.find(kLibraries[1] + ":\n");
+    const size_t second = errors.find(kLibraries[4] + ":\n");
+    Check(first != std::string::npos && second != std::string::npos && first < second,
+          "errors of all failed jobs, in job order");
+    Check(report.results[0].output.ok && report.results[5].output.ok, "the other jobs still build");
+
+    // No compiler can be created: every job fails with that error, and a
+    // thread tries to create its compiler only once
+    Run broken(kLibraries.size());
+    const ShaderBuildReport none = Build(pool, dir, 1, broken, {}, 1);
+    CheckRun(broken, none, threads);
+    std::printf("  without compilers: %u jobs failed, %u creations tried\n", none.Failed(), broken.created.load());
+    Check(none.Failed() == kLibraries.size() && none.compilers == 0, "jobs fail without a compiler");
+    Check(none.Errors().find("no compiler on this thread") != std::string::npos, "the missing compiler is reported");
+}
+
+void Cached(const fs::path& dir, uint32_t threads, uint32_t work) {
+    std::printf("shared cache\n");
+    const fs::path cacheDir = fs::temp_directory_path() / "ShaderBuildCheck";
+    std::error_code error;
+    fs::remove_all(cacheDir, error);
+    ShaderCache cache(cacheDir);
+    ThreadPool pool(threads);
+    Run first(kLibraries.size());
+    const ShaderBuildReport cold = Build(pool, dir, work, first, {}, 0, &cache);
+    Run second(kLibraries.size());
+    const ShaderBuildReport warm = Build(pool, dir, work, second, {}, 0, &cache);
+    PrintReport("cold", cold);
+    PrintReport("warm", warm);
+    Check(cold.Cached() == 0 && warm.Cached() == kLibraries.size(), "the second build is served by the cache");
+    Check(first.blobs == second.blobs, "cached blobs are the compiled ones");
+    Check(cache.Stats().stores == kLibraries.size() && cache.Stats().hits == kLibraries.size(), "cache counters");
+    fs::remove_all(cacheDir, error);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t threads = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 6;
+    const uint32_t work = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 100;
+#ifdef PATHTRACER_ASSET_DIR
+    const fs::path dir(PATHTRACER_ASSET_DIR);
+#else
+    const fs::path dir("include");
+#endif
+    Builds(dir, threads ? threads : 1, work);
+    Errors(dir, threads ? threads : 1);
+    Cached(dir, threads ? threads : 1, work);
+    std::printf("ShaderBuild checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,278 @@
+// Checks of the shader cache keys and entries (ShaderCache.h) on the
+// renderer's ray tracing libraries, without a compiler.
+//
+//   ShaderCache [includeDir]
+//
+// Prints the include closure and key of each library ShaderLibraryCompiler
+// builds, then works on a copy of the include directory: every file is edited
+// in turn and the keys of exactly the libraries that include it, directly or
+// not, have to change. Arguments and the compiler version have to be part of
+// the key. The cache is then run as the renderer does over a few launches,
+// with a stand-in for DXC that writes the sources as the "blob": a first
+// launch compiles everything, the next one loads everything, an edit
+// recompiles only the libraries that depend on it and replaces their stale
+// entries, and truncated, corrupted or misnamed entries are recompiled rather
+// than loaded. Any failure makes the exit code 1.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../src/Render/ShaderCache.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Renderer::CreateRaytracingPipeline
+const char* const kLibraries[] = {
+    "RayGen_v6_pass1.hlsl", "RayGen_v6_pass2.hlsl", "RayGen_v6_pass3.hlsl",
+    "Miss_v6.hlsl",         "Hit_v6.hlsl",          "ShadowRay.hlsl",
+};
+constexpr size_t kLibraryCount = sizeof(kLibraries) / sizeof(kLibraries[0]);
+
+// ShaderLibraryCompiler's arguments and target, SAMPLE_DATA_DEBUG off
+const std::vector<std::string> kArguments = {
+    "-Zi", "-O3", "-enable-16bit-types", "-D", "MAX_REGS=96", "-D", "SAMPLE_DATA_DEBUG=0", "-HV", "2021", "lib_6_7",
+};
+const std::string kCompiler = "dxc 1.8";
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+std::string Stem(const char* library) { return fs::path(library).stem().string(); }
+
+std::vector<uint64_t> Keys(const fs::path& dir, const std::vector<std::string>& arguments, const std::string& compiler) {
+    std::vector<uint64_t> keys;
+    for (const char* library : kLibraries) {
+        keys.push_back(ComputeShaderKey(dir / library, arguments, compiler).value);
+    }
+    return keys;
+}
+
+void AppendLine(const fs::path& file, const char* line) {
+    std::ofstream out(file, std::ios::binary | std::ios::app);
+    out << line << "\n";
+}
+
+void Closures(const fs::path& includeDir) {
+    std::printf("include closures (%s)\n", includeDir.string().c_str());
+    for (const char* library : kLibraries) {
+        const auto start = std::chrono::steady_clock::now();
+        const ShaderKey key = ComputeShaderKey(includeDir / library, kArguments, kCompiler);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::string files;
+        for (size_t i = 1; i < key.files.size(); i++) {
+            files += (i > 1 ? " " : "") + key.files[i].filename().string();
+        }
+        std::printf("  %-21s %016llx %5.2f ms  %s\n", library, static_cast<unsigned long long>(key.value), ms,
+                    files.c_str());
+        for (const std::string& missing : key.missing) {
+            std::printf("      not found: %s\n", missing.c_str());
+        }
+        Check(!key.files.empty() && key.files[0].filename() == library, "the library is the first file of its key");
+        Check(ComputeShaderKey(includeDir / library, kArguments, kCompiler).value == key.value, "keys are stable");
+    }
+}
+
+// Copies the files of includeDir the libraries may read
+bool CopySources(const fs::path& includeDir, const fs::path& dir) {
+    std::error_code error;
+    fs::remove_all(dir, error);
+    fs::create_directories(dir, error);
+    for (const auto& entry : fs::directory_iterator(includeDir, error)) {
+        const fs::path extension = entry.path().extension();
+        if (extension == ".hlsl" || extension == ".h") {
+            fs::copy_file(entry.path(), dir / entry.path().filename(), error);
+            if (error) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Dependencies(const fs::path& dir) {
+    std::printf("editing each source file\n");
+    std::vector<ShaderKey> closures;
+    for (const char* library : kLibraries) {
+        closures.push_back(ComputeShaderKey(dir / library, kArguments, kCompiler));
+    }
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        files.push_back(entry.path());
+    }
+    uint32_t edited = 0, unused = 0;
+    for (const fs::path& file : files) {
+        const std::vector<uint64_t> before = Keys(dir, kArguments, kCompiler);
+        AppendLine(file, "// edited");
+        const std::vector<uint64_t> after = Keys(dir, kArguments, kCompiler);
+        bool any = false;
+        for (size_t l = 0; l < kLibraryCount; l++) {
+            bool dependent = false;
+            for (const fs::path& f : closures[l].files) {
+                dependent = dependent || f == file.lexically_normal();
+            }
+            any = any || dependent;
+            if ((before[l] != after[l]) != dependent) {
+                std::printf("  %s: key of %s %s\n", file.filename().string().c_str(), kLibraries[l],
+                            dependent ? "unchanged" : "changed");
+                g_failures++;
+            }
+        }
+        edited++;
+        unused += any ? 0 : 1;
+    }
+    std::printf("  %u files edited, %u read by no library\n", edited, unused);
+
+    const std::vector<uint64_t> keys = Keys(dir, kArguments, kCompiler);
+    std::vector<std::string> arguments = kArguments;
+    arguments[4] = "MAX_REGS=128";
+    const std::vector<uint64_t> define = Keys(dir, arguments, kCompiler);
+    arguments = kArguments;
+    arguments[3] = "-DMAX_REGS";
+    arguments[4] = "=96";
+    const std::vector<uint64_t> split = Keys(dir, arguments, kCompiler);
+    arguments = kArguments;
+    arguments.back() = "lib_6_8";
+    const std::vector<uint64_t> target = Keys(dir, arguments, kCompiler);
+    const std::vector<uint64_t> compiler = Keys(dir, kArguments, "dxc 1.9");
+    for (size_t l = 0; l < kLibraryCount; l++) {
+        Check(define[l] != keys[l], "a define is part of the key");
+        Check(split[l] != keys[l], "arguments split differently give another key");
+        Check(target[l] != keys[l], "the target profile is part of the key");
+        Check(compiler[l] != keys[l], "the compiler version is part of the key");
+        for (size_t o = 0; o < l; o++) {
+            Check(keys[o] != keys[l], "libraries have different keys");
+        }
+    }
+}
+
+// What ShaderLibraryCompiler does with the cache; the "compiler" concatenates
+// the sources
+struct Launch {
+    uint32_t loaded = 0, compiled = 0;
+};
+
+std::string StandInCompile(const ShaderKey& key) {
+    std::string blob = "DXIL";
+    for (const fs::path& file : key.files) {
+        std::ifstream in(file, std::ios::binary);
+        blob.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    return blob;
+}
+
+Launch Run(const fs::path& dir, const fs::path& cacheDir) {
+    ShaderCache cache(cacheDir);
+    Launch launch;
+    for (const char* library : kLibraries) {
+        const ShaderKey key = ComputeShaderKey(dir / library, kArguments, kCompiler);
+        const std::string expected = StandInCompile(key);
+        std::vector<uint8_t> blob;
+        if (cache.Load(Stem(library), key.value, blob)) {
+            launch.loaded++;
+            Check(std::string(blob.begin(), blob.end()) == expected, "a loaded blob is the one stored");
+            continue;
+        }
+        launch.compiled++;
+        Check(cache.Store(Stem(library), key.value, expected.data(), expected.size()), "entry stored");
+    }
+    return launch;
+}
+
+size_t Entries(const fs::path& cacheDir) {
+    size_t count = 0;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(cacheDir, error)) {
+        count += entry.path().extension() == ".dxil" ? 1 : 0;
+    }
+    return count;
+}
+
+void Launches(const fs::path& dir, const fs::path& cacheDir) {
+    std::printf("launches\n");
+    std::error_code error;
+    fs::remove_all(cacheDir, error);
+
+    Launch launch = Run(dir, cacheDir);
+    std::printf("  first:        %u loaded, %u compiled\n", launch.loaded, launch.compiled);
+    Check(launch.compiled == kLibraryCount, "an empty cache compiles everything");
+    launch = Run(dir, cacheDir);
+    std::printf("  unchanged:    %u loaded, %u compiled\n", launch.loaded, launch.compiled);
+    Check(launch.loaded == kLibraryCount, "a second launch loads everything");
+
+    AppendLine(dir / "Hit_v6.hlsl", "// edited");
+    launch = Run(dir, cacheDir);
+    std::printf("  Hit_v6 edit:  %u loaded, %u compiled\n", launch.loaded, launch.compiled);
+    Check(launch.compiled == 1, "editing a library recompiles it alone");
+    AppendLine(dir / "GiResolution.h", "// edited");
+    launch = Run(dir, cacheDir);
+    std::printf("  header edit:  %u loaded, %u compiled\n", launch.loaded, launch.compiled);
+    Check(launch.compiled == 5 && launch.loaded == 1, "editing a header recompiles its includers");
+    Check(Entries(cacheDir) == kLibraryCount, "stale entries are replaced");
+
+    // Damaged entries: cut short, a flipped byte, and the entry of one
+    // library copied over another's name
+    ShaderCache cache(cacheDir);
+    const ShaderKey pass1 = ComputeShaderKey(dir / kLibraries[0], kArguments, kCompiler);
+    const ShaderKey pass2 = ComputeShaderKey(dir / kLibraries[1], kArguments, kCompiler);
+    const ShaderKey miss = ComputeShaderKey(dir / kLibraries[3], kArguments, kCompiler);
+    const fs::path pass1Path = cache.EntryPath(Stem(kLibraries[0]), pass1.value);
+    fs::resize_file(pass1Path, fs::file_size(pass1Path) / 2, error);
+    {
+        const fs::path path = cache.EntryPath(Stem(kLibraries[1]), pass2.value);
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(fs::file_size(path) - 3));
+        file.put('#');
+    }
+    fs::copy_file(cache.EntryPath(Stem(kLibraries[4]), ComputeShaderKey(dir / kLibraries[4], kArguments, kCompiler).value),
+                  cache.EntryPath(Stem(kLibraries[3]), miss.value), fs::copy_options::overwrite_existing, error);
+    std::vector<uint8_t> blob;
+    Check(!cache.Load(Stem(kLibraries[0]), pass1.value, blob), "a truncated entry is not loaded");
+    Check(!cache.Load(Stem(kLibraries[1]), pass2.value, blob), "a corrupted entry is not loaded");
+    Check(!cache.Load(Stem(kLibraries[3]), miss.value, blob), "an entry under another key is not loaded");
+    Check(cache.Stats().rejected == 3 && cache.Stats().hits == 0, "damaged entries counted as rejected");
+    launch = Run(dir, cacheDir);
+    std::printf("  damaged:      %u loaded, %u compiled\n", launch.loaded, launch.compiled);
+    Check(launch.compiled == 3, "damaged entries are compiled again");
+    launch = Run(dir, cacheDir);
+    Check(launch.loaded == kLibraryCount, "and loaded afterwards");
+    fs::remove_all(cacheDir, error);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+#ifdef PATHTRACER_ASSET_DIR
+    const fs::path includeDir = argc > 1 ? fs::path(argv[1]) : fs::path(PATHTRACER_ASSET_DIR);
+#else
+    const fs::path includeDir = argc > 1 ? fs::path(argv[1]) : fs::path("include");
+#endif
+    Closures(includeDir);
+    const fs::path work = fs::temp_directory_path() / "ShaderCacheCheck";
+    const fs::path dir = work / "include";
+    if (!CopySources(includeDir, dir)) {
+        std::printf("  FAILED: cannot copy %s\n", includeDir.string().c_str());
+        return 1;
+    }
+    Dependencies(dir);
+    CopySources(includeDir, dir);
+    Launches(dir, work / "ShaderCache");
+    std::error_code error;
+    fs::remove_all(work, error);
+    std::printf("ShaderCache checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,256 @@
+// Checks of the ReSTIR shader permutations (ShaderPermutation.h) against the
+// shaders, without a compiler.
+//
+//   ShaderPermutation [includeDir] [shaderDir]
+//
+// Every define a permutation can set has to be guarded by #ifndef in
+// Common_v6.hlsl and Common_v7.hlsl, so -D wins, and its value there has to
+// be the RestirSettings default, so the shipped permutation and the CPU port
+// agree. The presets' -D arguments, ids and float literals are checked, then
+// the variants are run through a shader cache as the renderer does when
+// cycling presets: each variant compiles once, variants of one library live
+// side by side, and an edit replaces only stale entries. Any failure makes the
+// exit code 1.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../src/Render/ShaderPermutation.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::vector<std::string> kLibraries = {
+    "RayGen_v6_pass1.hlsl", "RayGen_v6_pass2.hlsl", "RayGen_v6_pass3.hlsl",
+    "Miss_v6.hlsl",         "Hit_v6.hlsl",          "ShadowRay.hlsl",
+};
+const std::vector<std::string> kArguments = {"-Zi", "-O3", "-HV", "2021", "lib_6_7"};
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+// Numeric value of a define ("5.0f", "128")
+double Value(const std::string& text) {
+    std::string number = text;
+    if (!number.empty() && (number.back() == 'f' || number.back() == 'F')) {
+        number.pop_back();
+    }
+    return std::strtod(number.c_str(), nullptr);
+}
+
+void Guards(const fs::path& common) {
+    std::printf("%s\n", common.filename().string().c_str());
+    std::ifstream file(common);
+    if (!file.good()) {
+        std::printf("  FAILED: cannot open %s\n", common.string().c_str());
+        g_failures++;
+        return;
+    }
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) {
+        lines.push_back(line);
+    }
+    for (const ShaderDefine& define : RestirDefines(RestirSettings{})) {
+        bool guarded = false, found = false;
+        std::string value;
+        for (size_t i = 0; i < lines.size(); i++) {
+            std::istringstream words(lines[i]);
+            std::string directive, name;
+            words >> directive >> name;
+            if (directive == "#define" && name == define.name) {
+                found = true;
+                words >> value;
+                guarded = i > 0 && lines[i - 1].find("#ifndef " + define.name) == 0 && i + 1 < lines.size() &&
+                          lines[i + 1].find("#endif") == 0;
+            }
+        }
+        std::printf("  %-24s %-6s %s\n", define.name.c_str(), value.c_str(),
+                    !found ? "missing" : guarded ? "guarded" : "NOT GUARDED");
+        Check(found && guarded, "the define is guarded by #ifndef");
+        Check(found && Value(value) == Value(define.value), "shader value is the RestirSettings default");
+    }
+}
+
+void Presets() {
+    std::printf("presets\n");
+    const std::vector<ShaderPermutation> presets = RestirPresets();
+    Check(presets.size() >= 2 && presets[0].defines.empty(), "the shipped preset comes first");
+    Check(presets[0].Id() == 0 && presets[0].Arguments().empty() && presets[0].CacheSuffix().empty(),
+          "the shipped preset adds nothing");
+    const size_t defineCount = RestirDefines(RestirSettings{}).size();
+    for (size_t p = 0; p < presets.size(); p++) {
+        const ShaderPermutation& preset = presets[p];
+        const std::vector<std::string> arguments = preset.Arguments();
+        std::string changed;
+        const std::vector<ShaderDefine> defaults = RestirDefines(RestirSettings{});
+        for (size_t d = 0; d < preset.defines.size(); d++) {
+            if (preset.defines[d].value != defaults[d].value) {
+                changed += " " + preset.defines[d].name + "=" + preset.defines[d].value;
+            }
+        }
+        std::printf("  %-12s %016llx%s\n", preset.name.c_str(), static_cast<unsigned long long>(preset.Id()),
+                    changed.c_str());
+        if (p == 0) {
+            continue;
+        }
+        Check(preset.defines.size() == defineCount, "a preset sets every define");
+        Check(arguments.size() == 2 * preset.defines.size(), "one -D pair per define");
+        for (size_t a = 0; a + 1 < arguments.size(); a += 2) {
+            Check(arguments[a] == "-D" && arguments[a + 1].find('=') != std::string::npos, "-D name=value");
+        }
+        for (const ShaderDefine& define : preset.defines) {
+            Check(Value(define.value) >= 0.0 && !define.value.empty(), "values are literals");
+        }
+        for (size_t o = 0; o < p; o++) {
+            Check(presets[o].Id() != preset.Id() && presets[o].CacheSuffix() != preset.CacheSuffix(),
+                  "presets have their own ids");
+        }
+        ShaderPermutation renamed = preset;
+        renamed.name += " copy";
+        Check(renamed.Id() == preset.Id(), "the id depends on the defines only");
+    }
+
+    // Float literals: a decimal point or exponent, an f, the same float back
+    for (float v : {1.0f, 5.0f, 0.09f, 0.1f, 1e-7f, 123456.0f, 2.5e10f}) {
+        const std::string literal = shader_permutation_detail::FloatLiteral(v);
+        Check(literal.back() == 'f' && literal.find_first_of(".e") != std::string::npos, "HLSL float literal");
+        Check(static_cast<float>(Value(literal)) == v, "the literal reads back as the value");
+    }
+    Check(shader_permutation_detail::FloatLiteral(0.09f) == "0.09f", "shortest literal");
+}
+
+std::vector<std::string> PermutationArguments(const ShaderPermutation& permutation) {
+    std::vector<std::string> arguments = kArguments;
+    for (const std::string& argument : permutation.Arguments()) {
+        arguments.push_back(argument);
+    }
+    return arguments;
+}
+
+// CompileShaderLibraries with a stand-in compiler and the renderer's in-memory
+// variants; returns the libraries compiled (not loaded)
+uint32_t Select(const fs::path& dir, const ShaderPermutation& permutation, ShaderCache& cache,
+                std::map<uint64_t, int>& variants) {
+    if (variants.count(permutation.Id())) {
+        return 0;
+    }
+    variants[permutation.Id()] = 1;
+    uint32_t compiled = 0;
+    for (const std::string& library : kLibraries) {
+        const ShaderKey key = ComputeShaderKey(dir / library, PermutationArguments(permutation), std::string("dxc"));
+        const std::string name = fs::path(library).stem().string() + permutation.CacheSuffix();
+        std::vector<uint8_t> blob;
+        if (!cache.Load(name, key.value, blob)) {
+            const std::string stand = name + std::to_string(key.value);
+            cache.Store(name, key.value, stand.data(), stand.size());
+            compiled++;
+        }
+    }
+    return compiled;
+}
+
+size_t Entries(const fs::path& cacheDir) {
+    size_t count = 0;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(cacheDir, error)) {
+        count += entry.path().extension() == ".dxil" ? 1 : 0;
+    }
+    return count;
+}
+
+void Switching(const fs::path& includeDir) {
+    std::printf("switching presets\n");
+    const fs::path work = fs::temp_directory_path() / "ShaderPermutationCheck";
+    const fs::path dir = work / "include";
+    const fs::path cacheDir = work / "ShaderCache";
+    std::error_code error;
+    fs::remove_all(work, error);
+    fs::create_directories(dir, error);
+    for (const auto& entry : fs::directory_iterator(includeDir, error)) {
+        if (entry.path().extension() == ".hlsl" || entry.path().extension() == ".h") {
+            fs::copy_file(entry.path(), dir / entry.path().filename(), error);
+        }
+    }
+
+    const std::vector<ShaderPermutation> presets = RestirPresets();
+    const size_t count = presets.size();
+    // Keys of one library differ between presets
+    for (size_t p = 0; p < count; p++) {
+        for (size_t o = 0; o < p; o++) {
+            Check(ComputeShaderKey(dir / kLibraries[0], PermutationArguments(presets[p]), std::string("dxc")).value !=
+                      ComputeShaderKey(dir / kLibraries[0], PermutationArguments(presets[o]), std::string("dxc")).value,
+                  "presets compile to different keys");
+        }
+    }
+
+    // One run cycling through the presets twice: every variant compiles once
+    {
+        ShaderCache cache(cacheDir);
+        std::map<uint64_t, int> variants;
+        uint32_t compiled = 0;
+        for (size_t press = 0; press < 2 * count; press++) {
+            compiled += Select(dir, presets[press % count], cache, variants);
+        }
+        std::printf("  first run:  %u libraries compiled for %zu presets, %zu entries\n", compiled, count,
+                    Entries(cacheDir));
+        Check(compiled == count * kLibraries.size(), "each variant compiles once");
+        Check(Entries(cacheDir) == count * kLibraries.size(), "the variants of a library live side by side");
+    }
+    // The next run loads every preset
+    {
+        ShaderCache cache(cacheDir);
+        std::map<uint64_t, int> variants;
+        uint32_t compiled = 0;
+        for (size_t p = 0; p < count; p++) {
+            compiled += Select(dir, presets[p], cache, variants);
+        }
+        std::printf("  next run:   %u compiled, %u loaded\n", compiled, cache.Stats().hits);
+        Check(compiled == 0, "the next run loads every preset");
+    }
+    // An edit of the miss shader: its variants are replaced, not added
+    {
+        std::ofstream(dir / "Miss_v6.hlsl", std::ios::app) << "// edited\n";
+        ShaderCache cache(cacheDir);
+        std::map<uint64_t, int> variants;
+        uint32_t compiled = 0;
+        for (size_t p = 0; p < count; p++) {
+            compiled += Select(dir, presets[p], cache, variants);
+        }
+        std::printf("  after edit: %u compiled, %u stale entries removed\n", compiled, cache.Stats().pruned);
+        Check(compiled == count && cache.Stats().pruned == count, "an edit replaces the stale variants only");
+        Check(Entries(cacheDir) == count * kLibraries.size(), "entry count unchanged");
+    }
+    fs::remove_all(work, error);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+#ifdef PATHTRACER_ASSET_DIR
+    const fs::path includeDir = argc > 1 ? fs::path(argv[1]) : fs::path(PATHTRACER_ASSET_DIR);
+    const fs::path shaderDir = argc > 2 ? fs::path(argv[2]) : fs::path(PATHTRACER_ASSET_DIR) / ".." / "shaders";
+#else
+    const fs::path includeDir = argc > 1 ? fs::path(argv[1]) : fs::path("include");
+    const fs::path shaderDir = argc > 2 ? fs::path(argv[2]) : fs::path("shaders");
+#endif
+    Guards(includeDir / "Common_v6.hlsl");
+    Guards(shaderDir / "Common_v7.hlsl");
+    Presets();
+    Switching(includeDir);
+    std::printf("ShaderPermutation checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
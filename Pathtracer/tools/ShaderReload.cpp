@@ -0,0 +1,303 @@
+// Checks of shader hot reload (ShaderReload.h) on the renderer's ray tracing
+// libraries, without a compiler or a GPU.
+//
+//   ShaderReload [includeDir]
+//
+// Works on a copy of the include directory. Every file is touched in turn and
+// a poll has to report exactly the libraries whose include closure holds it,
+// once. Adding an #include of a file that does not exist yet, creating it,
+// editing it, dropping the #include again and deleting files have to be
+// followed. The schedule is run on a made-up clock: changes settle before a
+// build starts, one build runs at a time, and the libraries of a failed build
+// come back with the next change. Last, the renderer's loop is played with a
+// stand-in compiler on a background thread: frames keep coming while a build
+// runs, the pipeline is swapped between frames with the blobs of the edited
+// sources, the frame history is never reset, and a build with errors leaves
+// the running libraries in place until the source is fixed. Any failure makes
+// the exit code 1.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "../src/Render/ShaderReload.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Renderer.cpp, kShaderLibraries
+const std::vector<std::string> kLibraries = {
+    "RayGen_v6_pass1.hlsl", "RayGen_v6_pass2.hlsl", "RayGen_v6_pass3.hlsl",
+    "Miss_v6.hlsl",         "Hit_v6.hlsl",          "ShadowRay.hlsl",
+};
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+// Moves the write time of a file forward; a real save may land in the same
+// clock tick as the last poll on coarse file systems
+void Touch(const fs::path& file) {
+    static int seconds = 0;
+    std::error_code error;
+    const fs::file_time_type time = fs::last_write_time(file, error);
+    fs::last_write_time(file, time + std::chrono::seconds(++seconds), error);
+}
+
+void Append(const fs::path& file, const std::string& text) {
+    std::ofstream(file, std::ios::app) << text;
+    Touch(file);
+}
+
+void Write(const fs::path& file, const std::string& text) {
+    std::ofstream(file, std::ios::trunc) << text;
+    Touch(file);
+}
+
+std::string Read(const fs::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+std::string Names(const std::vector<uint32_t>& libraries) {
+    std::string names;
+    for (uint32_t library : libraries) {
+        names += (names.empty() ? "" : " ") + fs::path(kLibraries[library]).stem().string();
+    }
+    return names.empty() ? "(none)" : names;
+}
+
+// The libraries whose closure holds file, from the keys of the cache
+std::vector<uint32_t> Closures(const fs::path& dir, const fs::path& file) {
+    std::vector<uint32_t> libraries;
+    for (uint32_t library = 0; library < kLibraries.size(); library++) {
+        const ShaderKey key = ComputeShaderKey(dir / kLibraries[library], std::vector<std::string>{}, std::string());
+        if (std::find(key.files.begin(), key.files.end(), file.lexically_normal()) != key.files.end()) {
+            libraries.push_back(library);
+        }
+    }
+    return libraries;
+}
+
+fs::path CopyIncludes(const fs::path& includeDir, const char* name) {
+    const fs::path dir = fs::temp_directory_path() / name;
+    std::error_code error;
+    fs::remove_all(dir, error);
+    fs::create_directories(dir, error);
+    for (const auto& entry : fs::directory_iterator(includeDir, error)) {
+        if (entry.path().extension() == ".hlsl" || entry.path().extension() == ".h") {
+            fs::copy_file(entry.path(), dir / entry.path().filename(), error);
+        }
+    }
+    return dir;
+}
+
+void Watch(const fs::path& includeDir) {
+    std::printf("dependencies\n");
+    const fs::path dir = CopyIncludes(includeDir, "ShaderReloadWatch");
+    ShaderWatch watch(dir, kLibraries);
+    Check(watch.Poll().empty(), "nothing changed after the first scan");
+
+    std::vector<fs::path> files;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(dir, error)) {
+        files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    for (const fs::path& file : files) {
+        Touch(file);
+        const std::vector<uint32_t> changed = watch.Poll();
+        std::printf("  %-28s %s\n", file.filename().string().c_str(), Names(changed).c_str());
+        Check(changed == Closures(dir, file), "a touched file reports the libraries that include it");
+        Check(changed == watch.Dependents(file), "Dependents agrees with the poll");
+        Check(watch.Poll().empty(), "a change is reported once");
+    }
+
+    std::printf("include edits\n");
+    const fs::path miss = dir / "Miss_v6.hlsl";
+    const fs::path added = dir / "ReloadAdded.hlsl";
+    const std::string missSource = Read(miss);
+    Append(miss, "\n#include \"ReloadAdded.hlsl\"\n");
+    Check(watch.Poll() == std::vector<uint32_t>{3}, "the edited library");
+    Check(watch.Dependents(added) == std::vector<uint32_t>{3}, "an include that does not exist yet is watched");
+    Write(added, "// added\n");
+    Check(watch.Poll() == std::vector<uint32_t>{3}, "creating the include");
+    Append(added, "// edited\n");
+    Check(watch.Poll() == std::vector<uint32_t>{3}, "editing the include");
+    Write(miss, missSource);
+    Check(watch.Poll() == std::vector<uint32_t>{3}, "dropping the include");
+    Append(added, "// edited again\n");
+    Check(watch.Poll().empty() && watch.Dependents(added).empty(), "a dropped include is no longer watched");
+
+    const fs::path common = dir / "Common_v6.hlsl";
+    const std::string commonSource = Read(common);
+    const std::vector<uint32_t> dependents = watch.Dependents(common);
+    fs::remove(common, error);
+    const std::vector<uint32_t> removed = watch.Poll();
+    std::printf("  removing Common_v6.hlsl:    %s\n", Names(removed).c_str());
+    Check(!removed.empty() && removed == dependents, "removing a file reports its dependents");
+    Write(common, commonSource);
+    Check(watch.Poll() == dependents, "restoring it as well");
+    fs::remove_all(dir, error);
+}
+
+void Schedule() {
+    std::printf("schedule\n");
+    ShaderReloadSchedule schedule(250.0);
+    Check(schedule.Start(0.0).empty(), "nothing to build");
+    // An editor saving in two writes
+    schedule.Changed({3}, 1000.0);
+    schedule.Changed({3, 4}, 1100.0);
+    Check(schedule.Start(1200.0).empty(), "changes settle first");
+    const std::vector<uint32_t> first = schedule.Start(1350.0);
+    Check(first == std::vector<uint32_t>{3, 4}, "the changed libraries, once each");
+    Check(schedule.Building() && schedule.Start(5000.0).empty(), "nothing else starts with no change");
+    schedule.Changed({0}, 1400.0);
+    Check(schedule.Start(5000.0).empty(), "one build at a time");
+    schedule.Finished(true);
+    Check(schedule.Start(5000.0) == std::vector<uint32_t>{0}, "changes made during a build wait for the next");
+    schedule.Finished(false);
+    Check(schedule.Start(9000.0).empty(), "a failed build is not retried on the same sources");
+    schedule.Changed({5}, 9000.0);
+    Check(schedule.Start(9300.0) == std::vector<uint32_t>{0, 5}, "failed libraries come back with the next change");
+    schedule.Finished(true);
+    Check(schedule.Stats().builds == 3 && schedule.Stats().failures == 1 && schedule.Stats().changes == 4,
+          "schedule counters");
+}
+
+// The stand-in "blob" of a library: a hash of its closure, or an error when
+// the source has one
+struct StandInJob {
+    std::vector<uint32_t> libraries;
+    std::vector<uint64_t> blobs;
+    std::string errors;
+};
+
+uint64_t StandInBlob(const fs::path& shader, std::string& errors) {
+    const ShaderKey key = ComputeShaderKey(shader, std::vector<std::string>{}, std::string("stand-in"));
+    for (const fs::path& file : key.files) {
+        if (Read(file).find("#error") != std::string::npos) {
+            errors += file.filename().string() + ": error\n";
+        }
+    }
+    // A compile costs a few ms
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return key.value;
+}
+
+void Loop(const fs::path& includeDir) {
+    std::printf("renderer loop\n");
+    using Clock = std::chrono::steady_clock;
+    const fs::path dir = CopyIncludes(includeDir, "ShaderReloadLoop");
+    std::vector<uint64_t> pipeline(kLibraries.size());
+    std::string errors;
+    for (uint32_t library = 0; library < kLibraries.size(); library++) {
+        pipeline[library] = StandInBlob(dir / kLibraries[library], errors);
+    }
+    ShaderWatch watch(dir, kLibraries);
+    ShaderReloadSchedule schedule(50.0);
+    std::future<StandInJob> job;
+    uint64_t history = 0; // frames accumulated; a reload must not reset it
+    uint32_t swaps = 0, failed = 0, framesDuringBuilds = 0;
+
+    // Renderer::UpdateShaderReload and FinishShaderReload
+    auto frame = [&]() {
+        if (job.valid() && job.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            StandInJob done = job.get();
+            schedule.Finished(done.errors.empty());
+            if (done.errors.empty()) {
+                for (size_t i = 0; i < done.libraries.size(); i++) {
+                    pipeline[done.libraries[i]] = done.blobs[i];
+                }
+                swaps++;
+            } else {
+                failed++;
+            }
+        }
+        const double now = std::chrono::duration<double, std::milli>(Clock::now().time_since_epoch()).count();
+        schedule.Changed(watch.Poll(), now);
+        const std::vector<uint32_t> libraries = schedule.Start(now);
+        if (!libraries.empty()) {
+            job = std::async(std::launch::async, [&dir, libraries]() {
+                StandInJob build;
+                build.libraries = libraries;
+                for (uint32_t library : libraries) {
+                    build.blobs.push_back(StandInBlob(dir / kLibraries[library], build.errors));
+                }
+                return build;
+            });
+        }
+        framesDuringBuilds += schedule.Building() ? 1 : 0;
+        history++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    };
+    // Frames until nothing is pending or building, at most a few seconds
+    auto settle = [&]() {
+        const Clock::time_point start = Clock::now();
+        do {
+            frame();
+        } while ((schedule.Building() || schedule.Pending()) && Clock::now() - start < std::chrono::seconds(10));
+    };
+    auto current = [&]() {
+        std::string ignored;
+        std::vector<uint64_t> blobs;
+        for (const std::string& library : kLibraries) {
+            blobs.push_back(StandInBlob(dir / library, ignored));
+        }
+        return blobs;
+    };
+
+    // An edit of the shared header reloads every library depending on it
+    const fs::path common = dir / "Common_v6.hlsl";
+    Append(common, "// tuning\n");
+    settle();
+    std::printf("  edit:        %u swaps, %u frames rendered during the build\n", swaps, framesDuringBuilds);
+    Check(swaps == 1 && pipeline == current(), "the edited sources are swapped in");
+    Check(framesDuringBuilds > 0, "frames go on while the build runs");
+
+    // A broken edit keeps the running libraries, the fix reloads
+    const fs::path hit = dir / "Hit_v6.hlsl";
+    const std::string hitSource = Read(hit);
+    const std::vector<uint64_t> before = pipeline;
+    Append(hit, "#error broken\n");
+    settle();
+    std::printf("  broken edit: %u failed builds\n", failed);
+    Check(failed == 1 && pipeline == before, "a failed build keeps the running libraries");
+    Write(hit, hitSource + "// fixed\n");
+    settle();
+    std::printf("  fix:         %u swaps\n", swaps);
+    Check(swaps == 2 && pipeline == current(), "the fix is swapped in");
+    Check(history > framesDuringBuilds && schedule.Stats().builds == 3, "the frame history runs on through reloads");
+    std::error_code error;
+    fs::remove_all(dir, error);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+#ifdef PATHTRACER_ASSET_DIR
+    const fs::path includeDir = argc > 1 ? fs::path(argv[1]) : fs::path(PATHTRACER_ASSET_DIR);
+#else
+    const fs::path includeDir = argc > 1 ? fs::path(argv[1]) : fs::path("include");
+#endif
+    Watch(includeDir);
+    Schedule();
+    Loop(includeDir);
+    std::printf("ShaderReload checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,340 @@
+// Fuzz test and benchmark of the TLSF heap suballocator (Tlsf.h), without a
+// device.
+//
+//   TlsfAllocator [operations] [heapMB]
+//
+// Fuzz: random Allocate / Free of placed-resource sized requests (256 B to
+// 8 MB, 256 B / 4 KB / 64 KB aligned) against a shadow map of the live
+// ranges. Every allocation is checked to be aligned, inside the heap and
+// disjoint from the live ones, the block structure is validated as it goes,
+// and freeing everything has to leave one free block again. Then the
+// renderer's load is replayed (static buffers, BLAS scratch shared by the
+// builds and returned after the load, constants placed after it), and
+// Allocate + Free are timed against a first-fit free list. Any failure makes
+// the exit code 1.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#include "../src/Render/Rng.h"
+#include "../src/Render/Tlsf.h"
+
+namespace {
+
+// D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, what placed buffers get
+constexpr uint64_t kPlacement = 64 << 10;
+
+uint32_t g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("  FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+struct Live {
+    TlsfAllocation allocation;
+    uint64_t size;
+};
+
+void Fuzz(uint32_t operations, uint64_t capacity) {
+    std::printf("fuzz: %u operations in a %llu MB heap\n", operations,
+                static_cast<unsigned long long>(capacity >> 20));
+    TlsfAllocator tlsf(capacity);
+    std::map<uint64_t, uint64_t> ranges; // offset -> end of the live allocations
+    std::vector<Live> live;
+    glm::uvec2 seed(3u, 7u);
+    uint32_t failures = 0, full = 0, missedFits = 0;
+    double fragmentation = 0.0;
+    uint32_t fragmentationSamples = 0;
+    auto fail = [&](const char* what) {
+        if (failures++ < 8) {
+            std::printf("  FAILED: %s\n", what);
+        }
+    };
+
+    for (uint32_t op = 0; op < operations; op++) {
+        if (live.empty() || RandomFloat(seed) < 0.52f) {
+            // Log-uniform sizes, most requests small
+            const uint64_t size = static_cast<uint64_t>(256.0 * std::pow(2.0, RandomFloat(seed) * 15.0));
+            const float a = RandomFloat(seed);
+            const uint64_t alignment = a < 0.5f ? 256 : a < 0.8f ? 4096 : kPlacement;
+            const uint64_t largestBefore = tlsf.Stats().largestFree;
+            const TlsfAllocation allocation = tlsf.Allocate(size, alignment);
+            if (allocation.offset == kTlsfNone) {
+                full++;
+                // Good fit rounds requests up to a size class: a block that
+                // would fit exactly may be passed over, a much larger one not
+                if (largestBefore >= 2 * (size + alignment)) {
+                    fail("no block found although a much larger one is free");
+                } else if (largestBefore >= size + alignment) {
+                    missedFits++;
+                }
+                continue;
+            }
+            if (allocation.offset % alignment != 0 || allocation.offset + size > capacity ||
+                allocation.size < size) {
+                fail("misplaced allocation");
+            }
+            auto next = ranges.lower_bound(allocation.offset);
+            if ((next != ranges.end() && next->first < allocation.offset + size) ||
+                (next != ranges.begin() && std::prev(next)->second > allocation.offset)) {
+                fail("overlaps a live allocation");
+            }
+            ranges[allocation.offset] = allocation.offset + size;
+            live.push_back({allocation, size});
+        } else {
+            const size_t index = static_cast<size_t>(RandomFloat(seed) * live.size()) % live.size();
+            tlsf.Free(live[index].allocation);
+            ranges.erase(live[index].allocation.offset);
+            live[index] = live.back();
+            live.pop_back();
+        }
+        if (op % 997 == 0) {
+            if (!tlsf.Validate()) {
+                fail("block structure broken");
+            }
+            const TlsfStats stats = tlsf.Stats();
+            uint64_t used = 0;
+            for (const Live& l : live) {
+                used += l.allocation.size;
+            }
+            if (stats.usedBytes != used || stats.liveBlocks != live.size()) {
+                fail("stats differ from the live allocations");
+            }
+            fragmentation += stats.Fragmentation();
+            fragmentationSamples++;
+        }
+    }
+    const TlsfStats stats = tlsf.Stats();
+    std::printf("  %llu allocations, %u without a block (%u of them with an exact fit free)\n",
+                static_cast<unsigned long long>(stats.allocations), full, missedFits);
+    std::printf("  at the end: %u live, %.1f MB used, %u free blocks, largest %.1f MB, fragmentation %.2f "
+                "(mean %.2f)\n",
+                stats.liveBlocks, stats.usedBytes / 1048576.0, stats.freeBlocks, stats.largestFree / 1048576.0,
+                stats.Fragmentation(), fragmentationSamples ? fragmentation / fragmentationSamples : 0.0);
+
+    for (const Live& l : live) {
+        tlsf.Free(l.allocation);
+    }
+    const TlsfStats empty = tlsf.Stats();
+    if (!tlsf.Validate() || empty.freeBlocks != 1 || empty.largestFree != tlsf.Capacity() || empty.usedBytes != 0) {
+        fail("freeing everything does not give back one block");
+    }
+    g_failures += failures;
+}
+
+// Renderer::CreatePlacedBuffer: first heap with room, else a new heap of
+// capacity bytes, or of the buffer's size if it is larger
+struct HeapSet {
+    explicit HeapSet(uint64_t heapCapacity) : capacity(heapCapacity) {}
+
+    uint64_t capacity;
+    std::vector<TlsfAllocator> heaps;
+    uint64_t highWater = 0; // end of the highest placed buffer, over all heaps
+
+    struct Placed {
+        size_t heap;
+        TlsfAllocation allocation;
+    };
+
+    Placed Place(uint64_t size) {
+        size = (size + kPlacement - 1) / kPlacement * kPlacement; // GetResourceAllocationInfo
+        Placed placed = {0, {}};
+        for (; placed.heap < heaps.size(); placed.heap++) {
+            placed.allocation = heaps[placed.heap].Allocate(size, kPlacement);
+            if (placed.allocation.offset != kTlsfNone) {
+                break;
+            }
+        }
+        if (placed.heap == heaps.size()) {
+            heaps.emplace_back(std::max(capacity, size), kPlacement);
+            placed.allocation = heaps.back().Allocate(size, kPlacement);
+        }
+        Check(placed.allocation.offset != kTlsfNone, "buffer placed");
+        uint64_t before = 0;
+        for (size_t h = 0; h < placed.heap; h++) {
+            before += heaps[h].Capacity();
+        }
+        highWater = std::max(highWater, before + placed.allocation.offset + placed.allocation.size);
+        return placed;
+    }
+
+    void Release(const Placed& placed) { heaps[placed.heap].Free(placed.allocation); }
+};
+
+void RendererLoad(uint64_t capacity) {
+    // Placed buffers of the renderer with garage.obj + monke.obj, roughly
+    // (vertex / index buffers, materials, material IDs, emissive triangles);
+    // the acceleration structure sizes are estimates, the driver decides
+    const std::vector<uint64_t> statics = {48ull << 20, 16ull << 20, 1ull << 20, 256 << 10,
+                                           2ull << 20, 1ull << 20, 4ull << 20};
+    const std::vector<uint64_t> blasScratch = {300 << 10, 26ull << 20};
+    const std::vector<uint64_t> blasResult = {400 << 10, 30ull << 20};
+    // TLAS scratch and result, then camera and instance constants
+    const std::vector<uint64_t> tlas = {64 << 10, 64 << 10};
+    const std::vector<uint64_t> after = {512, 768};
+
+    std::printf("renderer load, %llu MB heaps\n", static_cast<unsigned long long>(capacity >> 20));
+    for (bool shared : {false, true}) {
+        HeapSet set(capacity);
+        for (uint64_t size : statics) {
+            set.Place(size);
+        }
+        // BLAS builds: a scratch each, kept until the function returns, or
+        // one scratch grown to the largest build and released after the flush
+        std::vector<HeapSet::Placed> scratch;
+        uint64_t scratchSize = 0;
+        for (size_t i = 0; i < blasScratch.size(); i++) {
+            if (!shared || blasScratch[i] > scratchSize) {
+                scratch.push_back(set.Place(blasScratch[i]));
+                scratchSize = blasScratch[i];
+            }
+            set.Place(blasResult[i]);
+        }
+        for (uint64_t size : tlas) {
+            set.Place(size);
+        }
+        if (shared) {
+            for (const HeapSet::Placed& p : scratch) {
+                set.Release(p);
+            }
+        }
+        for (uint64_t size : after) {
+            set.Place(size);
+        }
+
+        uint64_t heapBytes = 0, used = 0, freeBytes = 0, largest = 0;
+        for (const TlsfAllocator& heap : set.heaps) {
+            Check(heap.Validate(), "block structure after the load");
+            const TlsfStats stats = heap.Stats();
+            heapBytes += heap.Capacity();
+            used += stats.usedBytes;
+            freeBytes += stats.freeBytes;
+            largest = std::max(largest, stats.largestFree);
+        }
+        std::printf("  %-26s %zu heaps, %6.1f MB, high water %6.1f MB, used %6.1f MB, "
+                    "largest free %6.1f of %6.1f MB\n",
+                    shared ? "shared BLAS scratch, freed" : "BLAS scratch each, kept", set.heaps.size(),
+                    heapBytes / 1048576.0, set.highWater / 1048576.0, used / 1048576.0, largest / 1048576.0,
+                    freeBytes / 1048576.0);
+    }
+}
+
+// First-fit over a sorted free list, what the allocator is compared with
+class FirstFit {
+public:
+    explicit FirstFit(uint64_t capacity) { m_free.push_back({0, capacity}); }
+
+    uint64_t Allocate(uint64_t size, uint64_t alignment) {
+        for (size_t i = 0; i < m_free.size(); i++) {
+            const uint64_t aligned = (m_free[i].first + alignment - 1) & ~(alignment - 1);
+            if (aligned + size > m_free[i].first + m_free[i].count) {
+                continue;
+            }
+            const Range range = m_free[i];
+            m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i));
+            if (range.first + range.count > aligned + size) {
+                m_free.insert(m_free.begin() + static_cast<std::ptrdiff_t>(i),
+                              {aligned + size, range.first + range.count - aligned - size});
+            }
+            if (aligned > range.first) {
+                m_free.insert(m_free.begin() + static_cast<std::ptrdiff_t>(i), {range.first, aligned - range.first});
+            }
+            return aligned;
+        }
+        return kTlsfNone;
+    }
+
+    void Free(uint64_t first, uint64_t count) {
+        size_t i = 0;
+        while (i < m_free.size() && m_free[i].first < first) {
+            i++;
+        }
+        m_free.insert(m_free.begin() + static_cast<std::ptrdiff_t>(i), {first, count});
+        if (i + 1 < m_free.size() && m_free[i].first + m_free[i].count == m_free[i + 1].first) {
+            m_free[i].count += m_free[i + 1].count;
+            m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i + 1));
+        }
+        if (i > 0 && m_free[i - 1].first + m_free[i - 1].count == m_free[i].first) {
+            m_free[i - 1].count += m_free[i].count;
+            m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+    }
+
+private:
+    struct Range {
+        uint64_t first, count;
+    };
+    std::vector<Range> m_free;
+};
+
+template <class Allocate, class Free>
+double TimePairs(uint32_t liveCount, uint32_t pairs, Allocate allocate, Free free) {
+    glm::uvec2 seed(9u, 1u);
+    std::vector<uint64_t> sizes(liveCount);
+    std::vector<uint32_t> slots(liveCount);
+    for (uint32_t i = 0; i < liveCount; i++) {
+        sizes[i] = 256 + static_cast<uint64_t>(RandomFloat(seed) * 65536.0f) / 256 * 256;
+        slots[i] = allocate(i, sizes[i]);
+    }
+    // Replace a random live allocation with a new one of a new size
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t p = 0; p < pairs; p++) {
+        const uint32_t i = static_cast<uint32_t>(RandomFloat(seed) * liveCount) % liveCount;
+        free(i, sizes[i]);
+        sizes[i] = 256 + static_cast<uint64_t>(RandomFloat(seed) * 65536.0f) / 256 * 256;
+        allocate(i, sizes[i]);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    return seconds * 1e9 / pairs;
+}
+
+void Benchmark() {
+    std::printf("Allocate + Free, ns per pair\n");
+    std::printf("  %8s %10s %10s\n", "live", "tlsf", "first fit");
+    constexpr uint64_t kCapacity = 1ull << 30;
+    for (uint32_t liveCount : {64u, 1024u, 8192u}) {
+        const uint32_t pairs = 200000;
+        TlsfAllocator tlsf(kCapacity);
+        std::vector<TlsfAllocation> tlsfLive(liveCount);
+        const double tlsfNs = TimePairs(
+            liveCount, pairs,
+            [&](uint32_t i, uint64_t size) {
+                tlsfLive[i] = tlsf.Allocate(size, 256);
+                Check(tlsfLive[i].offset != kTlsfNone, "benchmark allocation");
+                return 0u;
+            },
+            [&](uint32_t i, uint64_t) { tlsf.Free(tlsfLive[i]); });
+
+        FirstFit firstFit(kCapacity);
+        std::vector<uint64_t> firstFitLive(liveCount);
+        const double firstFitNs = TimePairs(
+            liveCount, pairs / 10,
+            [&](uint32_t i, uint64_t size) {
+                firstFitLive[i] = firstFit.Allocate(size, 256);
+                return 0u;
+            },
+            [&](uint32_t i, uint64_t size) { firstFit.Free(firstFitLive[i], size); });
+        std::printf("  %8u %10.1f %10.1f\n", liveCount, tlsfNs, firstFitNs);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t operations = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1000000;
+    const uint64_t heapMB = argc > 2 ? static_cast<uint64_t>(std::atoll(argv[2])) : 256;
+    Fuzz(operations, heapMB << 20);
+    RendererLoad(heapMB << 20);
+    Benchmark();
+    std::printf("Tlsf checks: %s\n", g_failures ? "FAIL" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+// Checks and statistics of the upload ring allocator (UploadRing.h), without
+// a device.
+//
+//   UploadRing [frames] [capacityMB] [framesInFlight]
+//
+// Replays the renderer's use of the ring: a staged load of static buffers
+// (vertex / index / material data, in chunks of a quarter of the ring,
+// flushing the loading command list when it is full), then per frame the
+// camera constants and instance properties plus a random mix of transient
+// allocations. A frame's fence completes framesInFlight frames after it is
+// submitted. Every allocation is checked to be aligned, inside the buffer and
+// disjoint from every allocation whose frame has not retired; a full ring has
+// to accept the request after waiting for the GPU. Any failure makes the exit
+// code 1. Prints upload bytes per frame, peak use and padding while rendering,
+// the flushes the staged load needs and the cost of Allocate.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/Render/Rng.h"
+#include "../src/Render/UploadRing.h"
+
+namespace {
+
+// Renderer::m_cameraBufferSize, six matrices and the time rounded to 256
+constexpr uint64_t kCameraBytes = 512;
+// sizeof(Renderer::InstanceProperties) for each of the two instances
+constexpr uint64_t kInstanceBytes = 2 * 6 * 64;
+constexpr uint64_t kConstantAlignment = 256;
+// garage.obj + monke.obj vertex, index and material data, roughly
+constexpr uint64_t kStaticBytes = 96ull << 20;
+
+struct Live {
+    uint64_t offset, size, fenceValue;
+};
+
+class Checker {
+public:
+    uint32_t failures = 0;
+    uint64_t stalls = 0;
+
+    Checker(UploadRing& ring, uint32_t lag) : m_ring(ring), m_lag(lag) {}
+
+    // Allocates like the renderer: on a full ring, wait for the GPU and retry
+    uint64_t Allocate(uint64_t size, uint64_t alignment) {
+        uint64_t offset = m_ring.Allocate(size, alignment);
+        if (offset == kUploadRingFull) {
+            stalls++;
+            WaitIdle();
+            offset = m_ring.Allocate(size, alignment);
+            if (offset == kUploadRingFull) {
+                Fail("no room in an idle ring", size);
+                return offset;
+            }
+        }
+        if (offset % alignment != 0 || offset + size > m_ring.Capacity()) {
+            Fail("misplaced allocation", size);
+        }
+        for (const Live& live : m_live) {
+            if (offset < live.offset + live.size && live.offset < offset + size) {
+                Fail("overlaps a live allocation", size);
+                break;
+            }
+        }
+        m_live.push_back({offset, size, m_nextValue});
+        return offset;
+    }
+
+    // Submits the frame; the fence of the frame lag frames back completes
+    void EndFrame() {
+        m_ring.EndFrame(m_nextValue++);
+        if (m_nextValue > m_lag) {
+            Complete(m_nextValue - 1 - m_lag);
+        }
+    }
+
+    // FlushUploads / WaitForGpu: everything submitted and the open frame complete
+    void WaitIdle() {
+        m_ring.EndFrame(m_nextValue++);
+        Complete(m_nextValue - 1);
+    }
+
+private:
+    void Complete(uint64_t value) {
+        m_ring.Retire(value);
+        m_live.erase(std::remove_if(m_live.begin(), m_live.end(),
+                                    [&](const Live& live) { return live.fenceValue <= value; }),
+                     m_live.end());
+        uint64_t live = 0;
+        for (const Live& l : m_live) {
+            live += l.size;
+        }
+        if (live > m_ring.Used()) {
+            Fail("ring reports less use than is live", live);
+        }
+    }
+
+    void Fail(const char* what, uint64_t size) {
+        if (failures++ < 8) {
+            std::printf("  %s (%llu bytes)\n", what, static_cast<unsigned long long>(size));
+        }
+    }
+
+    UploadRing& m_ring;
+    uint32_t m_lag;
+    uint64_t m_nextValue = 1;
+    std::vector<Live> m_live;
+};
+
+struct Result {
+    uint64_t loadFlushes = 0;
+    double frameBytes = 0.0;
+    uint64_t framePeakUsed = 0; // after loading
+    uint64_t paddingBytes = 0;
+    uint64_t frameStalls = 0;
+    uint32_t failures = 0;
+};
+
+Result Run(uint64_t capacity, uint32_t frames, uint32_t framesInFlight, bool transient) {
+    UploadRing ring(capacity);
+    Checker checker(ring, framesInFlight);
+    Result result;
+
+    for (uint64_t done = 0; done < kStaticBytes;) {
+        const uint64_t chunk = std::min(kStaticBytes - done, capacity / 4);
+        checker.Allocate(chunk, 16);
+        done += chunk;
+    }
+    result.loadFlushes = checker.stalls;
+    checker.WaitIdle();
+    const uint64_t loadStalls = checker.stalls;
+    const uint64_t bytesBefore = ring.Stats().bytes;
+    const uint64_t paddingBefore = ring.Stats().paddingBytes;
+
+    glm::uvec2 seed(17u, 23u);
+    for (uint32_t f = 0; f < frames; f++) {
+        checker.Allocate(kCameraBytes, kConstantAlignment);
+        checker.Allocate(kInstanceBytes, kConstantAlignment);
+        if (transient) {
+            // Staging of a few small dynamic updates, up to 64 KB each
+            const uint32_t count = static_cast<uint32_t>(RandomFloat(seed) * 6.0f);
+            for (uint32_t i = 0; i < count; i++) {
+                const uint64_t size = 16 + static_cast<uint64_t>(RandomFloat(seed) * 65536.0f);
+                const uint64_t alignment = 4ull << static_cast<uint32_t>(RandomFloat(seed) * 8.0f);
+                checker.Allocate(size, alignment);
+            }
+        }
+        result.framePeakUsed = std::max(result.framePeakUsed, ring.Used());
+        checker.EndFrame();
+    }
+
+    result.frameBytes = static_cast<double>(ring.Stats().bytes - bytesBefore) / frames;
+    result.paddingBytes = ring.Stats().paddingBytes - paddingBefore;
+    result.frameStalls = checker.stalls - loadStalls;
+    result.failures = checker.failures;
+    return result;
+}
+
+double AllocateNs(uint64_t capacity) {
+    UploadRing ring(capacity);
+    constexpr uint32_t kFrames = 20000, kPerFrame = 64;
+    uint64_t sink = 0, value = 1;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t f = 0; f < kFrames; f++) {
+        for (uint32_t i = 0; i < kPerFrame; i++) {
+            sink += ring.Allocate(256 + 64 * (i & 7), 256);
+        }
+        ring.EndFrame(value++);
+        ring.Retire(value > 3 ? value - 3 : 0);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    volatile uint64_t keep = sink;
+    (void)keep;
+    return seconds * 1e9 / (static_cast<double>(kFrames) * kPerFrame);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 10000;
+    const uint64_t capacityMB = argc > 2 ? static_cast<uint64_t>(std::atoll(argv[2])) : 0;
+    const uint32_t framesInFlight = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 2;
+
+    std::vector<uint64_t> capacities = {1, 4, 32};
+    if (capacityMB > 0) {
+        capacities = {capacityMB};
+    }
+
+    uint32_t failures = 0;
+    std::printf("%u frames, %u in flight, %llu MB of static data staged at load\n", frames, framesInFlight,
+                static_cast<unsigned long long>(kStaticBytes >> 20));
+    std::printf("%8s %-10s %12s %12s %12s %12s %12s\n", "ring", "frames", "load flushes", "bytes/frame",
+                "peak KB", "padding B/f", "frame stalls");
+    for (uint64_t mb : capacities) {
+        for (bool transient : {false, true}) {
+            const Result r = Run(mb << 20, frames, framesInFlight, transient);
+            failures += r.failures;
+            std::printf("%6lluMB %-10s %12llu %12.0f %12.1f %12.0f %12llu\n", static_cast<unsigned long long>(mb),
+                        transient ? "+transient" : "constants", static_cast<unsigned long long>(r.loadFlushes),
+                        r.frameBytes, r.framePeakUsed / 1024.0, static_cast<double>(r.paddingBytes) / frames,
+                        static_cast<unsigned long long>(r.frameStalls));
+        }
+    }
+    std::printf("Allocate: %.1f ns\n", AllocateNs(4ull << 20));
+    std::printf("Ring checks: %s\n", failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}